@@ -9,6 +9,7 @@
 
 #include <optional>
 #include <string>
+#include <string_view>
 #include <utility>
 
 #include "AModule.hpp"
@@ -37,20 +38,16 @@ class ALabel : public AModule {
 
   // resolveTooltipFormat() / resolveFormat() are inherited from AModule.
 
-  // Combined label + tooltip helper. Builds a single fmt argument store from
-  // `args`, renders `labelFormat` into the label and the resolved tooltip format
-  // into the tooltip, both through the dedup-aware setters. Honors the `tooltip`
-  // toggle. This replaces the label/tooltip formatting boilerplate that modules
-  // used to duplicate. `state` selects `tooltip-format-<state>` when non-empty.
+  // Combined label + tooltip helper. Renders `labelFormat` into the label and
+  // the resolved tooltip format into the tooltip with the same arguments, both
+  // through the dedup-aware setters. Honors the `tooltip` toggle. This replaces
+  // the label/tooltip formatting boilerplate that modules used to duplicate.
+  // `state` selects `tooltip-format-<state>` when non-empty. Configured formats
+  // are rendered from their compiled form, see util::CompiledFormat.
   template <typename... Args>
   void updateLabelAndTooltipForState(const std::string& state, const std::string& labelFormat,
                                      const std::string& tooltipDefault, Args&&... args) {
-    fmt::dynamic_format_arg_store<fmt::format_context> store;
-    (store.push_back(std::forward<Args>(args)), ...);
-    setLabelMarkup(fmt::vformat(labelFormat, store));
-    if (tooltipEnabled()) {
-      setTooltipMarkup(fmt::vformat(resolveTooltipFormat(tooltipDefault, state), store));
-    }
+    renderLabelAndTooltip(state, labelFormat, tooltipDefault, fmt::make_format_args(args...));
   }
 
   template <typename... Args>
@@ -68,10 +65,7 @@ class ALabel : public AModule {
   void updateLabelAndTooltipForState(const std::string& state, const std::string& labelFormat,
                                      const std::string& tooltipDefault,
                                      fmt::dynamic_format_arg_store<fmt::format_context>& store) {
-    setLabelMarkup(fmt::vformat(labelFormat, store));
-    if (tooltipEnabled()) {
-      setTooltipMarkup(fmt::vformat(resolveTooltipFormat(tooltipDefault, state), store));
-    }
+    renderLabelAndTooltip(state, labelFormat, tooltipDefault, store);
   }
 
   void updateLabelAndTooltip(const std::string& labelFormat, const std::string& tooltipDefault,
@@ -79,6 +73,26 @@ class ALabel : public AModule {
     updateLabelAndTooltipForState("", labelFormat, tooltipDefault, store);
   }
 
+  // Whether `labelFormat` or the configured tooltip format for `state` has a field
+  // referencing an argument `pred` accepts, so that arguments nothing shows can be
+  // skipped. Formats that are not configured ones are assumed to reference any.
+  template <typename Pred>
+  bool formatReferences(const std::string& labelFormat, std::string_view state, Pred pred) const {
+    const auto* label = compiledFormat(labelFormat);
+    if (label == nullptr || label->usesAny(pred)) {
+      return true;
+    }
+    if (!tooltipEnabled()) {
+      return false;
+    }
+    const auto* tooltip = util::ModuleConfig::first(
+        {module_config_.string("tooltip-format", state), module_config_.string("tooltip-format")});
+    return tooltip != nullptr && compiledFormat(*tooltip)->usesAny(pred);
+  }
+
+  // Compiled form of a configured format or of the default one, nullptr otherwise
+  const util::CompiledFormat* compiledFormat(std::string_view format) const;
+
   bool handleToggle(GdkEventButton* const& e) override;
   void copyToClipboard(const std::string&);
   virtual std::string getState(uint8_t value, bool lesser = false);
@@ -88,11 +102,23 @@ class ALabel : public AModule {
   static void handleGtkMenuEvent(GtkMenuItem* menuitem, gpointer data);
 
  private:
+  void renderLabelAndTooltip(std::string_view state, const std::string& labelFormat,
+                             const std::string& tooltipDefault, fmt::format_args args);
+  // Renders `format` into markup_buffer_
+  std::string_view renderMarkup(const std::string& format, fmt::format_args args);
+  bool applyLabelMarkup(std::string_view markup);
+  bool applyTooltipMarkup(std::string_view markup);
+
   // Raw UTF-8 bytes, not Glib::ustring: ustring::operator== collates with
   // g_utf8_collate(), which gives private-use codepoints (nerd-font icons)
   // no collation weight, so two different icons compare equal.
   std::optional<std::string> last_label_markup_;
   std::optional<std::string> last_tooltip_markup_;
+  // Reused for every rendering
+  fmt::memory_buffer markup_buffer_;
+  const util::CompiledFormat default_compiled_;
+  // State class currently set by getState()
+  std::string applied_state_;
   Glib::RefPtr<Gtk::Tooltip> active_tooltip_;
 };
 
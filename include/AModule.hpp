@@ -2,16 +2,19 @@
 
 #include <fmt/args.h>
 #include <fmt/format.h>
-#include <glibmm/dispatcher.h>
 #include <glibmm/markup.h>
 #include <gtkmm.h>
 #include <gtkmm/eventbox.h>
 #include <json/json.h>
 
 #include <string>
+#include <string_view>
 #include <utility>
 
 #include "IModule.hpp"
+#include "util/module_config.hpp"
+#include "util/module_stats.hpp"
+#include "util/update_dispatcher.hpp"
 
 namespace waybar {
 
@@ -26,8 +29,9 @@ class AModule : public IModule {
   operator Gtk::Widget&() override;
   auto doAction(const std::string& name) -> void override;
 
-  /// Emitting on this dispatcher triggers a update() call
-  Glib::Dispatcher dp;
+  /// Emitting on this dispatcher triggers a update() call on the next frame. Emits are
+  /// coalesced, update() runs once per frame however many times it was emitted.
+  util::UpdateDispatcher dp;
 
   bool expandEnabled() const;
 
@@ -48,24 +52,14 @@ class AModule : public IModule {
 
   // --- Generic format/tooltip resolution (config-only, usable by any module,
   // ALabel-derived or not). Prefers `<key>-<state>`, then `<key>`, then default.
-  std::string resolveFormat(const std::string& defaultFormat, const std::string& state = "") const {
-    if (!state.empty() && config_["format-" + state].isString()) {
-      return config_["format-" + state].asString();
-    }
-    if (config_["format"].isString()) {
-      return config_["format"].asString();
-    }
-    return defaultFormat;
+  // The result refers to the config or to `defaultFormat`, don't keep it past the call.
+  const std::string& resolveFormat(const std::string& defaultFormat,
+                                   std::string_view state = {}) const {
+    return module_config_.resolve("format", state, defaultFormat);
   }
-  std::string resolveTooltipFormat(const std::string& defaultFormat,
-                                   const std::string& state = "") const {
-    if (!state.empty() && config_["tooltip-format-" + state].isString()) {
-      return config_["tooltip-format-" + state].asString();
-    }
-    if (config_["tooltip-format"].isString()) {
-      return config_["tooltip-format"].asString();
-    }
-    return defaultFormat;
+  const std::string& resolveTooltipFormat(const std::string& defaultFormat,
+                                          std::string_view state = {}) const {
+    return module_config_.resolve("tooltip-format", state, defaultFormat);
   }
 
   // Generic tooltip for any widget: honors the `tooltip` toggle and
@@ -83,7 +77,11 @@ class AModule : public IModule {
   std::vector<int> pid_children_;
   const std::string name_;
   const Json::Value& config_;
+  // `config_` resolved for the lookups done on every update
+  const util::ModuleConfig module_config_;
   Gtk::EventBox event_box_;
+  // Instrumentation of this instance, see `--stats`
+  const std::shared_ptr<util::ModuleStats> stats_;
 
   virtual void setCursor(std::string const& c);
   // Backward-compat overload for legacy numeric Gdk::CursorType configs (pre-0.16)
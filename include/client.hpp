@@ -32,6 +32,8 @@ class Client {
   std::vector<std::unique_ptr<Bar>> bars;
   Config config;
   std::string bar_id;
+  // Target of the 'stats' signal action, the log if empty
+  std::string stats_file;
 
  private:
   Client() = default;
@@ -25,6 +25,9 @@ class Config {
 
   Config() = default;
 
+  // Reuses the resolved configuration snapshot cached in `dir` when it is still valid
+  void enableCache(const std::string& dir) { cache_dir_ = dir; }
+
   void load(const std::string& config);
 
   Json::Value& getConfig() { return config_; }
@@ -40,6 +43,7 @@ class Config {
       const std::string& name, const std::vector<std::string>& dirs = CONFIG_DIRS);
 
   std::string config_file_;
+  std::string cache_dir_;
 
   Json::Value config_;
 };
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <json/json.h>
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace waybar {
+
+/**
+ * On-disk snapshot of the fully merged configuration.
+ *
+ * While a configuration is parsed under a `Recording`, every file read, every directory searched
+ * for a file or a wildcard include and every environment variable used in a path are recorded.
+ * The merged result is stored in a compact binary form along with the stat of each of them, and
+ * is reused by the next load as long as none changed, which costs a stat per dependency instead
+ * of the path expansion and JSON parsing of every file. Paths using command substitution or
+ * wildcards in directory names can't be validated that way and are never cached.
+ */
+class ConfigCache {
+ public:
+  // $XDG_CACHE_HOME/waybar, or ~/.cache/waybar
+  static std::optional<std::string> defaultDir();
+
+  // `config` is the path given on the command line, if any
+  ConfigCache(const std::string& dir, const std::string& config);
+
+  struct Snapshot {
+    std::string file;
+    Json::Value config;
+  };
+
+  // The stored snapshot, if none of its dependencies changed
+  std::optional<Snapshot> load() const;
+  // Stores the snapshot with the dependencies recorded so far
+  void store(const std::string& file, const Json::Value& config) const;
+
+  // Records the dependencies of the configuration parsed on this thread into `cache`
+  class Recording {
+   public:
+    explicit Recording(ConfigCache& cache);
+    ~Recording();
+    Recording(const Recording&) = delete;
+    Recording& operator=(const Recording&) = delete;
+
+   private:
+    ConfigCache* previous_;
+  };
+
+  // Hooks for the config parser, no-ops outside of a Recording
+  static void recordFile(const std::string& path);
+  static void recordPattern(const std::string& pattern);
+  static void recordEnv(const std::string& name);
+
+  static std::string encode(const Json::Value& value);
+  static bool decode(std::string_view data, Json::Value& value);
+
+ private:
+  enum class Kind : uint8_t { PATH, ENV };
+
+  struct Dependency {
+    Kind kind;
+    // Path, or name of the environment variable
+    std::string name;
+    bool exists{false};
+    uint64_t dev{0};
+    uint64_t ino{0};
+    uint64_t size{0};
+    int64_t mtime_ns{0};
+    int64_t ctime_ns{0};
+    // Value of the environment variable
+    std::string value;
+
+    bool operator==(const Dependency&) const = default;
+  };
+
+  static Dependency current(Kind kind, const std::string& name);
+  void add(Kind kind, const std::string& name);
+
+  std::string key_;
+  std::string path_;
+  std::vector<Dependency> dependencies_;
+  bool cacheable_{true};
+};
+
+}  // namespace waybar
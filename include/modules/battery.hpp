@@ -2,21 +2,21 @@
 
 #include <fmt/format.h>
 
+#include <glibmm/main.h>
+
 #include <filesystem>
-#if defined(__linux__)
-#include <sys/inotify.h>
-#endif
-#include <poll.h>
 
 #include <algorithm>
 #include <chrono>
 #include <fstream>
+#include <optional>
 #include <string>
 #include <vector>
 
 #include "ALabel.hpp"
 #include "bar.hpp"
-#include "util/sleeper_thread.hpp"
+#include "util/power_supply.hpp"
+#include "util/scheduler.hpp"
 #include "util/udev_deleter.hpp"
 
 namespace waybar::modules {
@@ -34,18 +34,20 @@ class Battery : public ALabel {
 
   void refreshBatteries();
   void worker();
-  const std::string getAdapterStatus(uint8_t capacity) const;
+  bool handleUdevEvents(Glib::IOCondition condition);
+  const std::string getAdapterStatus(uint8_t capacity);
   std::tuple<uint8_t, float, std::string, float, uint16_t, float> getInfos();
   const std::string formatTimeRemaining(float hoursRemaining);
   void setBarClass(std::string&);
   void processEvents(std::string& state, std::string& status, uint8_t capacity);
 
-  std::map<fs::path, int> batteries_;
+  // Rescanned on hotplug only, sampled through their uevent
+  std::map<fs::path, util::PowerSupply> batteries_;
   std::unique_ptr<udev, util::UdevDeleter> udev_;
-  std::array<pollfd, 1> poll_fds_;
+  // power_supply uevents, watched from the main loop
   std::unique_ptr<udev_monitor, util::UdevMonitorDeleter> mon_;
-  fs::path adapter_;
-  int battery_watch_fd_;
+  sigc::connection udev_watch_;
+  std::optional<util::PowerSupply> adapter_;
   std::mutex battery_list_mutex_;
   std::string old_status_;
   std::string last_event_;
@@ -58,9 +60,8 @@ class Battery : public ALabel {
   std::chrono::steady_clock::time_point last_t_{std::chrono::steady_clock::now()};
   std::string old_status_raw_{""};
 
-  util::SleeperThread thread_;
-  util::SleeperThread thread_battery_update_;
-  util::SleeperThread thread_timer_;
+  // Fallback for drivers that don't emit change events
+  util::PeriodicTask timer_;
 };
 
 }  // namespace waybar::modules
@@ -1,8 +1,9 @@
 #pragma once
 
 #include "ALabel.hpp"
+#include "util/compiled_format.hpp"
 #include "util/date.hpp"
-#include "util/sleeper_thread.hpp"
+#include "util/scheduler.hpp"
 
 namespace waybar::modules {
 
@@ -25,6 +26,8 @@ class Clock final : public ALabel {
   const std::locale m_locale_;
   // tooltip
   const std::string m_tlpFmt_;
+  // Parsed once to substitute the placeholders below
+  const util::CompiledFormat m_tlpCompiled_;
   std::string m_tlpText_{""};                 // tooltip text to print
   const Glib::RefPtr<Gtk::Label> m_tooltip_;  // tooltip as a separate Gtk::Label
   bool query_tlp_cb(int, int, bool, const Glib::RefPtr<Gtk::Tooltip>& tooltip);
@@ -66,7 +69,7 @@ class Clock final : public ALabel {
   int tzCurrIdx_;                               // current time zone index for tzList_
   std::string tzText_{""};                      // time zones text to print
   std::string tzTooltipFormat_{""};             // optional timezone tooltip format
-  util::SleeperThread thread_;
+  util::PeriodicTask timer_;
 
   // ordinal date in tooltip
   const bool ordInTooltip_;
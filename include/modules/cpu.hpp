@@ -10,7 +10,7 @@
 #include <vector>
 
 #include "ALabel.hpp"
-#include "util/sleeper_thread.hpp"
+#include "modules/cpu_usage.hpp"
 
 namespace waybar::modules {
 
@@ -21,9 +21,7 @@ class Cpu : public ALabel {
   auto update() -> void override;
 
  private:
-  std::vector<std::tuple<size_t, size_t>> prev_times_;
-
-  util::SleeperThread thread_;
+  util::SharedSampler<CpuUsage::Sample>::Subscription usage_;
 };
 
 }  // namespace waybar::modules
@@ -6,11 +6,13 @@
 #include <fstream>
 #include <numeric>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 
 #include "ALabel.hpp"
-#include "util/sleeper_thread.hpp"
+#include "util/proc_file.hpp"
+#include "util/shared_sampler.hpp"
 
 namespace waybar::modules {
 
@@ -20,16 +22,45 @@ class CpuUsage : public ALabel {
   virtual ~CpuUsage() = default;
   auto update() -> void override;
 
-  // This is a static member because it is also used by the cpu module.
-  static std::tuple<std::vector<uint16_t>, std::string> getCpuUsage(
-      std::vector<std::tuple<size_t, size_t>>&);
+  using Times = std::vector<std::tuple<size_t, size_t>>;
 
- private:
-  static std::vector<std::tuple<size_t, size_t>> parseCpuinfo();
+  // Samples the (idle, total) jiffies of the aggregate line followed by every cpu into a vector
+  // kept across samples. On Linux /proc/stat and the present cpus stay open. `path` is only used
+  // on Linux, the benchmarks feed it a fixture.
+  class StatReader {
+   public:
+    explicit StatReader(const std::string& path = "/proc/stat");
+    StatReader(const StatReader&) = delete;
+    StatReader& operator=(const StatReader&) = delete;
+
+    // Valid until the next read
+    const Times& read();
+
+   private:
+    util::ProcFile stat_;
+    util::ProcFile present_;
+    Times times_;
+  };
+
+  // This is a static member because it is also used by the cpu module. Compared to `prev_times`,
+  // or to boot when it is empty, so that it never waits for a second read.
+  static std::tuple<std::vector<uint16_t>, std::string> getCpuUsage(StatReader& reader,
+                                                                    Times& prev_times);
 
-  std::vector<std::tuple<size_t, size_t>> prev_times_;
+  // Per-core usage and tooltip, sampled once per interval for every cpu, cpu_usage and
+  // cpu_graph module sharing that interval, whichever bar they are on.
+  using Sample = std::tuple<std::vector<uint16_t>, std::string>;
+  static util::SharedSampler<Sample>::Subscription subscribe(std::chrono::milliseconds interval,
+                                                             std::function<void()> on_sample);
 
-  util::SleeperThread thread_;
+  // A single sample from a fresh reader, see StatReader
+  static Times parseCpuinfo(const std::string& path = "/proc/stat");
+
+  // Whether `name` is one of the per-core format arguments: usage<N>, icon<N> or icons
+  static bool isPerCoreArg(std::string_view name);
+
+ private:
+  util::SharedSampler<Sample>::Subscription usage_;
 };
 
 }  // namespace waybar::modules
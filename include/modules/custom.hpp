@@ -1,16 +1,23 @@
 #pragma once
 
 #include <fmt/format.h>
+#include <glibmm/dispatcher.h>
 
+#include <atomic>
+#include <chrono>
 #include <csignal>
 #include <memory>
+#include <optional>
 #include <string>
+#include <vector>
 
 #include "AIconLabel.hpp"
 #include "util/command.hpp"
 #include "util/command_line_stream.hpp"
+#include "util/exec_pool.hpp"
 #include "util/json.hpp"
-#include "util/sleeper_thread.hpp"
+#include "util/scheduler.hpp"
+#include "util/shared_sampler.hpp"
 
 namespace waybar::modules {
 
@@ -22,15 +29,43 @@ class Custom : public AIconLabel {
   void refresh(int /*signal*/) override;
 
  private:
+  // exec-if and exec, with what they run with
+  struct Scripts {
+    std::optional<std::string> exec_if{};
+    std::optional<std::string> exec{};
+    // Empty when the output is shared between bars
+    std::string output_name{};
+    bool direct{false};
+    std::chrono::milliseconds timeout{0};
+    std::size_t max_output{util::command::kMaxOutputSize};
+  };
+
+  // exec-if then exec, exec only runs if exec-if succeeds
+  static std::vector<util::ExecPool::Request> requests(const Scripts& scripts,
+                                                       util::ExecPool::clock::time_point deadline);
+  Scripts scripts() const;
   void delayWorker();
+  void reapChildren();
+  void runScripts();
   void continuousWorker();
   void startContinuousProcess(bool throw_on_failure);
   void handleContinuousProcessExit(int exit_code);
   void scheduleContinuousRestart();
   void waitingWorker();
+  // mode "coprocess": the script is kept running and sent a request line on stdin for every
+  // interval, signal and event, it replies with a line of output
+  void coprocessWorker();
+  void startCoprocess(bool throw_on_failure);
+  void handleCoprocessExit(int exit_code);
+  void scheduleCoprocessRestart();
+  // Kills a coprocess that didn't reply within exec-timeout, and restarts it
+  void handleReplyTimeout();
+  std::chrono::milliseconds coprocessRestartInterval() const;
+  void request(const std::string& line);
   void parseOutputRaw();
   void parseOutputJson();
-  void handleEvent();
+  // `event` is the request sent to a coprocess
+  void handleEvent(const std::string& event);
   bool handleScroll(GdkEventScroll* e) override;
   bool handleToggle(GdkEventButton* const& e) override;
 
@@ -45,14 +80,40 @@ class Custom : public AIconLabel {
   std::string image_name_;
   unsigned app_icon_size_{24};
   const bool tooltip_format_enabled_;
+  // Options read on every update
+  const bool has_exec_;
+  const bool json_output_;
+  const bool hide_empty_text_;
+  const bool escape_;
+  // Run exec and exec-if without the shell when they don't need it
+  const bool exec_direct_;
+  // exec and exec-if are killed after running that long, no limit if zero
+  const std::chrono::milliseconds exec_timeout_;
+  // Bytes of the output of exec kept, the rest is discarded
+  const std::size_t max_output_;
+  // The next run was asked for by a signal or an event
+  std::atomic<bool> urgent_{false};
+  const bool coprocess_;
+  // The coprocess hasn't replied to its last request
+  bool awaiting_reply_{false};
+  // Until the next restart of the coprocess
+  std::chrono::milliseconds restart_delay_{0};
+  static constexpr std::chrono::milliseconds COPROCESS_MAX_RESTART_DELAY{60000};
   std::vector<std::string> class_;
   int percentage_;
   util::command::res output_;
   util::JsonParser parser_;
   std::unique_ptr<util::command::LineStream> continuous_stream_;
   sigc::connection restart_connection_;
+  sigc::connection reply_connection_;
+  // Brings the ticks of timer_ to the coprocess on the main loop
+  Glib::Dispatcher tick_dp_;
 
-  util::SleeperThread thread_;
+  util::PeriodicTask timer_;
+  // The scripts run by the exec pool on behalf of timer_, which never waits for them
+  util::ExecPool::Task exec_task_;
+  // Instead of timer_ when the scripts are not output-specific
+  util::SharedSampler<util::command::res>::Subscription shared_exec_;
 };
 
 }  // namespace waybar::modules
@@ -2,11 +2,14 @@
 
 #include <fmt/format.h>
 
+#include <atomic>
+#include <chrono>
 #include <csignal>
 #include <string>
 
 #include "AGraph.hpp"
 #include "util/command.hpp"
+#include "util/exec_pool.hpp"
 #include "util/json.hpp"
 #include "util/sleeper_thread.hpp"
 
@@ -21,6 +24,7 @@ class CustomGraph : public AGraph {
 
  private:
   void delayWorker();
+  void runScripts(util::ExecPool::clock::time_point deadline);
   void continuousWorker();
   void waitingWorker();
   void parseOutputRaw();
@@ -36,6 +40,14 @@ class CustomGraph : public AGraph {
   std::string alt_;
   std::string tooltip_;
   const bool tooltip_format_enabled_;
+  // Run exec and exec-if without the shell when they don't need it
+  const bool exec_direct_;
+  // exec and exec-if are killed after running that long, no limit if zero
+  const std::chrono::milliseconds exec_timeout_;
+  // Bytes of the output of exec kept, the rest is discarded
+  const std::size_t max_output_;
+  // The next run was asked for by a signal or an event
+  std::atomic<bool> urgent_{false};
   std::vector<std::string> class_;
   int percentage_;
   FILE* fp_;
@@ -3,27 +3,72 @@
 #include <fmt/format.h>
 #include <sys/statvfs.h>
 
-#include <fstream>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <vector>
 
 #include "ALabel.hpp"
 #include "util/format.hpp"
-#include "util/sleeper_thread.hpp"
+#include "util/proc_file.hpp"
+#include "util/scheduler.hpp"
+#include "util/scoped_fd.hpp"
 
 namespace waybar::modules {
 
 class Disk : public ALabel {
  public:
   Disk(const std::string&, const Json::Value&);
-  virtual ~Disk() = default;
+  virtual ~Disk();
   auto update() -> void override;
 
  private:
-  util::SleeperThread thread_;
+  // statvfs of a path on its own thread, which a stale network mount can block for good. Shared
+  // by the disk modules of every bar showing the path.
+  struct Probe;
+  struct ProbeSubscription {
+    std::shared_ptr<Probe> probe;
+    uint64_t id;
+  };
+
+  struct Sample {
+    enum class State : uint8_t { PENDING, OK, FAILED, STALE };
+
+    State state{State::PENDING};
+    struct statvfs stats {};
+    // From the mount table, empty if unknown
+    std::string device;
+    std::string fstype;
+  };
+
+  // Starts the probes, the results come with the callbacks of the probes
+  void sample();
+  void handleProbe(size_t index, const struct statvfs& stats, int error);
+  // Maps the paths to their mount again, after the mount table changed
+  void updateMounts();
+  bool handleMountsChanged(Glib::IOCondition condition);
+
+  util::PeriodicTask timer_;
   std::string header_;
   std::vector<std::string> paths_;
   std::string separator_;
   std::string unit_;
+  std::chrono::milliseconds timeout_;
+
+  // One per path
+  std::vector<ProbeSubscription> probes_;
+  std::mutex mutex_;
+  // One per path
+  std::vector<Sample> samples_;
+
+  // /proc/self/mountinfo, read on the timer and watched for POLLPRI on the main loop
+  std::optional<util::ProcFile> mountinfo_;
+  util::ScopedFd mount_events_;
+  sigc::connection mount_watch_;
+  std::atomic<bool> mounts_changed_{true};
 
   float calc_specific_divisor(const std::string& divisor);
 };
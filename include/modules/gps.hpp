@@ -10,6 +10,7 @@
 #include <gps.h>
 
 #include "ALabel.hpp"
+#include "util/scheduler.hpp"
 #include "util/sleeper_thread.hpp"
 
 namespace waybar::modules {
@@ -29,7 +30,8 @@ class Gps : public ALabel {
 
   const std::string getFixStatusString() const;
 
-  util::SleeperThread thread_, gps_thread_;
+  util::PeriodicTask timer_;
+  util::SleeperThread gps_thread_;
   gps_data_t gps_data_;
   std::string state_;
 
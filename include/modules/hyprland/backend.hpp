@@ -53,6 +53,9 @@ class IPC {
   static std::optional<bool> s_luaProtocolDetected_;  // cached detection result
 
  private:
+  // Calls parseIPC() from the benchmarks
+  friend struct IPCTestAccess;
+
   void socketListener();
   void parseIPC(const std::string&);
 
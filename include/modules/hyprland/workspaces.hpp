@@ -6,6 +6,7 @@
 #include <json/value.h>
 #include <sigc++/connection.h>
 
+#include <atomic>
 #include <cstdint>
 #include <map>
 #include <memory>
@@ -22,6 +23,7 @@
 #include "util/enum.hpp"
 #include "util/icon_loader.hpp"
 #include "util/regex_collection.hpp"
+#include "util/scheduler.hpp"
 
 using WindowAddress = std::string;
 
@@ -230,6 +232,10 @@ class Workspaces : public AModule, public EventHandler {
   // Coalesces bursts of Hyprland events into a single UI refresh. Armed and
   // disconnected only on the GTK main thread (see Workspaces::update).
   sigc::connection m_debounceTimer;
+
+  // Queries the initial state, see the constructor
+  util::BackgroundTask m_discovery;
+  std::atomic<bool> m_initialized = false;
 };
 
 }  // namespace waybar::modules::hyprland
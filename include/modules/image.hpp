@@ -10,7 +10,7 @@
 #include "gtkmm/box.h"
 #include "util/command.hpp"
 #include "util/json.hpp"
-#include "util/sleeper_thread.hpp"
+#include "util/scheduler.hpp"
 
 namespace waybar::modules {
 
@@ -92,7 +92,7 @@ class Image : public AModule {
 
   std::chrono::milliseconds interval_;
   std::unique_ptr<image::IStrategy> strategy_;
-  util::SleeperThread thread_;
+  util::PeriodicTask timer_;
 };
 
 }  // namespace waybar::modules
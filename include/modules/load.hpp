@@ -10,7 +10,7 @@
 #include <vector>
 
 #include "ALabel.hpp"
-#include "util/sleeper_thread.hpp"
+#include "util/scheduler.hpp"
 
 namespace waybar::modules {
 
@@ -24,7 +24,7 @@ class Load : public ALabel {
   static std::tuple<double, double, double> getLoad();
 
  private:
-  util::SleeperThread thread_;
+  util::PeriodicTask timer_;
 };
 
 }  // namespace waybar::modules
@@ -2,11 +2,12 @@
 
 #include <fmt/format.h>
 
-#include <fstream>
+#include <optional>
 #include <unordered_map>
 
 #include "ALabel.hpp"
-#include "util/sleeper_thread.hpp"
+#include "util/proc_file.hpp"
+#include "util/shared_sampler.hpp"
 
 namespace waybar::modules {
 
@@ -16,12 +17,44 @@ class Memory : public ALabel {
   virtual ~Memory() = default;
   auto update() -> void override;
 
- private:
-  void parseMeminfo();
-
-  std::unordered_map<std::string, unsigned long> meminfo_;
+  // The /proc/meminfo fields the module uses, in kiB
+  struct Meminfo {
+    unsigned long mem_total{0};
+    unsigned long mem_free{0};
+    unsigned long mem_available{0};
+    unsigned long buffers{0};
+    unsigned long cached{0};
+    unsigned long s_reclaimable{0};
+    unsigned long shmem{0};
+    unsigned long swap_total{0};
+    unsigned long swap_free{0};
+    // ZFS ARC size, which the kernel doesn't count as available
+    unsigned long zfs_size{0};
+    // MemAvailable is missing before Linux 3.4
+    bool has_mem_available{false};
+  };
+
+  // Samples Meminfo from files kept open, the ZFS ARC size only when `zfs`. `path` is only used
+  // on Linux, the benchmarks feed it a fixture.
+  class MeminfoReader {
+   public:
+    MeminfoReader(const std::string& path, bool zfs);
+
+    // Valid until the next read
+    const Meminfo& read();
+
+   private:
+    util::ProcFile meminfo_;
+    std::optional<util::ProcFile> arcstats_;
+    Meminfo values_;
+  };
+
+  // A single sample from a fresh reader, ZFS included
+  static Meminfo parseMeminfo(const std::string& path = "/proc/meminfo");
 
-  util::SleeperThread thread_;
+ private:
+  // Shared by every memory module with the same interval
+  util::SharedSampler<Meminfo>::Subscription meminfo_;
 
   std::string unit_;
 };
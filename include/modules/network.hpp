@@ -6,13 +6,14 @@
 #include <netlink/genl/ctrl.h>
 #include <netlink/genl/genl.h>
 #include <netlink/netlink.h>
-#include <sys/epoll.h>
 
 #include <optional>
 #include <vector>
 
 #include "ALabel.hpp"
-#include "util/sleeper_thread.hpp"
+#include "util/link_stats.hpp"
+#include "util/netlink_monitor.hpp"
+#include "util/scheduler.hpp"
 #ifdef WANT_RFKILL
 #include "util/rfkill.hpp"
 #endif
@@ -30,21 +31,16 @@ class Network : public ALabel {
   auto update() -> void override;
 
  private:
-  static const uint8_t MAX_RETRY{5};
-  static const uint8_t EPOLL_MAX{200};
-
-  static int handleEvents(struct nl_msg*, void*);
-  static int handleEventsDone(struct nl_msg*, void*);
   static int handleScan(struct nl_msg*, void*);
   static int handleStationGet(struct nl_msg *msg, void *data);
 
-  void askForStateDump(void);
-
   void worker();
-  void createInfoSocket();
-  void createEventSocket();
+  void updateFromNetlink(const util::NetlinkState& state);
+  const util::NetlinkRoute* findDefaultRoute(const util::NetlinkState& state, int oif) const;
+  void updateAddresses(const util::NetlinkState& state);
   void parseEssid(struct nlattr**);
   void parseSignal(struct nlattr**);
+  void setSignal(int32_t dbm);
   void parseFreq(struct nlattr**);
   void parseBssid(struct nlattr**);
   bool associatedOrJoined(struct nlattr**);
@@ -54,24 +50,13 @@ class Network : public ALabel {
   bool isWireless() const;
   const std::string getNetworkState() const;
   void clearIface();
-  std::optional<std::pair<unsigned long long, unsigned long long>> readBandwidthUsage();
   uint32_t readLinkSpeed() const;
 
   int ifid_{-1};
   ip_addr_pref addr_pref_{ip_addr_pref::IPV4};
-  struct sockaddr_nl nladdr_{0};
-  struct nl_sock* sock_{nullptr};
-  struct nl_sock* ev_sock_{nullptr};
-  struct nl_sock* station_sock_{nullptr};
-  int efd_{-1};
-  int ev_fd_{-1};
-  int nl80211_id_{-1};
   std::mutex mutex_;
+  util::NetlinkMonitor::Subscription netlink_;
 
-  bool want_route_dump_{false};
-  bool want_link_dump_{false};
-  bool want_addr_dump_{false};
-  bool dump_in_progress_{false};
   bool is_p2p_{false};
 
   unsigned long long bandwidth_down_total_{0};
@@ -79,6 +64,9 @@ class Network : public ALabel {
   unsigned long long bandwidth_down_prev_{0};
   unsigned long long bandwidth_up_prev_{0};
   std::chrono::steady_clock::time_point bandwidth_last_sample_time_;
+  // Counters of the interface, sampled by the timer
+  std::chrono::steady_clock::time_point link_sample_time_;
+  util::LinkCounters link_sample_;
 
   std::string state_;
   std::string essid_;
@@ -95,11 +83,13 @@ class Network : public ALabel {
   int32_t signal_strength_dbm_;
   uint8_t signal_strength_;
   std::string signal_strength_app_;
-  uint32_t route_priority;
+  uint32_t route_priority{0};
   uint32_t link_speed_{0};
 
-  util::SleeperThread thread_;
-  util::SleeperThread thread_timer_;
+  // Whether the nl80211 state has to be queried at the next tick, it is otherwise pushed
+  bool wifi_refresh_{true};
+  std::chrono::steady_clock::time_point wifi_last_refresh_;
+  util::PeriodicTask timer_;
 #ifdef WANT_RFKILL
   util::Rfkill rfkill_{RFKILL_TYPE_WLAN};
 #endif
@@ -2,10 +2,15 @@
 
 #include <fmt/format.h>
 
-#include <fstream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
 
 #include "ALabel.hpp"
-#include "util/sleeper_thread.hpp"
+#include "util/hwmon_index.hpp"
+#include "util/proc_file.hpp"
+#include "util/shared_sampler.hpp"
 
 namespace waybar::modules {
 
@@ -17,13 +22,67 @@ class Temperature : public ALabel {
   void suspend() override;
   void resume() override;
 
+  // Celsius of every sensor, in the order of the module's sensors, unset for the ones that can't
+  // be read
+  using Readings = std::vector<std::optional<float>>;
+
  private:
-  float getTemperature();
+  struct Sensor {
+    // Key in "sensors", empty for the sensor of the top-level config
+    std::string name;
+    Json::Value config;
+    // Placeholders of the sensor, e.g. {cpuC}
+    std::string arg_c;
+    std::string arg_f;
+    std::string arg_k;
+  };
+
+  // Resolves the inputs of the sensors and keeps them open. Shared by the modules with the same
+  // sensors and interval.
+  class Reader {
+   public:
+    Reader(std::string name, const std::vector<Sensor>& sensors);
+
+    // Reads every sensor, resolving the ones that vanished again
+    Readings read();
+
+   private:
+    struct Input {
+      // For the warnings
+      std::string label;
+      Json::Value config;
+      // Unset while the sensor is unresolved
+      std::optional<util::ProcFile> file;
+      // Its last read succeeded
+      bool read{false};
+      // Its failure was reported
+      bool failed{false};
+    };
+
+    // Resolves the input file of `config`, throws if no sensor matches
+    std::string findSensor(const Json::Value& config);
+    void resolve(Input& input);
+    float getTemperature(Input& input);
+
+    std::string name_;
+    std::shared_ptr<util::HwmonIndex> hwmon_;
+    std::vector<Input> inputs_;
+    // The first read, which resolves the sensors, is done
+    bool discovered_{false};
+    // Generation of the hwmon index the sensors were resolved from
+    uint64_t hwmon_generation_{0};
+  };
+
+  // Builds sensors_ from the config
+  void addSensors();
+  void subscribe();
   bool isCritical(uint16_t);
   bool isWarning(uint16_t);
 
-  std::string file_path_;
-  util::SleeperThread thread_;
+  std::vector<Sensor> sensors_;
+  // What the readings depend on, empty if the config is invalid
+  std::string key_;
+  util::SharedSampler<Readings>::Subscription readings_;
 };
 
 }  // namespace waybar::modules
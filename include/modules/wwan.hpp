@@ -8,7 +8,7 @@
 
 #include "ALabel.hpp"
 #include "util/format.hpp"
-#include "util/sleeper_thread.hpp"
+#include "util/scheduler.hpp"
 
 namespace waybar::modules {
 
@@ -21,7 +21,7 @@ class Wwan : public ALabel {
  private:
   void updateCurrentModem();
 
-  util::SleeperThread thread_;
+  util::PeriodicTask timer_;
   std::string state_;
   GDBusConnection* connection = nullptr;
   MMManager* manager = nullptr;
@@ -2,44 +2,324 @@
 
 #include <fcntl.h>
 #include <giomm.h>
+#include <poll.h>
+#include <signal.h>
 #include <spdlog/spdlog.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
 #ifdef __linux__
+#include <sched.h>
 #include <sys/prctl.h>
 #endif
 #ifdef __FreeBSD__
 #include <sys/procctl.h>
 #endif
 
+#include <algorithm>
 #include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "util/module_stats.hpp"
 
 extern std::mutex reap_mtx;
 extern std::list<pid_t> reap;
+extern char** environ;
 
 namespace waybar::util::command {
 
 constexpr int kExecFailureExitCode = 127;
+// Default limit of the output kept from a command
+constexpr std::size_t kMaxOutputSize = 4 * 1024 * 1024;
 
 struct res {
   int exit_code;
   std::string out;
 };
 
-inline std::string read(FILE* fp) {
-  std::array<char, 128> buffer = {0};
-  std::string output;
-  while (feof(fp) == 0) {
-    if (fgets(buffer.data(), 128, fp) != nullptr) {
-      output += buffer.data();
+// A spawned command. `pidfd` refers to the process without the pid reuse race, -1 where pidfds
+// aren't available.
+struct Child {
+  pid_t pid{-1};
+  int pidfd{-1};
+};
+
+// Whether `cmd` uses anything of the shell language: quoting, expansions, redirections,
+// operators, globs, comments or assignments. Without any, its words are the argv.
+inline bool needsShell(std::string_view cmd) {
+  if (cmd.find_first_of("|&;<>()$`\\\"'*?[]#~{}!\n") != std::string_view::npos) {
+    return true;
+  }
+  // FOO=bar cmd
+  const auto begin = cmd.find_first_not_of(" \t");
+  const auto first_word = cmd.substr(begin == std::string_view::npos ? cmd.size() : begin);
+  return first_word.substr(0, first_word.find_first_of(" \t")).find('=') != std::string_view::npos;
+}
+
+namespace detail {
+
+// Built by the parent: the child shares its memory until it execs, so it must not allocate
+struct SpawnArgs {
+  std::string path;
+  std::vector<std::string> words;
+  std::vector<std::string> env;
+  std::vector<char*> argv;
+  std::vector<char*> envp;
+  int out_fd{-1};
+  bool death_signal{false};
+  // Written by the child when the exec fails
+  int error{0};
+};
+
+inline std::vector<char*> pointers(std::vector<std::string>& strings) {
+  std::vector<char*> pointers;
+  pointers.reserve(strings.size() + 1);
+  for (auto& string : strings) {
+    pointers.push_back(string.data());
+  }
+  pointers.push_back(nullptr);
+  return pointers;
+}
+
+// The PATH lookup of execvp, done in the parent
+inline std::string findExecutable(const std::string& name) {
+  if (name.find('/') != std::string::npos) {
+    return name;
+  }
+  const char* path = getenv("PATH");
+  std::string_view dirs = path != nullptr ? path : "/usr/local/bin:/usr/bin:/bin";
+  while (true) {
+    const auto end = dirs.find(':');
+    auto dir = dirs.substr(0, end);
+    auto candidate = std::string(dir.empty() ? "." : dir) + "/" + name;
+    if (access(candidate.c_str(), X_OK) == 0) {
+      return candidate;
+    }
+    if (end == std::string_view::npos) {
+      return name;
     }
+    dirs.remove_prefix(end + 1);
   }
+}
 
-  // Remove last newline
-  if (!output.empty() && output[output.length() - 1] == '\n') {
-    output.erase(output.length() - 1);
+// Runs in the child, before the exec: only async-signal-safe calls
+inline int spawnChild(void* data) {
+  auto* args = static_cast<SpawnArgs*>(data);
+  // The handlers of the parent would run on its memory, reset them before unblocking
+  struct sigaction action {};
+  for (int sig = 1; sig < NSIG; sig++) {
+    if (sigaction(sig, nullptr, &action) == 0 && action.sa_handler != SIG_DFL &&
+        action.sa_handler != SIG_IGN) {
+      action.sa_handler = SIG_DFL;
+      sigaction(sig, &action, nullptr);
+    }
+  }
+  sigset_t mask;
+  sigemptyset(&mask);
+  sigprocmask(SIG_SETMASK, &mask, nullptr);
+  // Kill child if Waybar exits
+  if (args->death_signal) {
+    int deathsig = SIGTERM;
+#ifdef __linux__
+    prctl(PR_SET_PDEATHSIG, deathsig);
+#endif
+#ifdef __FreeBSD__
+    procctl(P_PID, 0, PROC_PDEATHSIG_CTL, reinterpret_cast<void*>(&deathsig));
+#endif
+  }
+  setpgid(0, 0);
+  if (args->out_fd != -1) {
+    dup2(args->out_fd, STDOUT_FILENO);
+  }
+  execve(args->path.c_str(), args->argv.data(), args->envp.data());
+  args->error = errno;
+  _exit(kExecFailureExitCode);
+}
+
+}  // namespace detail
+
+/**
+ * Starts `cmd` in its own process group, with `/bin/sh -c`, or directly when `direct` is set and
+ * it needs no shell.
+ *
+ * The child is created with clone(CLONE_VM | CLONE_VFORK) on Linux and vfork() elsewhere: unlike
+ * fork(), nothing of the address space of Waybar is copied, so the cost doesn't grow with its
+ * memory. It still gets PR_SET_PDEATHSIG when `death_signal` is set, and WAYBAR_OUTPUT_NAME
+ * when `output_name` isn't empty. `out_fd`, if not -1, becomes its stdout. An exec failure is
+ * logged and the child exits with kExecFailureExitCode, as the shell would.
+ */
+inline Child spawn(const std::string& cmd, const std::string& output_name, int out_fd,
+                   bool death_signal, bool direct = false) {
+  detail::SpawnArgs args;
+  if (direct && !needsShell(cmd)) {
+    std::string_view rest = cmd;
+    while (true) {
+      const auto begin = rest.find_first_not_of(" \t");
+      if (begin == std::string_view::npos) {
+        break;
+      }
+      rest.remove_prefix(begin);
+      const auto end = rest.find_first_of(" \t");
+      args.words.emplace_back(rest.substr(0, end));
+      rest.remove_prefix(end == std::string_view::npos ? rest.size() : end);
+    }
+  }
+  if (!args.words.empty()) {
+    args.path = detail::findExecutable(args.words.front());
+  } else {
+    args.path = "/bin/sh";
+    args.words = {"sh", "-c", cmd};
+  }
+  for (char** var = environ; *var != nullptr; var++) {
+    if (output_name.empty() || !std::string_view(*var).starts_with("WAYBAR_OUTPUT_NAME=")) {
+      args.env.emplace_back(*var);
+    }
+  }
+  if (!output_name.empty()) {
+    args.env.push_back("WAYBAR_OUTPUT_NAME=" + output_name);
+  }
+  args.argv = detail::pointers(args.words);
+  args.envp = detail::pointers(args.env);
+  args.out_fd = out_fd;
+  args.death_signal = death_signal;
+
+  // Blocked until the child has reset the signal handlers it shares the memory of
+  sigset_t all;
+  sigset_t previous;
+  sigfillset(&all);
+  pthread_sigmask(SIG_SETMASK, &all, &previous);
+  Child child;
+#ifdef __linux__
+  constexpr std::size_t STACK_SIZE = 64 * 1024;
+  auto stack = std::make_unique_for_overwrite<char[]>(STACK_SIZE);
+  child.pid = clone(detail::spawnChild, stack.get() + STACK_SIZE,
+                    CLONE_VM | CLONE_VFORK | CLONE_PIDFD | SIGCHLD, &args, &child.pidfd);
+  if (child.pid == -1 && errno == EINVAL) {
+    // Before Linux 5.2
+    child.pidfd = -1;
+    child.pid = clone(detail::spawnChild, stack.get() + STACK_SIZE,
+                      CLONE_VM | CLONE_VFORK | SIGCHLD, &args);
+  }
+#else
+  child.pid = vfork();
+  if (child.pid == 0) {
+    detail::spawnChild(&args);
+  }
+#endif
+  const int spawn_errno = errno;
+  pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+
+  if (child.pid < 0) {
+    spdlog::error("Unable to exec cmd {}, error {}", cmd, strerror(spawn_errno));
+    return {};
+  }
+  if (args.error != 0) {
+    spdlog::error("exec of {} failed: {}", args.path, strerror(args.error));
+  }
+  ModuleStats::addChildSpawned();
+  return child;
+}
+
+// Waits for `child` to terminate and closes its pidfd. Returns a waitpid() status.
+inline int wait(Child& child) {
+  int stat = -1;
+#ifdef __linux__
+  if (child.pidfd != -1) {
+    // P_PIDFD, Linux 5.4, older kernels fail with EINVAL and the pid is waited for below
+    constexpr int P_PIDFD_ID = 3;
+    siginfo_t info{};
+    int ret;
+    do {
+      ret = waitid(static_cast<idtype_t>(P_PIDFD_ID), child.pidfd, &info, WEXITED);
+    } while (ret == -1 && errno == EINTR);
+    ::close(child.pidfd);
+    child.pidfd = -1;
+    if (ret == 0) {
+      stat = info.si_code == CLD_EXITED ? W_EXITCODE(info.si_status, 0) : info.si_status;
+      spdlog::debug("Cmd exited with status {}", stat);
+      return stat;
+    }
+  }
+#endif
+  if (child.pidfd != -1) {
+    ::close(child.pidfd);
+    child.pidfd = -1;
+  }
+  while (waitpid(child.pid, &stat, 0) == -1 && errno == EINTR) {
+  }
+  return stat;
+}
+
+// Output of a command, see readAll()
+struct Output {
+  std::string text;
+  // The command wrote more than the limit, the rest was discarded
+  bool truncated{false};
+  // The deadline passed before the end of the output
+  bool timed_out{false};
+};
+
+/**
+ * Reads `fd` until its end with read(2), into a buffer that doubles as it fills up.
+ *
+ * Up to `max_size` bytes are kept, the rest is read and discarded so that the command doesn't
+ * block on a full pipe. With a `deadline`, the reads are preceded by poll(2) and stop once it
+ * passes, the command may then still be writing.
+ */
+inline Output readAll(int fd, std::size_t max_size = kMaxOutputSize,
+                      std::optional<std::chrono::steady_clock::time_point> deadline = {}) {
+  constexpr std::size_t MIN_CHUNK = 4096;
+  Output output;
+  std::size_t used = 0;
+  std::size_t total = 0;
+  std::array<char, MIN_CHUNK> discard;
+  while (true) {
+    if (deadline) {
+      const auto left = std::chrono::ceil<std::chrono::milliseconds>(
+                            *deadline - std::chrono::steady_clock::now())
+                            .count();
+      pollfd pfd{.fd = fd, .events = POLLIN, .revents = 0};
+      const int ready = poll(&pfd, 1,
+                             static_cast<int>(std::clamp<decltype(left)>(
+                                 left, 0, std::numeric_limits<int>::max())));
+      if (ready == -1 && errno == EINTR) continue;
+      if (ready == 0) {
+        output.timed_out = true;
+        break;
+      }
+      if (ready == -1) break;
+    }
+    char* dst = discard.data();
+    std::size_t room = discard.size();
+    if (used < max_size) {
+      if (used == output.text.size()) {
+        output.text.resize(std::min(max_size, std::max(MIN_CHUNK, output.text.size() * 2)));
+      }
+      dst = output.text.data() + used;
+      room = output.text.size() - used;
+    }
+    const auto n = ::read(fd, dst, room);
+    if (n == -1 && errno == EINTR) continue;
+    if (n <= 0) break;
+    total += n;
+    if (dst == discard.data()) {
+      output.truncated = true;
+    } else {
+      used += n;
+    }
   }
+  output.text.resize(used);
+  ModuleStats::addBytesRead(total);
   return output;
 }
 
@@ -69,7 +349,8 @@ inline int close(FILE* fp, pid_t pid) {
   return stat;
 }
 
-inline FILE* open(const std::string& cmd, int& pid, const std::string& output_name) {
+inline FILE* open(const std::string& cmd, int& pid, const std::string& output_name,
+                  bool direct = false) {
   if (cmd == "") return nullptr;
   int fd[2];
   // Open the pipe with the close-on-exec flag set, so it will not be inherited
@@ -81,102 +362,76 @@ inline FILE* open(const std::string& cmd, int& pid, const std::string& output_na
     return nullptr;
   }
 
-  pid_t child_pid = fork();
-
-  if (child_pid < 0) {
-    spdlog::error("Unable to exec cmd {}, error {}", cmd.c_str(), strerror(errno));
+  auto child = spawn(cmd, output_name, fd[1], true, direct);
+  ::close(fd[1]);
+  if (child.pid < 0) {
     ::close(fd[0]);
-    ::close(fd[1]);
     return nullptr;
   }
-
-  if (!child_pid) {
-    int err;
-    sigset_t mask;
-    sigfillset(&mask);
-    // Reset sigmask
-    err = pthread_sigmask(SIG_UNBLOCK, &mask, nullptr);
-    if (err != 0) spdlog::error("pthread_sigmask in open failed: {}", strerror(err));
-    // Kill child if Waybar exits
-    int deathsig = SIGTERM;
-#ifdef __linux__
-    if (prctl(PR_SET_PDEATHSIG, deathsig) != 0) {
-      spdlog::error("prctl(PR_SET_PDEATHSIG) in open failed: {}", strerror(errno));
-    }
-#endif
-#ifdef __FreeBSD__
-    if (procctl(P_PID, 0, PROC_PDEATHSIG_CTL, reinterpret_cast<void*>(&deathsig)) == -1) {
-      spdlog::error("procctl(PROC_PDEATHSIG_CTL) in open failed: {}", strerror(errno));
-    }
-#endif
-    ::close(fd[0]);
-    dup2(fd[1], 1);
-    setpgid(child_pid, child_pid);
-    if (!output_name.empty()) {
-      setenv("WAYBAR_OUTPUT_NAME", output_name.c_str(), 1);
-    }
-    execlp("/bin/sh", "sh", "-c", cmd.c_str(), (char*)0);
-    const int saved_errno = errno;
-    spdlog::error("execlp(/bin/sh) failed in open: {}", strerror(saved_errno));
-    _exit(kExecFailureExitCode);
-  } else {
-    ::close(fd[1]);
+  // close() waits by pid
+  if (child.pidfd != -1) {
+    ::close(child.pidfd);
   }
-  pid = child_pid;
+  pid = child.pid;
   return fdopen(fd[0], "r");
 }
 
-inline struct res exec(const std::string& cmd, const std::string& output_name) {
-  int pid;
-  auto fp = command::open(cmd, pid, output_name);
-  if (!fp) return {-1, ""};
-  auto output = command::read(fp);
-  auto stat = command::close(fp, pid);
-  return {WEXITSTATUS(stat), output};
+inline struct res exec(const std::string& cmd, const std::string& output_name,
+                       bool direct = false) {
+  if (cmd == "") return {-1, ""};
+  int fd[2];
+  if (pipe2(fd, O_CLOEXEC) != 0) {
+    spdlog::error("Unable to pipe fd");
+    return {-1, ""};
+  }
+  auto child = spawn(cmd, output_name, fd[1], true, direct);
+  ::close(fd[1]);
+  if (child.pid < 0) {
+    ::close(fd[0]);
+    return {-1, ""};
+  }
+  auto output = command::readAll(fd[0]);
+  ::close(fd[0]);
+  auto stat = command::wait(child);
+  if (output.truncated) {
+    spdlog::warn("Output of {} truncated to {} bytes", cmd, output.text.size());
+  }
+  // Remove last newline
+  if (!output.text.empty() && output.text.back() == '\n') {
+    output.text.pop_back();
+  }
+  return {WEXITSTATUS(stat), std::move(output.text)};
 }
 
-inline struct res execNoRead(const std::string& cmd) {
-  int pid;
-  auto fp = command::open(cmd, pid, "");
-  if (!fp) return {-1, ""};
-  auto stat = command::close(fp, pid);
+inline struct res execNoRead(const std::string& cmd, bool direct = false) {
+  if (cmd == "") return {-1, ""};
+  // The output is discarded
+  int null_fd = ::open("/dev/null", O_WRONLY | O_CLOEXEC);
+  auto child = spawn(cmd, "", null_fd, true, direct);
+  if (null_fd != -1) {
+    ::close(null_fd);
+  }
+  if (child.pid < 0) return {-1, ""};
+  auto stat = command::wait(child);
   return {WEXITSTATUS(stat), ""};
 }
 
 inline int32_t forkExec(const std::string& cmd, const std::string& output_name) {
   if (cmd == "") return -1;
 
-  pid_t pid = fork();
-
-  if (pid < 0) {
-    spdlog::error("Unable to exec cmd {}, error {}", cmd.c_str(), strerror(errno));
-    return pid;
+  // Not tied to the lifetime of Waybar, unlike the commands whose output is read
+  auto child = spawn(cmd, output_name, -1, false);
+  if (child.pid < 0) {
+    return -1;
   }
-
-  // Child executes the command
-  if (!pid) {
-    int err;
-    sigset_t mask;
-    sigfillset(&mask);
-    // Reset sigmask
-    err = pthread_sigmask(SIG_UNBLOCK, &mask, nullptr);
-    if (err != 0) spdlog::error("pthread_sigmask in forkExec failed: {}", strerror(err));
-    setpgid(pid, pid);
-    if (!output_name.empty()) {
-      setenv("WAYBAR_OUTPUT_NAME", output_name.c_str(), 1);
-    }
-    execl("/bin/sh", "sh", "-c", cmd.c_str(), (char*)0);
-    const int saved_errno = errno;
-    spdlog::error("execl(/bin/sh) failed in forkExec: {}", strerror(saved_errno));
-    _exit(kExecFailureExitCode);
-  } else {
-    reap_mtx.lock();
-    reap.push_back(pid);
-    reap_mtx.unlock();
-    spdlog::debug("Added child to reap list: {}", pid);
+  if (child.pidfd != -1) {
+    ::close(child.pidfd);
   }
-
-  return pid;
+  reap_mtx.lock();
+  reap.push_back(child.pid);
+  reap_mtx.unlock();
+  spdlog::debug("Added child to reap list: {}", child.pid);
+  return child.pid;
 }
 
 inline int32_t forkExec(const std::string& cmd) { return forkExec(cmd, ""); }
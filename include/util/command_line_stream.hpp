@@ -3,8 +3,10 @@
 #include <glibmm/main.h>
 #include <glibmm/spawn.h>
 
+#include <csignal>
 #include <functional>
 #include <string>
+#include <string_view>
 
 namespace waybar::util::command {
 
@@ -16,14 +18,20 @@ class LineStream {
   LineStream(std::string output_name, OutputCallback on_output, ExitCallback on_exit);
   ~LineStream();
 
-  void start(const std::string& cmd);
-  void stop();
+  // With `with_stdin`, the stdin of the command is a pipe that write() sends to
+  void start(const std::string& cmd, bool with_stdin = false);
+  // Sends `sig` to the process group of the command and waits for it
+  void stop(int sig = SIGTERM);
   bool running() const;
+  // Sends `line` and a newline to the stdin of the command, without blocking. False if it has no
+  // stdin, exited or doesn't read it fast enough. Lines up to PIPE_BUF bytes are sent whole.
+  bool write(std::string_view line);
 
  private:
   bool handleStdout(Glib::IOCondition condition);
   void handleExit(Glib::Pid pid, int status);
   void closeStdout();
+  void closeStdin();
   void drainStdout(bool flush_trailing_line);
   static int statusToExitCode(int status);
 
@@ -33,6 +41,7 @@ class LineStream {
   std::string buffer_;
   Glib::Pid pid_;
   int stdout_fd_;
+  int stdin_fd_;
   sigc::connection stdout_connection_;
   sigc::connection child_connection_;
 };
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace waybar::util {
+
+/**
+ * Format string split once into literal text and replacement fields.
+ *
+ * Rendering appends the literals as they are and writes fields without format spec holding a
+ * string or an integer directly, only the other fields go through fmt, instead of having fmt scan
+ * the whole string on every update. The named arguments the fields reference are
+ * recorded, so a module can skip computing the ones no format uses. Strings fmt would reject, or
+ * that mix automatic and manual indexing, are rendered whole so that fmt reports the same errors.
+ */
+class CompiledFormat {
+ public:
+  CompiledFormat() = default;
+  explicit CompiledFormat(std::string format);
+
+  const std::string& str() const { return format_; }
+
+  // Whether a field references the named argument. Always true when the format couldn't be
+  // parsed.
+  bool uses(std::string_view name) const;
+  template <typename Pred>
+  bool usesAny(Pred pred) const {
+    return !parsed_ || std::ranges::any_of(names_, pred);
+  }
+  // Whether a field references a positional argument, `{}` or `{0}`. Always true when the format
+  // couldn't be parsed.
+  bool usesPositional() const { return !parsed_ || positional_; }
+
+  // Appends the rendering to `out`
+  void renderTo(fmt::memory_buffer& out, fmt::format_args args) const;
+  std::string render(fmt::format_args args) const;
+
+  // The format string with every `{name}` field `value` has a replacement for substituted, the
+  // other fields are kept for a later formatting
+  std::string substitute(const std::function<const std::string*(std::string_view)>& value) const;
+
+ private:
+  struct Segment {
+    // Literal text with the braces unescaped, or a single field
+    std::string text;
+    bool field;
+    // Name of a `{name}` field without format spec
+    std::string plain_name;
+    // Span in the format string
+    std::size_t begin;
+    std::size_t end;
+    // Index of a `{}` or `{0}` field without format spec
+    int plain_index{-1};
+  };
+
+  std::string format_;
+  std::vector<Segment> segments_;
+  std::vector<std::string> names_;
+  bool positional_{false};
+  bool parsed_{false};
+  // Rendered by fmt as a whole, see above
+  bool whole_{true};
+};
+
+}  // namespace waybar::util
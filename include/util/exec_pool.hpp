@@ -0,0 +1,170 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "util/command.hpp"
+
+namespace waybar::util {
+
+class ModuleStats;
+
+/**
+ * Process-wide limit on the commands run by the polling script modules.
+ *
+ * Modules with the same interval come due together, and each one forking its script at once
+ * makes a CPU spike at every interval boundary. Commands submitted to the pool are instead
+ * queued, and at most `maxChildren()` of them run at once on threads of the pool, so that a
+ * hung script blocks neither the scheduler nor the thread of its module. Queued commands start
+ * in the order of their deadline, the time their result is needed by: a module woken by a signal
+ * or a click goes before the modules polling on a timer, and a module polling every second
+ * before one polling every minute.
+ *
+ * The limit spreads the start of the scripts, where they spend their CPU time. A command still
+ * running after `LONG_RUNNING` mostly waits, on the network or a device, and stops counting
+ * toward it so that a few slow scripts don't hold back every other module.
+ *
+ * A command running longer than its timeout, if it has one, gets its whole process group killed,
+ * so that the children it started don't keep its output open.
+ */
+class ExecPool {
+  struct Job;
+
+ public:
+  using clock = std::chrono::steady_clock;
+  using Callback = std::function<void(command::res)>;
+
+  static constexpr std::size_t DEFAULT_MAX_CHILDREN = 4;
+  static constexpr std::chrono::milliseconds LONG_RUNNING{1000};
+  // Exit code of a command killed on timeout, as with timeout(1)
+  static constexpr int TIMEOUT_EXIT_CODE = 124;
+
+  struct Request {
+    std::string cmd{};
+    // WAYBAR_OUTPUT_NAME of the command, none if empty
+    std::string output_name{};
+    // Discard the output instead of reading it
+    bool no_read{false};
+    // See command::spawn()
+    bool direct{false};
+    // No limit if zero
+    std::chrono::milliseconds timeout{0};
+    // Bytes of output kept, the rest is discarded and reported
+    std::size_t max_output{command::kMaxOutputSize};
+    clock::time_point deadline{clock::now()};
+  };
+
+  /**
+   * Handle to submitted commands. Cancelling it, destroying it or assigning it another task
+   * kills the command still running and waits for a callback in progress: once it returns, the
+   * callback is never called. It must not be cancelled from its own callback.
+   */
+  class Task {
+   public:
+    Task() = default;
+    Task(Task&&) noexcept = default;
+    Task& operator=(Task&& other) noexcept;
+    ~Task() { cancel(); }
+
+    // The commands are queued or running
+    bool pending() const;
+    void cancel();
+
+   private:
+    friend class ExecPool;
+    explicit Task(std::shared_ptr<Job> job) : job_(std::move(job)) {}
+
+    std::shared_ptr<Job> job_;
+  };
+
+  static ExecPool* inst();
+
+  explicit ExecPool(std::size_t max_children = DEFAULT_MAX_CHILDREN);
+  ExecPool(const ExecPool&) = delete;
+  ExecPool& operator=(const ExecPool&) = delete;
+  // Drops the queued commands and waits for the running ones
+  ~ExecPool();
+
+  void setMaxChildren(std::size_t max_children);
+  std::size_t maxChildren();
+
+  // Queues `steps` and returns at once. They run one after the other on a thread of the pool,
+  // the next one only if the previous one exited with 0, and `done` is called on that thread
+  // with the result of the last one run. The deadline of the first step orders the queue. The
+  // children and the time of the steps are counted to `stats`, if set.
+  Task submit(std::vector<Request> steps, Callback done,
+              std::shared_ptr<ModuleStats> stats = nullptr);
+  Task submit(Request request, Callback done, std::shared_ptr<ModuleStats> stats = nullptr);
+
+  // Blocks the calling thread until `request` ran, for the callers owning a thread
+  command::res run(const Request& request);
+
+  // Deadline of a module running every `interval`, without overflowing for "once"
+  static clock::time_point deadlineIn(std::chrono::milliseconds interval);
+
+  // Number of commands running, including the long running ones, waiting for a slot, and killed
+  // on timeout so far
+  std::size_t running();
+  std::size_t waiting();
+  uint64_t timedOut();
+
+ private:
+  struct Job {
+    std::vector<Request> steps;
+    Callback done;
+    std::shared_ptr<ModuleStats> stats;
+    // Set by the thread running the job: when it took a slot, and whether it gave it back
+    clock::time_point started{};
+    bool long_running{false};
+    // Ties are served in arrival order
+    uint64_t seq{0};
+    // Guards the fields below, and is held while `done` runs
+    std::mutex mutex;
+    // Process group of the command running, -1 if none
+    pid_t pgid{-1};
+    bool cancelled{false};
+    bool finished{false};
+  };
+
+  struct Later {
+    bool operator()(const std::shared_ptr<Job>& a, const std::shared_ptr<Job>& b) const {
+      const auto& lhs = a->steps.front().deadline;
+      const auto& rhs = b->steps.front().deadline;
+      return lhs != rhs ? lhs > rhs : a->seq > b->seq;
+    }
+  };
+
+  // Spawns the threads needed for the queued jobs, with mutex_ held
+  void spawnThreads();
+  void work();
+  // Stops counting the job toward max_children_, once it ran for LONG_RUNNING
+  void releaseSlot(Job& job);
+  command::res runJob(Job& job);
+  void finish(Job& job, command::res result);
+  command::res execute(const Request& request, Job& job);
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::priority_queue<std::shared_ptr<Job>, std::vector<std::shared_ptr<Job>>, Later> queue_;
+  std::vector<std::thread> threads_;
+  std::size_t max_children_;
+  // Jobs counted toward max_children_, and the ones running past LONG_RUNNING
+  std::size_t running_{0};
+  std::size_t long_running_{0};
+  uint64_t seq_{0};
+  uint64_t timed_out_{0};
+  bool stop_{false};
+};
+
+}  // namespace waybar::util
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifdef HAVE_LIBUDEV
+#include "util/udev_deleter.hpp"
+#endif
+
+namespace waybar::util {
+
+struct HwmonDevice {
+  // e.g. /sys/class/hwmon/hwmon3
+  std::filesystem::path dir;
+  // Content of its `name` attribute, without the newline
+  std::string name;
+};
+
+// The hwmon devices under `root`, in the order of their number
+std::vector<HwmonDevice> scanHwmon(const std::filesystem::path& root);
+
+/**
+ * hwmon name to directory index, shared by every module looking up sensors by name.
+ *
+ * hwmon numbers follow the probe order and change across boots, so sensors are looked up by the
+ * name of their device. The directory is walked once, on the first lookup, instead of once per
+ * sensor and module. With udev, an hwmon device added or removed marks the index stale and bumps
+ * `generation()` on the next lookup, so that modules resolve their sensors again.
+ */
+class HwmonIndex {
+ public:
+  explicit HwmonIndex(std::filesystem::path root);
+
+  // The index of /sys/class/hwmon, watched for udev events
+  static std::shared_ptr<HwmonIndex> shared();
+
+  // Directory of the first device named `name`
+  std::optional<std::filesystem::path> find(std::string_view name);
+  // Directory of the first device whose name contains `needle` and, unless empty, that has the
+  // attribute `input` (e.g. temp2_input)
+  std::optional<std::filesystem::path> findContaining(std::string_view needle,
+                                                      std::string_view input = {});
+  // Changes every time the index is rebuilt, paths resolved from an older one may be stale
+  uint64_t generation();
+  // Rebuilds the index on the next lookup, e.g. after a sensor vanished
+  void invalidate();
+
+ private:
+  // Applies the pending udev events and rebuilds the index if stale, with `mutex_` held
+  void refresh();
+  void watchUdev();
+
+  const std::filesystem::path root_;
+  std::mutex mutex_;
+  std::vector<HwmonDevice> devices_;
+  bool stale_{true};
+  uint64_t generation_{0};
+#ifdef HAVE_LIBUDEV
+  std::unique_ptr<udev, UdevDeleter> udev_;
+  std::unique_ptr<udev_monitor, UdevMonitorDeleter> mon_;
+#endif
+};
+
+}  // namespace waybar::util
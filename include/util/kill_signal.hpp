@@ -12,13 +12,15 @@ enum class KillSignalAction : std::uint8_t {
   SHOW,
   HIDE,
   NOOP,
+  STATS,
 };
 inline const std::map<std::string, KillSignalAction> userKillSignalActions = {
     {"TOGGLE", KillSignalAction::TOGGLE},
     {"RELOAD", KillSignalAction::RELOAD},
     {"SHOW", KillSignalAction::SHOW},
     {"HIDE", KillSignalAction::HIDE},
-    {"NOOP", KillSignalAction::NOOP}};
+    {"NOOP", KillSignalAction::NOOP},
+    {"STATS", KillSignalAction::STATS}};
 
 inline const KillSignalAction SIGNALACTION_DEFAULT_SIGUSR1 = KillSignalAction::TOGGLE;
 inline const KillSignalAction SIGNALACTION_DEFAULT_SIGUSR2 = KillSignalAction::RELOAD;
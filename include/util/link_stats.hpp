@@ -0,0 +1,50 @@
+#pragma once
+
+#include <linux/netlink.h>
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "util/proc_file.hpp"
+#include "util/scoped_fd.hpp"
+
+namespace waybar::util {
+
+// Byte counters of a network interface
+struct LinkCounters {
+  uint64_t rx_bytes{0};
+  uint64_t tx_bytes{0};
+};
+
+// Counters from the IFLA_STATS64 attribute of an RTM_NEWLINK message, nullopt without it
+std::optional<LinkCounters> parseLinkStats(const nlmsghdr* message);
+// Counters of `ifname` in the content of /proc/net/dev, nullopt if it isn't listed
+std::optional<LinkCounters> parseNetDev(std::string_view netdev, std::string_view ifname);
+
+/**
+ * Samples the counters of a single interface.
+ *
+ * An RTM_GETLINK request for the interface index is answered with its binary stats, instead of
+ * the kernel printing, and us parsing, the line of every interface of /proc/net/dev, which is
+ * large with many veth or container interfaces. /proc/net/dev is the fallback when netlink isn't
+ * available or doesn't report IFLA_STATS64.
+ */
+class LinkStatsReader {
+ public:
+  explicit LinkStatsReader(std::string netdev_path = "/proc/net/dev");
+
+  std::optional<LinkCounters> read(int ifindex, std::string_view ifname);
+
+ private:
+  std::optional<LinkCounters> query(int ifindex);
+
+  ScopedFd sock_;
+  uint32_t seq_{0};
+  // Replies are at most a few kB, they come with every attribute of the link
+  alignas(nlmsghdr) char buffer_[16384];
+  ProcFile netdev_;
+};
+
+}  // namespace waybar::util
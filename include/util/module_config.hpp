@@ -0,0 +1,96 @@
+#pragma once
+
+#include <json/json.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "util/compiled_format.hpp"
+
+namespace waybar::util {
+
+/**
+ * Configuration of a module resolved once at construction.
+ *
+ * Formats, states and icons are looked up on every update; reading them from the `Json::Value`
+ * builds a key string per lookup and `format-icons` was even copied whole. Here the string
+ * options are indexed by key, states are sorted in both directions and icon sets are flattened,
+ * so none of the lookups below allocate. The `format*` and `tooltip-format*` options are also
+ * compiled.
+ */
+class ModuleConfig {
+ public:
+  struct State {
+    std::string name;
+    uint8_t threshold;
+  };
+
+  // One entry of `format-icons`: a single icon, a list spread over the range, or thresholds
+  struct Icons {
+    std::vector<std::string> icons;
+    // Upper bound of each icon, thresholds only
+    std::vector<unsigned> max;
+    bool thresholds{false};
+
+    const std::string& get(uint16_t percentage, uint16_t range) const;
+  };
+
+  explicit ModuleConfig(const Json::Value& config);
+
+  // String option `<key>`, `<key>-<a>` or `<key>-<a>-<b>`. nullptr when not a string, or when
+  // one of the parts is empty.
+  const std::string* string(std::string_view key) const;
+  const std::string* string(std::string_view key, std::string_view a) const;
+  const std::string* string(std::string_view key, std::string_view a, std::string_view b) const;
+  // First of `options` that is set
+  static const std::string* first(std::initializer_list<const std::string*> options);
+
+  // `<key>-<state>` if set, then `<key>`, then `fallback`
+  const std::string& resolve(std::string_view key, std::string_view state,
+                             const std::string& fallback) const;
+
+  // Compiled form of a configured format string, nullptr if `format` isn't one
+  const CompiledFormat* compiled(std::string_view format) const;
+  // Whether any configured format references a positional argument or a named one `pred`
+  // accepts
+  template <typename Pred>
+  bool anyFormatUses(Pred pred) const {
+    return std::ranges::any_of(formats_, [&pred](const auto& entry) {
+      return entry.second.usesPositional() || entry.second.usesAny(pred);
+    });
+  }
+
+  // `states` by decreasing threshold, or increasing for `lesser`
+  const std::vector<State>& states(bool lesser) const {
+    return lesser ? states_ascending_ : states_descending_;
+  }
+  // Name of the first state reached by `value`, nullptr if none
+  const State* state(uint8_t value, bool lesser) const;
+
+  // Icon set of the first `alts` configured, falling back to `default`. nullptr when none.
+  const Icons* icons(std::initializer_list<std::string_view> alts) const;
+  const Icons* icons(const std::vector<std::string>& alts) const;
+
+ private:
+  const Icons* iconsOf(std::string_view alt) const;
+  const std::string* find(std::initializer_list<std::string_view> parts) const;
+
+  std::map<std::string, std::string, std::less<>> strings_;
+  std::size_t max_key_size_{0};
+  // By format string
+  std::map<std::string, CompiledFormat, std::less<>> formats_;
+  std::vector<State> states_descending_;
+  std::vector<State> states_ascending_;
+  // `format-icons` given directly rather than per alt
+  std::optional<Icons> root_icons_;
+  std::map<std::string, Icons, std::less<>> icons_;
+};
+
+}  // namespace waybar::util
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <json/value.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace waybar::util {
+
+/**
+ * Lock-free latency histogram with power-of-two microsecond buckets.
+ */
+class LatencyHistogram {
+ public:
+  // Bucket i counts durations below 2^i µs, the last one is open ended (> ~0.5s)
+  static constexpr std::size_t BUCKETS = 20;
+
+  void record(std::chrono::nanoseconds elapsed);
+  Json::Value toJson() const;
+
+ private:
+  std::array<std::atomic<uint64_t>, BUCKETS> buckets_{};
+  std::atomic<uint64_t> count_{0};
+  std::atomic<uint64_t> total_ns_{0};
+  std::atomic<uint64_t> max_ns_{0};
+};
+
+/**
+ * Instrumentation counters of one module instance or shared data source.
+ *
+ * Collection is off unless waybar runs with `--stats`; every hook starts with a check of
+ * `enabled()`, a relaxed atomic load, so the disabled cost is a branch. Work is attributed to a
+ * module through `Scope`, which marks the module as the one running on the calling thread: code
+ * shared by all modules (command execution, /proc readers) then reports to `current()`.
+ */
+class ModuleStats {
+ public:
+  // Marks `stats` as current on this thread and records the scope duration into `histogram`,
+  // if not null
+  class Scope {
+   public:
+    Scope(ModuleStats* stats, LatencyHistogram ModuleStats::* histogram);
+    ~Scope();
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+   private:
+    ModuleStats* stats_{nullptr};
+    ModuleStats* previous_{nullptr};
+    LatencyHistogram* histogram_{nullptr};
+    std::chrono::steady_clock::time_point start_;
+  };
+
+  explicit ModuleStats(std::string name);
+
+  // Creates stats registered for dumps. `name` identifies the instance, e.g. "cpu#bar-1".
+  static std::shared_ptr<ModuleStats> create(const std::string& name);
+
+  static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+  static void setEnabled(bool enabled);
+  // Stats of the module whose code is running on the calling thread, if any
+  static ModuleStats* current();
+
+  static void addBytesRead(std::size_t bytes);
+  static void addChildSpawned();
+
+  // All live stats as a JSON object keyed by name
+  static Json::Value dump();
+  // Writes the dump to `path`, or to the log if `path` is empty
+  static void dumpTo(const std::string& path);
+
+  Json::Value toJson() const;
+
+  // Time spent producing data off the main thread
+  LatencyHistogram sample_time;
+  // Time spent in update() on the main thread
+  LatencyHistogram update_time;
+  std::atomic<uint64_t> emits{0};
+  std::atomic<uint64_t> updates{0};
+  std::atomic<uint64_t> label_changes{0};
+  std::atomic<uint64_t> label_unchanged{0};
+  std::atomic<uint64_t> bytes_read{0};
+  std::atomic<uint64_t> children_spawned{0};
+
+ private:
+  static std::atomic<bool> enabled_;
+
+  const std::string name_;
+  const std::chrono::steady_clock::time_point created_;
+};
+
+}  // namespace waybar::util
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace waybar::util {
+
+// A line of /proc/<pid>/mountinfo
+struct MountEntry {
+  unsigned int major{0};
+  unsigned int minor{0};
+  std::string mount_point;
+  std::string fstype;
+  // e.g. /dev/nvme0n1p2 or server:/export
+  std::string source;
+};
+
+// The mounts of a mountinfo file, in its order. Malformed lines are skipped.
+std::vector<MountEntry> parseMountinfo(std::string_view text);
+
+// The mount `path` resides on, without touching the filesystem: the one with the longest mount
+// point containing it, the last listed if stacked. nullptr for a relative path.
+const MountEntry* findMount(const std::vector<MountEntry>& mounts, std::string_view path);
+
+}  // namespace waybar::util
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <netlink/netlink.h>
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "util/link_stats.hpp"
+#include "util/module_stats.hpp"
+#include "util/netlink_state.hpp"
+#include "util/scoped_fd.hpp"
+#include "util/sleeper_thread.hpp"
+
+namespace waybar::util {
+
+/**
+ * rtnetlink event loop shared by every network module of the process.
+ *
+ * A single socket joins the link, address and route groups, and each message is parsed once
+ * into a NetlinkState. Another one joins the nl80211 "mlme", "scan" and "config" groups, so
+ * that association, roaming, scan results and the signal level crossing the connection quality
+ * thresholds set by the supplicant are pushed instead of polled. Subscribers are only notified
+ * of the changes of the interface they follow, once per batch of messages, and read the state
+ * back with `read()`. The monitor also holds the request sockets the modules used to open each:
+ * nl80211 and the link counters. It is created with the first subscription and released with
+ * the last.
+ */
+class NetlinkMonitor {
+ public:
+  using Callback = std::function<void(const NetlinkNotification&)>;
+  struct Subscriber;
+
+  // Keeps the monitor alive and unsubscribes on destruction
+  class Subscription {
+   public:
+    Subscription() = default;
+    Subscription(std::shared_ptr<NetlinkMonitor> monitor, std::shared_ptr<Subscriber> subscriber);
+    Subscription(const Subscription&) = delete;
+    Subscription& operator=(const Subscription&) = delete;
+    Subscription(Subscription&& other) noexcept = default;
+    Subscription& operator=(Subscription&& other) noexcept;
+    ~Subscription() { reset(); }
+
+    // Blocks until a notification in progress has returned
+    void reset();
+    // Follow the changes of this interface, or the link changes of every interface with -1
+    void setInterface(int ifindex);
+
+    NetlinkMonitor* operator->() const { return monitor_.get(); }
+    explicit operator bool() const { return monitor_ != nullptr; }
+
+   private:
+    std::shared_ptr<NetlinkMonitor> monitor_;
+    std::shared_ptr<Subscriber> subscriber_;
+  };
+
+  // With `routes`, every default route change is also notified, for modules following the
+  // default route. `callback` runs on the monitor thread.
+  static Subscription subscribe(bool routes, Callback callback);
+
+  NetlinkMonitor(const NetlinkMonitor&) = delete;
+  NetlinkMonitor& operator=(const NetlinkMonitor&) = delete;
+  ~NetlinkMonitor();
+
+  // Calls `reader` with the current state, which isn't changed until it returns
+  template <typename F>
+  void read(F&& reader) const {
+    std::lock_guard lock(state_mutex_);
+    reader(state_);
+  }
+
+  std::optional<LinkCounters> linkStats(int ifindex, std::string_view ifname);
+
+  // -1 if the nl80211 family isn't available
+  int nl80211Id() const { return nl80211_id_; }
+  // Whether nl80211 events are received, otherwise the wireless state has to be polled
+  bool nl80211Events() const { return nl80211_events_ != nullptr; }
+  // Sends `message`, which is freed, and passes each reply to `callback`
+  int nl80211Request(nl_msg* message, nl_recvmsg_msg_cb_t callback, void* arg);
+
+ private:
+  NetlinkMonitor();
+
+  static int handleNl80211Event(nl_msg* message, void* data);
+
+  void joinNl80211Groups();
+  void unsubscribe(const std::shared_ptr<Subscriber>& subscriber);
+  void receive(bool rtnetlink, bool nl80211);
+  void receiveRtnetlink();
+  void receiveNl80211();
+  void handleMessage(const nlmsghdr* message);
+  void requestDump(uint16_t type);
+  void sendNextDump();
+  void notify();
+
+  ScopedFd sock_;
+  uint32_t seq_{0};
+  // Sequence number of the dump in progress, 0 if none
+  uint32_t dump_seq_{0};
+  uint16_t dump_type_{0};
+  bool dump_interrupted_{false};
+  // The kernel still runs a dump we abandoned, it refuses new ones until its end
+  bool dump_busy_{false};
+  std::vector<uint16_t> wanted_dumps_;
+  // Changes of the current batch, and whether it completed a dump, which concerns everyone
+  std::vector<NetlinkChange> changes_;
+  bool notify_all_{false};
+  // Dump replies hold every attribute of a batch of links
+  alignas(nlmsghdr) char buffer_[32768];
+
+  mutable std::mutex state_mutex_;
+  NetlinkState state_;
+
+  std::mutex subscribers_mutex_;
+  std::vector<std::shared_ptr<Subscriber>> subscribers_;
+
+  std::mutex link_stats_mutex_;
+  LinkStatsReader link_stats_;
+
+  std::mutex nl80211_mutex_;
+  nl_sock* nl80211_sock_{nullptr};
+  int nl80211_id_{-1};
+  // Multicast events, null if no group could be joined
+  nl_sock* nl80211_events_{nullptr};
+
+  const std::shared_ptr<ModuleStats> stats_;
+  SleeperThread thread_;
+};
+
+}  // namespace waybar::util
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <linux/netlink.h>
+
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace waybar::util {
+
+struct NetlinkLink {
+  int index{0};
+  std::string ifname;
+  std::vector<std::string> altnames;
+  unsigned int flags{0};
+  std::optional<bool> carrier;
+  // Last dump that listed it
+  uint32_t generation{0};
+};
+
+struct NetlinkAddress {
+  int index{0};
+  int family{0};
+  uint8_t prefixlen{0};
+  uint8_t scope{0};
+  // IFA_ADDRESS, the peer address on a point-to-point link
+  std::string address;
+  // IFA_LOCAL
+  std::string local;
+  uint32_t generation{0};
+};
+
+// A default route of the main table
+struct NetlinkRoute {
+  int family{0};
+  int oif{-1};
+  uint32_t priority{0};
+  std::string gateway;
+  uint32_t generation{0};
+};
+
+// What a message changed, so that it is only forwarded to the modules it concerns
+struct NetlinkChange {
+  // WIRELESS are nl80211 events: association, roaming, scan results or signal level
+  enum class Kind : uint8_t { NONE, LINK, ADDRESS, ROUTE, WIRELESS };
+
+  Kind kind{Kind::NONE};
+  // Interface the change applies to, -1 for a WIRELESS change of every interface
+  int index{-1};
+  // Signal level of a connection quality monitor event, in dBm
+  std::optional<int32_t> signal_dbm;
+};
+
+// What changed for a subscriber in a batch of messages
+struct NetlinkNotification {
+  // Links, addresses or routes, to `read()` again
+  bool state{false};
+  // The association or the BSS of the interface, to query again over nl80211
+  bool wireless{false};
+  // Latest signal level pushed by a connection quality monitor event, in dBm
+  std::optional<int32_t> signal_dbm;
+
+  void add(const NetlinkChange& change);
+  bool empty() const { return !state && !wireless && !signal_dbm.has_value(); }
+};
+
+// Change of an nl80211 multicast event, NONE for the events that don't change what is displayed
+NetlinkChange parseNl80211Event(const nlmsghdr* message);
+
+/**
+ * Interfaces, addresses and default routes of the system, maintained from rtnetlink messages.
+ *
+ * Notifications and dump replies are applied as they are received. A dump, opened with
+ * `beginDump()`, also drops the entries of its kind that it didn't list by `endDump()`, which
+ * resynchronises the state after notifications were lost.
+ */
+class NetlinkState {
+ public:
+  NetlinkChange apply(const nlmsghdr* message);
+
+  // `type` is the request of the dump: RTM_GETLINK, RTM_GETADDR or RTM_GETROUTE
+  void beginDump(uint16_t type);
+  void endDump();
+
+  const std::map<int, NetlinkLink>& links() const { return links_; }
+  const std::vector<NetlinkAddress>& addresses() const { return addresses_; }
+  const std::vector<NetlinkRoute>& routes() const { return routes_; }
+
+ private:
+  NetlinkChange applyLink(const nlmsghdr* message);
+  NetlinkChange applyAddress(const nlmsghdr* message);
+  NetlinkChange applyRoute(const nlmsghdr* message);
+
+  std::map<int, NetlinkLink> links_;
+  // In the order the kernel reported them
+  std::vector<NetlinkAddress> addresses_;
+  std::vector<NetlinkRoute> routes_;
+  uint32_t generation_{0};
+  uint16_t dump_type_{0};
+};
+
+}  // namespace waybar::util
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "util/proc_file.hpp"
+
+namespace waybar::util {
+
+// Properties of a power_supply class device, a battery or an adapter. Unreported ones are empty.
+struct PowerSupplyReadings {
+  std::string status;
+  std::optional<int64_t> online;
+  std::optional<int64_t> capacity;
+  std::optional<int64_t> current_now;
+  std::optional<int64_t> current_avg;
+  std::optional<int64_t> voltage_now;
+  std::optional<int64_t> voltage_avg;
+  std::optional<int64_t> power_now;
+  std::optional<int64_t> charge_now;
+  std::optional<int64_t> charge_full;
+  std::optional<int64_t> charge_full_design;
+  std::optional<int64_t> energy_now;
+  std::optional<int64_t> energy_full;
+  std::optional<int64_t> energy_full_design;
+  std::optional<int64_t> time_to_empty_now;
+  std::optional<int64_t> time_to_full_now;
+  std::optional<int64_t> cycle_count;
+
+  // Whether no property was read
+  bool empty() const;
+  // Empties every property, keeping the storage of `status`
+  void clear();
+};
+
+// Fills `readings` from the `POWER_SUPPLY_<PROPERTY>=<value>` lines of a uevent file
+void parsePowerSupplyUevent(std::string_view uevent, PowerSupplyReadings& readings);
+// Fills `readings` from the attribute files of the device directory `dir`, one per property
+void readPowerSupplyAttributes(const std::filesystem::path& dir, PowerSupplyReadings& readings);
+
+/**
+ * A power_supply device sampled through its `uevent` file.
+ *
+ * The kernel reports every property of the device in the uevent, so a single pread on a kept-open
+ * fd replaces an open and a parse per attribute file. The attribute files are only read when the
+ * uevent holds no property, as with mocked devices.
+ */
+class PowerSupply {
+ public:
+  explicit PowerSupply(std::filesystem::path dir);
+
+  const std::filesystem::path& dir() const { return dir_; }
+
+  // Valid until the next read
+  const PowerSupplyReadings& read();
+
+ private:
+  std::filesystem::path dir_;
+  ProcFile uevent_;
+  PowerSupplyReadings readings_;
+};
+
+}  // namespace waybar::util
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <charconv>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "util/scoped_fd.hpp"
+
+namespace waybar::util {
+
+/**
+ * A procfs or sysfs file kept open and read again from offset 0 on every sample.
+ *
+ * These files are regenerated by the kernel on each read from the start, so a single fd serves
+ * every sample without the open/close and stream setup, and the content lands in a buffer that
+ * only grows until it fits the file. Files of several records, such as /proc/self/mountinfo, are
+ * read until the end one chunk at a time: records changing meanwhile may be missed or repeated.
+ */
+class ProcFile {
+ public:
+  explicit ProcFile(std::string path);
+
+  const std::string& path() const { return path_; }
+  bool isOpen() const { return fd_ != -1; }
+
+  // The whole content, valid until the next read. Throws std::runtime_error when the file can't
+  // be opened or read; the open is retried on the next call.
+  std::string_view read();
+
+ private:
+  std::string path_;
+  ScopedFd fd_;
+  std::vector<char> buffer_;
+};
+
+// Skips the blanks at the start of `text` and parses the unsigned decimal that follows,
+// advancing `text` past it. False, with `text` unchanged, if there is none.
+template <typename T>
+bool scanUnsigned(std::string_view& text, T& value) {
+  const auto begin = text.find_first_not_of(" \t");
+  if (begin == std::string_view::npos) {
+    return false;
+  }
+  const auto [end, ec] = std::from_chars(text.data() + begin, text.data() + text.size(), value);
+  if (ec != std::errc()) {
+    return false;
+  }
+  text.remove_prefix(end - text.data());
+  return true;
+}
+
+// The line at the start of `text`, without its newline, and advances `text` to the next one
+inline std::string_view nextLine(std::string_view& text) {
+  const auto end = text.find('\n');
+  const auto line = text.substr(0, end);
+  text.remove_prefix(end == std::string_view::npos ? text.size() : end + 1);
+  return line;
+}
+
+}  // namespace waybar::util
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace waybar::util {
+
+/**
+ * Process-wide timer shared by every polling module.
+ *
+ * A single timer thread keeps a min-heap of due jobs and hands them to a small worker pool, so
+ * the number of threads stays flat no matter how many modules or bars register periodic work.
+ * A job never runs concurrently with itself; it is rearmed once its callback returns.
+ *
+ * Periodic jobs must not block: the workers are shared by every module, so a job waiting on a
+ * child process or a hung device delays all the others. Such work belongs to the ExecPool or to
+ * a thread of its own, with the result posted back. A periodic job running longer than its
+ * interval, or than `SLOW_JOB`, is counted as an overrun and logged once.
+ *
+ * With a timer slack configured, due times are rounded up to the next multiple of the slack on
+ * the wall clock. Jobs due within the same slack window then fire together in a single wakeup,
+ * and jobs aligned on the wall clock (e.g. clocks) stay aligned when their interval is a
+ * multiple of the slack. The slack is also applied to the scheduler threads with
+ * PR_SET_TIMERSLACK on Linux.
+ */
+class Scheduler {
+ public:
+  using clock = std::chrono::steady_clock;
+
+  // Upper bound for the worker pool. Workers are spawned lazily, only when every existing
+  // worker is busy running a (possibly blocking) job.
+  static constexpr std::size_t MAX_WORKERS = 8;
+  // Longest run of a periodic job with a longer interval that isn't an overrun
+  static constexpr std::chrono::milliseconds SLOW_JOB{1000};
+
+  static Scheduler* inst();
+
+  Scheduler(const Scheduler&) = delete;
+  Scheduler& operator=(const Scheduler&) = delete;
+
+  // Number of threads owned by the scheduler (timer thread + workers)
+  std::size_t threadCount();
+
+  void setTimerSlack(std::chrono::milliseconds slack);
+  std::chrono::milliseconds timerSlack();
+
+  // Delay until the next run of a job run every `interval`, `since_epoch` being the time on the
+  // wall clock: lined up on multiples of `interval` with `align`, then rounded up to the next
+  // multiple of `slack` if set
+  static clock::duration nextDelay(std::chrono::milliseconds interval, bool align,
+                                   std::chrono::milliseconds slack,
+                                   std::chrono::system_clock::duration since_epoch);
+
+  // Number of times the timer thread woke up to run due jobs. The rate is also logged every
+  // minute at debug level.
+  uint64_t wakeups();
+
+  // Number of runs of periodic jobs that overran, see above
+  uint64_t overruns();
+
+  struct Job;
+
+ private:
+  friend class PeriodicTask;
+  friend class BackgroundTask;
+
+  struct Entry {
+    clock::time_point due;
+    uint64_t generation;
+    std::shared_ptr<Job> job;
+    bool operator>(const Entry& other) const { return due > other.due; }
+  };
+
+  Scheduler();
+
+  void add(const std::shared_ptr<Job>& job);
+  void wakeUp(const std::shared_ptr<Job>& job);
+  void wakeUpAll();
+  void pause(const std::shared_ptr<Job>& job);
+  void resume(const std::shared_ptr<Job>& job);
+  void remove(const std::shared_ptr<Job>& job);
+
+  void timerLoop();
+  void workerLoop();
+  void arm(const std::shared_ptr<Job>& job, clock::time_point due);
+  void dispatch(const std::shared_ptr<Job>& job);
+  clock::duration nextDelay(const Job& job) const;
+  void countWakeup();
+  void applyTimerSlack(std::chrono::milliseconds::rep& applied) const;
+
+  std::mutex mutex_;
+  std::condition_variable timer_cv_;
+  std::condition_variable work_cv_;
+  std::condition_variable done_cv_;
+  std::priority_queue<Entry, std::vector<Entry>, std::greater<>> heap_;
+  std::deque<std::shared_ptr<Job>> ready_;
+  std::vector<std::weak_ptr<Job>> jobs_;
+  std::vector<std::thread> workers_;
+  std::size_t idle_workers_{0};
+  std::chrono::milliseconds slack_{0};
+  // Read by every thread to apply the kernel timer slack without taking the mutex
+  std::atomic<std::chrono::milliseconds::rep> slack_ms_{0};
+  uint64_t wakeups_{0};
+  uint64_t overruns_{0};
+  uint64_t report_wakeups_{0};
+  clock::time_point report_start_{clock::now()};
+  std::thread timer_thread_;
+};
+
+/**
+ * Handle to a periodic job registered with the Scheduler.
+ *
+ * Drop-in replacement for the `SleeperThread` + `sleep_for(interval_)` idiom of polling modules:
+ * `wake_up`, `pause` and `resume` behave the same way, but no thread is owned by the handle.
+ * The callback runs on a scheduler worker, first right after `start()` and then `interval` after
+ * each run. With `align` set, runs are lined up on multiples of `interval` of the wall clock
+ * (useful for clocks). An `interval` of `milliseconds::max()` runs the job only on `wake_up`.
+ */
+class PeriodicTask {
+ public:
+  PeriodicTask() = default;
+  PeriodicTask(const PeriodicTask&) = delete;
+  PeriodicTask& operator=(const PeriodicTask&) = delete;
+  ~PeriodicTask() { stop(); }
+
+  void start(std::function<void()> func, std::chrono::milliseconds interval, bool align = false);
+  bool isRunning() const { return job_ != nullptr; }
+
+  void wake_up();
+  void pause();
+  void resume();
+  // Unregisters the job. Blocks until an in-flight run has returned, unless called from the job
+  // itself.
+  void stop();
+
+ private:
+  std::shared_ptr<Scheduler::Job> job_;
+};
+
+/**
+ * One-shot job on a scheduler worker, for blocking work a module would otherwise do in its
+ * constructor (device discovery, compositor queries). The function runs once, it is not rerun
+ * after resuming from sleep.
+ */
+class BackgroundTask {
+ public:
+  BackgroundTask() = default;
+  BackgroundTask(const BackgroundTask&) = delete;
+  BackgroundTask& operator=(const BackgroundTask&) = delete;
+  ~BackgroundTask() { stop(); }
+
+  void start(std::function<void()> func);
+  // Drops the task if it has not run yet, otherwise blocks until it has returned (unless called
+  // from the task itself)
+  void stop();
+
+ private:
+  std::shared_ptr<Scheduler::Job> job_;
+};
+
+}  // namespace waybar::util
@@ -0,0 +1,209 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include "util/module_stats.hpp"
+#include "util/scheduler.hpp"
+
+namespace waybar::util {
+
+/**
+ * Reference-counted data source shared by every module instance using the same key.
+ *
+ * Modules on different bars that display the same data (e.g. /proc/stat) acquire the same
+ * sampler, so the data is read once per interval no matter how many bars show it. The sampler
+ * runs on the Scheduler, subscribers are notified after each sample and read the latest
+ * snapshot. The source is released together with its last subscriber.
+ *
+ * Like any Scheduler job, a sampler must not block. One waiting for a child process or a slow
+ * device is started with `subscribeAsync()` instead and publishes its value once ready.
+ */
+template <typename T>
+class SharedSampler {
+ public:
+  using Sampler = std::function<T()>;
+  using Publish = std::function<void(T)>;
+  // Starts a sample and returns without waiting for it. `publish` is called with the value,
+  // possibly from another thread, and no other sample starts before that. Whatever calls
+  // `publish` must be owned by the sampler, so that destroying it stops them.
+  using AsyncSampler = std::function<void(Publish publish)>;
+  using Callback = std::function<void()>;
+
+  // Keeps the source alive and unsubscribes on destruction
+  class Subscription {
+   public:
+    Subscription() = default;
+    Subscription(std::shared_ptr<SharedSampler> source, uint64_t id)
+        : source_(std::move(source)), id_(id) {}
+    Subscription(const Subscription&) = delete;
+    Subscription& operator=(const Subscription&) = delete;
+    Subscription(Subscription&& other) noexcept { *this = std::move(other); }
+    Subscription& operator=(Subscription&& other) noexcept {
+      reset();
+      source_ = std::move(other.source_);
+      id_ = other.id_;
+      return *this;
+    }
+    ~Subscription() { reset(); }
+
+    void reset() {
+      if (source_) {
+        source_->unsubscribe(id_);
+        source_.reset();
+      }
+    }
+
+    explicit operator bool() const { return source_ != nullptr; }
+
+    // Latest sample; a default constructed value until the first sample completes
+    std::shared_ptr<const T> snapshot() const {
+      return source_ ? source_->snapshot() : std::make_shared<const T>();
+    }
+    // Ask for a new sample outside of the regular interval. Asked while a sample is in flight,
+    // the new one starts once that one is published, so the value is never older than the ask.
+    void refresh() const {
+      if (source_) source_->task_.wake_up();
+    }
+
+   private:
+    std::shared_ptr<SharedSampler> source_;
+    uint64_t id_{0};
+  };
+
+  SharedSampler(const SharedSampler&) = delete;
+  SharedSampler& operator=(const SharedSampler&) = delete;
+
+  // Subscribe to the source identified by `key`, starting it with `sampler` if no other module
+  // uses it yet. `key` must capture everything the sampler output depends on.
+  static Subscription subscribe(const std::string& key, std::chrono::milliseconds interval,
+                                Sampler sampler, Callback callback) {
+    return subscribeAsync(
+        key, interval,
+        [sampler = std::move(sampler)](const Publish& publish) { publish(sampler()); },
+        std::move(callback));
+  }
+
+  static Subscription subscribeAsync(const std::string& key, std::chrono::milliseconds interval,
+                                     AsyncSampler sampler, Callback callback) {
+    std::shared_ptr<SharedSampler> source;
+    {
+      std::lock_guard lock(registryMutex());
+      auto& weak = registry()[key];
+      source = weak.lock();
+      if (!source) {
+        source = std::shared_ptr<SharedSampler>(new SharedSampler(key, std::move(sampler)));
+        weak = source;
+        source->task_.start([raw = source.get()] { raw->sample(); }, interval);
+      }
+    }
+    auto id = source->addSubscriber(std::move(callback));
+    return Subscription(std::move(source), id);
+  }
+
+  ~SharedSampler() {
+    {
+      // A publish in flight no longer wakes the task up
+      std::lock_guard lock(wake_mutex_);
+      closing_ = true;
+    }
+    task_.stop();
+    // Waits for a sample in flight, it still publishes to the members
+    sampler_ = nullptr;
+    std::lock_guard lock(registryMutex());
+    std::erase_if(registry(), [](const auto& entry) { return entry.second.expired(); });
+  }
+
+  std::shared_ptr<const T> snapshot() const {
+    std::lock_guard lock(snapshot_mutex_);
+    return snapshot_;
+  }
+
+ private:
+  SharedSampler(const std::string& key, AsyncSampler sampler)
+      : sampler_(std::move(sampler)), stats_(ModuleStats::create("sampler:" + key)) {}
+
+  static std::map<std::string, std::weak_ptr<SharedSampler>>& registry() {
+    static std::map<std::string, std::weak_ptr<SharedSampler>> registry;
+    return registry;
+  }
+
+  static std::mutex& registryMutex() {
+    static std::mutex mutex;
+    return mutex;
+  }
+
+  uint64_t addSubscriber(Callback callback) {
+    std::lock_guard lock(subscribers_mutex_);
+    auto id = ++last_id_;
+    subscribers_.emplace(id, std::move(callback));
+    // Late subscribers still get the sample that was taken before they joined
+    if (has_sample_) {
+      subscribers_.at(id)();
+    }
+    return id;
+  }
+
+  void unsubscribe(uint64_t id) {
+    std::lock_guard lock(subscribers_mutex_);
+    subscribers_.erase(id);
+  }
+
+  void sample() {
+    // Left set when a sample is in flight, publish() then starts another one
+    refresh_pending_ = true;
+    if (in_flight_.exchange(true)) {
+      return;
+    }
+    refresh_pending_ = false;
+    ModuleStats::Scope scope(stats_.get(), &ModuleStats::sample_time);
+    sampler_([this](T value) { publish(std::move(value)); });
+  }
+
+  void publish(T value) {
+    {
+      std::lock_guard lock(snapshot_mutex_);
+      snapshot_ = std::make_shared<const T>(std::move(value));
+    }
+    {
+      // Callbacks are invoked with the lock held so a module cannot be destroyed while it is
+      // being notified.
+      std::lock_guard lock(subscribers_mutex_);
+      has_sample_ = true;
+      for (auto& [id, callback] : subscribers_) {
+        callback();
+      }
+    }
+    in_flight_ = false;
+    if (refresh_pending_.exchange(false)) {
+      std::lock_guard lock(wake_mutex_);
+      if (!closing_) {
+        task_.wake_up();
+      }
+    }
+  }
+
+  AsyncSampler sampler_;
+  std::atomic<bool> in_flight_{false};
+  std::atomic<bool> refresh_pending_{false};
+  // Guards the wake-ups of task_ by publish() against its stop
+  std::mutex wake_mutex_;
+  bool closing_{false};
+  const std::shared_ptr<ModuleStats> stats_;
+  mutable std::mutex snapshot_mutex_;
+  std::shared_ptr<const T> snapshot_ = std::make_shared<const T>();
+  std::mutex subscribers_mutex_;
+  std::map<uint64_t, Callback> subscribers_;
+  uint64_t last_id_{0};
+  bool has_sample_{false};
+  PeriodicTask task_;
+};
+
+}  // namespace waybar::util
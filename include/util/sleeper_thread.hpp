@@ -1,10 +1,17 @@
 #pragma once
 
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <array>
 #include <atomic>
+#include <cerrno>
 #include <chrono>
 #include <condition_variable>
 #include <ctime>
 #include <functional>
+#include <mutex>
 #include <thread>
 
 #include "prepare_for_sleep.h"
@@ -12,26 +19,20 @@
 namespace waybar::util {
 
 /**
- * Defer pthread_cancel until the end of a current scope.
+ * Worker thread with cooperative cancellation.
  *
- * Required to protect a scope where it's unsafe to raise `__forced_unwind` exception.
- * An example of these is a call of a method marked as `noexcept`; an attempt to cancel within such
- * a method may result in a `std::terminate` call.
+ * `stop()` never kills the thread: it wakes up `sleep*()` and makes `stopFd()` readable, so a
+ * worker blocking on I/O must wait through `waitReadable()` or include `stopFd()` in its own
+ * poll()/epoll() set, then return once `isRunning()` is false. Because every blocking point is
+ * interruptible, destruction is bounded by the time the current iteration needs to notice.
  */
-class CancellationGuard {
-  int oldstate;
-
- public:
-  CancellationGuard() { pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &oldstate); }
-  ~CancellationGuard() { pthread_setcancelstate(oldstate, &oldstate); }
-};
-
 class SleeperThread {
  public:
-  SleeperThread() = default;
+  SleeperThread() : stop_fd_{eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)} {}
 
   SleeperThread(std::function<void()> func)
-      : thread_{[this, func] {
+      : stop_fd_{eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)},
+        thread_{[this, func] {
           while (do_run_.load(std::memory_order_relaxed)) {
             signal_.store(false, std::memory_order_relaxed);
             func();
@@ -43,14 +44,13 @@ class SleeperThread {
   }
 
   SleeperThread& operator=(std::function<void()> func) {
-    if (thread_.joinable()) {
-      stop();
-      thread_.join();
-    }
+    join();
     {
       std::lock_guard<std::mutex> lck(mutex_);
       do_run_.store(true, std::memory_order_relaxed);
       signal_.store(false, std::memory_order_relaxed);
+      eventfd_t value;
+      eventfd_read(stop_fd_, &value);
     }
     thread_ = std::thread([this, func] {
       while (do_run_.load(std::memory_order_relaxed)) {
@@ -68,9 +68,25 @@ class SleeperThread {
 
   bool isRunning() const { return do_run_.load(std::memory_order_relaxed); }
 
+  // Becomes readable once the thread is asked to stop
+  int stopFd() const { return stop_fd_; }
+
+  // Blocks until `fd` has something to read (or was hung up). Returns false if the thread was
+  // stopped or `timeout_ms` elapsed first.
+  bool waitReadable(int fd, int timeout_ms = -1) {
+    std::array<pollfd, 2> fds{{{fd, POLLIN, 0}, {stop_fd_, POLLIN, 0}}};
+    while (isRunning()) {
+      int ret = poll(fds.data(), fds.size(), timeout_ms);
+      if (ret < 0 && errno == EINTR) {
+        continue;
+      }
+      return ret > 0 && fds[1].revents == 0 && fds[0].revents != 0;
+    }
+    return false;
+  }
+
   auto sleep() {
     std::unique_lock lk(mutex_);
-    CancellationGuard cancel_lock;
     return condvar_.wait(lk, [this] {
       return signal_.load(std::memory_order_relaxed) || !do_run_.load(std::memory_order_relaxed);
     });
@@ -78,7 +94,6 @@ class SleeperThread {
 
   auto sleep_for(std::chrono::system_clock::duration dur) {
     std::unique_lock lk(mutex_);
-    CancellationGuard cancel_lock;
 
     condvar_.wait(lk, [this] {
       return !is_paused_ || signal_.load(std::memory_order_relaxed) ||
@@ -100,7 +115,6 @@ class SleeperThread {
       std::chrono::time_point<std::chrono::system_clock, std::chrono::system_clock::duration>
           time_point) {
     std::unique_lock lk(mutex_);
-    CancellationGuard cancel_lock;
 
     condvar_.wait(lk, [this] {
       return !is_paused_ || signal_.load(std::memory_order_relaxed) ||
@@ -127,10 +141,15 @@ class SleeperThread {
       do_run_.store(false, std::memory_order_relaxed);
     }
     condvar_.notify_all();
-    auto handle = thread_.native_handle();
-    if (handle != 0) {
-      // TODO: find a proper way to terminate thread...
-      pthread_cancel(handle);
+    eventfd_write(stop_fd_, 1);
+  }
+
+  // Stops the thread and waits for the current iteration to return. A no-op from the worker
+  // itself.
+  void join() {
+    stop();
+    if (thread_.joinable() && thread_.get_id() != std::this_thread::get_id()) {
+      thread_.join();
     }
   }
 
@@ -147,13 +166,15 @@ class SleeperThread {
 
   ~SleeperThread() {
     connection_.disconnect();
-    stop();
+    join();
     if (thread_.joinable()) {
-      thread_.join();
+      thread_.detach();
     }
+    close(stop_fd_);
   }
 
  private:
+  int stop_fd_;
   std::thread thread_;
   std::condition_variable condvar_;
   std::mutex mutex_;
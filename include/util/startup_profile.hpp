@@ -0,0 +1,49 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+
+namespace waybar::util {
+
+/**
+ * Phase timeline of the startup, enabled with `--profile-startup`.
+ *
+ * Phases are recorded from any thread until every bar created by the first batch has presented
+ * its first frame; the timeline is then printed to stderr and recording stops. Offsets are
+ * relative to the start of the process when it can be read from /proc, otherwise to `enable()`.
+ * While disabled, every call is a relaxed atomic load.
+ */
+class StartupProfile {
+ public:
+  // Records the lifetime of the span as a phase
+  class Span {
+   public:
+    explicit Span(std::string name);
+    ~Span();
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+
+   private:
+    std::string name_;
+    std::chrono::steady_clock::time_point start_;
+    bool active_{false};
+  };
+
+  // Must be called from the main thread
+  static void enable();
+  static bool enabled();
+
+  // Records a point in time
+  static void mark(const std::string& name);
+
+  // A bar of the first batch will present a frame
+  static void expectFrame();
+  static void frameDone(const std::string& output);
+  // The first batch of bars was created. The timeline is printed as soon as every expected frame
+  // is done.
+  static void batchDone();
+  // Prints the timeline if it was not printed yet
+  static void report();
+};
+
+}  // namespace waybar::util
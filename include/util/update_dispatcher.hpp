@@ -0,0 +1,66 @@
+#pragma once
+
+#include <glib.h>
+#include <gtkmm/widget.h>
+#include <sigc++/sigc++.h>
+
+#include "util/module_stats.hpp"
+
+namespace waybar::util {
+
+/**
+ * Coalescing replacement for the per-module `Glib::Dispatcher`.
+ *
+ * `emit()` may be called from any thread. It only marks the owner dirty in a process-wide set;
+ * the first mark wakes the main loop through a single shared dispatcher, so modules do not own a
+ * pipe each and a burst of events costs one wakeup. On the main thread every dirty module is
+ * scheduled on the frame clock of its widget and its handlers run once on the next frame tick,
+ * no matter how many times it was emitted in between. All modules of a bar are therefore
+ * updated in the same frame and laid out once. Modules whose widget is not mapped (not shown
+ * yet, or hidden) are updated right away, as there is no frame to wait for.
+ *
+ * A mapped widget may still get no tick for a long time: on Wayland, the compositor withholds
+ * frame callbacks from a surface that isn't visible, e.g. with the output off or the bar under a
+ * fullscreen window. The handlers also do work that must go on then (battery events, on-update
+ * commands...), so an update waiting for `FRAME_TIMEOUT` runs without its frame.
+ */
+class UpdateDispatcher {
+ public:
+  // Several frames at any refresh rate
+  static constexpr guint FRAME_TIMEOUT_MS = 100;
+
+  UpdateDispatcher();
+  ~UpdateDispatcher();
+  UpdateDispatcher(const UpdateDispatcher&) = delete;
+  UpdateDispatcher& operator=(const UpdateDispatcher&) = delete;
+
+  sigc::connection connect(const sigc::slot<void()>& slot) { return signal_.connect(slot); }
+  // Thread safe
+  void emit();
+  void operator()() { emit(); }
+
+  // Sync updates to the frame clock of `widget`. Must be reset to nullptr before the widget is
+  // destroyed.
+  void setWidget(Gtk::Widget* widget);
+  // Count emits and time the handlers into `stats`
+  void setStats(ModuleStats* stats) { stats_ = stats; }
+
+ private:
+  friend class DirtySet;
+
+  // Main thread only
+  void schedule();
+  void run();
+  static gboolean onTick(GtkWidget* widget, GdkFrameClock* clock, gpointer data);
+  static gboolean onFrameTimeout(gpointer data);
+  // Drops the tick callback and its timeout, main thread only
+  void cancelTick();
+
+  sigc::signal<void()> signal_;
+  Gtk::Widget* widget_{nullptr};
+  guint tick_id_{0};
+  guint timeout_id_{0};
+  ModuleStats* stats_{nullptr};
+};
+
+}  // namespace waybar::util
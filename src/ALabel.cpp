@@ -35,7 +35,8 @@ ALabel::ALabel(const Json::Value& config, const std::string& name, const std::st
                                       // modulo-by-zero clock code.
                                       : (interval == 0 ? 0L : 1000L * static_cast<long>(interval)))
                                : 1000 * (long)interval))),
-      default_format_(format_) {
+      default_format_(format_),
+      default_compiled_(format) {
   label_.set_name(name);
   if (!id.empty()) {
     label_.get_style_context()->add_class(id);
@@ -167,118 +168,74 @@ ALabel::ALabel(const Json::Value& config, const std::string& name, const std::st
 
 auto ALabel::update() -> void { AModule::update(); }
 
-bool ALabel::setLabelMarkup(const Glib::ustring& markup) {
-  if (last_label_markup_ == markup.raw()) {
+bool ALabel::setLabelMarkup(const Glib::ustring& markup) { return applyLabelMarkup(markup.raw()); }
+
+bool ALabel::setTooltipMarkup(const Glib::ustring& markup) {
+  return applyTooltipMarkup(markup.raw());
+}
+
+bool ALabel::applyLabelMarkup(std::string_view markup) {
+  if (last_label_markup_ == markup) {
+    if (util::ModuleStats::enabled()) {
+      stats_->label_unchanged.fetch_add(1, std::memory_order_relaxed);
+    }
     return false;
   }
 
-  label_.set_markup(markup);
-  last_label_markup_ = markup.raw();
+  if (util::ModuleStats::enabled()) {
+    stats_->label_changes.fetch_add(1, std::memory_order_relaxed);
+  }
+  last_label_markup_.emplace(markup);
+  label_.set_markup(*last_label_markup_);
   return true;
 }
 
-bool ALabel::setTooltipMarkup(const Glib::ustring& markup) {
-  if (last_tooltip_markup_ == markup.raw()) {
+bool ALabel::applyTooltipMarkup(std::string_view markup) {
+  if (last_tooltip_markup_ == markup) {
     return false;
   }
 
-  last_tooltip_markup_ = markup.raw();
+  last_tooltip_markup_.emplace(markup);
   if (active_tooltip_) {
-    active_tooltip_->set_markup(markup);
+    active_tooltip_->set_markup(*last_tooltip_markup_);
   }
   return true;
 }
 
-std::string ALabel::getIcon(uint16_t percentage, const std::string& alt, uint16_t max) {
-  auto format_icons = config_["format-icons"];
-  if (format_icons.isObject()) {
-    if (!alt.empty() && (format_icons[alt].isString() || format_icons[alt].isArray())) {
-      format_icons = format_icons[alt];
-    } else {
-      format_icons = format_icons["default"];
-    }
+const util::CompiledFormat* ALabel::compiledFormat(std::string_view format) const {
+  if (const auto* compiled = module_config_.compiled(format)) {
+    return compiled;
   }
-  if (format_icons.isArray()) {
-    auto size = format_icons.size();
-    if (size != 0U && format_icons[0].isObject()) {
-      std::string last_icon;
-      for (const auto& threshold : format_icons) {
-        if (!threshold.isObject() || !threshold["icon"].isString() || !threshold["max"].isUInt()) {
-          static bool warned = false;
-          if (!warned) {
-            spdlog::warn(
-                "format-icons: skipping invalid threshold object, expected {\"icon\": \"...\", "
-                "\"max\": N}");
-            warned = true;
-          }
-          continue;
-        }
-        last_icon = threshold["icon"].asString();
-        if (percentage <= threshold["max"].asUInt()) {
-          return last_icon;
-        }
-      }
-      if (!last_icon.empty()) {
-        return last_icon;
-      }
-    } else if (size != 0U) {
-      auto divisor = std::max(1U, (max == 0 ? 100U : static_cast<unsigned>(max)) / size);
-      auto idx = std::clamp(percentage / divisor, 0U, size - 1);
-      format_icons = format_icons[idx];
-    }
+  return format == default_compiled_.str() ? &default_compiled_ : nullptr;
+}
+
+std::string_view ALabel::renderMarkup(const std::string& format, fmt::format_args args) {
+  markup_buffer_.clear();
+  if (const auto* compiled = compiledFormat(format)) {
+    compiled->renderTo(markup_buffer_, args);
+  } else {
+    fmt::vformat_to(fmt::appender(markup_buffer_), format, args);
   }
-  if (format_icons.isString()) {
-    return format_icons.asString();
+  return {markup_buffer_.data(), markup_buffer_.size()};
+}
+
+void ALabel::renderLabelAndTooltip(std::string_view state, const std::string& labelFormat,
+                                   const std::string& tooltipDefault, fmt::format_args args) {
+  applyLabelMarkup(renderMarkup(labelFormat, args));
+  if (tooltipEnabled()) {
+    applyTooltipMarkup(renderMarkup(resolveTooltipFormat(tooltipDefault, state), args));
   }
-  return "";
+}
+
+std::string ALabel::getIcon(uint16_t percentage, const std::string& alt, uint16_t max) {
+  const auto* icons = module_config_.icons({alt});
+  return icons != nullptr ? icons->get(percentage, max) : "";
 }
 
 std::string ALabel::getIcon(uint16_t percentage, const std::vector<std::string>& alts,
                             uint16_t max) {
-  auto format_icons = config_["format-icons"];
-  if (format_icons.isObject()) {
-    std::string _alt = "default";
-    for (const auto& alt : alts) {
-      if (!alt.empty() && (format_icons[alt].isString() || format_icons[alt].isArray())) {
-        _alt = alt;
-        break;
-      }
-    }
-    format_icons = format_icons[_alt];
-  }
-  if (format_icons.isArray()) {
-    auto size = format_icons.size();
-    if (size != 0U && format_icons[0].isObject()) {
-      std::string last_icon;
-      for (const auto& threshold : format_icons) {
-        if (!threshold.isObject() || !threshold["icon"].isString() || !threshold["max"].isUInt()) {
-          static bool warned = false;
-          if (!warned) {
-            spdlog::warn(
-                "format-icons: skipping invalid threshold object, expected {\"icon\": \"...\", "
-                "\"max\": N}");
-            warned = true;
-          }
-          continue;
-        }
-        last_icon = threshold["icon"].asString();
-        if (percentage <= threshold["max"].asUInt()) {
-          return last_icon;
-        }
-      }
-      if (!last_icon.empty()) {
-        return last_icon;
-      }
-    } else if (size != 0U) {
-      auto divisor = std::max(1U, (max == 0 ? 100U : static_cast<unsigned>(max)) / size);
-      auto idx = std::clamp(percentage / divisor, 0U, size - 1);
-      format_icons = format_icons[idx];
-    }
-  }
-  if (format_icons.isString()) {
-    return format_icons.asString();
-  }
-  return "";
+  const auto* icons = module_config_.icons(alts);
+  return icons != nullptr ? icons->get(percentage, max) : "";
 }
 
 void ALabel::copyToClipboard(const std::string& literal) {
@@ -306,32 +263,21 @@ void ALabel::handleGtkMenuEvent(GtkMenuItem* /*menuitem*/, gpointer data) {
 }
 
 std::string ALabel::getState(uint8_t value, bool lesser) {
-  if (!config_["states"].isObject()) {
-    return "";
-  }
-  // Get current state
-  std::vector<std::pair<std::string, uint8_t>> states;
-  if (config_["states"].isObject()) {
-    for (auto it = config_["states"].begin(); it != config_["states"].end(); ++it) {
-      if (it->isUInt() && it.key().isString()) {
-        states.emplace_back(it.key().asString(), it->asUInt());
-      }
+  static const std::string none;
+  const auto* state = module_config_.state(value, lesser);
+  const std::string& name = state != nullptr ? state->name : none;
+  // The style context is only touched when the state changes
+  if (name != applied_state_) {
+    auto style = label_.get_style_context();
+    if (!applied_state_.empty()) {
+      style->remove_class(applied_state_);
     }
-  }
-  // Sort states
-  std::ranges::sort(states.begin(), states.end(), [&lesser](auto& a, auto& b) {
-    return lesser ? a.second < b.second : a.second > b.second;
-  });
-  std::string valid_state;
-  for (auto const& state : states) {
-    if ((lesser ? value <= state.second : value >= state.second) && valid_state.empty()) {
-      label_.get_style_context()->add_class(state.first);
-      valid_state = state.first;
-    } else {
-      label_.get_style_context()->remove_class(state.first);
+    if (!name.empty()) {
+      style->add_class(name);
     }
+    applied_state_ = name;
   }
-  return valid_state;
+  return name;
 }
 
 }  // namespace waybar
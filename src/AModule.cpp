@@ -15,6 +15,8 @@ AModule::AModule(const Json::Value& config, const std::string& name, const std::
                  bool enable_click, bool enable_scroll)
     : name_(name),
       config_(config),
+      module_config_(config_),
+      stats_(util::ModuleStats::create(id.empty() ? name : name + "#" + id)),
       isTooltip{config_["tooltip"].isBool() ? config_["tooltip"].asBool() : true},
       isExpand{config_["expand"].isBool() ? config_["expand"].asBool() : false},
       distance_scrolled_y_(0.0),
@@ -38,6 +40,9 @@ AModule::AModule(const Json::Value& config, const std::string& name, const std::
       spdlog::warn("Wrong actions section configuration. See config by index: {}", it.index());
   }
 
+  dp.setWidget(&event_box_);
+  dp.setStats(stats_.get());
+
   event_box_.signal_enter_notify_event().connect(sigc::mem_fun(*this, &AModule::handleMouseEnter));
   event_box_.signal_leave_notify_event().connect(sigc::mem_fun(*this, &AModule::handleMouseLeave));
 
@@ -99,6 +104,8 @@ AModule::AModule(const Json::Value& config, const std::string& name, const std::
 }
 
 AModule::~AModule() {
+  dp.setWidget(nullptr);
+  dp.setStats(nullptr);
   if (cursor_timeout_conn_.connected()) {
     cursor_timeout_conn_.disconnect();
   }
@@ -196,6 +203,8 @@ bool AModule::handleToggle(GdkEventButton* const& e) { return handleUserEvent(e)
 bool AModule::handleRelease(GdkEventButton* const& e) { return handleUserEvent(e); }
 
 bool AModule::handleUserEvent(GdkEventButton* const& e) {
+  // Attribute the commands spawned below to this module
+  util::ModuleStats::Scope stats_scope(stats_.get(), nullptr);
   std::string format{};
   const std::map<std::pair<uint, GdkEventType>, std::string>::const_iterator& rec{
       eventMap_.find(std::pair(e->button, e->type))};
@@ -339,6 +348,7 @@ bool AModule::handleScroll(GdkEventScroll* e) {
   // First call module actions
   this->AModule::doAction(eventName);
   // Second call user scripts
+  util::ModuleStats::Scope stats_scope(stats_.get(), nullptr);
   if (config_[eventName].isString())
     pid_children_.push_back(util::command::forkExec(config_[eventName].asString()));
 
@@ -12,6 +12,7 @@
 #include "util/enum.hpp"
 #include "util/hosts_check.hpp"
 #include "util/kill_signal.hpp"
+#include "util/startup_profile.hpp"
 
 #ifdef HAVE_SWAY
 #include "modules/sway/bar.hpp"
@@ -145,6 +146,7 @@ waybar::Bar::Bar(struct waybar_output* w_output, const Json::Value& w_config)
       center_(Gtk::ORIENTATION_HORIZONTAL, 0),
       right_(Gtk::ORIENTATION_HORIZONTAL, 0),
       box_(Gtk::ORIENTATION_HORIZONTAL, 0) {
+  util::StartupProfile::Span profile_span("bar on " + output->name);
   window.set_title("waybar");
   window.set_name("waybar");
   window.set_decorated(false);
@@ -324,6 +326,17 @@ waybar::Bar::Bar(struct waybar_output* w_output, const Json::Value& w_config)
   setupWidgets();
   window.show_all();
 
+  if (util::StartupProfile::enabled() && visible) {
+    util::StartupProfile::expectFrame();
+    gtk_widget_add_tick_callback(
+        GTK_WIDGET(window.gobj()),
+        [](GtkWidget* /*widget*/, GdkFrameClock* /*clock*/, gpointer data) -> gboolean {
+          util::StartupProfile::frameDone(static_cast<Bar*>(data)->output->name);
+          return G_SOURCE_REMOVE;
+        },
+        this, nullptr);
+  }
+
   /*
    * If gtk-layer-shell's synchronous wait for the initial configure timed out, show_all() can
    * return with a configured but not-yet-presented surface. Kick GTK/layer-shell once control has
@@ -489,6 +502,7 @@ void waybar::Bar::onMap(GdkEventAny* /*unused*/) {
   }
 
   surface = gdk_wayland_window_get_wl_surface(gdk_window);
+  util::StartupProfile::mark("mapped on " + output->name);
   configureGlobalOffset(gdk_window_get_width(gdk_window), gdk_window_get_height(gdk_window));
 
   setPassThrough(passthrough_);
@@ -573,6 +587,7 @@ void waybar::Bar::getModules(const Factory& factory, const std::string& pos,
     for (const auto& name : module_list) {
       try {
         auto ref = name.asString();
+        util::StartupProfile::Span profile_span("module " + ref);
 
         if (config[ref].isMember("hosts") && !waybar::util::valid_host(config[ref])) {
           continue;
@@ -4,15 +4,39 @@
 #include <spdlog/spdlog.h>
 
 #include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <utility>
 
+#include "config_cache.hpp"
 #include "gtkmm/icontheme.h"
 #include "ext-idle-notify-v1-client-protocol.h"
 #include "idle-inhibit-unstable-v1-client-protocol.h"
 #include "util/clara.hpp"
+#include "util/exec_pool.hpp"
 #include "util/format.hpp"
 #include "util/hex_checker.hpp"
+#include "util/module_stats.hpp"
+#include "util/scheduler.hpp"
+#include "util/startup_profile.hpp"
+
+namespace {
+// Options shared by all bars: the top-level config, else the first bar that sets `key` wins.
+// Null if none does.
+Json::Value firstConfigValue(const Json::Value& config, const char* key) {
+  if (config.isObject()) {
+    return config[key];
+  }
+  if (config.isArray()) {
+    for (const auto& conf : config) {
+      if (conf.isMember(key)) {
+        return conf[key];
+      }
+    }
+  }
+  return {};
+}
+}  // namespace
 
 waybar::Client* waybar::Client::inst() {
   static auto* c = new Client();
@@ -129,6 +153,7 @@ void waybar::Client::handleOutputDone(void* data, struct zxdg_output_v1* /*xdg_o
 void waybar::Client::createBarsBatch() {
   pending_outputs_.remove_if([this](auto* output) { return std::none_of(outputs_.begin(), outputs_.end(), [&output](const auto& o) { return &o == output; }); });
   for (auto* output : pending_outputs_) {
+    util::StartupProfile::Span span("bars on " + output->name);
     try {
       auto configs = getOutputConfigs(*output);
       if (!configs.empty()) {
@@ -143,6 +168,7 @@ void waybar::Client::createBarsBatch() {
 
   pending_outputs_.clear();
   bars_scheduled_ = false;
+  util::StartupProfile::batchDone();
 }
 
 void waybar::Client::handleOutputName(void* data, struct zxdg_output_v1* /*xdg_output*/,
@@ -312,6 +338,9 @@ int waybar::Client::main(int argc, char* argv[]) {
   std::string config_opt;
   std::string style_opt;
   std::string log_level;
+  bool stats = false;
+  bool profile_startup = false;
+  bool no_config_cache = false;
   auto cli = clara::detail::Help(show_help) |
              clara::detail::Opt(show_version)["-v"]["--version"]("Show version") |
              clara::detail::Opt(config_opt, "config")["-c"]["--config"]("Config path") |
@@ -319,7 +348,15 @@ int waybar::Client::main(int argc, char* argv[]) {
              clara::detail::Opt(
                  log_level,
                  "trace|debug|info|warning|error|critical|off")["-l"]["--log-level"]("Log level") |
-             clara::detail::Opt(bar_id, "id")["-b"]["--bar"]("Bar id");
+             clara::detail::Opt(bar_id, "id")["-b"]["--bar"]("Bar id") |
+             clara::detail::Opt(stats)["--stats"](
+                 "Collect per-module statistics, dumped by the 'stats' signal action") |
+             clara::detail::Opt(stats_file, "file")["--stats-file"](
+                 "Write the statistics to this file instead of the log") |
+             clara::detail::Opt(profile_startup)["--profile-startup"](
+                 "Print a timeline of the startup phases once the bars are shown") |
+             clara::detail::Opt(no_config_cache)["--no-config-cache"](
+                 "Always parse the configuration instead of reusing the cached one");
   auto res = cli.parse(clara::detail::Args(argc, argv));
   if (!res) {
     spdlog::error("Error in command line: {}", res.errorMessage());
@@ -336,23 +373,39 @@ int waybar::Client::main(int argc, char* argv[]) {
   if (!log_level.empty()) {
     spdlog::set_level(spdlog::level::from_str(log_level));
   }
-  gtk_app = Gtk::Application::create(argc, argv, "fr.arouillard.waybar",
-                                     Gio::APPLICATION_HANDLES_COMMAND_LINE);
-
-  // Initialize Waybars GTK resources with our custom icons
-  auto theme = Gtk::IconTheme::get_default();
-  theme->add_resource_path("/fr/arouillard/waybar/icons");
-
-  gdk_display = Gdk::Display::get_default();
-  if (!gdk_display) {
-    throw std::runtime_error("Can't find display");
+  util::ModuleStats::setEnabled(stats || !stats_file.empty());
+  if (profile_startup) {
+    util::StartupProfile::enable();
+  }
+  {
+    util::StartupProfile::Span span("gtk and display");
+    gtk_app = Gtk::Application::create(argc, argv, "fr.arouillard.waybar",
+                                       Gio::APPLICATION_HANDLES_COMMAND_LINE);
+
+    // Initialize Waybars GTK resources with our custom icons
+    auto theme = Gtk::IconTheme::get_default();
+    theme->add_resource_path("/fr/arouillard/waybar/icons");
+
+    gdk_display = Gdk::Display::get_default();
+    if (!gdk_display) {
+      throw std::runtime_error("Can't find display");
+    }
+    if (!GDK_IS_WAYLAND_DISPLAY(gdk_display->gobj())) {
+      throw std::runtime_error("Bar need to run under Wayland");
+    }
+    wl_display = gdk_wayland_display_get_wl_display(gdk_display->gobj());
   }
-  if (!GDK_IS_WAYLAND_DISPLAY(gdk_display->gobj())) {
-    throw std::runtime_error("Bar need to run under Wayland");
+  {
+    util::StartupProfile::Span span("config");
+    if (!no_config_cache) {
+      if (auto dir = ConfigCache::defaultDir()) {
+        config.enableCache(*dir);
+      }
+    }
+    config.load(config_opt);
   }
-  wl_display = gdk_wayland_display_get_wl_display(gdk_display->gobj());
-  config.load(config_opt);
   if (!portal) {
+    util::StartupProfile::Span span("desktop portal");
     try {
       portal = std::make_unique<waybar::Portal>();
     } catch (const Glib::Error& e) {
@@ -363,8 +416,11 @@ int waybar::Client::main(int argc, char* argv[]) {
       spdlog::warn("Failed to connect to the desktop portal, light/dark theme detection disabled");
     }
   }
-  m_cssFile = getStyle(style_opt);
-  setupCss(m_cssFile);
+  {
+    util::StartupProfile::Span span("style");
+    m_cssFile = getStyle(style_opt);
+    setupCss(m_cssFile);
+  }
   m_cssReloadHelper = std::make_unique<CssReloadHelper>(m_cssFile, [&](const std::string& css_file) { setupCss(css_file); });
   if (portal) {
     portal->signal_appearance_changed().connect([&](waybar::Appearance appearance) {
@@ -386,11 +442,33 @@ int waybar::Client::main(int argc, char* argv[]) {
     }
   }
 
-  bindInterfaces();
+  std::chrono::milliseconds timer_slack{0};
+  if (const auto value = firstConfigValue(m_config, "timer-slack"); value.isUInt()) {
+    timer_slack = std::chrono::milliseconds(value.asUInt());
+  }
+  util::Scheduler::inst()->setTimerSlack(timer_slack);
+
+  auto exec_concurrency = util::ExecPool::DEFAULT_MAX_CHILDREN;
+  if (const auto value = firstConfigValue(m_config, "exec-concurrency"); value.isUInt()) {
+    exec_concurrency = value.asUInt();
+  }
+  util::ExecPool::inst()->setMaxChildren(exec_concurrency);
+
+  {
+    util::StartupProfile::Span span("wayland globals and outputs");
+    bindInterfaces();
+  }
   gtk_app->hold();
   gtk_app->run();
+  // No bar was ever presented
+  util::StartupProfile::report();
   m_cssReloadHelper.reset();  // stop watching css file
+  const auto teardown_start = std::chrono::steady_clock::now();
   bars.clear();
+  spdlog::debug("Bars torn down in {}ms",
+                std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - teardown_start)
+                    .count());
   return 0;
 }
 
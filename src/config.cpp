@@ -12,6 +12,7 @@
 #include <fstream>
 #include <stdexcept>
 
+#include "config_cache.hpp"
 #include "util/json.hpp"
 
 namespace fs = std::filesystem;
@@ -36,6 +37,7 @@ std::vector<std::string> Config::tryExpandPath(const std::string& base,
   }
 
   spdlog::debug("Try expanding: {}", path.string());
+  ConfigCache::recordPattern(path.string());
 
   std::vector<std::string> results;
 #ifndef __OpenBSD__
@@ -67,6 +69,7 @@ std::vector<std::string> Config::tryExpandPath(const std::string& base,
 
 std::optional<std::string> Config::findConfigPath(const std::vector<std::string>& names,
                                                   const std::vector<std::string>& dirs) {
+  ConfigCache::recordEnv(Config::CONFIG_PATH_ENV);
   if (const char* dir = std::getenv(Config::CONFIG_PATH_ENV)) {
     for (const auto& name : names) {
       if (auto res = tryExpandPath(dir, name); !res.empty()) {
@@ -89,6 +92,7 @@ void Config::setupConfig(Json::Value& dst, const std::string& config_file, int d
   if (depth > 100) {
     throw std::runtime_error("Aborting due to likely recursive include in config files");
   }
+  ConfigCache::recordFile(config_file);
   std::ifstream file(config_file);
   if (!file.is_open()) {
     throw std::runtime_error("Can't open config file");
@@ -112,6 +116,7 @@ std::vector<std::string> Config::findIncludePath(const std::string& name,
   if (!match1.empty()) {
     return match1;
   }
+  ConfigCache::recordEnv(Config::CONFIG_PATH_ENV);
   if (const char* dir = std::getenv(Config::CONFIG_PATH_ENV)) {
     if (auto res = tryExpandPath(dir, name); !res.empty()) {
       return res;
@@ -287,6 +292,21 @@ bool isValidOutput(const Json::Value& config, const std::string& name,
 }
 
 void Config::load(const std::string& config) {
+  std::optional<ConfigCache> cache;
+  if (!cache_dir_.empty()) {
+    cache.emplace(cache_dir_, config);
+    if (auto snapshot = cache->load()) {
+      config_file_ = std::move(snapshot->file);
+      config_ = std::move(snapshot->config);
+      spdlog::info("Using configuration file {} (cached)", config_file_);
+      return;
+    }
+  }
+
+  std::optional<ConfigCache::Recording> recording;
+  if (cache) {
+    recording.emplace(*cache);
+  }
   auto file = config.empty() ? findConfigPath({"config", "config.jsonc"}) : config;
   if (!file) {
     throw std::runtime_error("Missing required resource files");
@@ -295,6 +315,9 @@ void Config::load(const std::string& config) {
   spdlog::info("Using configuration file {}", config_file_);
   config_ = Json::Value();
   setupConfig(config_, config_file_, 0);
+  if (cache) {
+    cache->store(config_file_, config_);
+  }
 }
 
 std::vector<Json::Value> Config::getOutputConfigs(const std::string& name,
@@ -0,0 +1,502 @@
+#include "config_cache.hpp"
+
+#include <spdlog/spdlog.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifndef __OpenBSD__
+#include <wordexp.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <system_error>
+
+namespace fs = std::filesystem;
+
+namespace waybar {
+
+namespace {
+
+// Bumped whenever the layout changes
+constexpr uint32_t FORMAT_VERSION = 1;
+constexpr std::string_view MAGIC = "WBCFG";
+constexpr int MAX_DEPTH = 512;
+constexpr int64_t RACY_NS = 2000000000;
+
+thread_local ConfigCache* recording_cache = nullptr;
+
+enum Tag : uint8_t {
+  TAG_NULL,
+  TAG_INT,
+  TAG_UINT,
+  TAG_REAL,
+  TAG_STRING,
+  TAG_FALSE,
+  TAG_TRUE,
+  TAG_ARRAY,
+  TAG_OBJECT,
+};
+
+class Writer {
+ public:
+  void byte(uint8_t value) { out_.push_back(static_cast<char>(value)); }
+
+  void varint(uint64_t value) {
+    while (value >= 0x80) {
+      byte(static_cast<uint8_t>(value) | 0x80);
+      value >>= 7;
+    }
+    byte(static_cast<uint8_t>(value));
+  }
+
+  // Zigzag encoded, small negative numbers stay short
+  void svarint(int64_t value) {
+    varint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+  }
+
+  void real(double value) {
+    char raw[sizeof(value)];
+    std::memcpy(raw, &value, sizeof(value));
+    out_.append(raw, sizeof(raw));
+  }
+
+  void string(std::string_view value) {
+    varint(value.size());
+    out_.append(value);
+  }
+
+  std::string& str() { return out_; }
+
+ private:
+  std::string out_;
+};
+
+// Every read fails once the input is exhausted or malformed
+class Reader {
+ public:
+  explicit Reader(std::string_view in) : in_(in) {}
+
+  bool ok() const { return ok_; }
+  bool atEnd() const { return pos_ == in_.size(); }
+
+  uint8_t byte() {
+    if (!ok_ || pos_ >= in_.size()) {
+      ok_ = false;
+      return 0;
+    }
+    return static_cast<uint8_t>(in_[pos_++]);
+  }
+
+  uint64_t varint() {
+    uint64_t value = 0;
+    for (int shift = 0; ok_ && shift < 64; shift += 7) {
+      const auto b = byte();
+      value |= static_cast<uint64_t>(b & 0x7f) << shift;
+      if ((b & 0x80) == 0) {
+        return value;
+      }
+    }
+    ok_ = false;
+    return 0;
+  }
+
+  int64_t svarint() {
+    const auto value = varint();
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+  }
+
+  double real() {
+    double value = 0;
+    if (!ok_ || in_.size() - pos_ < sizeof(value)) {
+      ok_ = false;
+      return 0;
+    }
+    std::memcpy(&value, in_.data() + pos_, sizeof(value));
+    pos_ += sizeof(value);
+    return value;
+  }
+
+  std::string_view string() {
+    const auto size = varint();
+    if (!ok_ || in_.size() - pos_ < size) {
+      ok_ = false;
+      return {};
+    }
+    auto value = in_.substr(pos_, size);
+    pos_ += size;
+    return value;
+  }
+
+ private:
+  std::string_view in_;
+  std::size_t pos_{0};
+  bool ok_{true};
+};
+
+void encodeValue(Writer& out, const Json::Value& value) {
+  switch (value.type()) {
+    case Json::nullValue:
+      out.byte(TAG_NULL);
+      break;
+    case Json::intValue:
+      out.byte(TAG_INT);
+      out.svarint(value.asInt64());
+      break;
+    case Json::uintValue:
+      out.byte(TAG_UINT);
+      out.varint(value.asUInt64());
+      break;
+    case Json::realValue:
+      out.byte(TAG_REAL);
+      out.real(value.asDouble());
+      break;
+    case Json::stringValue: {
+      out.byte(TAG_STRING);
+      const char* begin = nullptr;
+      const char* end = nullptr;
+      value.getString(&begin, &end);
+      out.string(std::string_view(begin, end - begin));
+      break;
+    }
+    case Json::booleanValue:
+      out.byte(value.asBool() ? TAG_TRUE : TAG_FALSE);
+      break;
+    case Json::arrayValue:
+      out.byte(TAG_ARRAY);
+      out.varint(value.size());
+      for (const auto& item : value) {
+        encodeValue(out, item);
+      }
+      break;
+    case Json::objectValue:
+      out.byte(TAG_OBJECT);
+      out.varint(value.size());
+      for (auto it = value.begin(); it != value.end(); ++it) {
+        out.string(it.name());
+        encodeValue(out, *it);
+      }
+      break;
+  }
+}
+
+bool decodeValue(Reader& in, Json::Value& value, int depth) {
+  if (depth > MAX_DEPTH) {
+    return false;
+  }
+  switch (in.byte()) {
+    case TAG_NULL:
+      value = Json::Value();
+      break;
+    case TAG_INT:
+      value = Json::Value(static_cast<Json::Int64>(in.svarint()));
+      break;
+    case TAG_UINT:
+      value = Json::Value(static_cast<Json::UInt64>(in.varint()));
+      break;
+    case TAG_REAL:
+      value = Json::Value(in.real());
+      break;
+    case TAG_STRING: {
+      const auto str = in.string();
+      value = Json::Value(str.data(), str.data() + str.size());
+      break;
+    }
+    case TAG_FALSE:
+      value = Json::Value(false);
+      break;
+    case TAG_TRUE:
+      value = Json::Value(true);
+      break;
+    case TAG_ARRAY: {
+      value = Json::Value(Json::arrayValue);
+      const auto size = in.varint();
+      for (uint64_t i = 0; in.ok() && i < size; ++i) {
+        if (!decodeValue(in, value.append(Json::Value()), depth + 1)) {
+          return false;
+        }
+      }
+      break;
+    }
+    case TAG_OBJECT: {
+      value = Json::Value(Json::objectValue);
+      const auto size = in.varint();
+      for (uint64_t i = 0; in.ok() && i < size; ++i) {
+        const auto name = in.string();
+        if (!decodeValue(in, value[std::string(name)], depth + 1)) {
+          return false;
+        }
+      }
+      break;
+    }
+    default:
+      return false;
+  }
+  return in.ok();
+}
+
+// FNV-1a, stable across builds unlike std::hash
+uint64_t hashKey(std::string_view key) {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (const char c : key) {
+    hash = (hash ^ static_cast<uint8_t>(c)) * 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+// Expands variables and ~ in a single path without globbing
+std::optional<std::string> expandWord(const std::string& word) {
+#ifndef __OpenBSD__
+  wordexp_t p;
+  if (wordexp(word.c_str(), &p, WRDE_NOCMD) != 0) {
+    return std::nullopt;
+  }
+  std::optional<std::string> result;
+  if (p.we_wordc == 1) {
+    result = p.we_wordv[0];
+  }
+  wordfree(&p);
+  return result;
+#else
+  // Paths are only globbed on OpenBSD, see Config::tryExpandPath
+  return word;
+#endif
+}
+
+}  // namespace
+
+std::optional<std::string> ConfigCache::defaultDir() {
+  if (const char* cache_home = std::getenv("XDG_CACHE_HOME"); cache_home && *cache_home) {
+    return (fs::path(cache_home) / "waybar").string();
+  }
+  if (const char* home = std::getenv("HOME"); home && *home) {
+    return (fs::path(home) / ".cache" / "waybar").string();
+  }
+  return std::nullopt;
+}
+
+ConfigCache::ConfigCache(const std::string& dir, const std::string& config) {
+  // Relative paths in the config and the search directories depend on the working directory
+  std::error_code ec;
+  key_ = config + '\n' + fs::current_path(ec).string();
+  path_ = (fs::path(dir) / fmt::format("config-{:016x}.bin", hashKey(key_))).string();
+}
+
+ConfigCache::Recording::Recording(ConfigCache& cache) : previous_(recording_cache) {
+  cache.dependencies_.clear();
+  cache.cacheable_ = true;
+  recording_cache = &cache;
+}
+
+ConfigCache::Recording::~Recording() { recording_cache = previous_; }
+
+ConfigCache::Dependency ConfigCache::current(Kind kind, const std::string& name) {
+  Dependency dependency{.kind = kind, .name = name};
+  if (kind == Kind::ENV) {
+    if (const char* value = std::getenv(name.c_str())) {
+      dependency.exists = true;
+      dependency.value = value;
+    }
+    return dependency;
+  }
+  struct stat st {};
+  if (::stat(name.c_str(), &st) == 0) {
+    dependency.exists = true;
+    dependency.dev = st.st_dev;
+    dependency.ino = st.st_ino;
+    dependency.size = st.st_size;
+    dependency.mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    dependency.ctime_ns = static_cast<int64_t>(st.st_ctim.tv_sec) * 1000000000 + st.st_ctim.tv_nsec;
+  }
+  return dependency;
+}
+
+void ConfigCache::add(Kind kind, const std::string& name) {
+  const auto known = std::ranges::any_of(dependencies_, [&](const Dependency& dependency) {
+    return dependency.kind == kind && dependency.name == name;
+  });
+  if (!known) {
+    dependencies_.push_back(current(kind, name));
+  }
+}
+
+void ConfigCache::recordFile(const std::string& path) {
+  if (recording_cache != nullptr) {
+    recording_cache->add(Kind::PATH, path);
+  }
+}
+
+void ConfigCache::recordEnv(const std::string& name) {
+  if (recording_cache != nullptr) {
+    recording_cache->add(Kind::ENV, name);
+  }
+}
+
+void ConfigCache::recordPattern(const std::string& pattern) {
+  auto* cache = recording_cache;
+  if (cache == nullptr || !cache->cacheable_) {
+    return;
+  }
+  if (pattern.find('`') != std::string::npos || pattern.find("$(") != std::string::npos) {
+    spdlog::debug("Config path {} runs a command, the config won't be cached", pattern);
+    cache->cacheable_ = false;
+    return;
+  }
+
+  // Variables the expansion depends on
+  if (pattern.starts_with('~')) {
+    cache->add(Kind::ENV, "HOME");
+  }
+  for (auto pos = pattern.find('$'); pos != std::string::npos; pos = pattern.find('$', pos)) {
+    ++pos;
+    const bool braced = pos < pattern.size() && pattern[pos] == '{';
+    const auto start = braced ? pos + 1 : pos;
+    auto end = start;
+    while (end < pattern.size() && (std::isalnum(static_cast<unsigned char>(pattern[end])) ||
+                                    pattern[end] == '_')) {
+      ++end;
+    }
+    if (end > start) {
+      cache->add(Kind::ENV, pattern.substr(start, end - start));
+    }
+  }
+
+  // A file showing up in, or leaving, the searched directory changes its mtime
+  const fs::path path(pattern);
+  std::optional<std::string> dir;
+  if (path.filename().string().find_first_of("*?[") == std::string::npos) {
+    // Variables may expand to several components, expand before taking the parent
+    if (auto expanded = expandWord(pattern)) {
+      dir = fs::path(*expanded).parent_path().string();
+    }
+  } else if (path.filename().string().find_first_of("$~") == std::string::npos &&
+             path.parent_path().string().find_first_of("*?[") == std::string::npos) {
+    dir = expandWord(path.parent_path().string());
+  }
+  if (!dir) {
+    spdlog::debug("Config path {} can't be validated by stat, the config won't be cached",
+                  pattern);
+    cache->cacheable_ = false;
+    return;
+  }
+  cache->add(Kind::PATH, dir->empty() ? "." : *dir);
+}
+
+std::optional<ConfigCache::Snapshot> ConfigCache::load() const {
+  std::ifstream file(path_, std::ios::binary);
+  if (!file.is_open()) {
+    return std::nullopt;
+  }
+  const std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  Reader in(data);
+
+  if (in.string() != MAGIC || in.varint() != FORMAT_VERSION || in.string() != VERSION ||
+      in.string() != key_) {
+    return std::nullopt;
+  }
+  const auto count = in.varint();
+  for (uint64_t i = 0; in.ok() && i < count; ++i) {
+    Dependency stored{.kind = static_cast<Kind>(in.byte()), .name = std::string(in.string())};
+    stored.exists = in.byte() != 0;
+    if (stored.kind == Kind::ENV) {
+      stored.value = in.string();
+    } else {
+      stored.dev = in.varint();
+      stored.ino = in.varint();
+      stored.size = in.varint();
+      stored.mtime_ns = in.svarint();
+      stored.ctime_ns = in.svarint();
+    }
+    if (!in.ok()) {
+      break;
+    }
+    if (current(stored.kind, stored.name) != stored) {
+      spdlog::debug("Config cache: {} changed", stored.name);
+      return std::nullopt;
+    }
+  }
+
+  Snapshot snapshot;
+  snapshot.file = in.string();
+  if (!decodeValue(in, snapshot.config, 0) || !in.atEnd()) {
+    spdlog::warn("Ignoring corrupted config cache {}", path_);
+    return std::nullopt;
+  }
+  return snapshot;
+}
+
+void ConfigCache::store(const std::string& file, const Json::Value& config) const {
+  // A change within the timestamp granularity of the filesystem would go unnoticed, skip the
+  // snapshot until every dependency settled, as git does for racily clean entries
+  const auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::system_clock::now().time_since_epoch())
+                       .count();
+  const auto racy = std::ranges::any_of(dependencies_, [now](const Dependency& dependency) {
+    return dependency.kind == Kind::PATH && dependency.exists &&
+           now - dependency.mtime_ns < RACY_NS;
+  });
+  if (!cacheable_ || racy) {
+    std::error_code ec;
+    fs::remove(path_, ec);
+    return;
+  }
+
+  Writer out;
+  out.string(MAGIC);
+  out.varint(FORMAT_VERSION);
+  out.string(VERSION);
+  out.string(key_);
+  out.varint(dependencies_.size());
+  for (const auto& dependency : dependencies_) {
+    out.byte(static_cast<uint8_t>(dependency.kind));
+    out.string(dependency.name);
+    out.byte(dependency.exists ? 1 : 0);
+    if (dependency.kind == Kind::ENV) {
+      out.string(dependency.value);
+    } else {
+      out.varint(dependency.dev);
+      out.varint(dependency.ino);
+      out.varint(dependency.size);
+      out.svarint(dependency.mtime_ns);
+      out.svarint(dependency.ctime_ns);
+    }
+  }
+  out.string(file);
+  encodeValue(out, config);
+
+  // Written aside and renamed, so a concurrent load never sees a partial snapshot
+  std::error_code ec;
+  fs::create_directories(fs::path(path_).parent_path(), ec);
+  const auto tmp = fmt::format("{}.{}", path_, getpid());
+  {
+    std::ofstream tmp_file(tmp, std::ios::binary | std::ios::trunc);
+    if (!(tmp_file << out.str())) {
+      spdlog::debug("Can't write config cache {}", tmp);
+      fs::remove(tmp, ec);
+      return;
+    }
+  }
+  fs::rename(tmp, path_, ec);
+  if (ec) {
+    spdlog::debug("Can't write config cache {}: {}", path_, ec.message());
+    fs::remove(tmp, ec);
+  }
+}
+
+std::string ConfigCache::encode(const Json::Value& value) {
+  Writer out;
+  encodeValue(out, value);
+  return std::move(out.str());
+}
+
+bool ConfigCache::decode(std::string_view data, Json::Value& value) {
+  Reader in(data);
+  return decodeValue(in, value, 0) && in.atEnd();
+}
+
+}  // namespace waybar
@@ -21,6 +21,7 @@
 #include "bar.hpp"
 #include "client.hpp"
 #include "util/SafeSignal.hpp"
+#include "util/module_stats.hpp"
 
 std::mutex reap_mtx;
 std::list<pid_t> reap;
@@ -120,6 +121,9 @@ void handleUserSignal(int signal, bool& reload) {
         reload = true;
         waybar::Client::inst()->reset();
         return;
+      case waybar::util::KillSignalAction::STATS:
+        waybar::util::ModuleStats::dumpTo(waybar::Client::inst()->stats_file);
+        return;
       case waybar::util::KillSignalAction::NOOP:
         break;
     }
@@ -11,17 +11,21 @@
 #include <sys/sysctl.h>
 #endif
 #include <libudev.h>
-#include <poll.h>
 #include <spdlog/spdlog.h>
-#include <sys/signalfd.h>
+
+#include <cstring>
+#include <type_traits>
+
+// With udev reporting every change, the timer is only a fallback for silent drivers
+#if defined(__linux__)
+static constexpr uint16_t DEFAULT_INTERVAL = 300;
+#else
+static constexpr uint16_t DEFAULT_INTERVAL = 60;
+#endif
 
 waybar::modules::Battery::Battery(const std::string& id, const Bar& bar, const Json::Value& config)
-    : ALabel(config, "battery", id, "{capacity}%", 60), last_event_(""), bar_(bar) {
+    : ALabel(config, "battery", id, "{capacity}%", DEFAULT_INTERVAL), last_event_(""), bar_(bar) {
 #if defined(__linux__)
-  battery_watch_fd_ = inotify_init1(IN_CLOEXEC);
-  if (battery_watch_fd_ == -1) {
-    throw std::runtime_error("Unable to listen batteries.");
-  }
   udev_ = std::unique_ptr<udev, util::UdevDeleter>(udev_new());
   if (udev_ == nullptr) {
     throw std::runtime_error("udev_new failed");
@@ -44,65 +48,64 @@ waybar::modules::Battery::Battery(const std::string& id, const Bar& bar, const J
   if (config_["weighted-average"].isBool()) weightedAverage_ = config_["weighted-average"].asBool();
 #endif
   spdlog::debug("battery: worker interval is {}", interval_.count());
+  refreshBatteries();
   worker();
 }
 
 waybar::modules::Battery::~Battery() {
-#if defined(__linux__)
-  std::lock_guard<std::mutex> guard(battery_list_mutex_);
+  udev_watch_.disconnect();
+  timer_.stop();
+}
 
-  for (auto it = batteries_.cbegin(), next_it = it; it != batteries_.cend(); it = next_it) {
-    ++next_it;
-    auto watch_id = (*it).second;
-    if (watch_id >= 0) {
-      inotify_rm_watch(battery_watch_fd_, watch_id);
-    }
-    batteries_.erase(it);
-  }
-  close(battery_watch_fd_);
+void waybar::modules::Battery::worker() {
+  timer_.start([this] { dp.emit(); }, interval_);
+#if defined(__linux__)
+  udev_watch_ = Glib::signal_io().connect(sigc::mem_fun(*this, &Battery::handleUdevEvents),
+                                          udev_monitor_get_fd(mon_.get()),
+                                          Glib::IO_IN | Glib::IO_ERR | Glib::IO_HUP);
 #endif
 }
 
-void waybar::modules::Battery::worker() {
-#if defined(__FreeBSD__)
-  thread_timer_ = [this] {
-    dp.emit();
-    thread_timer_.sleep_for(interval_);
-  };
-#else
-  thread_timer_ = [this] {
-    // Make sure we eventually update the list of batteries even if we miss an
-    // inotify event for some reason
-    refreshBatteries();
-    dp.emit();
-    thread_timer_.sleep_for(interval_);
-  };
-  thread_ = [this] {
-    struct inotify_event event = {0};
-    int nbytes = read(battery_watch_fd_, &event, sizeof(event));
-    if (nbytes != sizeof(event) || event.mask & IN_IGNORED) {
-      thread_.stop();
-      return;
+bool waybar::modules::Battery::handleUdevEvents([[maybe_unused]] Glib::IOCondition condition) {
+#if defined(__linux__)
+  if ((condition & (Glib::IO_ERR | Glib::IO_HUP)) != 0) {
+    spdlog::warn("battery: udev monitor failed, falling back to polling");
+    return false;
+  }
+  // Every property change of a power supply comes as a "change" uevent, only an "add" or a
+  // "remove" needs the directory rescanned. The monitor doesn't block, drain what's pending so
+  // that a burst makes a single update.
+  bool rescan = false;
+  bool changed = false;
+  while (true) {
+    std::unique_ptr<udev_device, util::UdevDeviceDeleter> dev(
+        udev_monitor_receive_device(mon_.get()));
+    if (dev == nullptr) {
+      break;
     }
-    dp.emit();
-  };
-  thread_battery_update_ = [this] {
-    poll_fds_[0].revents = 0;
-    poll_fds_[0].events = POLLIN;
-    poll_fds_[0].fd = udev_monitor_get_fd(mon_.get());
-    int ret = poll(poll_fds_.data(), poll_fds_.size(), -1);
-    if (ret < 0) {
-      thread_.stop();
-      return;
+    const char* action = udev_device_get_action(dev.get());
+    if (action != nullptr && (strcmp(action, "add") == 0 || strcmp(action, "remove") == 0)) {
+      rescan = true;
+      continue;
     }
-    if ((poll_fds_[0].revents & POLLIN) != 0) {
-      signalfd_siginfo signal_info;
-      read(poll_fds_[0].fd, &signal_info, sizeof(signal_info));
+    // Other power supplies, like the battery of a mouse, change without concern
+    const char* name = udev_device_get_sysname(dev.get());
+    if (name == nullptr) {
+      continue;
     }
+    std::lock_guard<std::mutex> guard(battery_list_mutex_);
+    changed = changed || (adapter_ && adapter_->dir().filename() == name) ||
+              std::ranges::any_of(batteries_,
+                                  [name](const auto& bat) { return bat.first.filename() == name; });
+  }
+  if (rescan) {
     refreshBatteries();
+  }
+  if (rescan || changed) {
     dp.emit();
-  };
+  }
 #endif
+  return true;
 }
 
 void waybar::modules::Battery::refreshBatteries() {
@@ -114,6 +117,7 @@ void waybar::modules::Battery::refreshBatteries() {
     check_map[bat.first] = false;
   }
 
+  fs::path adapter_dir;
   try {
     for (auto& node : fs::directory_iterator(data_dir_)) {
       if (!fs::is_directory(node)) {
@@ -140,29 +144,22 @@ void waybar::modules::Battery::refreshBatteries() {
           }
 
           check_map[node.path()] = true;
-          auto search = batteries_.find(node.path());
-          if (search == batteries_.end()) {
-            // We've found a new battery save it and start listening for events
-            auto event_path = (node.path() / "uevent");
-            auto wd = inotify_add_watch(battery_watch_fd_, event_path.c_str(), IN_ACCESS);
-            if (wd < 0) {
-              spdlog::warn("Could not watch events for {} (device may have been removed)",
-                           node.path().string());
-              continue;
-            }
-            batteries_[node.path()] = wd;
-          }
+          // A new battery keeps its uevent open from now on
+          batteries_.try_emplace(node.path(), node.path());
         }
       }
       auto adap_defined = config_["adapter"].isString();
       if (((adap_defined && dir_name == config_["adapter"].asString()) || !adap_defined) &&
           (fs::exists(node.path() / "online") || fs::exists(node.path() / "status"))) {
-        adapter_ = node.path();
+        adapter_dir = node.path();
       }
     }
   } catch (fs::filesystem_error& e) {
     spdlog::warn("Battery directory tracking failed: {}", e.what());
   }
+  if (!adapter_dir.empty() && (!adapter_ || adapter_->dir() != adapter_dir)) {
+    adapter_.emplace(adapter_dir);
+  }
   if (warnFirstTime_ && batteries_.empty()) {
     if (config_["bat"].isString()) {
       spdlog::warn("No battery named {0}", config_["bat"].asString());
@@ -173,13 +170,9 @@ void waybar::modules::Battery::refreshBatteries() {
     warnFirstTime_ = false;
   }
 
-  // Remove any batteries that are no longer present and unwatch them
+  // Remove any batteries that are no longer present
   for (auto const& check : check_map) {
     if (!check.second) {
-      auto watch_id = batteries_[check.first];
-      if (watch_id >= 0) {
-        inotify_rm_watch(battery_watch_fd_, watch_id);
-      }
       batteries_.erase(check.first);
     }
   }
@@ -278,15 +271,20 @@ waybar::modules::Battery::getInfos() {
     float mainBatHealthPercent = 0.0F;
 
     std::string status = "Unknown";
-    for (auto const& item : batteries_) {
-      auto bat = item.first;
-      std::string _status;
-
-      {
-        std::ifstream f{bat / "status"};
-        if (!std::getline(f, _status)) {
-          std::getline(std::ifstream(adapter_ / "status"), _status);
-        }
+    // Copies a reading into one of the values below, whether it was reported
+    const auto take = [](const std::optional<int64_t>& reading, auto& value) {
+      if (!reading) {
+        return false;
+      }
+      value = static_cast<std::remove_reference_t<decltype(value)>>(*reading);
+      return true;
+    };
+
+    for (auto& item : batteries_) {
+      const auto& readings = item.second.read();
+      std::string _status = readings.status;
+      if (_status.empty() && adapter_) {
+        _status = adapter_->read().status;
       }
 
       // Some battery will report current and charge in μA/μAh.
@@ -294,108 +292,51 @@ waybar::modules::Battery::getInfos() {
 
       uint32_t current_now = 0;
       int32_t _current_now_int = 0;
-      bool current_now_exists = false;
-      if (std::ifstream current_now_f{bat / "current_now"}) {
-        if (current_now_f >> _current_now_int) {
-          current_now_exists = true;
-        }
-      } else if (std::ifstream current_avg_f{bat / "current_avg"}) {
-        if (current_avg_f >> _current_now_int) {
-          current_now_exists = true;
-        }
-      }
+      bool current_now_exists = take(readings.current_now ? readings.current_now
+                                                          : readings.current_avg,
+                                     _current_now_int);
       // Documentation ABI allows a negative value when discharging, positive
       // value when charging.
       current_now = std::abs(_current_now_int);
 
-      if (std::ifstream f{bat / "time_to_empty_now"}) {
-        if (f >> time_to_empty_now) {
-          time_to_empty_now_exists = true;
-        }
+      if (take(readings.time_to_empty_now, time_to_empty_now)) {
+        time_to_empty_now_exists = true;
       }
-
-      if (std::ifstream f{bat / "time_to_full_now"}) {
-        if (f >> time_to_full_now) {
-          time_to_full_now_exists = true;
-        }
+      if (take(readings.time_to_full_now, time_to_full_now)) {
+        time_to_full_now_exists = true;
       }
 
       uint32_t voltage_now = 0;
-      bool voltage_now_exists = false;
-      if (std::ifstream voltage_now_f{bat / "voltage_now"}) {
-        if (voltage_now_f >> voltage_now) {
-          voltage_now_exists = true;
-        }
-      } else if (std::ifstream voltage_avg_f{bat / "voltage_avg"}) {
-        if (voltage_avg_f >> voltage_now) {
-          voltage_now_exists = true;
-        }
-      }
+      bool voltage_now_exists = take(
+          readings.voltage_now ? readings.voltage_now : readings.voltage_avg, voltage_now);
 
       uint32_t charge_full = 0;
-      bool charge_full_exists = false;
-      if (std::ifstream f{bat / "charge_full"}) {
-        if (f >> charge_full) {
-          charge_full_exists = true;
-        }
-      }
+      bool charge_full_exists = take(readings.charge_full, charge_full);
 
       uint32_t charge_full_design = 0;
-      bool charge_full_design_exists = false;
-      if (std::ifstream f{bat / "charge_full_design"}) {
-        if (f >> charge_full_design) {
-          charge_full_design_exists = true;
-        }
-      }
+      bool charge_full_design_exists = take(readings.charge_full_design, charge_full_design);
 
       uint32_t charge_now = 0;
-      bool charge_now_exists = false;
-      if (std::ifstream f{bat / "charge_now"}) {
-        if (f >> charge_now) {
-          charge_now_exists = true;
-        }
-      }
+      bool charge_now_exists = take(readings.charge_now, charge_now);
 
       uint32_t power_now = 0;
       int32_t _power_now_int = 0;
-      bool power_now_exists = false;
-      if (std::ifstream f{bat / "power_now"}) {
-        if (f >> _power_now_int) {
-          power_now_exists = true;
-        }
-      }
+      bool power_now_exists = take(readings.power_now, _power_now_int);
       // Some drivers (example: Qualcomm) exposes use a negative value when
       // discharging, positive value when charging.
       power_now = std::abs(_power_now_int);
 
       uint32_t energy_now = 0;
-      bool energy_now_exists = false;
-      if (std::ifstream f{bat / "energy_now"}) {
-        if (f >> energy_now) {
-          energy_now_exists = true;
-        }
-      }
+      bool energy_now_exists = take(readings.energy_now, energy_now);
 
       uint32_t energy_full = 0;
-      bool energy_full_exists = false;
-      if (std::ifstream f{bat / "energy_full"}) {
-        if (f >> energy_full) {
-          energy_full_exists = true;
-        }
-      }
+      bool energy_full_exists = take(readings.energy_full, energy_full);
 
       uint32_t energy_full_design = 0;
-      bool energy_full_design_exists = false;
-      if (std::ifstream f{bat / "energy_full_design"}) {
-        if (f >> energy_full_design) {
-          energy_full_design_exists = true;
-        }
-      }
+      bool energy_full_design_exists = take(readings.energy_full_design, energy_full_design);
 
       uint16_t cycleCount = 0;
-      if (std::ifstream f{bat / "cycle_count"}) {
-        f >> cycleCount;
-      }
+      take(readings.cycle_count, cycleCount);
       if (charge_full_design >= largestDesignCapacity) {
         largestDesignCapacity = charge_full_design;
 
@@ -424,10 +365,8 @@ waybar::modules::Battery::getInfos() {
       } else if (energy_now_exists && energy_full_exists && energy_full != 0) {
         capacity_exists = true;
         capacity = 100 * (uint64_t)energy_now / (uint64_t)energy_full;
-      } else if (std::ifstream f{bat / "capacity"}) {
-        if (f >> capacity) {
-          capacity_exists = true;
-        }
+      } else {
+        capacity_exists = take(readings.capacity, capacity);
       }
 
       if (!voltage_now_exists) {
@@ -577,12 +516,9 @@ waybar::modules::Battery::getInfos() {
 
     // Give `Plugged` higher priority over `Not charging`.
     // So in a setting where TLP is used, `Plugged` is shown when the threshold is reached
-    if (!adapter_.empty() && (status == "Discharging" || status == "Not charging")) {
-      bool online;
-      std::string current_status;
-      std::ifstream(adapter_ / "online") >> online;
-      std::getline(std::ifstream(adapter_ / "status"), current_status);
-      if (online && current_status != "Discharging") status = "Plugged";
+    if (adapter_ && (status == "Discharging" || status == "Not charging")) {
+      const auto& adapter = adapter_->read();
+      if (adapter.online.value_or(0) != 0 && adapter.status != "Discharging") status = "Plugged";
     }
 
     if (total_energy_exists && total_power_exists && total_power != 0) {
@@ -673,7 +609,7 @@ waybar::modules::Battery::getInfos() {
   }
 }
 
-const std::string waybar::modules::Battery::getAdapterStatus(uint8_t capacity) const {
+const std::string waybar::modules::Battery::getAdapterStatus(uint8_t capacity) {
 #if defined(__FreeBSD__)
   int state;
   size_t size_state = sizeof state;
@@ -684,11 +620,10 @@ const std::string waybar::modules::Battery::getAdapterStatus(uint8_t capacity) c
   std::string status{"Unknown"};  // TODO: add status in FreeBSD
   {
 #else
-  if (!adapter_.empty()) {
-    bool online;
-    std::string status;
-    std::ifstream(adapter_ / "online") >> online;
-    std::getline(std::ifstream(adapter_ / "status"), status);
+  if (adapter_) {
+    const auto& adapter = adapter_->read();
+    bool online = adapter.online.value_or(0) != 0;
+    const std::string& status = adapter.status;
 #endif
     if (capacity == 100) {
       return "Full";
@@ -726,14 +661,18 @@ auto waybar::modules::Battery::update() -> void {
   }
 #endif
   auto [capacity, time_remaining, status, power, cycles, health] = getInfos();
-  if (status == "Unknown") {
-    status = getAdapterStatus(capacity);
-  }
-  auto state = getState(capacity, true);
   bool adapter_online = false;
-  if (!adapter_.empty()) {
-    std::ifstream(adapter_ / "online") >> adapter_online;
+  {
+    // The adapter may be replaced by a rescan
+    std::lock_guard<std::mutex> guard(battery_list_mutex_);
+    if (status == "Unknown") {
+      status = getAdapterStatus(capacity);
+    }
+    if (adapter_) {
+      adapter_online = adapter_->read().online.value_or(0) != 0;
+    }
   }
+  auto state = getState(capacity, true);
   if (config_["full-at-plugged"].asBool() && status == "Full" && adapter_online) {
     status = "Plugged";
   }
@@ -758,14 +697,12 @@ auto waybar::modules::Battery::update() -> void {
     } else {
       tooltip_text_default = status_pretty;
     }
-    if (!state.empty() && config_["tooltip-format-" + status + "-" + state].isString()) {
-      tooltip_format = config_["tooltip-format-" + status + "-" + state].asString();
-    } else if (config_["tooltip-format-" + status].isString()) {
-      tooltip_format = config_["tooltip-format-" + status].asString();
-    } else if (!state.empty() && config_["tooltip-format-" + state].isString()) {
-      tooltip_format = config_["tooltip-format-" + state].asString();
-    } else if (config_["tooltip-format"].isString()) {
-      tooltip_format = config_["tooltip-format"].asString();
+    if (const auto* configured = util::ModuleConfig::first(
+            {module_config_.string("tooltip-format", status, state),
+             module_config_.string("tooltip-format", status),
+             module_config_.string("tooltip-format", state),
+             module_config_.string("tooltip-format")})) {
+      tooltip_format = *configured;
     }
     setTooltipMarkup(
         fmt::format(fmt::runtime(tooltip_format), fmt::arg("timeTo", tooltip_text_default),
@@ -778,12 +715,11 @@ auto waybar::modules::Battery::update() -> void {
   }
   label_.get_style_context()->add_class(status);
   old_status_ = status;
-  if (!state.empty() && config_["format-" + status + "-" + state].isString()) {
-    format = config_["format-" + status + "-" + state].asString();
-  } else if (config_["format-" + status].isString()) {
-    format = config_["format-" + status].asString();
-  } else if (!state.empty() && config_["format-" + state].isString()) {
-    format = config_["format-" + state].asString();
+  if (const auto* configured =
+          util::ModuleConfig::first({module_config_.string("format", status, state),
+                                     module_config_.string("format", status),
+                                     module_config_.string("format", state)})) {
+    format = *configured;
   }
   if (format.empty()) {
     event_box_.hide();
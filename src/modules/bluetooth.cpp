@@ -271,21 +271,15 @@ auto waybar::modules::Bluetooth::update() -> void {
     if (battery_available && config_["format-connected-battery"].isString()) {
       format_ = config_["format-connected-battery"].asString();
       icon_label = getIcon(cur_focussed_device_.battery_percentage.value_or(0));
-    } else if (config_["format-" + state].isString()) {
-      format_ = config_["format-" + state].asString();
-    } else if (config_["format"].isString()) {
-      format_ = config_["format"].asString();
     } else {
-      format_ = default_format_;
+      format_ = resolveFormat(default_format_, state);
     }
   }
   if (battery_available && config_["tooltip-format-connected-battery"].isString()) {
     tooltip_format = config_["tooltip-format-connected-battery"].asString();
     icon_tooltip = getIcon(cur_focussed_device_.battery_percentage.value_or(0));
-  } else if (config_["tooltip-format-" + state].isString()) {
-    tooltip_format = config_["tooltip-format-" + state].asString();
-  } else if (config_["tooltip-format"].isString()) {
-    tooltip_format = config_["tooltip-format"].asString();
+  } else {
+    tooltip_format = resolveTooltipFormat(tooltip_format, state);
   }
 
   auto update_style_context = [this](const std::string& style_class, bool in_next_state) {
@@ -72,16 +72,19 @@ waybar::modules::cava::CavaBackend::~CavaBackend() {
   audio_data_.terminate = 1;
   pthread_mutex_unlock(&audio_data_.lock);
 
-  out_thread_.stop();
+  out_thread_.join();
   read_thread_.stop();
 
-  std::unique_lock<std::mutex> lk(read_thread_exit_mutex_);
-  if (!read_thread_exit_cv_.wait_for(lk, std::chrono::milliseconds(100),
-                                     [this] { return read_thread_exited_; })) {
-    spdlog::debug(
-        "Cava backend: read thread still blocked in input_source() on shutdown. "
-        "Proceeding with cleanup.");
+  // The input sources of libcava can't be interrupted, they return once they see terminate. They
+  // write to audio_data_ until then, so the thread must be joined before it is freed.
+  {
+    std::unique_lock<std::mutex> lk(read_thread_exit_mutex_);
+    if (!read_thread_exit_cv_.wait_for(lk, std::chrono::seconds(1),
+                                       [this] { return read_thread_exited_; })) {
+      spdlog::warn("Cava backend: waiting for the audio input to stop");
+    }
   }
+  read_thread_.join();
 
   std::lock_guard<std::recursive_mutex> lock(state_mutex_);
   freeBackend();
@@ -25,6 +25,7 @@ waybar::modules::Clock::Clock(const std::string& id, const Json::Value& config)
     : ALabel(config, "clock", id, "{:%H:%M}", 60, false, false, true),
       m_locale_{std::locale(config_["locale"].isString() ? config_["locale"].asString() : "")},
       m_tlpFmt_{(config_["tooltip-format"].isString()) ? config_["tooltip-format"].asString() : ""},
+      m_tlpCompiled_{m_tlpFmt_},
       m_tooltip_{new Gtk::Label()},
       cldInTooltip_{m_tlpFmt_.find("{" + kCldPlaceholder + "}") != std::string::npos},
       cldYearShift_{January / 1 / 1900},
@@ -169,10 +170,7 @@ waybar::modules::Clock::Clock(const std::string& id, const Json::Value& config)
     label_.signal_query_tooltip().connect(sigc::mem_fun(*this, &Clock::query_tlp_cb));
   }
 
-  thread_ = [this] {
-    dp.emit();
-    thread_.sleep_for(interval_ - system_clock::now().time_since_epoch() % interval_);
-  };
+  timer_.start([this] { dp.emit(); }, interval_, true);
 }
 
 bool waybar::modules::Clock::query_tlp_cb(int, int, bool,
@@ -223,13 +221,16 @@ auto waybar::modules::Clock::update() -> void {
     try {
       if (tzInTooltip_ || cldInTooltip_ || ordInTooltip_) {
         // std::vformat doesn't support named arguments.
-        m_tlpText_ =
-            std::regex_replace(m_tlpFmt_, std::regex("\\{" + kTZPlaceholder + "\\}"), tzText_);
-        m_tlpText_ = std::regex_replace(
-            m_tlpText_, std::regex("\\{" + kCldPlaceholder + "\\}"),
-            fmt_lib::vformat(m_locale_, cldText_, fmt_lib::make_format_args(shiftedNow)));
-        m_tlpText_ =
-            std::regex_replace(m_tlpText_, std::regex("\\{" + kOrdPlaceholder + "\\}"), ordText_);
+        const auto calendar =
+            cldInTooltip_
+                ? fmt_lib::vformat(m_locale_, cldText_, fmt_lib::make_format_args(shiftedNow))
+                : std::string();
+        m_tlpText_ = m_tlpCompiled_.substitute([&](std::string_view name) -> const std::string* {
+          if (name == kTZPlaceholder) return &tzText_;
+          if (name == kCldPlaceholder) return &calendar;
+          if (name == kOrdPlaceholder) return &ordText_;
+          return nullptr;
+        });
       } else {
         m_tlpText_ = m_tlpFmt_;
       }
@@ -15,23 +15,21 @@
 
 waybar::modules::Cpu::Cpu(const std::string& id, const Json::Value& config)
     : ALabel(config, "cpu", id, "{usage}%", 10) {
-  thread_ = [this] {
-    dp.emit();
-    thread_.sleep_for(interval_);
-  };
+  usage_ = CpuUsage::subscribe(interval_, [this] { dp.emit(); });
 }
 
 auto waybar::modules::Cpu::update() -> void {
   // TODO: as creating dynamic fmt::arg arrays is buggy we have to calc both
   auto [load1, load5, load15] = Load::getLoad();
-  auto [cpu_usage, tooltip] = CpuUsage::getCpuUsage(prev_times_);
+  const auto sample = usage_.snapshot();
+  const auto& [cpu_usage, tooltip] = *sample;
   auto [max_frequency, min_frequency, avg_frequency] = CpuFrequency::getCpuFrequency();
 
   auto format = format_;
   auto total_usage = cpu_usage.empty() ? 0 : cpu_usage[0];
   auto state = getState(total_usage);
-  if (!state.empty() && config_["format-" + state].isString()) {
-    format = config_["format-" + state].asString();
+  if (const auto* state_format = module_config_.string("format", state)) {
+    format = *state_format;
   }
 
   if (format.empty()) {
@@ -50,9 +48,13 @@ auto waybar::modules::Cpu::update() -> void {
     store.push_back(fmt::arg("min_frequency", min_frequency));
     store.push_back(fmt::arg("avg_frequency", avg_frequency));
     std::vector<std::string> arg_names;
-    arg_names.reserve(cpu_usage.size() * 2);
     std::string all_icons;
-    for (size_t i = 1; i < cpu_usage.size(); ++i) {
+    // The per-core arguments are the bulk of the work, only build them when shown
+    const bool per_core = formatReferences(format, state, CpuUsage::isPerCoreArg);
+    if (per_core) {
+      arg_names.reserve(cpu_usage.size() * 2);
+    }
+    for (size_t i = 1; per_core && i < cpu_usage.size(); ++i) {
       auto core_i = i - 1;
       arg_names.push_back(fmt::format("usage{}", core_i));
       store.push_back(fmt::arg(arg_names.back().c_str(), cpu_usage[i]));
@@ -11,10 +11,7 @@
 
 waybar::modules::CpuFrequency::CpuFrequency(const std::string& id, const Json::Value& config)
     : ALabel(config, "cpu_frequency", id, "{avg_frequency}", 10) {
-  thread_ = [this] {
-    dp.emit();
-    thread_.sleep_for(interval_);
-  };
+  timer_.start([this] { dp.emit(); }, interval_);
 }
 
 auto waybar::modules::CpuFrequency::update() -> void {
@@ -23,8 +20,8 @@ auto waybar::modules::CpuFrequency::update() -> void {
 
   auto format = format_;
   auto state = getState(avg_frequency);
-  if (!state.empty() && config_["format-" + state].isString()) {
-    format = config_["format-" + state].asString();
+  if (const auto* state_format = module_config_.string("format", state)) {
+    format = *state_format;
   }
 
   if (format.empty()) {
@@ -15,15 +15,13 @@
 
 waybar::modules::CpuGraph::CpuGraph(const std::string& id, const Json::Value& config)
     : AGraph(config, "cpu_graph", id, 5) {
-  thread_ = [this] {
-    dp.emit();
-    thread_.sleep_for(interval_);
-  };
+  usage_ = CpuUsage::subscribe(interval_, [this] { dp.emit(); });
 }
 
 auto waybar::modules::CpuGraph::update() -> void {
   // TODO: as creating dynamic fmt::arg arrays is buggy we have to calc both
-  auto [cpu_usage, tooltip] = CpuUsage::getCpuUsage(prev_times_);
+  const auto sample = usage_.snapshot();
+  const auto& [cpu_usage, tooltip] = *sample;
   if (tooltipEnabled()) {
     graph_.set_tooltip_text(tooltip);
   }
@@ -28,7 +28,8 @@ typedef uint64_t pcp_time_t;
 typedef long pcp_time_t;
 #endif
 
-std::vector<std::tuple<size_t, size_t>> waybar::modules::CpuUsage::parseCpuinfo() {
+std::vector<std::tuple<size_t, size_t>> waybar::modules::CpuUsage::parseCpuinfo(
+    const std::string& /*path*/) {
   cp_time_t sum_cp_time[CPUSTATES];
   size_t sum_sz = sizeof(sum_cp_time);
   int ncpu = sysconf(_SC_NPROCESSORS_CONF);
@@ -105,3 +106,12 @@ std::vector<std::tuple<size_t, size_t>> waybar::modules::CpuUsage::parseCpuinfo(
   }
   return cpuinfo;
 }
+
+// sysctl has no file to keep open, the sample is only copied into the kept vector
+waybar::modules::CpuUsage::StatReader::StatReader(const std::string& /*path*/)
+    : stat_(""), present_("") {}
+
+auto waybar::modules::CpuUsage::StatReader::read() -> const Times& {
+  times_ = parseCpuinfo();
+  return times_;
+}
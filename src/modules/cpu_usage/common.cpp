@@ -1,5 +1,9 @@
 #include "modules/cpu_usage.hpp"
 
+#include <cctype>
+#include <iterator>
+#include <memory>
+
 // In the 80000 version of fmt library authors decided to optimize imports
 // and moved declarations required for fmt::dynamic_format_arg_store in new
 // header fmt/args.h
@@ -11,21 +15,19 @@
 
 waybar::modules::CpuUsage::CpuUsage(const std::string& id, const Json::Value& config)
     : ALabel(config, "cpu_usage", id, "{usage}%", 10) {
-  thread_ = [this] {
-    dp.emit();
-    thread_.sleep_for(interval_);
-  };
+  usage_ = subscribe(interval_, [this] { dp.emit(); });
 }
 
 auto waybar::modules::CpuUsage::update() -> void {
   // TODO: as creating dynamic fmt::arg arrays is buggy we have to calc both
-  auto [cpu_usage, tooltip] = CpuUsage::getCpuUsage(prev_times_);
+  const auto sample = usage_.snapshot();
+  const auto& [cpu_usage, tooltip] = *sample;
 
   auto format = format_;
   auto total_usage = cpu_usage.empty() ? 0 : cpu_usage[0];
   auto state = getState(total_usage);
-  if (!state.empty() && config_["format-" + state].isString()) {
-    format = config_["format-" + state].asString();
+  if (const auto* state_format = module_config_.string("format", state)) {
+    format = *state_format;
   }
 
   if (format.empty()) {
@@ -37,9 +39,13 @@ auto waybar::modules::CpuUsage::update() -> void {
     store.push_back(fmt::arg("usage", total_usage));
     store.push_back(fmt::arg("icon", getIcon(total_usage, icons)));
     std::vector<std::string> arg_names;
-    arg_names.reserve(cpu_usage.size() * 2);
     std::string all_icons;
-    for (size_t i = 1; i < cpu_usage.size(); ++i) {
+    // The per-core arguments are the bulk of the work, only build them when shown
+    const bool per_core = formatReferences(format, state, isPerCoreArg);
+    if (per_core) {
+      arg_names.reserve(cpu_usage.size() * 2);
+    }
+    for (size_t i = 1; per_core && i < cpu_usage.size(); ++i) {
       auto core_i = i - 1;
       arg_names.push_back(fmt::format("usage{}", core_i));
       store.push_back(fmt::arg(arg_names.back().c_str(), cpu_usage[i]));
@@ -56,13 +62,23 @@ auto waybar::modules::CpuUsage::update() -> void {
   ALabel::update();
 }
 
+bool waybar::modules::CpuUsage::isPerCoreArg(std::string_view name) {
+  const auto core = [name](std::string_view prefix) {
+    return name.starts_with(prefix) && name.size() > prefix.size() &&
+           std::isdigit(static_cast<unsigned char>(name[prefix.size()])) != 0;
+  };
+  return name == "icons" || core("usage") || core("icon");
+}
+
 std::tuple<std::vector<uint16_t>, std::string> waybar::modules::CpuUsage::getCpuUsage(
-    std::vector<std::tuple<size_t, size_t>>& prev_times) {
-  if (prev_times.empty()) {
-    prev_times = CpuUsage::parseCpuinfo();
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    StatReader& reader, Times& prev_times) {
+  const Times& curr_times = reader.read();
+  // Without a previous sample, the first one is the usage since boot rather than a wait for a
+  // second read on the scheduler worker
+  const bool since_boot = prev_times.empty();
+  if (since_boot) {
+    prev_times.assign(curr_times.size(), {0, 0});
   }
-  std::vector<std::tuple<size_t, size_t>> curr_times = CpuUsage::parseCpuinfo();
   std::string tooltip;
   std::vector<uint16_t> usage;
 
@@ -87,12 +103,16 @@ std::tuple<std::vector<uint16_t>, std::string> waybar::modules::CpuUsage::getCpu
     return {usage, tooltip};
   }
 
+  usage.reserve(curr_times.size());
+  // "\nCoreNNN: 100%"
+  tooltip.reserve(curr_times.size() * 16);
+  auto out = std::back_inserter(tooltip);
   for (size_t i = 0; i < curr_times.size(); ++i) {
     auto [curr_idle, curr_total] = curr_times[i];
     auto [prev_idle, prev_total] = prev_times[i];
-    if (i > 0 && (curr_total == 0 || prev_total == 0)) {
+    if (i > 0 && (curr_total == 0 || (prev_total == 0 && !since_boot))) {
       // This CPU is offline
-      tooltip = tooltip + fmt::format("\nCore{}: offline", i - 1);
+      fmt::format_to(out, "\nCore{}: offline", i - 1);
       usage.push_back(0);
       continue;
     }
@@ -101,12 +121,26 @@ std::tuple<std::vector<uint16_t>, std::string> waybar::modules::CpuUsage::getCpu
     uint16_t tmp =
         (delta_total > 0) ? static_cast<uint16_t>(100 * (1 - delta_idle / delta_total)) : 0;
     if (i == 0) {
-      tooltip = fmt::format("Total: {}%", tmp);
+      fmt::format_to(out, "Total: {}%", tmp);
     } else {
-      tooltip = tooltip + fmt::format("\nCore{}: {}%", i - 1, tmp);
+      fmt::format_to(out, "\nCore{}: {}%", i - 1, tmp);
     }
     usage.push_back(tmp);
   }
+  // Same size as before, the copy reuses the storage
   prev_times = curr_times;
-  return {usage, tooltip};
+  return {std::move(usage), std::move(tooltip)};
+}
+
+waybar::util::SharedSampler<waybar::modules::CpuUsage::Sample>::Subscription
+waybar::modules::CpuUsage::subscribe(std::chrono::milliseconds interval,
+                                     std::function<void()> on_sample) {
+  return util::SharedSampler<Sample>::subscribe(
+      fmt::format("cpu_usage@{}", interval.count()), interval,
+      // The reader and the previous times are kept by the sampler, so a sample parses into
+      // the same buffers every time
+      [reader = std::make_shared<StatReader>(), prev_times = Times()]() mutable {
+        return getCpuUsage(*reader, prev_times);
+      },
+      std::move(on_sample));
 }
@@ -2,7 +2,10 @@
 
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
 #include <cerrno>
+#include <cmath>
+#include <limits>
 #include <stdexcept>
 #include <utility>
 
@@ -13,13 +16,28 @@ waybar::modules::Custom::Custom(const std::string& name, const std::string& id,
       output_name_(output_name),
       id_(id),
       tooltip_format_enabled_{config_["tooltip-format"].isString()},
+      has_exec_{config_["exec"].isString() || config_["exec-if"].isString()},
+      json_output_{config_["return-type"].asString() == "json"},
+      hide_empty_text_{config_["hide-empty-text"].asBool()},
+      escape_{config_["escape"].isBool() && config_["escape"].asBool()},
+      exec_direct_{config_["exec-direct"].isBool() && config_["exec-direct"].asBool()},
+      exec_timeout_{config_["exec-timeout"].isNumeric()
+                        ? std::chrono::milliseconds(
+                              static_cast<int64_t>(config_["exec-timeout"].asDouble() * 1000))
+                        : std::chrono::milliseconds::zero()},
+      max_output_{config_["exec-max-output"].isUInt64()
+                      ? static_cast<std::size_t>(config_["exec-max-output"].asUInt64())
+                      : util::command::kMaxOutputSize},
+      coprocess_{config_["mode"].asString() == "coprocess"},
       percentage_(0) {
   if (config.isNull()) {
     spdlog::warn("There is no configuration for 'custom/{}', element will be hidden", name);
   }
 
-  if (!config_["signal"].empty() && config_["interval"].empty() &&
-      config_["restart-interval"].empty()) {
+  if (coprocess_) {
+    coprocessWorker();
+  } else if (!config_["signal"].empty() && config_["interval"].empty() &&
+             config_["restart-interval"].empty()) {
     waitingWorker();
   } else if (interval_.count() > 0) {
     delayWorker();
@@ -38,6 +56,11 @@ waybar::modules::Custom::Custom(const std::string& name, const std::string& id,
 }
 
 waybar::modules::Custom::~Custom() {
+  // The timer may submit until it is stopped
+  timer_.stop();
+  exec_task_.cancel();
+  shared_exec_.reset();
+  reply_connection_.disconnect();
   restart_connection_.disconnect();
   if (continuous_stream_) {
     continuous_stream_->stop();
@@ -50,38 +73,115 @@ void waybar::modules::Custom::delayWorker() {
     return;
   }
 
-  thread_ = [this] {
-    for (auto it = this->pid_children_.begin(); it != this->pid_children_.end();) {
-      int status = 0;
-      const auto pid = static_cast<pid_t>(*it);
-      const auto waited = waitpid(pid, &status, WNOHANG);
-      if (waited == 0) {
-        ++it;
-        continue;
-      }
-      if (waited == -1 && errno != ECHILD) {
-        ++it;
-        continue;
-      }
-      it = this->pid_children_.erase(it);
-    }
+  if (!config_["output-specific"].isBool() || config_["output-specific"].asBool()) {
+    timer_.start(
+        [this] {
+          reapChildren();
+          runScripts();
+        },
+        interval_);
+    return;
+  }
 
-    bool can_update = true;
-    if (config_["exec-if"].isString()) {
-      output_ = util::command::execNoRead(config_["exec-if"].asString());
-      if (output_.exit_code != 0) {
-        can_update = false;
+  // The same scripts on every bar run once for all of them, without WAYBAR_OUTPUT_NAME
+  auto scripts = this->scripts();
+  scripts.output_name.clear();
+  // Length-prefixed, so that a command containing the separator can't make another key
+  auto field = [](const std::optional<std::string>& cmd) {
+    return cmd ? fmt::format("{}:{}", cmd->size(), *cmd) : std::string("-");
+  };
+  const auto key = fmt::format(
+      "custom:{}|{}@{}{}{}+max{}", field(scripts.exec_if), field(scripts.exec), interval_.count(),
+      scripts.direct ? "+direct" : "",
+      scripts.timeout.count() > 0 ? fmt::format("+timeout{}", scripts.timeout.count()) : "",
+      scripts.max_output);
+  using Sampler = util::SharedSampler<util::command::res>;
+  // Owned by the sampler, so that its run is cancelled with the last subscriber
+  auto task = std::make_shared<util::ExecPool::Task>();
+  shared_exec_ = Sampler::subscribeAsync(
+      key, interval_,
+      [scripts, interval = interval_, task](Sampler::Publish publish) {
+        // A signal or an event of any bar wakes the shared run up, but it keeps the deadline of
+        // its interval
+        *task = util::ExecPool::inst()->submit(
+            requests(scripts, util::ExecPool::deadlineIn(interval)), std::move(publish));
+      },
+      [this] {
+        reapChildren();
         dp.emit();
-      }
+      });
+}
+
+void waybar::modules::Custom::reapChildren() {
+  for (auto it = this->pid_children_.begin(); it != this->pid_children_.end();) {
+    int status = 0;
+    const auto pid = static_cast<pid_t>(*it);
+    const auto waited = waitpid(pid, &status, WNOHANG);
+    if (waited == 0) {
+      ++it;
+      continue;
     }
-    if (can_update) {
-      if (config_["exec"].isString()) {
-        output_ = util::command::exec(config_["exec"].asString(), output_name_);
-      }
-      dp.emit();
+    if (waited == -1 && errno != ECHILD) {
+      ++it;
+      continue;
     }
-    thread_.sleep_for(interval_);
-  };
+    it = this->pid_children_.erase(it);
+  }
+}
+
+waybar::modules::Custom::Scripts waybar::modules::Custom::scripts() const {
+  Scripts scripts{.output_name = output_name_,
+                  .direct = exec_direct_,
+                  .timeout = exec_timeout_,
+                  .max_output = max_output_};
+  if (config_["exec-if"].isString()) {
+    scripts.exec_if = config_["exec-if"].asString();
+  }
+  if (config_["exec"].isString()) {
+    scripts.exec = config_["exec"].asString();
+  }
+  return scripts;
+}
+
+std::vector<waybar::util::ExecPool::Request> waybar::modules::Custom::requests(
+    const Scripts& scripts, util::ExecPool::clock::time_point deadline) {
+  std::vector<util::ExecPool::Request> requests;
+  if (scripts.exec_if) {
+    requests.push_back({.cmd = *scripts.exec_if,
+                        .no_read = true,
+                        .direct = scripts.direct,
+                        .timeout = scripts.timeout,
+                        .deadline = deadline});
+  }
+  if (scripts.exec) {
+    requests.push_back({.cmd = *scripts.exec,
+                        .output_name = scripts.output_name,
+                        .direct = scripts.direct,
+                        .timeout = scripts.timeout,
+                        .max_output = scripts.max_output,
+                        .deadline = deadline});
+  }
+  return requests;
+}
+
+void waybar::modules::Custom::runScripts() {
+  // Still running since the last time, its result wakes the timer up again if this was urgent
+  if (exec_task_.pending()) {
+    return;
+  }
+  // Woken up by a signal or an event, the output is wanted now. Otherwise it is by the next run.
+  const auto deadline = urgent_.exchange(false) ? util::ExecPool::clock::now()
+                                                : util::ExecPool::deadlineIn(interval_);
+  exec_task_ = util::ExecPool::inst()->submit(
+      requests(scripts(), deadline),
+      [this](util::command::res output) {
+        output_ = std::move(output);
+        dp.emit();
+        if (urgent_) {
+          timer_.wake_up();
+        }
+      },
+      stats_);
 }
 
 void waybar::modules::Custom::continuousWorker() {
@@ -145,59 +245,195 @@ void waybar::modules::Custom::scheduleContinuousRestart() {
       std::max(1U, static_cast<unsigned>(config_["restart-interval"].asDouble() * 1000)));
 }
 
-void waybar::modules::Custom::waitingWorker() {
-  thread_ = [this] {
-    bool can_update = true;
-    if (config_["exec-if"].isString()) {
-      output_ = util::command::execNoRead(config_["exec-if"].asString());
-      if (output_.exit_code != 0) {
-        can_update = false;
+void waybar::modules::Custom::coprocessWorker() {
+  if (!config_["exec"].isString()) {
+    throw std::runtime_error("coprocess mode requires exec");
+  }
+  restart_delay_ = coprocessRestartInterval();
+  continuous_stream_ = std::make_unique<util::command::LineStream>(
+      output_name_,
+      [this](const std::string& output) {
+        // A reply, or a line the script printed on its own, shown all the same
+        awaiting_reply_ = false;
+        reply_connection_.disconnect();
+        restart_delay_ = coprocessRestartInterval();
+        output_ = {.exit_code = 0, .out = output};
         dp.emit();
-      }
+      },
+      [this](int exit_code) { handleCoprocessExit(exit_code); });
+  startCoprocess(true);
+  if (interval_.count() > 0 && interval_ != std::chrono::milliseconds::max()) {
+    // Due on the scheduler like every polling module, the request is written on the main loop,
+    // where the stream lives. Not through update(), which waits for a frame that doesn't come
+    // while the bar isn't visible.
+    tick_dp_.connect([this] { request("tick"); });
+    timer_.start([this] { tick_dp_.emit(); }, interval_);
+  }
+}
+
+void waybar::modules::Custom::startCoprocess(bool throw_on_failure) {
+  const auto cmd = config_["exec"].asString();
+  awaiting_reply_ = false;
+  try {
+    continuous_stream_->start(cmd, true);
+  } catch (const Glib::SpawnError& e) {
+    if (throw_on_failure) {
+      throw std::runtime_error("Unable to open " + cmd + ": " + e.what().raw());
     }
-    if (can_update) {
-      if (config_["exec"].isString()) {
-        output_ = util::command::exec(config_["exec"].asString(), output_name_);
-      }
-      dp.emit();
+    spdlog::error("Unable to restart {}: {}", name_, e.what().raw());
+    scheduleCoprocessRestart();
+    return;
+  } catch (const std::exception& e) {
+    if (throw_on_failure) {
+      throw;
     }
-    thread_.sleep();
-  };
+    spdlog::error("Unable to restart {}: {}", name_, e.what());
+    scheduleCoprocessRestart();
+    return;
+  }
+  // The first output doesn't wait for the first interval
+  request("tick");
+}
+
+void waybar::modules::Custom::handleCoprocessExit(int exit_code) {
+  awaiting_reply_ = false;
+  reply_connection_.disconnect();
+  output_ = {.exit_code = exit_code, .out = ""};
+  dp.emit();
+  spdlog::warn("{} exited with code {}, restarting in {}ms", name_, exit_code,
+               restart_delay_.count());
+  scheduleCoprocessRestart();
+}
+
+void waybar::modules::Custom::scheduleCoprocessRestart() {
+  restart_connection_.disconnect();
+  const auto delay = restart_delay_;
+  // Doubled on every restart without a reply in between, so a crashing script isn't respawned
+  // in a loop
+  restart_delay_ = std::min(restart_delay_ * 2, std::max(COPROCESS_MAX_RESTART_DELAY, delay));
+  restart_connection_ = Glib::signal_timeout().connect(
+      [this] {
+        startCoprocess(false);
+        return false;
+      },
+      static_cast<unsigned>(delay.count()));
+}
+
+std::chrono::milliseconds waybar::modules::Custom::coprocessRestartInterval() const {
+  if (config_["restart-interval"].isNumeric() && config_["restart-interval"].asDouble() > 0) {
+    return std::max(std::chrono::milliseconds(1),
+                    std::chrono::milliseconds(static_cast<int64_t>(
+                        std::min(config_["restart-interval"].asDouble(), 86400.0) * 1000)));
+  }
+  return std::chrono::seconds(1);
+}
+
+void waybar::modules::Custom::handleReplyTimeout() {
+  spdlog::warn("{} didn't reply within {}ms, restarting in {}ms", name_, exec_timeout_.count(),
+               restart_delay_.count());
+  awaiting_reply_ = false;
+  // It may ignore SIGTERM as well, and stop() waits for it on the main loop
+  continuous_stream_->stop(SIGKILL);
+  output_ = {.exit_code = util::ExecPool::TIMEOUT_EXIT_CODE, .out = ""};
+  dp.emit();
+  scheduleCoprocessRestart();
+}
+
+void waybar::modules::Custom::request(const std::string& line) {
+  // A script still busy with a request doesn't get ticks piling up, only the events
+  if (line == "tick" && awaiting_reply_) {
+    return;
+  }
+  if (!continuous_stream_->write(line)) {
+    return;
+  }
+  // The deadline runs from the oldest request without a reply
+  if (!awaiting_reply_ && exec_timeout_.count() > 0) {
+    reply_connection_ = Glib::signal_timeout().connect(
+        [this] {
+          handleReplyTimeout();
+          return false;
+        },
+        static_cast<unsigned>(std::min<std::chrono::milliseconds::rep>(
+            exec_timeout_.count(), std::numeric_limits<unsigned>::max())));
+  }
+  awaiting_reply_ = true;
+}
+
+void waybar::modules::Custom::waitingWorker() {
+  // Run once, then only when woken up by a signal or an event
+  timer_.start([this] { runScripts(); }, std::chrono::milliseconds::max());
 }
 
 void waybar::modules::Custom::refresh(int sig) {
 #ifdef SIGRTMIN
   if (config_["signal"].isInt() && sig == SIGRTMIN + config_["signal"].asInt()) {
-    thread_.wake_up();
+    if (coprocess_) {
+      request("refresh");
+      return;
+    }
+    urgent_ = true;
+    timer_.wake_up();
+    shared_exec_.refresh();
   }
 #endif
 }
 
-void waybar::modules::Custom::handleEvent() {
+void waybar::modules::Custom::handleEvent(const std::string& event) {
   if (!config_["exec-on-event"].isBool() || config_["exec-on-event"].asBool()) {
-    thread_.wake_up();
+    if (coprocess_) {
+      request(event);
+      return;
+    }
+    urgent_ = true;
+    timer_.wake_up();
+    shared_exec_.refresh();
   }
 }
 
 bool waybar::modules::Custom::handleScroll(GdkEventScroll* e) {
   auto ret = ALabel::handleScroll(e);
-  handleEvent();
+  std::string direction;
+  switch (e->direction) {
+    case GDK_SCROLL_UP:
+      direction = "up";
+      break;
+    case GDK_SCROLL_DOWN:
+      direction = "down";
+      break;
+    case GDK_SCROLL_LEFT:
+      direction = "left";
+      break;
+    case GDK_SCROLL_RIGHT:
+      direction = "right";
+      break;
+    case GDK_SCROLL_SMOOTH:
+      if (std::abs(e->delta_y) >= std::abs(e->delta_x)) {
+        direction = e->delta_y < 0 ? "up" : "down";
+      } else {
+        direction = e->delta_x < 0 ? "left" : "right";
+      }
+      break;
+  }
+  handleEvent("scroll " + direction);
   return ret;
 }
 
 bool waybar::modules::Custom::handleToggle(GdkEventButton* const& e) {
   auto ret = ALabel::handleToggle(e);
-  handleEvent();
+  handleEvent("click " + std::to_string(e->button));
   return ret;
 }
 
 auto waybar::modules::Custom::update() -> void {
+  if (shared_exec_) {
+    output_ = *shared_exec_.snapshot();
+  }
   // Hide label if output is empty
-  if ((config_["exec"].isString() || config_["exec-if"].isString()) &&
-      (output_.out.empty() || output_.exit_code != 0)) {
+  if (has_exec_ && (output_.out.empty() || output_.exit_code != 0)) {
     event_box_.hide();
   } else {
-    if (config_["return-type"].asString() == "json") {
+    if (json_output_) {
       parseOutputJson();
     } else {
       parseOutputRaw();
@@ -207,7 +443,7 @@ auto waybar::modules::Custom::update() -> void {
       auto str = fmt::format(fmt::runtime(format_), fmt::arg("text", text_), fmt::arg("alt", alt_),
                              fmt::arg("icon", getIcon(percentage_, alt_)),
                              fmt::arg("percentage", percentage_));
-      if ((config_["hide-empty-text"].asBool() && text_.empty()) ||
+      if ((hide_empty_text_ && text_.empty()) ||
           (str.empty() && image_path_.empty() && image_name_.empty())) {
         event_box_.hide();
       } else {
@@ -215,11 +451,10 @@ auto waybar::modules::Custom::update() -> void {
         if (tooltipEnabled()) {
           std::string tooltip_markup;
           if (tooltip_format_enabled_) {
-            auto tooltip = config_["tooltip-format"].asString();
-            tooltip_markup = fmt::format(fmt::runtime(tooltip), fmt::arg("text", text_),
-                                         fmt::arg("tooltip", tooltip_), fmt::arg("alt", alt_),
-                                         fmt::arg("icon", getIcon(percentage_, alt_)),
-                                         fmt::arg("percentage", percentage_));
+            tooltip_markup = fmt::format(
+                fmt::runtime(*module_config_.string("tooltip-format")), fmt::arg("text", text_),
+                fmt::arg("tooltip", tooltip_), fmt::arg("alt", alt_),
+                fmt::arg("icon", getIcon(percentage_, alt_)), fmt::arg("percentage", percentage_));
           } else if (text_ == tooltip_) {
             tooltip_markup = str;
           } else {
@@ -302,7 +537,7 @@ void waybar::modules::Custom::parseOutputRaw() {
     }
 
     if (i == 0) {
-      if (config_["escape"].isBool() && config_["escape"].asBool()) {
+      if (escape_) {
         text_ = Glib::Markup::escape_text(validated_line);
         tooltip_ = Glib::Markup::escape_text(validated_line);
       } else {
@@ -312,7 +547,7 @@ void waybar::modules::Custom::parseOutputRaw() {
       tooltip_ = validated_line;
       class_.clear();
     } else if (i == 1) {
-      if (config_["escape"].isBool() && config_["escape"].asBool()) {
+      if (escape_) {
         tooltip_ = Glib::Markup::escape_text(validated_line);
       } else {
         tooltip_ = validated_line;
@@ -341,18 +576,17 @@ void waybar::modules::Custom::parseOutputJson() {
   };
   while (getline(output, line)) {
     auto parsed = parser_.parse(line);
-    const bool escape = config_["escape"].isBool() && config_["escape"].asBool();
-    if (escape) {
+    if (escape_) {
       text_ = Glib::Markup::escape_text(sanitize(parsed["text"].asString()));
     } else {
       text_ = sanitize(parsed["text"].asString());
     }
-    if (escape) {
+    if (escape_) {
       alt_ = Glib::Markup::escape_text(sanitize(parsed["alt"].asString()));
     } else {
       alt_ = sanitize(parsed["alt"].asString());
     }
-    if (escape) {
+    if (escape_) {
       tooltip_ = Glib::Markup::escape_text(sanitize(parsed["tooltip"].asString()));
     } else {
       tooltip_ = sanitize(parsed["tooltip"].asString());
@@ -16,6 +16,14 @@ waybar::modules::CustomGraph::CustomGraph(const std::string& name, const std::st
       output_name_(output_name),
       id_(id),
       tooltip_format_enabled_{config_["tooltip-format"].isString()},
+      exec_direct_{config_["exec-direct"].isBool() && config_["exec-direct"].asBool()},
+      exec_timeout_{config_["exec-timeout"].isNumeric()
+                        ? std::chrono::milliseconds(
+                              static_cast<int64_t>(config_["exec-timeout"].asDouble() * 1000))
+                        : std::chrono::milliseconds::zero()},
+      max_output_{config_["exec-max-output"].isUInt64()
+                      ? static_cast<std::size_t>(config_["exec-max-output"].asUInt64())
+                      : util::command::kMaxOutputSize},
       percentage_(0),
       fp_(nullptr),
       pid_(-1) {
@@ -34,11 +42,20 @@ waybar::modules::CustomGraph::CustomGraph(const std::string& name, const std::st
 }
 
 waybar::modules::CustomGraph::~CustomGraph() {
+  // Stop first, so the worker doesn't restart the command it sees exiting
+  thread_.stop();
   if (pid_ != -1) {
+    // Also closes the output of a continuous command, which unblocks the worker
     killpg(pid_, SIGTERM);
+  }
+  thread_.join();
+  if (fp_) {
+    util::command::close(fp_, pid_);
+    fp_ = nullptr;
+  } else if (pid_ != -1) {
     waitpid(pid_, NULL, 0);
-    pid_ = -1;
   }
+  pid_ = -1;
 }
 
 void waybar::modules::CustomGraph::delayWorker() {
@@ -50,28 +67,43 @@ void waybar::modules::CustomGraph::delayWorker() {
 
     this->pid_children_.clear();
 
-    bool can_update = true;
-    if (config_["exec-if"].isString()) {
-      output_ = util::command::execNoRead(config_["exec-if"].asString());
-      if (output_.exit_code != 0) {
-        can_update = false;
-        dp.emit();
-      }
-    }
-    if (can_update) {
-      if (config_["exec"].isString()) {
-        output_ = util::command::exec(config_["exec"].asString(), output_name_);
-      }
-      dp.emit();
-    }
+    // Woken up by a signal or an event, the output is wanted now. Otherwise it is by the next run.
+    runScripts(urgent_.exchange(false) ? util::ExecPool::clock::now()
+                                       : util::ExecPool::deadlineIn(interval_));
     thread_.sleep_for(interval_);
   };
 }
 
+void waybar::modules::CustomGraph::runScripts(util::ExecPool::clock::time_point deadline) {
+  bool can_update = true;
+  if (config_["exec-if"].isString()) {
+    output_ = util::ExecPool::inst()->run({.cmd = config_["exec-if"].asString(),
+                                           .no_read = true,
+                                           .direct = exec_direct_,
+                                           .timeout = exec_timeout_,
+                                           .deadline = deadline});
+    if (output_.exit_code != 0) {
+      can_update = false;
+      dp.emit();
+    }
+  }
+  if (can_update) {
+    if (config_["exec"].isString()) {
+      output_ = util::ExecPool::inst()->run({.cmd = config_["exec"].asString(),
+                                             .output_name = output_name_,
+                                             .direct = exec_direct_,
+                                             .timeout = exec_timeout_,
+                                             .max_output = max_output_,
+                                             .deadline = deadline});
+    }
+    dp.emit();
+  }
+}
+
 void waybar::modules::CustomGraph::continuousWorker() {
   auto cmd = config_["exec"].asString();
   pid_ = -1;
-  fp_ = util::command::open(cmd, pid_, output_name_);
+  fp_ = util::command::open(cmd, pid_, output_name_, exec_direct_);
   if (!fp_) {
     throw std::runtime_error("Unable to open " + cmd);
   }
@@ -89,6 +121,11 @@ void waybar::modules::CustomGraph::continuousWorker() {
         exit_code = WEXITSTATUS(util::command::close(fp_, pid_));
         fp_ = nullptr;
       }
+      if (!thread_.isRunning()) {
+        // Killed on purpose by the destructor
+        pid_ = -1;
+        return;
+      }
       if (exit_code != 0) {
         output_ = {exit_code, ""};
         dp.emit();
@@ -97,7 +134,10 @@ void waybar::modules::CustomGraph::continuousWorker() {
       if (config_["restart-interval"].isUInt()) {
         pid_ = -1;
         thread_.sleep_for(std::chrono::seconds(config_["restart-interval"].asUInt()));
-        fp_ = util::command::open(cmd, pid_, output_name_);
+        if (!thread_.isRunning()) {
+          return;
+        }
+        fp_ = util::command::open(cmd, pid_, output_name_, exec_direct_);
         if (!fp_) {
           // Letting this exception escape the SleeperThread would call
           // std::terminate and kill all of Waybar. Degrade gracefully instead.
@@ -126,20 +166,8 @@ void waybar::modules::CustomGraph::continuousWorker() {
 
 void waybar::modules::CustomGraph::waitingWorker() {
   thread_ = [this] {
-    bool can_update = true;
-    if (config_["exec-if"].isString()) {
-      output_ = util::command::execNoRead(config_["exec-if"].asString());
-      if (output_.exit_code != 0) {
-        can_update = false;
-        dp.emit();
-      }
-    }
-    if (can_update) {
-      if (config_["exec"].isString()) {
-        output_ = util::command::exec(config_["exec"].asString(), output_name_);
-      }
-      dp.emit();
-    }
+    runScripts(urgent_.exchange(false) ? util::ExecPool::clock::now()
+                                       : util::ExecPool::clock::time_point::max());
     thread_.sleep();
   };
 }
@@ -147,6 +175,7 @@ void waybar::modules::CustomGraph::waitingWorker() {
 void waybar::modules::CustomGraph::refresh(int sig) {
 #ifdef SIGRTMIN
   if (config_["signal"].isInt() && sig == SIGRTMIN + config_["signal"].asInt()) {
+    urgent_ = true;
     thread_.wake_up();
   }
 #endif
@@ -154,6 +183,7 @@ void waybar::modules::CustomGraph::refresh(int sig) {
 
 void waybar::modules::CustomGraph::handleEvent() {
   if (!config_["exec-on-event"].isBool() || config_["exec-on-event"].asBool()) {
+    urgent_ = true;
     thread_.wake_up();
   }
 }
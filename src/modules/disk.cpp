@@ -1,15 +1,123 @@
 #include "modules/disk.hpp"
 
+#include <fcntl.h>
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <thread>
+
+#include "util/mountinfo.hpp"
+
 using namespace waybar::util;
 
+struct waybar::modules::Disk::Probe {
+  using Callback = std::function<void(const struct statvfs& stats, int error)>;
+
+  explicit Probe(std::string path) : path(std::move(path)) {}
+
+  // Returns the probe of `path`, started with its first subscriber. `callback` is called on the
+  // thread of the probe with every result.
+  static ProbeSubscription subscribe(const std::string& path, Callback callback) {
+    std::lock_guard lock(registryMutex());
+    auto& probe = registry()[path];
+    if (!probe) {
+      probe = std::make_shared<Probe>(path);
+      std::thread([probe] { run(probe); }).detach();
+    }
+    std::lock_guard probe_lock(probe->mutex);
+    const auto id = ++probe->last_id;
+    probe->subscribers.emplace(id, std::move(callback));
+    return {probe, id};
+  }
+
+  // Waits for a callback in progress. The probe is stopped with its last subscriber, its thread
+  // exits once it returns from a statvfs stuck on a dead server, which can't be interrupted.
+  void unsubscribe(uint64_t id) {
+    std::lock_guard lock(registryMutex());
+    std::lock_guard probe_lock(mutex);
+    subscribers.erase(id);
+    if (subscribers.empty()) {
+      stopped = true;
+      cv.notify_all();
+      registry().erase(path);
+    }
+  }
+
+  // Starts a statvfs unless one is running, and returns for how long that one has been running.
+  // A result younger than `max_age`, asked for by another bar, is good enough.
+  std::chrono::steady_clock::duration request(std::chrono::milliseconds max_age) {
+    std::lock_guard lock(mutex);
+    const auto now = std::chrono::steady_clock::now();
+    if (requested != done) {
+      return now - started;
+    }
+    if (done != 0 && now - finished < max_age) {
+      return {};
+    }
+    requested++;
+    started = now;
+    cv.notify_all();
+    return {};
+  }
+
+  const std::string path;
+
+ private:
+  static std::map<std::string, std::shared_ptr<Probe>>& registry() {
+    static std::map<std::string, std::shared_ptr<Probe>> registry;
+    return registry;
+  }
+
+  static std::mutex& registryMutex() {
+    static std::mutex mutex;
+    return mutex;
+  }
+
+  static void run(const std::shared_ptr<Probe>& probe) {
+    std::unique_lock lock(probe->mutex);
+    while (true) {
+      probe->cv.wait(lock, [&probe] { return probe->stopped || probe->requested != probe->done; });
+      if (probe->stopped) {
+        return;
+      }
+      const auto seq = probe->requested;
+      lock.unlock();
+      struct statvfs stats {};
+      const int error = statvfs(probe->path.c_str(), &stats) == 0 ? 0 : errno;
+      lock.lock();
+      probe->done = seq;
+      probe->finished = std::chrono::steady_clock::now();
+      // With the lock held, so that a module can't be destroyed while it is called
+      for (const auto& [id, callback] : probe->subscribers) {
+        callback(stats, error);
+      }
+    }
+  }
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::map<uint64_t, Callback> subscribers;
+  uint64_t last_id{0};
+  uint64_t requested{0};
+  uint64_t done{0};
+  std::chrono::steady_clock::time_point started;
+  std::chrono::steady_clock::time_point finished;
+  bool stopped{false};
+};
+
 waybar::modules::Disk::Disk(const std::string& id, const Json::Value& config)
-    : ALabel(config, "disk", id, "{}%", 30), header_(""), paths_(), separator_(" ") {
-  thread_ = [this] {
-    dp.emit();
-    thread_.sleep_for(interval_);
-  };
+    : ALabel(config, "disk", id, "{}%", 30),
+      header_(""),
+      paths_(),
+      separator_(" "),
+      timeout_(config["timeout"].isNumeric()
+                   ? std::chrono::milliseconds(
+                         std::max(1L, static_cast<long>(config["timeout"].asDouble() * 1000)))
+                   : std::chrono::seconds(2)) {
   if (config["header"].isString()) {
     header_ = config["header"].asString();
   }
@@ -31,18 +139,143 @@ waybar::modules::Disk::Disk(const std::string& id, const Json::Value& config)
   if (config["unit"].isString()) {
     unit_ = config["unit"].asString();
   }
+
+  samples_.resize(paths_.size());
+  for (size_t i = 0; i < paths_.size(); ++i) {
+    probes_.push_back(Probe::subscribe(
+        paths_[i],
+        [this, i](const struct statvfs& stats, int error) { handleProbe(i, stats, error); }));
+  }
+
+#if defined(__linux__)
+  // The kernel flags the mount table changes with POLLPRI (and POLLERR) on mountinfo
+  mountinfo_.emplace("/proc/self/mountinfo");
+  mount_events_.reset(open("/proc/self/mountinfo", O_RDONLY | O_CLOEXEC));
+  if (mount_events_ != -1) {
+    mount_watch_ = Glib::signal_io().connect(sigc::mem_fun(*this, &Disk::handleMountsChanged),
+                                             mount_events_, Glib::IO_PRI | Glib::IO_ERR);
+  }
+#endif
+
+  timer_.start([this] { sample(); }, interval_);
+}
+
+waybar::modules::Disk::~Disk() {
+  mount_watch_.disconnect();
+  timer_.stop();
+  for (const auto& [probe, id] : probes_) {
+    probe->unsubscribe(id);
+  }
+}
+
+bool waybar::modules::Disk::handleMountsChanged(Glib::IOCondition /*condition*/) {
+  // poll() itself acknowledges the change, nothing to read
+  mounts_changed_.store(true, std::memory_order_relaxed);
+  timer_.wake_up();
+  return true;
+}
+
+void waybar::modules::Disk::updateMounts() {
+  if (!mountinfo_) {
+    return;
+  }
+  std::vector<MountEntry> mounts;
+  try {
+    mounts = parseMountinfo(mountinfo_->read());
+  } catch (const std::exception& e) {
+    spdlog::warn("Disk: {}", e.what());
+    return;
+  }
+  std::lock_guard lock(mutex_);
+  for (size_t i = 0; i < paths_.size(); ++i) {
+    const auto* mount = findMount(mounts, paths_[i]);
+    samples_[i].device = mount != nullptr ? mount->source : "";
+    samples_[i].fstype = mount != nullptr ? mount->fstype : "";
+  }
+}
+
+void waybar::modules::Disk::sample() {
+  bool changed = false;
+  // Results from before the mount table changed may be of another filesystem
+  auto max_age = interval_ / 2;
+  if (mounts_changed_.exchange(false, std::memory_order_relaxed)) {
+    updateMounts();
+    changed = true;
+    max_age = std::chrono::milliseconds::zero();
+  }
+
+  // A probe still busy since an earlier request is stale once it ran out of time, it is never
+  // waited for here
+  for (size_t i = 0; i < probes_.size(); ++i) {
+    if (probes_[i].probe->request(max_age) <= timeout_) {
+      continue;
+    }
+    std::lock_guard lock(mutex_);
+    auto& sample = samples_[i];
+    if (sample.state != Sample::State::STALE) {
+      spdlog::warn("Disk: statvfs of '{}' timed out, the mount is stale", paths_[i]);
+      sample.state = Sample::State::STALE;
+      changed = true;
+    }
+  }
+  if (changed) {
+    dp.emit();
+  }
+}
+
+void waybar::modules::Disk::handleProbe(size_t index, const struct statvfs& stats, int error) {
+  {
+    std::lock_guard lock(mutex_);
+    auto& sample = samples_[index];
+    if (error != 0 || stats.f_blocks == 0) {
+      if (sample.state != Sample::State::FAILED) {
+        spdlog::warn("Disk: statvfs failed for path '{}' (errno={})", paths_[index], error);
+      }
+      sample.state = Sample::State::FAILED;
+    } else {
+      sample.state = Sample::State::OK;
+      sample.stats = stats;
+    }
+  }
+  dp.emit();
 }
 
 auto waybar::modules::Disk::update() -> void {
+  std::lock_guard lock(mutex_);
   std::string tooltip_label;
   std::string label = header_;
 
   bool had_valid_disk = false;
+  bool had_stale_disk = false;
 
   for (size_t i = 0; i < paths_.size(); ++i) {
     const auto& path = paths_[i];
+    const auto& sample = samples_[i];
+
+    if (sample.state == Sample::State::STALE) {
+      // Nothing to show but that the mount doesn't answer
+      std::string stale_format = config_["format-stale"].isString()
+                                     ? config_["format-stale"].asString()
+                                     : "{path}: stale";
+      if (!stale_format.empty()) {
+        if (had_valid_disk || had_stale_disk) {
+          label += separator_;
+        }
+        label += fmt::format(fmt::runtime(stale_format), fmt::arg("path", path),
+                             fmt::arg("device", sample.device), fmt::arg("fstype", sample.fstype));
+      }
+      if (had_valid_disk || had_stale_disk) {
+        tooltip_label += "\n";
+      }
+      tooltip_label += fmt::format("{} is not responding", path);
+      had_stale_disk = true;
+      continue;
+    }
+    if (sample.state != Sample::State::OK) {
+      continue;
+    }
 
-    struct statvfs /* {
+    const struct statvfs /* {
         unsigned long  f_bsize;    // filesystem block size
         unsigned long  f_frsize;   // fragment size
         fsblkcnt_t     f_blocks;   // size of fs in f_frsize units
@@ -55,9 +288,7 @@ auto waybar::modules::Disk::update() -> void {
         unsigned long  f_flag;     // mount flags
         unsigned long  f_namemax;  // maximum filename length
     }; */
-        stats;
-
-    int err = statvfs(path.c_str(), &stats);
+        & stats = sample.stats;
 
     /* Conky options
       fs_bar - Bar that shows how much space is used
@@ -67,11 +298,6 @@ auto waybar::modules::Disk::update() -> void {
       fs_used - File system used space
     */
 
-    if (err != 0 || stats.f_blocks == 0) {
-      spdlog::warn("Disk: statvfs failed for path '{}' (errno={})", path, errno);
-      continue;
-    }
-
     float specific_free, specific_used, specific_total, divisor;
 
     divisor = calc_specific_divisor(unit_);
@@ -86,12 +312,12 @@ auto waybar::modules::Disk::update() -> void {
 
     std::string disk_format = format_;
     auto state = getState(percentage_used);
-    if (!state.empty() && config_["format-" + state].isString()) {
-      disk_format = config_["format-" + state].asString();
+    if (const auto* state_format = module_config_.string("format", state)) {
+      disk_format = *state_format;
     }
 
     if (!disk_format.empty()) {
-      if (had_valid_disk) {
+      if (had_valid_disk || had_stale_disk) {
         label += separator_;
       }
 
@@ -99,7 +325,8 @@ auto waybar::modules::Disk::update() -> void {
           fmt::runtime(disk_format), stats.f_bavail * 100 / stats.f_blocks, fmt::arg("free", free),
           fmt::arg("percentage_free", stats.f_bavail * 100 / stats.f_blocks),
           fmt::arg("used", used), fmt::arg("percentage_used", percentage_used),
-          fmt::arg("total", total), fmt::arg("path", path),
+          fmt::arg("total", total), fmt::arg("path", path), fmt::arg("device", sample.device),
+          fmt::arg("fstype", sample.fstype),
           fmt::arg("specific_free", specific_free), fmt::arg("specific_used", specific_used),
           fmt::arg("specific_total", specific_total));
     }
@@ -110,7 +337,7 @@ auto waybar::modules::Disk::update() -> void {
     }
 
     if (!tooltip_format.empty()) {
-      if (had_valid_disk) {
+      if (had_valid_disk || had_stale_disk) {
         tooltip_label += "\n";
       }
 
@@ -119,14 +346,20 @@ auto waybar::modules::Disk::update() -> void {
           fmt::arg("free", free),
           fmt::arg("percentage_free", stats.f_bavail * 100 / stats.f_blocks),
           fmt::arg("used", used), fmt::arg("percentage_used", percentage_used),
-          fmt::arg("total", total), fmt::arg("path", path),
+          fmt::arg("total", total), fmt::arg("path", path), fmt::arg("device", sample.device),
+          fmt::arg("fstype", sample.fstype),
           fmt::arg("specific_free", specific_free), fmt::arg("specific_used", specific_used),
           fmt::arg("specific_total", specific_total));
     }
 
     had_valid_disk = true;
   }
-  if (had_valid_disk) {
+  if (had_stale_disk) {
+    label_.get_style_context()->add_class("stale");
+  } else {
+    label_.get_style_context()->remove_class("stale");
+  }
+  if (had_valid_disk || had_stale_disk) {
     event_box_.show();
   } else {
     event_box_.hide();
@@ -27,10 +27,7 @@ waybar::modules::Gps::Gps(const std::string& id, const Json::Value& config)
       rfkill_{RFKILL_TYPE_GPS}
 #endif
 {
-  thread_ = [this] {
-    dp.emit();
-    thread_.sleep_for(interval_);
-  };
+  timer_.start([this] { dp.emit(); }, interval_);
 
   if (0 != gps_open("localhost", "2947", &gps_data_)) {
     throw std::runtime_error("Can't open gpsd socket");
@@ -49,7 +46,8 @@ waybar::modules::Gps::Gps(const std::string& id, const Json::Value& config)
     gps_stream(&gps_data_, WATCH_ENABLE, NULL);
     int last_gps_mode = 0;
 
-    while (gps_waiting(&gps_data_, 5000000)) {
+    // Data already buffered by libgps doesn't show up on the socket
+    while (gps_waiting(&gps_data_, 0) || gps_thread_.waitReadable(gps_data_.gps_fd, 5000)) {
       if (gps_read(&gps_data_, NULL, 0) == -1) {
         throw std::runtime_error("Can't read data from gpsd.");
       }
@@ -181,6 +179,7 @@ auto waybar::modules::Gps::update() -> void {
 }
 
 waybar::modules::Gps::~Gps() {
+  gps_thread_.join();
   gps_stream(&gps_data_, WATCH_DISABLE, NULL);
   gps_close(&gps_data_);
 }
@@ -10,6 +10,7 @@
 #include <utility>
 
 #include "util/regex_collection.hpp"
+#include "util/startup_profile.hpp"
 #include "util/string.hpp"
 
 namespace waybar::modules::hyprland {
@@ -28,12 +29,36 @@ Workspaces::Workspaces(const std::string& id, const Bar& bar, const Json::Value&
   m_box.get_style_context()->add_class(MODULE_CLASS);
   event_box_.add(m_box);
 
-  setCurrentMonitorId();
-  init();
-  registerIpc();
+  if (barScroll()) {
+    auto& window = const_cast<Bar&>(m_bar).window;
+    window.add_events(Gdk::SCROLL_MASK | Gdk::SMOOTH_SCROLL_MASK);
+    m_scrollEventConnection_ =
+        window.signal_scroll_event().connect(sigc::mem_fun(*this, &Workspaces::handleScroll));
+  }
+
+  // The initial state takes a few round trips to Hyprland per bar, query it off the main thread
+  // so the bar can be shown meanwhile. Updates are held back until it is queued.
+  m_discovery.start([this] {
+    util::StartupProfile::Span span("hyprland/workspaces initial state on " +
+                                    m_bar.output->name);
+    try {
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        setCurrentMonitorId();
+        init();
+      }
+      m_initialized.store(true, std::memory_order_release);
+      dp.emit();
+      registerIpc();
+    } catch (const std::exception& e) {
+      spdlog::error("hyprland/workspaces: {}", e.what());
+    }
+  });
 }
 
 Workspaces::~Workspaces() {
+  // The initial query registers for IPC events, it must not run past this point
+  m_discovery.stop();
   if (m_scrollEventConnection_.connected()) {
     m_scrollEventConnection_.disconnect();
   }
@@ -52,17 +77,6 @@ void Workspaces::init() {
 
   initializeWorkspaces();
 
-  if (m_scrollEventConnection_.connected()) {
-    m_scrollEventConnection_.disconnect();
-  }
-
-  if (barScroll()) {
-    auto& window = const_cast<Bar&>(m_bar).window;
-    window.add_events(Gdk::SCROLL_MASK | Gdk::SMOOTH_SCROLL_MASK);
-    m_scrollEventConnection_ =
-        window.signal_scroll_event().connect(sigc::mem_fun(*this, &Workspaces::handleScroll));
-  }
-
   dp.emit();
 }
 
@@ -339,7 +353,7 @@ void Workspaces::onEvent(const std::string& ev) {
     }
   }
 
-  // Notify the main thread. dp (Glib::Dispatcher) is the only thread-safe way to
+  // Notify the main thread. dp is the only thread-safe way to
   // hand off to the GTK main loop; GLib timer state must never be touched from the
   // IPC listener thread. The debounce timer is owned entirely by the main-thread
   // update() path (see Workspaces::update).
@@ -1066,6 +1080,9 @@ void Workspaces::setUrgentWorkspace(std::string const& windowaddress) {
 }
 
 auto Workspaces::update() -> void {
+  if (!m_initialized.load(std::memory_order_acquire)) {
+    return;
+  }
   // Debounce rapid events (e.g. out-of-order create/destroy workspace events from
   // Hyprland) to prevent workspace button flicker. This runs on the GTK main thread
   // (invoked via the dp dispatcher), so arming/disconnecting the GLib timer here is
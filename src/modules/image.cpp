@@ -44,19 +44,21 @@ auto waybar::modules::Image::getStrategy(const std::string& id, const Json::Valu
 }
 
 void waybar::modules::Image::delayWorker() {
-  thread_ = [this] {
-    // Do the blocking work (e.g. running a user script) here on the worker
-    // thread; update() then only parses the result and draws on the main thread.
-    strategy_->fetch();
-    dp.emit();
-    thread_.sleep_for(interval_);
-  };
+  timer_.start(
+      [this] {
+        util::ModuleStats::Scope stats_scope(stats_.get(), &util::ModuleStats::sample_time);
+        // Do the blocking work (e.g. running a user script) here on the worker
+        // thread; update() then only parses the result and draws on the main thread.
+        strategy_->fetch();
+        dp.emit();
+      },
+      interval_);
 }
 
 void waybar::modules::Image::refresh(int sig) {
 #ifdef SIGRTMIN
   if (config_["signal"].isInt() && sig == SIGRTMIN + config_["signal"].asInt()) {
-    thread_.wake_up();
+    timer_.wake_up();
   }
 #endif
 }
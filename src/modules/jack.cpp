@@ -7,10 +7,7 @@ JACK::JACK(const std::string& id, const Json::Value& config)
   running_ = false;
   client_ = NULL;
 
-  thread_ = [this] {
-    dp.emit();
-    thread_.sleep_for(interval_);
-  };
+  timer_.start([this] { dp.emit(); }, interval_);
 }
 
 std::string JACK::JACKState() {
@@ -65,12 +62,8 @@ auto JACK::update() -> void {
   label_.get_style_context()->add_class(state);
   state_ = state;
 
-  if (config_["format-" + state].isString()) {
-    format = config_["format-" + state].asString();
-  } else if (config_["format"].isString()) {
-    format = config_["format"].asString();
-  } else
-    format = "{load}%";
+  static const std::string default_format = "{load}%";
+  format = resolveFormat(default_format, state);
 
   updateLabelAndTooltip(
       format, "{bufsize}/{samplerate} {latency}ms", fmt::arg("load", std::round(load_)),
@@ -6,6 +6,8 @@
 
 #include <filesystem>
 
+#include "util/scope_guard.hpp"
+
 extern "C" {
 #include <fcntl.h>
 #include <libinput.h>
@@ -208,9 +210,10 @@ waybar::modules::KeyboardState::KeyboardState(const std::string& id, const Bar&
 
   libinput_thread_ = [this] {
     dp.emit();
-    while (1) {
-      struct pollfd fd = {libinput_get_fd(libinput_), POLLIN, 0};
-      poll(&fd, 1, -1);
+    while (libinput_thread_.isRunning()) {
+      if (!libinput_thread_.waitReadable(libinput_get_fd(libinput_))) {
+        break;
+      }
       libinput_dispatch(libinput_);
       struct libinput_event* event;
       while ((event = libinput_get_event(libinput_))) {
@@ -237,8 +240,12 @@ waybar::modules::KeyboardState::KeyboardState(const std::string& id, const Bar&
       spdlog::error("Failed to initialize inotify: {}", strerror(errno));
       return;
     }
+    util::ScopeGuard fd_closer([fd] { close(fd); });
     inotify_add_watch(fd, devices_path_.c_str(), IN_CREATE | IN_DELETE);
-    while (1) {
+    while (hotplug_thread_.isRunning()) {
+      if (!hotplug_thread_.waitReadable(fd)) {
+        break;
+      }
       int BUF_LEN = 1024 * (sizeof(struct inotify_event) + 16);
       char buf[BUF_LEN];
       int length = read(fd, buf, 1024);
@@ -259,7 +266,7 @@ waybar::modules::KeyboardState::KeyboardState(const std::string& id, const Bar&
               break;
             } catch (const errno_error& e) {
               if (e.code == EACCES) {
-                sleep(1);
+                hotplug_thread_.sleep_for(std::chrono::seconds(1));
               }
             }
           }
@@ -287,6 +294,8 @@ waybar::modules::KeyboardState::KeyboardState(const std::string& id, const Bar&
 }
 
 waybar::modules::KeyboardState::~KeyboardState() {
+  libinput_thread_.join();
+  hotplug_thread_.join();
   std::lock_guard<std::mutex> lock(devices_mutex_);
   for (const auto& [_, dev_ptr] : libinput_devices_) {
     libinput_path_remove_device(dev_ptr);
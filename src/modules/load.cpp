@@ -11,10 +11,7 @@
 
 waybar::modules::Load::Load(const std::string& id, const Json::Value& config)
     : ALabel(config, "load", id, "{load1}", 10) {
-  thread_ = [this] {
-    dp.emit();
-    thread_.sleep_for(interval_);
-  };
+  timer_.start([this] { dp.emit(); }, interval_);
 }
 
 auto waybar::modules::Load::update() -> void {
@@ -26,8 +23,8 @@ auto waybar::modules::Load::update() -> void {
   }
   auto format = format_;
   auto state = getState(load1);
-  if (!state.empty() && config_["format-" + state].isString()) {
-    format = config_["format-" + state].asString();
+  if (const auto* state_format = module_config_.string("format", state)) {
+    format = *state_format;
   }
 
   if (format.empty()) {
@@ -79,7 +79,19 @@ static uint64_t get_free_memory() {
 #endif
 }
 
-void waybar::modules::Memory::parseMeminfo() {
-  meminfo_["MemTotal"] = get_total_memory() / 1024;
-  meminfo_["MemAvailable"] = get_free_memory() / 1024;
+auto waybar::modules::Memory::parseMeminfo(const std::string& /*path*/) -> Meminfo {
+  Meminfo meminfo;
+  meminfo.mem_total = get_total_memory() / 1024;
+  meminfo.mem_available = get_free_memory() / 1024;
+  meminfo.has_mem_available = true;
+  return meminfo;
+}
+
+// sysctl has no file to keep open, and there is no arcstats to read
+waybar::modules::Memory::MeminfoReader::MeminfoReader(const std::string& /*path*/, bool /*zfs*/)
+    : meminfo_("") {}
+
+auto waybar::modules::Memory::MeminfoReader::read() -> const Meminfo& {
+  values_ = parseMeminfo();
+  return values_;
 }
@@ -1,4 +1,5 @@
 #include <cmath>
+#include <memory>
 
 #include "modules/memory.hpp"
 
@@ -13,10 +14,18 @@ const std::unordered_map<std::string, float> kUnits = {
 
 waybar::modules::Memory::Memory(const std::string& id, const Json::Value& config)
     : ALabel(config, "memory", id, "{}%", 30) {
-  thread_ = [this] {
-    dp.emit();
-    thread_.sleep_for(interval_);
-  };
+  // The ZFS ARC counts as available memory, which everything but the totals and the swap figures
+  // derive from: the states, the default format and tooltip, and the percentage, used and avail
+  // arguments. Without them the arcstats file isn't scanned on every sample.
+  const bool zfs =
+      !module_config_.states(false).empty() || module_config_.string("format") == nullptr ||
+      (tooltipEnabled() && module_config_.string("tooltip-format") == nullptr) ||
+      module_config_.anyFormatUses(
+          [](const std::string& name) { return name != "total" && !name.starts_with("swap"); });
+  meminfo_ = util::SharedSampler<Meminfo>::subscribe(
+      fmt::format("meminfo{}@{}", zfs ? "+zfs" : "", interval_.count()), interval_,
+      [reader = std::make_shared<MeminfoReader>("/proc/meminfo", zfs)] { return reader->read(); },
+      [this] { dp.emit(); });
   if (config["unit"].isString()) {
     unit_ = config["unit"].asString();
     if (!kUnits.contains(unit_)) {
@@ -28,25 +37,20 @@ waybar::modules::Memory::Memory(const std::string& id, const Json::Value& config
 }
 
 auto waybar::modules::Memory::update() -> void {
-  parseMeminfo();
+  const auto sample = meminfo_.snapshot();
+  const Meminfo& meminfo = *sample;
 
-  unsigned long memtotal = meminfo_["MemTotal"];
-  unsigned long swaptotal = 0;
-  if (meminfo_.contains("SwapTotal")) {
-    swaptotal = meminfo_["SwapTotal"];
-  }
+  unsigned long memtotal = meminfo.mem_total;
+  unsigned long swaptotal = meminfo.swap_total;
   unsigned long memfree;
-  unsigned long swapfree = 0;
-  if (meminfo_.contains("SwapFree")) {
-    swapfree = meminfo_["SwapFree"];
-  }
-  if (meminfo_.contains("MemAvailable")) {
+  unsigned long swapfree = meminfo.swap_free;
+  if (meminfo.has_mem_available) {
     // New kernels (3.4+) have an accurate available memory field.
-    memfree = meminfo_["MemAvailable"] + meminfo_["zfs_size"];
+    memfree = meminfo.mem_available + meminfo.zfs_size;
   } else {
     // Old kernel; give a best-effort approximation of available memory.
-    memfree = meminfo_["MemFree"] + meminfo_["Buffers"] + meminfo_["Cached"] +
-              meminfo_["SReclaimable"] - meminfo_["Shmem"] + meminfo_["zfs_size"];
+    memfree = meminfo.mem_free + meminfo.buffers + meminfo.cached + meminfo.s_reclaimable -
+              meminfo.shmem + meminfo.zfs_size;
   }
 
   if (memtotal > 0 && memfree >= 0) {
@@ -69,8 +73,8 @@ auto waybar::modules::Memory::update() -> void {
 
     auto format = format_;
     auto state = getState(used_ram_percentage);
-    if (!state.empty() && config_["format-" + state].isString()) {
-      format = config_["format-" + state].asString();
+    if (const auto* state_format = module_config_.string("format", state)) {
+      format = *state_format;
     }
 
     if (format.empty()) {
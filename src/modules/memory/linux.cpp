@@ -1,43 +1,120 @@
+#include <algorithm>
+#include <array>
+
 #include "modules/memory.hpp"
 
-static unsigned zfsArcSize() {
-  std::ifstream zfs_arc_stats{"/proc/spl/kstat/zfs/arcstats"};
+namespace {
+
+using Meminfo = waybar::modules::Memory::Meminfo;
+
+struct Field {
+  std::string_view key;
+  unsigned long Meminfo::* value;
+};
 
-  if (zfs_arc_stats.is_open()) {
-    std::string name;
-    std::string type;
-    unsigned long data{0};
+constexpr std::array<Field, 9> FIELDS = {{
+    {"MemTotal", &Meminfo::mem_total},
+    {"MemFree", &Meminfo::mem_free},
+    {"MemAvailable", &Meminfo::mem_available},
+    {"Buffers", &Meminfo::buffers},
+    {"Cached", &Meminfo::cached},
+    {"SReclaimable", &Meminfo::s_reclaimable},
+    {"Shmem", &Meminfo::shmem},
+    {"SwapTotal", &Meminfo::swap_total},
+    {"SwapFree", &Meminfo::swap_free},
+}};
+
+// Perfect hash of the FIELDS keys, so that each of the ~50 lines costs a single comparison
+constexpr std::size_t TABLE_SIZE = 16;
+
+constexpr std::size_t slot(std::string_view key) {
+  return (key.size() + static_cast<unsigned char>(key.front()) +
+          static_cast<unsigned char>(key.back())) %
+         TABLE_SIZE;
+}
 
-    std::string line;
-    while (std::getline(zfs_arc_stats, line)) {
-      std::stringstream(line) >> name >> type >> data;
+constexpr auto TABLE = [] {
+  std::array<int, TABLE_SIZE> table{};
+  table.fill(-1);
+  for (std::size_t i = 0; i < FIELDS.size(); ++i) {
+    table[slot(FIELDS[i].key)] = static_cast<int>(i);
+  }
+  return table;
+}();
+
+static_assert(std::ranges::count(TABLE, -1) == TABLE_SIZE - FIELDS.size(),
+              "The meminfo keys collide, the hash needs adjusting");
+
+const Field* findField(std::string_view key) {
+  if (key.empty()) {
+    return nullptr;
+  }
+  const auto index = TABLE[slot(key)];
+  return index >= 0 && FIELDS[index].key == key ? &FIELDS[index] : nullptr;
+}
 
-      if (name == "size") {
+unsigned long zfsArcSize(waybar::util::ProcFile& arcstats) {
+  try {
+    auto text = arcstats.read();
+    while (!text.empty()) {
+      // name type data
+      auto line = waybar::util::nextLine(text);
+      if (!line.starts_with("size ")) {
+        continue;
+      }
+      line.remove_prefix(4);
+      unsigned long type = 0;
+      unsigned long data = 0;
+      if (waybar::util::scanUnsigned(line, type) && waybar::util::scanUnsigned(line, data)) {
         return data / 1024;  // convert to kB
       }
     }
+  } catch (const std::runtime_error&) {
   }
-
   return 0;
 }
 
-void waybar::modules::Memory::parseMeminfo() {
-  const std::string data_dir_ = "/proc/meminfo";
-  std::ifstream info(data_dir_);
-  if (!info.is_open()) {
-    throw std::runtime_error("Can't open " + data_dir_);
+}  // namespace
+
+waybar::modules::Memory::MeminfoReader::MeminfoReader(const std::string& path, bool zfs)
+    : meminfo_(path) {
+  if (zfs) {
+    arcstats_.emplace("/proc/spl/kstat/zfs/arcstats");
+    // No ZFS, the module isn't loaded later in practice
+    if (!arcstats_->isOpen()) {
+      arcstats_.reset();
+    }
   }
-  std::string line;
-  while (getline(info, line)) {
-    auto posDelim = line.find(':');
-    if (posDelim == std::string::npos) {
+}
+
+auto waybar::modules::Memory::MeminfoReader::read() -> const Meminfo& {
+  auto text = meminfo_.read();
+  values_ = {};
+  std::size_t found = 0;
+  while (!text.empty() && found < FIELDS.size()) {
+    // Key:     value kB
+    auto line = util::nextLine(text);
+    const auto delim = line.find(':');
+    if (delim == std::string_view::npos) {
+      continue;
+    }
+    const auto* field = findField(line.substr(0, delim));
+    if (field == nullptr) {
       continue;
     }
+    line.remove_prefix(delim + 1);
+    util::scanUnsigned(line, values_.*(field->value));
+    values_.has_mem_available = values_.has_mem_available || field->value == &Meminfo::mem_available;
+    found++;
+  }
 
-    std::string name = line.substr(0, posDelim);
-    int64_t value = std::stol(line.substr(posDelim + 1));
-    meminfo_[name] = value;
+  if (arcstats_) {
+    values_.zfs_size = zfsArcSize(*arcstats_);
   }
+  return values_;
+}
 
-  meminfo_["zfs_size"] = zfsArcSize();
+auto waybar::modules::Memory::parseMeminfo(const std::string& path) -> Meminfo {
+  MeminfoReader reader(path, true);
+  return reader.read();
 }
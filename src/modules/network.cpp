@@ -2,16 +2,16 @@
 
 #include <linux/if.h>
 #include <linux/if_link.h>
+#include <linux/rtnetlink.h>
 #include <netlink/netlink.h>
 #include <spdlog/spdlog.h>
-#include <sys/eventfd.h>
 
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 #include <filesystem>
 #include <fstream>
 #include <optional>
-#include <sstream>
 #include <string>
 #include <vector>
 
@@ -23,67 +23,30 @@
 namespace {
 using namespace waybar::util;
 constexpr const char* DEFAULT_FORMAT = "{ifname}";
-}  // namespace
-
-constexpr const char* NETDEV_FILE =
-    "/proc/net/dev";  // std::ifstream does not take std::string_view as param
-std::optional<std::pair<unsigned long long, unsigned long long>>
-waybar::modules::Network::readBandwidthUsage() {
-  std::ifstream netdev(NETDEV_FILE);
-  if (!netdev) {
-    spdlog::warn("Failed to open netdev file {}", NETDEV_FILE);
-    return {};
-  }
-
-  std::string line;
-  // skip the headers (first two lines)
-  std::getline(netdev, line);
-  std::getline(netdev, line);
-
-  unsigned long long receivedBytes = 0ull;
-  unsigned long long transmittedBytes = 0ull;
-  while (std::getline(netdev, line)) {
-    std::istringstream iss(line);
-
-    std::string ifacename;
-    iss >> ifacename;  // ifacename contains "eth0:"
-    if (ifacename.empty()) continue;
-    ifacename.pop_back();  // remove trailing ':'
-    if (ifacename != ifname_) {
-      continue;
-    }
-
-    // The rest of the line consists of whitespace separated counts divided
-    // into two groups (receive and transmit). Each group has the following
-    // columns: bytes, packets, errs, drop, fifo, frame, compressed, multicast
-    //
-    // We only care about the bytes count, so we'll just ignore the 7 other
-    // columns.
-    unsigned long long r = 0ull;
-    unsigned long long t = 0ull;
-    // Read received bytes
-    iss >> r;
-    // Skip all the other columns in the received group
-    for (int colsToSkip = 7; colsToSkip > 0; colsToSkip--) {
-      // skip whitespace between columns
-      while (iss.peek() == ' ') {
-        iss.ignore();
-      }
-      // skip the irrelevant column
-      while (iss.peek() != ' ') {
-        iss.ignore();
-      }
-    }
-    // Read transmit bytes
-    iss >> t;
+// Bitrates aren't pushed by nl80211 events, they are still polled at this pace
+constexpr std::chrono::seconds WIFI_POLL_INTERVAL{30};
+
+std::string netmask4(uint8_t prefixlen) {
+  struct in_addr netmask;
+  netmask.s_addr = prefixlen == 0 ? 0 : htonl(~0U << (32 - prefixlen));
+  char buffer[INET_ADDRSTRLEN];
+  return inet_ntop(AF_INET, &netmask, buffer, sizeof(buffer));
+}
 
-    receivedBytes += r;
-    transmittedBytes += t;
+std::string netmask6(uint8_t prefixlen) {
+  struct in6_addr netmask6;
+  for (int i = 0; i < 16; i++) {
+    int v = (i + 1) * 8 - prefixlen;
+    if (v < 0) v = 0;
+    if (v > 8) v = 8;
+    netmask6.s6_addr[i] = ~0 << v;
   }
-
-  return {{receivedBytes, transmittedBytes}};
+  char buffer[INET6_ADDRSTRLEN];
+  return inet_ntop(AF_INET6, &netmask6, buffer, sizeof(buffer));
 }
 
+}  // namespace
+
 uint32_t waybar::modules::Network::readLinkSpeed() const {
   auto path = fmt::format("/sys/class/net/{}/speed", ifname_);
   std::ifstream sysfs_speed(path);
@@ -116,206 +79,71 @@ waybar::modules::Network::Network(const std::string& id, const Json::Value& conf
     addr_pref_ = IPV4_6;
   }
 
-  auto bandwidth = readBandwidthUsage();
-  if (bandwidth.has_value()) {
-    bandwidth_down_total_ = (*bandwidth).first;
-    bandwidth_up_total_ = (*bandwidth).second;
-  } else {
-    bandwidth_down_total_ = 0;
-    bandwidth_up_total_ = 0;
-  }
-  bandwidth_last_sample_time_ = std::chrono::steady_clock::now();
-
-  if (!config_["interface"].isString()) {
-    // "interface" isn't configured, then try to guess the external
-    // interface currently used for internet.
-    want_route_dump_ = true;
-  } else {
-    // Look for an interface that match "interface"
-    // and then find the address associated with it.
-    want_link_dump_ = true;
-    want_addr_dump_ = true;
-  }
-
-  createEventSocket();
-  createInfoSocket();
-
-  // Ask for a dump of interfaces and then addresses to populate our
-  // information. First the interface dump, and once done, the callback
-  // will be called again which will ask for addresses dump.
-  askForStateDump();
+  // Without "interface", follow the interface of the default route to the outside world,
+  // otherwise look for an interface that matches "interface". Either way, its addresses follow.
+  // The netlink monitor may notify us as soon as we are subscribed, hold the lock until the
+  // subscription is stored.
+  std::lock_guard<std::mutex> lock(mutex_);
+  netlink_ = util::NetlinkMonitor::subscribe(
+      !config_["interface"].isString(), [this](const util::NetlinkNotification& notification) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (notification.state) {
+          netlink_->read([this](const auto& state) { updateFromNetlink(state); });
+        }
+        if (notification.signal_dbm.has_value() && carrier_) {
+          setSignal(*notification.signal_dbm);
+          dp.emit();
+        }
+        if (notification.wireless) {
+          // Association, roaming or new scan results: query the BSS again
+          wifi_refresh_ = true;
+          timer_.wake_up();
+        }
+      });
+  netlink_->read([this](const auto& state) { updateFromNetlink(state); });
   worker();
 }
 
 waybar::modules::Network::~Network() {
-  if (ev_fd_ > -1) {
-    close(ev_fd_);
-  }
-  if (efd_ > -1) {
-    close(efd_);
-  }
-  if (ev_sock_ != nullptr) {
-    nl_socket_drop_memberships(ev_sock_, RTNLGRP_LINK, RTNLGRP_IPV4_IFADDR, RTNLGRP_IPV6_IFADDR);
-    nl_close(ev_sock_);
-    nl_socket_free(ev_sock_);
-  }
-  if (sock_ != nullptr) {
-    nl_close(sock_);
-    nl_socket_free(sock_);
-  }
-  if (station_sock_ != nullptr) {
-    nl_close(station_sock_);
-    nl_socket_free(station_sock_);
-  }
-}
-
-void waybar::modules::Network::createEventSocket() {
-  ev_sock_ = nl_socket_alloc();
-  nl_socket_disable_seq_check(ev_sock_);
-  nl_socket_modify_cb(ev_sock_, NL_CB_VALID, NL_CB_CUSTOM, handleEvents, this);
-  nl_socket_modify_cb(ev_sock_, NL_CB_FINISH, NL_CB_CUSTOM, handleEventsDone, this);
-  auto groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR;
-  nl_join_groups(ev_sock_, groups);  // Deprecated
-  if (nl_connect(ev_sock_, NETLINK_ROUTE) != 0) {
-    throw std::runtime_error("Can't connect network socket");
-  }
-  if (nl_socket_set_nonblocking(ev_sock_)) {
-    throw std::runtime_error("Can't set non-blocking on network socket");
-  }
-  // Enlarge the socket receive buffer so that a burst of link/address/route
-  // change notifications (e.g. a router reboot or a PPPoE redial) is less likely
-  // to overflow it and make the kernel drop messages (ENOBUFS). Overruns are
-  // still handled in worker() by resynchronising the state, but a larger buffer
-  // avoids most of them. The kernel caps the request at net.core.rmem_max.
-  nl_socket_set_buffer_size(ev_sock_, 1024 * 1024, 0);
-  nl_socket_add_memberships(ev_sock_, RTNLGRP_LINK, RTNLGRP_IPV4_IFADDR, RTNLGRP_IPV6_IFADDR, 0);
-  if (!config_["interface"].isString()) {
-    nl_socket_add_memberships(ev_sock_, RTNLGRP_IPV4_ROUTE, RTNLGRP_IPV6_ROUTE, 0);
-  }
-
-  efd_ = epoll_create1(EPOLL_CLOEXEC);
-  if (efd_ < 0) {
-    throw std::runtime_error("Can't create epoll");
-  }
-  {
-    ev_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
-    struct epoll_event event;
-    memset(&event, 0, sizeof(event));
-    event.events = EPOLLIN | EPOLLET;
-    event.data.fd = ev_fd_;
-    if (epoll_ctl(efd_, EPOLL_CTL_ADD, ev_fd_, &event) == -1) {
-      throw std::runtime_error("Can't add epoll event");
-    }
-  }
-  {
-    auto fd = nl_socket_get_fd(ev_sock_);
-    struct epoll_event event;
-    memset(&event, 0, sizeof(event));
-    event.events = EPOLLIN | EPOLLET | EPOLLRDHUP;
-    event.data.fd = fd;
-    if (epoll_ctl(efd_, EPOLL_CTL_ADD, fd, &event) == -1) {
-      throw std::runtime_error("Can't add epoll event");
-    }
-  }
-}
-
-void waybar::modules::Network::createInfoSocket() {
-  sock_ = nl_socket_alloc();
-  if (genl_connect(sock_) != 0) {
-    throw std::runtime_error("Can't connect to netlink socket");
-  }
-  if (nl_socket_modify_cb(sock_, NL_CB_VALID, NL_CB_CUSTOM, handleScan, this) < 0) {
-    throw std::runtime_error("Can't set callback");
-  }
-  nl80211_id_ = genl_ctrl_resolve(sock_, "nl80211");
-  if (nl80211_id_ < 0) {
-    spdlog::warn("Can't resolve nl80211 interface");
-  }
-
-  // Create and configure the station_sock_ for NL80211_CMD_GET_STATION
-  station_sock_ = nl_socket_alloc();
-  if (genl_connect(station_sock_) != 0) {
-    throw std::runtime_error("Can't connect to station netlink socket");
-  }
-  if (nl_socket_modify_cb(station_sock_, NL_CB_VALID, NL_CB_CUSTOM, handleStationGet, this) < 0) {
-    throw std::runtime_error("Can't set station callback");
-  }
-  // nl80211_id_ is already resolved from the sock_ setup
+  // The timer job uses the netlink monitor, stop it before unsubscribing, which waits for a
+  // notification in progress
+  timer_.stop();
+  netlink_.reset();
 }
 
 void waybar::modules::Network::worker() {
   // update via here not working
-  thread_timer_ = [this] {
-    {
-      std::lock_guard<std::mutex> lock(mutex_);
-      if (ifid_ > 0) {
-        getInfo();
-      }
-      dp.emit();
-    }
-    thread_timer_.sleep_for(interval_);
-  };
+  timer_.start(
+      [this] {
+        util::ModuleStats::Scope stats_scope(stats_.get(), &util::ModuleStats::sample_time);
+        std::lock_guard<std::mutex> lock(mutex_);
+        const auto now = std::chrono::steady_clock::now();
+        // Without nl80211 events, the wireless state is polled at every interval. With them,
+        // only the bitrates still need a slow poll.
+        if (ifid_ > 0 && (wifi_refresh_ || !netlink_->nl80211Events() ||
+                          now - wifi_last_refresh_ >= std::max<std::chrono::milliseconds>(
+                                                         interval_, WIFI_POLL_INTERVAL))) {
+          getInfo();
+          wifi_refresh_ = false;
+          wifi_last_refresh_ = now;
+        }
+        link_sample_ = netlink_->linkStats(ifid_, ifname_).value_or(util::LinkCounters{});
+        link_sample_time_ = now;
+        dp.emit();
+      },
+      interval_);
 #ifdef WANT_RFKILL
   rfkill_.on_update.connect([this](auto&) {
-    /* If we are here, it's likely that the network thread already holds the mutex and will be
-     * holding it for a next few seconds.
-     * Let's delegate the update to the timer thread instead of blocking the main thread.
+    /* Called on the main loop. mutex_ is held by the timer job while it queries nl80211 and the
+     * link counters, and by the netlink monitor thread while it applies a notification, so it
+     * isn't taken here: the timer job runs right away and emits, and update() reads the new
+     * rfkill state.
      */
-    thread_timer_.wake_up();
+    timer_.wake_up();
   });
 #else
   spdlog::warn("Waybar has been built without rfkill support.");
 #endif
-  thread_ = [this] {
-    std::array<struct epoll_event, EPOLL_MAX> events{};
-
-    int ec = epoll_wait(efd_, events.data(), EPOLL_MAX, -1);
-    if (ec > 0) {
-      for (auto i = 0; i < ec; i++) {
-        if (events[i].data.fd == nl_socket_get_fd(ev_sock_)) {
-          int rc = 0;
-          // Read as many message as possible, until the socket blocks
-          while (true) {
-            errno = 0;
-            rc = nl_recvmsgs_default(ev_sock_);
-            if (rc == -NLE_AGAIN || errno == EAGAIN) {
-              rc = 0;
-              break;
-            }
-            if (rc == -NLE_NOMEM || errno == ENOBUFS) {
-              // The kernel dropped multicast notifications because our receive
-              // buffer overflowed. This happens during a burst of
-              // link/address/route changes such as a router reboot or a PPPoE
-              // redial. We have lost track of the current state -- in
-              // particular the RTM_NEWADDR carrying the interface's new IP
-              // address may have been dropped -- so request a fresh dump to
-              // resynchronise. Without this the address (cleared by the
-              // preceding RTM_DELADDR) would stay blank until Waybar is
-              // restarted, because nothing else re-queries it (#5122).
-              spdlog::warn("network: netlink receive buffer overrun, resyncing state");
-              want_link_dump_ = true;
-              want_addr_dump_ = true;
-              if (!config_["interface"].isString()) {
-                want_route_dump_ = true;
-              }
-              askForStateDump();
-              // Keep draining; the next recv proceeds normally now that the
-              // overrun has been reported.
-              continue;
-            }
-          }
-          if (rc < 0) {
-            spdlog::error("nl_recvmsgs_default error: {}", nl_geterror(-rc));
-            thread_.stop();
-            break;
-          }
-        } else {
-          thread_.stop();
-          break;
-        }
-      }
-    }
-  };
 }
 
 bool waybar::modules::Network::isWireless() const {
@@ -357,41 +185,35 @@ const std::string waybar::modules::Network::getNetworkState() const {
 auto waybar::modules::Network::update() -> void {
   std::lock_guard<std::mutex> lock(mutex_);
   std::string tooltip_format;
-  auto now = std::chrono::steady_clock::now();
-  auto elapsed_seconds = std::chrono::duration<double>(now - bandwidth_last_sample_time_).count();
-
-  auto bandwidth_down = 0ull;
-  auto bandwidth_up = 0ull;
-
-  // Only recalculate bandwidth when enough time has elapsed since the last
-  // sample.  Event-driven dp.emit() calls (link/addr/route changes) can
-  // trigger update() between timer intervals, which would consume the byte
-  // delta prematurely and show near-zero bandwidth.
-  auto min_elapsed = std::chrono::duration<double>(interval_).count() * 0.5;
-  if (elapsed_seconds >= min_elapsed) {
-    if (elapsed_seconds <= 0.0) {
-      elapsed_seconds = std::chrono::duration<double>(interval_).count();
+  auto elapsed_seconds = std::chrono::duration<double>(interval_).count();
+
+  auto bandwidth_down = bandwidth_down_prev_;
+  auto bandwidth_up = bandwidth_up_prev_;
+
+  // Only consume each link sample once. Event-driven dp.emit() calls
+  // (link/addr/route changes) can trigger update() between samples, which
+  // would otherwise consume the byte delta prematurely and show near-zero
+  // bandwidth.
+  if (link_sample_time_ != bandwidth_last_sample_time_) {
+    auto sample_elapsed =
+        std::chrono::duration<double>(link_sample_time_ - bandwidth_last_sample_time_).count();
+    if (sample_elapsed > 0.0 &&
+        bandwidth_last_sample_time_ != std::chrono::steady_clock::time_point{}) {
+      elapsed_seconds = sample_elapsed;
     }
-    bandwidth_last_sample_time_ = now;
+    bandwidth_last_sample_time_ = link_sample_time_;
 
-    auto bandwidth = readBandwidthUsage();
-    if (bandwidth.has_value()) {
-      auto down_octets = (*bandwidth).first;
-      auto up_octets = (*bandwidth).second;
+    unsigned long long down_octets = link_sample_.rx_bytes;
+    unsigned long long up_octets = link_sample_.tx_bytes;
 
-      bandwidth_down = down_octets - bandwidth_down_total_;
-      bandwidth_down_total_ = down_octets;
+    bandwidth_down = down_octets - bandwidth_down_total_;
+    bandwidth_down_total_ = down_octets;
 
-      bandwidth_up = up_octets - bandwidth_up_total_;
-      bandwidth_up_total_ = up_octets;
+    bandwidth_up = up_octets - bandwidth_up_total_;
+    bandwidth_up_total_ = up_octets;
 
-      bandwidth_down_prev_ = bandwidth_down;
-      bandwidth_up_prev_ = bandwidth_up;
-    }
-  } else {
-    bandwidth_down = bandwidth_down_prev_;
-    bandwidth_up = bandwidth_up_prev_;
-    elapsed_seconds = std::chrono::duration<double>(interval_).count();
+    bandwidth_down_prev_ = bandwidth_down;
+    bandwidth_up_prev_ = bandwidth_up;
   }
 
   link_speed_ = readLinkSpeed();
@@ -402,20 +224,15 @@ auto waybar::modules::Network::update() -> void {
     if (!state_.empty() && label_.get_style_context()->has_class(state_)) {
       label_.get_style_context()->remove_class(state_);
     }
-    if (!threshold_state.empty() && config_["format-" + state + "-" + threshold_state].isString()) {
-      default_format_ = config_["format-" + state + "-" + threshold_state].asString();
-    } else if (config_["format-" + state].isString()) {
-      default_format_ = config_["format-" + state].asString();
-    } else if (config_["format"].isString()) {
-      default_format_ = config_["format"].asString();
+    if (const auto* threshold_format = module_config_.string("format", state, threshold_state)) {
+      default_format_ = *threshold_format;
     } else {
-      default_format_ = DEFAULT_FORMAT;
+      default_format_ = resolveFormat(DEFAULT_FORMAT, state);
     }
-    if (!threshold_state.empty() &&
-        config_["tooltip-format-" + state + "-" + threshold_state].isString()) {
-      tooltip_format = config_["tooltip-format-" + state + "-" + threshold_state].asString();
-    } else if (config_["tooltip-format-" + state].isString()) {
-      tooltip_format = config_["tooltip-format-" + state].asString();
+    if (const auto* state_tooltip = util::ModuleConfig::first(
+            {module_config_.string("tooltip-format", state, threshold_state),
+             module_config_.string("tooltip-format", state)})) {
+      tooltip_format = *state_tooltip;
     }
     if (!label_.get_style_context()->has_class(state)) {
       label_.get_style_context()->add_class(state);
@@ -584,382 +401,160 @@ void waybar::modules::Network::clearIface() {
   tx_bitrate_ = 0;
 }
 
-int waybar::modules::Network::handleEvents(struct nl_msg* msg, void* data) {
-  auto net = static_cast<waybar::modules::Network*>(data);
-  std::lock_guard<std::mutex> lock(net->mutex_);
-  auto nh = nlmsg_hdr(msg);
-  bool is_del_event = false;
-
-  switch (nh->nlmsg_type) {
-    case RTM_DELLINK:
-      is_del_event = true;
-    case RTM_NEWLINK: {
-      struct ifinfomsg* ifi = static_cast<struct ifinfomsg*>(NLMSG_DATA(nh));
-      struct nlattr* attrs[IFLA_MAX + 1];
-      std::string ifname;
-      std::vector<std::string> altnames;
-      std::optional<bool> carrier;
-
-      if (nlmsg_parse(nh, sizeof(*ifi), attrs, IFLA_MAX, nullptr) < 0) {
-        spdlog::error("network: failed to parse netlink attributes");
-        return NL_SKIP;
-      }
-
-      if (net->ifid_ != -1 && ifi->ifi_index != net->ifid_) {
-        return NL_OK;
-      }
-
-      // Check if the interface goes "down" and if we want to detect the
-      // external interface.
-      if (net->ifid_ != -1 && !(ifi->ifi_flags & IFF_UP) && !net->config_["interface"].isString()) {
-        // The current interface is now down, all the routes associated with
-        // it have been deleted, so start looking for a new default route.
-        spdlog::debug("network: if{} down", net->ifid_);
-        net->clearIface();
-        net->dp.emit();
-        net->want_route_dump_ = true;
-        net->askForStateDump();
-        return NL_OK;
-      }
-
-      if (attrs[IFLA_IFNAME] != nullptr) {
-        const char* ifname_ptr = nla_get_string(attrs[IFLA_IFNAME]);
-        size_t ifname_len = nla_len(attrs[IFLA_IFNAME]) - 1;  // minus \0
-        ifname = std::string(ifname_ptr, ifname_len);
-      }
-
-      if (attrs[IFLA_CARRIER] != nullptr) {
-        carrier = nla_get_u8(attrs[IFLA_CARRIER]) == 1;
-      }
-
-      if (attrs[IFLA_PROP_LIST] != nullptr) {
-        struct nlattr* prop;
-        int rem;
-
-        nla_for_each_nested(prop, attrs[IFLA_PROP_LIST], rem) {
-          if (nla_type(prop) == IFLA_ALT_IFNAME) {
-            const char* altname_ptr = nla_get_string(prop);
-            size_t altname_len = nla_len(prop) - 1;  // minus \0
-            altnames.emplace_back(altname_ptr, altname_len);
-          }
-        }
-      }
+const waybar::util::NetlinkRoute* waybar::modules::Network::findDefaultRoute(
+    const util::NetlinkState& state, int oif) const {
+  // The route with the lowest metric wins, the current one is kept on a tie
+  const util::NetlinkRoute* best = nullptr;
+  for (const auto& route : state.routes()) {
+    if (oif != -1 && route.oif != oif) {
+      continue;
+    }
+    if (best == nullptr || route.priority < best->priority ||
+        (route.priority == best->priority && route.oif == ifid_)) {
+      best = &route;
+    }
+  }
+  return best;
+}
 
-      if (!is_del_event && ifi->ifi_index == net->ifid_) {
-        // Update interface information
-        if (net->ifname_.empty() && !ifname.empty()) {
-          net->ifname_ = ifname;
-        }
-        if (carrier.has_value()) {
-          if (net->carrier_ != *carrier) {
-            if (*carrier) {
-              // Ask for WiFi information
-              net->thread_timer_.wake_up();
-            } else {
-              // clear state related to WiFi connection
-              net->essid_.clear();
-              net->bssid_.clear();
-              net->signal_strength_dbm_ = 0;
-              net->signal_strength_ = 0;
-              net->signal_strength_app_.clear();
-              net->frequency_ = 0.0;
-            }
-          }
-          net->carrier_ = carrier.value();
-        }
-      } else if (!is_del_event && net->ifid_ == -1) {
-        // Checking if it's an interface we care about.
+void waybar::modules::Network::updateFromNetlink(const util::NetlinkState& state) {
+  const util::NetlinkLink* link = nullptr;
+  const util::NetlinkRoute* route = nullptr;
+  if (config_["interface"].isString()) {
+    if (auto it = state.links().find(ifid_); it != state.links().end()) {
+      link = &it->second;
+    } else {
+      // Checking if there is an interface we care about.
+      for (const auto& [index, candidate] : state.links()) {
         std::string matched;
-        if (net->matchInterface(ifname, altnames, matched)) {
-          if (ifname == matched) {
-            spdlog::debug("network: selecting new interface {}/{}", ifname, ifi->ifi_index);
-          } else {
-            spdlog::debug("network: selecting new interface {}/{} (matched altname {})", ifname,
-                          ifi->ifi_index, matched);
-          }
-
-          net->ifname_ = ifname;
-          net->ifid_ = ifi->ifi_index;
-          if ((ifi->ifi_flags & IFF_POINTOPOINT) != 0) {
-            net->is_p2p_ = true;
-          }
-          if ((ifi->ifi_flags & IFF_UP) == 0) {
-            // With some network drivers (e.g. mt7921e), the interface may
-            // report having a carrier even though interface is down.
-            carrier = false;
-          }
-          if (carrier.has_value()) {
-            net->carrier_ = carrier.value();
-          }
-          net->thread_timer_.wake_up();
-          /* An address for this new interface should be received via an
-           * RTM_NEWADDR event either because we ask for a dump of both links
-           * and addrs, or because this interface has just been created and
-           * the addr will be sent after the RTM_NEWLINK event.
-           * So we don't need to do anything. */
+        if (!matchInterface(candidate.ifname, candidate.altnames, matched)) {
+          continue;
         }
-      } else if (is_del_event && net->ifid_ >= 0) {
-        // Our interface has been deleted, start looking/waiting for one we care.
-        spdlog::debug("network: interface {}/{} deleted", net->ifname_, net->ifid_);
-
-        net->clearIface();
-        net->dp.emit();
+        if (candidate.ifname == matched) {
+          spdlog::debug("network: selecting new interface {}/{}", candidate.ifname, index);
+        } else {
+          spdlog::debug("network: selecting new interface {}/{} (matched altname {})",
+                        candidate.ifname, index, matched);
+        }
+        link = &candidate;
+        break;
       }
-      break;
     }
-
-    case RTM_DELADDR:
-      is_del_event = true;
-    case RTM_NEWADDR: {
-      struct ifaddrmsg* ifa = static_cast<struct ifaddrmsg*>(NLMSG_DATA(nh));
-      ssize_t attrlen = IFA_PAYLOAD(nh);
-      struct rtattr* ifa_rta = IFA_RTA(ifa);
-
-      if ((int)ifa->ifa_index != net->ifid_) {
-        return NL_OK;
-      }
-
-      // We ignore address mark as scope for the link or host,
-      // which should leave scope global addresses.
-      if (ifa->ifa_scope >= RT_SCOPE_LINK) {
-        return NL_OK;
-      }
-      for (; RTA_OK(ifa_rta, attrlen); ifa_rta = RTA_NEXT(ifa_rta, attrlen)) {
-        switch (ifa_rta->rta_type) {
-          case IFA_ADDRESS:
-            if (net->is_p2p_) continue;
-          case IFA_LOCAL:
-            char ipaddr[INET6_ADDRSTRLEN];
-            if (!is_del_event) {
-              bool addr_changed = false;
-              std::string changed_ipaddr;
-              int changed_cidr = 0;
-              if ((net->addr_pref_ == ip_addr_pref::IPV4 ||
-                   net->addr_pref_ == ip_addr_pref::IPV4_6) &&
-                  net->cidr_ == 0 && ifa->ifa_family == AF_INET) {
-                if (inet_ntop(ifa->ifa_family, RTA_DATA(ifa_rta), ipaddr, sizeof(ipaddr)) !=
-                    nullptr) {
-                  net->ipaddr_ = ipaddr;
-                  net->cidr_ = ifa->ifa_prefixlen;
-                  addr_changed = true;
-                  changed_ipaddr = net->ipaddr_;
-                  changed_cidr = net->cidr_;
-                }
-              } else if ((net->addr_pref_ == ip_addr_pref::IPV6 ||
-                          net->addr_pref_ == ip_addr_pref::IPV4_6) &&
-                         net->cidr6_ == 0 && ifa->ifa_family == AF_INET6) {
-                if (inet_ntop(ifa->ifa_family, RTA_DATA(ifa_rta), ipaddr, sizeof(ipaddr)) !=
-                    nullptr) {
-                  net->ipaddr6_ = ipaddr;
-                  net->cidr6_ = ifa->ifa_prefixlen;
-                  addr_changed = true;
-                  changed_ipaddr = net->ipaddr6_;
-                  changed_cidr = net->cidr6_;
-                }
-              }
-
-              switch (ifa->ifa_family) {
-                case AF_INET: {
-                  struct in_addr netmask;
-                  netmask.s_addr = htonl(~0 << (32 - ifa->ifa_prefixlen));
-                  net->netmask_ = inet_ntop(ifa->ifa_family, &netmask, ipaddr, sizeof(ipaddr));
-                }
-                case AF_INET6: {
-                  struct in6_addr netmask6;
-                  for (int i = 0; i < 16; i++) {
-                    int v = (i + 1) * 8 - ifa->ifa_prefixlen;
-                    if (v < 0) v = 0;
-                    if (v > 8) v = 8;
-                    netmask6.s6_addr[i] = ~0 << v;
-                  }
-                  net->netmask6_ = inet_ntop(ifa->ifa_family, &netmask6, ipaddr, sizeof(ipaddr));
-                }
-              }
-              if (addr_changed) {
-                spdlog::debug("network: {}, new addr {}/{}", net->ifname_, changed_ipaddr,
-                              changed_cidr);
-              }
-            } else {
-              if (ifa->ifa_family == AF_INET) {
-                net->ipaddr_.clear();
-                net->cidr_ = 0;
-                net->netmask_.clear();
-              } else if (ifa->ifa_family == AF_INET6) {
-                net->ipaddr6_.clear();
-                net->cidr6_ = 0;
-                net->netmask6_.clear();
-              }
-              spdlog::debug("network: {} addr deleted {}/{}", net->ifname_,
-                            inet_ntop(ifa->ifa_family, RTA_DATA(ifa_rta), ipaddr, sizeof(ipaddr)),
-                            ifa->ifa_prefixlen);
-            }
-            net->dp.emit();
-            break;
-        }
+    if (link != nullptr) {
+      route = findDefaultRoute(state, link->index);
+    }
+  } else {
+    // Find the interface used to reach the outside world. When it goes down, its routes are
+    // deleted and another default route is picked.
+    route = findDefaultRoute(state, -1);
+    if (route != nullptr) {
+      auto it = state.links().find(route->oif);
+      if (it != state.links().end() && (it->second.flags & IFF_UP) != 0) {
+        link = &it->second;
       }
-      break;
     }
+  }
 
-    case RTM_DELROUTE:
-      is_del_event = true;
-    case RTM_NEWROUTE: {
-      // Based on https://gist.github.com/Yawning/c70d804d4b8ae78cc698
-      // to find the interface used to reach the outside world
-
-      struct rtmsg* rtm = static_cast<struct rtmsg*>(NLMSG_DATA(nh));
-      int family = rtm->rtm_family;
-      ssize_t attrlen = RTM_PAYLOAD(nh);
-      struct rtattr* attr = RTM_RTA(rtm);
-      char gateway_addr[INET6_ADDRSTRLEN];
-      bool has_gateway = false;
-      bool has_destination = false;
-      int temp_idx = -1;
-      uint32_t priority = 0;
-
-      /* Find the message(s) concerting the main routing table, each message
-       * corresponds to a single routing table entry.
-       */
-      if (rtm->rtm_table != RT_TABLE_MAIN) {
-        return NL_OK;
-      }
+  if (link == nullptr) {
+    if (ifid_ != -1) {
+      // Our interface is gone, start looking/waiting for one we care.
+      spdlog::debug("network: interface {}/{} lost", ifname_, ifid_);
+      clearIface();
+      netlink_.setInterface(-1);
+      dp.emit();
+    }
+    return;
+  }
 
-      /* Parse all the attributes for a single routing table entry. */
-      for (; RTA_OK(attr, attrlen); attr = RTA_NEXT(attr, attrlen)) {
-        /* Determine if this routing table entry corresponds to the default
-         * route by seeing if it has a gateway, and if a destination addr is
-         * set, that it is all 0s.
-         */
-        switch (attr->rta_type) {
-          case RTA_GATEWAY:
-            /* The gateway of the route.
-             *
-             * If someone ever needs to figure out the gateway address as well,
-             * it's here as the attribute payload.
-             */
-            inet_ntop(family, RTA_DATA(attr), gateway_addr, sizeof(gateway_addr));
-            has_gateway = true;
-            break;
-          case RTA_DST: {
-            /* The destination address.
-             * Should be either missing, or maybe all 0s.  Accept both.
-             */
-            auto* dest = (const unsigned char*)RTA_DATA(attr);
-            size_t dest_size = RTA_PAYLOAD(attr);
-            for (size_t i = 0; i < dest_size; ++i) {
-              if (dest[i] != 0) {
-                has_destination = true;
-                break;
-              }
-            }
-
-            if (rtm->rtm_dst_len != 0) {
-              // We have found a destination like 0.0.0.0/24, this is not a
-              // default gateway route.
-              has_destination = true;
-            }
-            break;
-          }
-          case RTA_OIF:
-            /* The output interface index. */
-            temp_idx = *static_cast<int*>(RTA_DATA(attr));
-            break;
-          case RTA_PRIORITY:
-            priority = *(uint32_t*)RTA_DATA(attr);
-            break;
-          default:
-            break;
-        }
-      }
+  auto carrier = link->carrier;
+  if (carrier.has_value() && (link->flags & IFF_UP) == 0) {
+    // With some network drivers (e.g. mt7921e), the interface may report having a carrier
+    // even though interface is down.
+    carrier = false;
+  }
+
+  if (link->index != ifid_) {
+    clearIface();
+    ifid_ = link->index;
+    is_p2p_ = (link->flags & IFF_POINTOPOINT) != 0;
+    netlink_.setInterface(ifid_);
+    // Ask for WiFi information
+    wifi_refresh_ = true;
+    timer_.wake_up();
+  } else if (carrier.has_value() && *carrier != carrier_) {
+    if (*carrier) {
+      // Ask for WiFi information
+      wifi_refresh_ = true;
+      timer_.wake_up();
+    } else {
+      // clear state related to WiFi connection
+      essid_.clear();
+      bssid_.clear();
+      signal_strength_dbm_ = 0;
+      signal_strength_ = 0;
+      signal_strength_app_.clear();
+      frequency_ = 0.0;
+    }
+  }
+  ifname_ = link->ifname;
+  if (carrier.has_value()) {
+    carrier_ = *carrier;
+  }
 
-      // Check if we have a default route.
-      if (has_gateway && !has_destination && temp_idx != -1) {
-        // Check if this is the first default route we see, or if this new
-        // route have a higher priority.
-        /** Module doesn`t update state, because RTA_GATEWAY call before enable new router and set
-        higher priority. Disable router -> RTA_GATEWAY -> up new router -> set higher priority added
-        checking route id
-        **/
-        if (!is_del_event && ((net->ifid_ == -1) || (priority < net->route_priority))) {
-          // Clear if's state for the case were there is a higher priority
-          // route on a different interface.
-          net->clearIface();
-          net->ifid_ = temp_idx;
-          net->route_priority = priority;
-          net->gwaddr_ = gateway_addr;
-          spdlog::debug("network: new default route via {} on if{} metric {}", gateway_addr,
-                        temp_idx, priority);
-
-          /* Ask ifname associated with temp_idx as well as carrier status */
-          struct ifinfomsg ifinfo_hdr = {
-              .ifi_family = AF_UNSPEC,
-              .ifi_index = temp_idx,
-          };
-          int err;
-          err = nl_send_simple(net->ev_sock_, RTM_GETLINK, NLM_F_REQUEST, &ifinfo_hdr,
-                               sizeof(ifinfo_hdr));
-          if (err < 0) {
-            spdlog::error("network: failed to ask link info: {}", err);
-            /* Ask for a dump of all links instead */
-            net->want_link_dump_ = true;
-          }
-
-          /* Also ask for the address. Asking for a addresses of a specific
-           * interface doesn't seems to work so ask for a dump of all
-           * addresses. */
-          net->want_addr_dump_ = true;
-          net->askForStateDump();
-          net->thread_timer_.wake_up();
-        } else if (is_del_event && temp_idx == net->ifid_ && net->route_priority == priority) {
-          spdlog::debug("network: default route deleted {}/if{} metric {}", net->ifname_, temp_idx,
-                        priority);
-
-          net->clearIface();
-          net->dp.emit();
-          /* Ask for a dump of all routes in case another one is already
-           * setup. If there's none, there'll be an event with new one
-           * later. */
-          net->want_route_dump_ = true;
-          net->askForStateDump();
-        }
-      }
-      break;
+  if (route != nullptr) {
+    if (route->gateway != gwaddr_ || route->priority != route_priority) {
+      spdlog::debug("network: default route via {} on if{} metric {}", route->gateway, route->oif,
+                    route->priority);
     }
+    gwaddr_ = route->gateway;
+    route_priority = route->priority;
+  } else {
+    gwaddr_.clear();
   }
 
-  return NL_OK;
+  updateAddresses(state);
+  dp.emit();
 }
 
-void waybar::modules::Network::askForStateDump(void) {
-  /* We need to wait until the current dump is done before sending new
-   * messages. handleEventsDone() is called when a dump is done. */
-  if (dump_in_progress_) return;
-
-  struct rtgenmsg rt_hdr = {
-      .rtgen_family = AF_UNSPEC,
-  };
-
-  if (want_route_dump_) {
-    nl_send_simple(ev_sock_, RTM_GETROUTE, NLM_F_DUMP, &rt_hdr, sizeof(rt_hdr));
-    want_route_dump_ = false;
-    dump_in_progress_ = true;
-
-  } else if (want_link_dump_) {
-    nl_send_simple(ev_sock_, RTM_GETLINK, NLM_F_DUMP, &rt_hdr, sizeof(rt_hdr));
-    want_link_dump_ = false;
-    dump_in_progress_ = true;
-
-  } else if (want_addr_dump_) {
-    nl_send_simple(ev_sock_, RTM_GETADDR, NLM_F_DUMP, &rt_hdr, sizeof(rt_hdr));
-    want_addr_dump_ = false;
-    dump_in_progress_ = true;
+void waybar::modules::Network::updateAddresses(const util::NetlinkState& state) {
+  std::string ipaddr;
+  std::string ipaddr6;
+  int cidr = 0;
+  int cidr6 = 0;
+  for (const auto& address : state.addresses()) {
+    // We ignore address mark as scope for the link or host,
+    // which should leave scope global addresses.
+    if (address.index != ifid_ || address.scope >= RT_SCOPE_LINK) {
+      continue;
+    }
+    // IFA_ADDRESS is the peer on a point-to-point link
+    const auto& ip = is_p2p_ || address.address.empty() ? address.local : address.address;
+    if (ip.empty()) {
+      continue;
+    }
+    if (address.family == AF_INET && cidr == 0 &&
+        (addr_pref_ == ip_addr_pref::IPV4 || addr_pref_ == ip_addr_pref::IPV4_6)) {
+      ipaddr = ip;
+      cidr = address.prefixlen;
+    } else if (address.family == AF_INET6 && cidr6 == 0 &&
+               (addr_pref_ == ip_addr_pref::IPV6 || addr_pref_ == ip_addr_pref::IPV4_6)) {
+      ipaddr6 = ip;
+      cidr6 = address.prefixlen;
+    }
   }
-}
 
-int waybar::modules::Network::handleEventsDone(struct nl_msg* msg, void* data) {
-  auto net = static_cast<waybar::modules::Network*>(data);
-  net->dump_in_progress_ = false;
-  net->askForStateDump();
-  return NL_OK;
+  if (ipaddr != ipaddr_ || cidr != cidr_) {
+    spdlog::debug("network: {}, addr {}/{}", ifname_, ipaddr, cidr);
+    ipaddr_ = std::move(ipaddr);
+    cidr_ = cidr;
+    netmask_ = cidr_ != 0 ? netmask4(cidr_) : "";
+  }
+  if (ipaddr6 != ipaddr6_ || cidr6 != cidr6_) {
+    spdlog::debug("network: {}, addr {}/{}", ifname_, ipaddr6, cidr6);
+    ipaddr6_ = std::move(ipaddr6);
+    cidr6_ = cidr6;
+    netmask6_ = cidr6_ != 0 ? netmask6(cidr6_) : "";
+  }
 }
 
 int waybar::modules::Network::handleScan(struct nl_msg* msg, void* data) {
@@ -1065,36 +660,38 @@ void waybar::modules::Network::parseEssid(struct nlattr** bss) {
 void waybar::modules::Network::parseSignal(struct nlattr** bss) {
   if (bss[NL80211_BSS_SIGNAL_MBM] != nullptr) {
     // signalstrength in dBm from mBm
-    signal_strength_dbm_ = nla_get_s32(bss[NL80211_BSS_SIGNAL_MBM]) / 100;
-
-    // uses nmcli implementation for calculating strength
-    // https://github.com/NetworkManager/NetworkManager/blob/23ffa5fc6e7acbd7a96138c6c18f478f5127177d/src/libnm-platform/wifi/nm-wifi-utils-nl80211.c#L411
-
-    const int noise_floor_dbm = -90;
-    const int signal_max_dbm = -20;
-    signal_strength_dbm_ = CLAMP(signal_strength_dbm_, noise_floor_dbm, signal_max_dbm);
-    signal_strength_ = 100 - (70 * (((float)signal_max_dbm - (float)signal_strength_dbm_) /
-                                    ((float)signal_max_dbm - (float)noise_floor_dbm)));
-
-    if (signal_strength_dbm_ >= -50) {
-      signal_strength_app_ = "Great Connectivity";
-    } else if (signal_strength_dbm_ >= -60) {
-      signal_strength_app_ = "Good Connectivity";
-    } else if (signal_strength_dbm_ >= -67) {
-      signal_strength_app_ = "Streaming";
-    } else if (signal_strength_dbm_ >= -70) {
-      signal_strength_app_ = "Web Surfing";
-    } else if (signal_strength_dbm_ >= -80) {
-      signal_strength_app_ = "Basic Connectivity";
-    } else {
-      signal_strength_app_ = "Poor Connectivity";
-    }
+    setSignal(nla_get_s32(bss[NL80211_BSS_SIGNAL_MBM]) / 100);
   }
   if (bss[NL80211_BSS_SIGNAL_UNSPEC] != nullptr) {
     signal_strength_ = nla_get_u8(bss[NL80211_BSS_SIGNAL_UNSPEC]);
   }
 }
 
+void waybar::modules::Network::setSignal(int32_t dbm) {
+  // uses nmcli implementation for calculating strength
+  // https://github.com/NetworkManager/NetworkManager/blob/23ffa5fc6e7acbd7a96138c6c18f478f5127177d/src/libnm-platform/wifi/nm-wifi-utils-nl80211.c#L411
+
+  const int noise_floor_dbm = -90;
+  const int signal_max_dbm = -20;
+  signal_strength_dbm_ = CLAMP(dbm, noise_floor_dbm, signal_max_dbm);
+  signal_strength_ = 100 - (70 * (((float)signal_max_dbm - (float)signal_strength_dbm_) /
+                                  ((float)signal_max_dbm - (float)noise_floor_dbm)));
+
+  if (signal_strength_dbm_ >= -50) {
+    signal_strength_app_ = "Great Connectivity";
+  } else if (signal_strength_dbm_ >= -60) {
+    signal_strength_app_ = "Good Connectivity";
+  } else if (signal_strength_dbm_ >= -67) {
+    signal_strength_app_ = "Streaming";
+  } else if (signal_strength_dbm_ >= -70) {
+    signal_strength_app_ = "Web Surfing";
+  } else if (signal_strength_dbm_ >= -80) {
+    signal_strength_app_ = "Basic Connectivity";
+  } else {
+    signal_strength_app_ = "Poor Connectivity";
+  }
+}
+
 void waybar::modules::Network::parseFreq(struct nlattr** bss) {
   if (bss[NL80211_BSS_FREQUENCY] != nullptr) {
     // in GHz
@@ -1133,20 +730,21 @@ auto waybar::modules::Network::getInfo() -> void {
   if (nl_msg == nullptr) {
     return;
   }
-  if (genlmsg_put(nl_msg, NL_AUTO_PORT, NL_AUTO_SEQ, nl80211_id_, 0, NLM_F_DUMP,
+  const int nl80211_id = netlink_->nl80211Id();
+  if (genlmsg_put(nl_msg, NL_AUTO_PORT, NL_AUTO_SEQ, nl80211_id, 0, NLM_F_DUMP,
                   NL80211_CMD_GET_SCAN, 0) == nullptr ||
       nla_put_u32(nl_msg, NL80211_ATTR_IFINDEX, ifid_) < 0) {
     nlmsg_free(nl_msg);
     return;
   }
-  int err = nl_send_sync(sock_, nl_msg);
+  int err = netlink_->nl80211Request(nl_msg, handleScan, this);
   if (err < 0) {
     spdlog::warn("nl80211: nl_send_sync get_scan error {}", err);
     // Proceeding here as get_scan might not be essential if we already have ifid_
   }
 
   // If connected to an AP, try to get station data for bitrate
-  if (ifid_ > 0 && !bssid_.empty() && nl80211_id_ >= 0) {
+  if (ifid_ > 0 && !bssid_.empty() && nl80211_id >= 0) {
     nl_msg = nlmsg_alloc();
     if (nl_msg == nullptr) {
       return;
@@ -1156,15 +754,14 @@ auto waybar::modules::Network::getInfo() -> void {
     uint8_t bssid_mac[ETH_ALEN];
     if (sscanf(bssid_.c_str(), "%hhx:%hhx:%hhx:%hhx:%hhx:%hhx", &bssid_mac[0], &bssid_mac[1],
                &bssid_mac[2], &bssid_mac[3], &bssid_mac[4], &bssid_mac[5]) == ETH_ALEN) {
-      if (genlmsg_put(nl_msg, NL_AUTO_PORT, NL_AUTO_SEQ, nl80211_id_, 0, 0, /* No DUMP flag */
+      if (genlmsg_put(nl_msg, NL_AUTO_PORT, NL_AUTO_SEQ, nl80211_id, 0, 0, /* No DUMP flag */
                       NL80211_CMD_GET_STATION, 0) == nullptr ||
           nla_put_u32(nl_msg, NL80211_ATTR_IFINDEX, ifid_) < 0 ||
           nla_put(nl_msg, NL80211_ATTR_MAC, ETH_ALEN, bssid_mac) < 0) {
         nlmsg_free(nl_msg);
         return;
       }
-      // Use station_sock_ for NL80211_CMD_GET_STATION
-      err = nl_send_sync(station_sock_, nl_msg);
+      err = netlink_->nl80211Request(nl_msg, handleStationGet, this);
       if (err < 0) {
         spdlog::warn("nl80211: nl_send_sync get_station error {}", err);
       }
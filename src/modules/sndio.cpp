@@ -37,7 +37,8 @@ auto Sndio::connect_to_sndio() -> void {
     throw std::runtime_error("sioctl_onval() failed.");
   }
 
-  pfds_.reserve(sioctl_nfds(hdl_));
+  // One extra slot for the stop fd of the worker
+  pfds_.resize(sioctl_nfds(hdl_) + 1);
 }
 
 Sndio::Sndio(const std::string& id, const Json::Value& config)
@@ -64,11 +65,15 @@ Sndio::Sndio(const std::string& id, const Json::Value& config)
     if (nfds == 0) {
       throw std::runtime_error("sioctl_pollfd() failed.");
     }
-    while (poll(pfds_.data(), nfds, -1) < 0) {
+    pfds_[nfds] = {thread_.stopFd(), POLLIN, 0};
+    while (poll(pfds_.data(), nfds + 1, -1) < 0) {
       if (errno != EINTR) {
         throw std::runtime_error("poll() failed.");
       }
     }
+    if (pfds_[nfds].revents != 0) {
+      return;
+    }
 
     int revents = sioctl_revents(hdl_, pfds_.data());
     if (revents & POLLHUP) {
@@ -98,7 +103,12 @@ Sndio::Sndio(const std::string& id, const Json::Value& config)
   };
 }
 
-Sndio::~Sndio() { sioctl_close(hdl_); }
+Sndio::~Sndio() {
+  thread_.join();
+  if (hdl_) {
+    sioctl_close(hdl_);
+  }
+}
 
 auto Sndio::update() -> void {
   auto format = format_;
@@ -1,5 +1,11 @@
 #include "modules/temperature.hpp"
 
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cmath>
 #include <filesystem>
 #include <optional>
 #include <stdexcept>
@@ -9,11 +15,78 @@
 #include <sys/sysctl.h>
 #endif
 
+#include "util/startup_profile.hpp"
+
+
 waybar::modules::Temperature::Temperature(const std::string& id, const Json::Value& config)
     : ALabel(config, "temperature", id, "{temperatureC}°C", 10) {
-#if defined(__FreeBSD__)
-// FreeBSD uses sysctlbyname instead of read from a file
-#else
+  try {
+    addSensors();
+  } catch (const std::exception& e) {
+    spdlog::error("{}: {}", name_, e.what());
+    return;
+  }
+  // Modules showing the same sensors on several bars read them once per interval
+  Json::Value inputs(Json::arrayValue);
+  for (const auto& sensor : sensors_) {
+    Json::Value input(Json::objectValue);
+    for (const auto* key : {"hwmon-path", "hwmon-path-abs", "hwmon-name", "hwmon-by-name",
+                            "input-filename", "thermal-zone"}) {
+      if (sensor.config.isMember(key)) {
+        input[key] = sensor.config[key];
+      }
+    }
+    inputs.append(input);
+  }
+  Json::StreamWriterBuilder writer;
+  writer["indentation"] = "";
+  key_ = fmt::format("temperature{}@{}", Json::writeString(writer, inputs), interval_.count());
+  subscribe();
+}
+
+void waybar::modules::Temperature::subscribe() {
+  // Walking hwmon can take a while with many sensors, the first sample resolves them off the
+  // main thread. The module stays hidden until then.
+  readings_ = util::SharedSampler<Readings>::subscribe(
+      key_, interval_,
+      [reader = std::make_shared<Reader>(name_, sensors_)] { return reader->read(); },
+      [this] { dp.emit(); });
+}
+
+void waybar::modules::Temperature::addSensors() {
+  const auto& sensors = config_["sensors"];
+  if (!sensors.isObject()) {
+    sensors_.push_back({.config = config_});
+    return;
+  }
+  for (const auto& name : sensors.getMemberNames()) {
+    // The name makes the placeholders of the sensor
+    if (name.empty() || std::ranges::any_of(name, [](unsigned char c) {
+          return std::isalnum(c) == 0 && c != '_';
+        })) {
+      throw std::runtime_error("invalid sensor name '" + name + "'");
+    }
+    sensors_.push_back(
+        {.name = name, .config = sensors[name], .arg_c = name + "C", .arg_f = name + "F",
+         .arg_k = name + "K"});
+  }
+  if (sensors_.empty()) {
+    throw std::runtime_error("no sensor in sensors");
+  }
+}
+
+waybar::modules::Temperature::Reader::Reader(std::string name, const std::vector<Sensor>& sensors)
+    : name_(std::move(name)) {
+#if !defined(__FreeBSD__)
+  hwmon_ = util::HwmonIndex::shared();
+#endif
+  for (const auto& sensor : sensors) {
+    inputs_.push_back(
+        {.label = sensor.name.empty() ? name_ : name_ + " " + sensor.name, .config = sensor.config});
+  }
+}
+
+std::string waybar::modules::Temperature::Reader::findSensor(const Json::Value& config) {
   auto traverseAsArray = [](const Json::Value& value, auto&& check_set_path) {
     if (value.isString())
       check_set_path(value.asString());
@@ -22,115 +95,133 @@ waybar::modules::Temperature::Temperature(const std::string& id, const Json::Val
         if (check_set_path(item.asString())) break;
   };
 
-  if (config_["hwmon-by-name"].isString() && config_["input-filename"].isString()) {
-    auto name = config_["hwmon-by-name"].asString();
-    auto input_filename = config_["input-filename"].asString();
-    for (const auto& entry : std::filesystem::directory_iterator("/sys/class/hwmon/")) {
-      if (std::filesystem::is_directory(entry) && file_path_.empty()) {
-        auto name_filepath = entry.path().string() + "/name";
-        auto input_filepath = entry.path().string() + "/" + input_filename;
-
-        if (std::filesystem::exists(name_filepath) && std::filesystem::exists(input_filepath)) {
-          std::ifstream name_file(name_filepath);
-          if (!name_file.is_open()) {
-            throw std::runtime_error("Error: Could not open file " + name_filepath);
-          }
-
-          std::string line;
-          while (std::getline(name_file, line)) {
-            if (line.find(name) != std::string::npos) {
-              file_path_ = input_filepath;
-              break;
-            }
-          }
-        }
-      }
-    }
-    if (file_path_.empty()) throw std::runtime_error("Could not find hwmon by name " + name);
+  std::string file_path;
+  if (config["hwmon-by-name"].isString() && config["input-filename"].isString()) {
+    auto name = config["hwmon-by-name"].asString();
+    auto input_filename = config["input-filename"].asString();
+    // Several devices may share a name, e.g. an iGPU and a dGPU: take the one with the input
+    auto hwmon = hwmon_->findContaining(name, input_filename);
+    if (!hwmon) throw std::runtime_error("Could not find hwmon by name " + name);
+    file_path = (*hwmon / input_filename).string();
   }
 
-  auto find_hwmon_by_name = [](const std::string& name) -> std::optional<std::filesystem::path> {
-    for (const auto& entry : std::filesystem::directory_iterator("/sys/class/hwmon")) {
-      std::ifstream f(entry.path() / "name");
-      std::string hwname;
-      if (f >> hwname && hwname == name) {
-        return entry.path();
-      }
-    }
-    return std::nullopt;
-  };
-
   // ensure either hwmon-name OR old paths are used, not both
-  if (config_["hwmon-name"].isString() &&
-      (!config_["hwmon-path"].isNull() || !config_["hwmon-path-abs"].isNull())) {
+  if (config["hwmon-name"].isString() &&
+      (!config["hwmon-path"].isNull() || !config["hwmon-path-abs"].isNull())) {
     throw std::runtime_error(
         "hwmon-name cannot be used together with hwmon-path or hwmon-path-abs");
   }
 
-  if (file_path_.empty()) {
+  if (file_path.empty()) {
     // if hwmon_path is an array, loop to find first valid item
-    traverseAsArray(config_["hwmon-path"], [this](const std::string& path) {
+    traverseAsArray(config["hwmon-path"], [&file_path](const std::string& path) {
       if (!std::filesystem::exists(path)) return false;
-      file_path_ = path;
+      file_path = path;
       return true;
     });
   }
 
-  if (file_path_.empty() && config_["input-filename"].isString()) {
+  if (file_path.empty() && config["input-filename"].isString()) {
     // fallback to hwmon_paths-abs
-    traverseAsArray(config_["hwmon-path-abs"], [this](const std::string& path) {
+    traverseAsArray(config["hwmon-path-abs"], [&config, &file_path](const std::string& path) {
       if (!std::filesystem::is_directory(path)) return false;
       return std::ranges::any_of(
-          std::filesystem::directory_iterator(path), [this](const auto& hwmon) {
+          std::filesystem::directory_iterator(path), [&config, &file_path](const auto& hwmon) {
             if (!hwmon.path().filename().string().starts_with("hwmon")) return false;
-            file_path_ = hwmon.path().string() + "/" + config_["input-filename"].asString();
+            file_path = hwmon.path().string() + "/" + config["input-filename"].asString();
             return true;
           });
     });
   }
 
-  if (file_path_.empty() && config_["hwmon-name"].isString()) {
-    if (!config_["input-filename"].isString()) {
+  if (file_path.empty() && config["hwmon-name"].isString()) {
+    if (!config["input-filename"].isString()) {
       throw std::runtime_error("hwmon-name requires input-filename to be set");
     }
 
-    auto hwmon = find_hwmon_by_name(config_["hwmon-name"].asString());
+    auto hwmon = hwmon_->find(config["hwmon-name"].asString());
 
     if (!hwmon) {
-      throw std::runtime_error("hwmon-name '" + config_["hwmon-name"].asString() + "' not found");
+      throw std::runtime_error("hwmon-name '" + config["hwmon-name"].asString() + "' not found");
     }
 
-    file_path_ = hwmon->string() + "/" + config_["input-filename"].asString();
+    file_path = (*hwmon / config["input-filename"].asString()).string();
   }
 
-  if (file_path_.empty()) {
-    auto zone = config_["thermal-zone"].isInt() ? config_["thermal-zone"].asInt() : 0;
-    file_path_ = fmt::format("/sys/class/thermal/thermal_zone{}/temp", zone);
+  if (file_path.empty()) {
+    auto zone = config["thermal-zone"].isInt() ? config["thermal-zone"].asInt() : 0;
+    file_path = fmt::format("/sys/class/thermal/thermal_zone{}/temp", zone);
   }
+  return file_path;
+}
 
-  // check if file_path_ can be used to retrieve the temperature
-  std::ifstream temp(file_path_);
-  if (!temp.is_open()) {
-    throw std::runtime_error("Can't open " + file_path_);
-  }
-  if (!temp.good()) {
-    temp.close();
-    throw std::runtime_error("Can't read from " + file_path_);
+void waybar::modules::Temperature::Reader::resolve(Input& input) {
+  input.file.emplace(findSensor(input.config));
+  // check if the file can be used to retrieve the temperature, throws otherwise
+  input.file->read();
+}
+
+waybar::modules::Temperature::Readings waybar::modules::Temperature::Reader::read() {
+  std::optional<util::StartupProfile::Span> span;
+  if (!discovered_) {
+    span.emplace(name_ + " sensor discovery");
+    discovered_ = true;
   }
-  temp.close();
+#if !defined(__FreeBSD__)
+  // hwmon devices came or went, their numbers may have moved
+  const auto generation = hwmon_->generation();
+  const bool moved = generation != hwmon_generation_;
+  hwmon_generation_ = generation;
 #endif
-
-  thread_ = [this] {
-    dp.emit();
-    thread_.sleep_for(interval_);
-  };
+  Readings readings;
+  readings.reserve(inputs_.size());
+  for (auto& input : inputs_) {
+    try {
+#if !defined(__FreeBSD__)
+      if (moved || !input.file) {
+        resolve(input);
+      }
+#endif
+      readings.push_back(getTemperature(input));
+      input.read = true;
+      input.failed = false;
+    } catch (const std::exception& e) {
+      if (!input.failed) {
+        spdlog::warn("{}: {}", input.label, e.what());
+#if !defined(__FreeBSD__)
+        // The device may have been renumbered without a udev event we could see
+        if (input.read) {
+          hwmon_->invalidate();
+        }
+#endif
+      }
+      input.failed = true;
+      input.read = false;
+      input.file.reset();
+      readings.emplace_back();
+    }
+  }
+  return readings;
 }
 
 auto waybar::modules::Temperature::update() -> void {
-  auto temperature = getTemperature();
-  uint16_t temperature_c = std::round(temperature);
-  uint16_t temperature_f = std::round(temperature * 1.8 + 32);
-  uint16_t temperature_k = std::round(temperature + 273.15);
+  // Empty until the sensors are resolved
+  const auto readings = readings_.snapshot();
+  // The thresholds and the icon follow the hottest sensor
+  std::optional<float> temperature;
+  for (const auto& reading : *readings) {
+    if (reading && (!temperature || *reading > *temperature)) {
+      temperature = reading;
+    }
+  }
+  if (!temperature) {
+    event_box_.hide();
+    return;
+  }
+  auto toC = [](float celsius) -> uint16_t { return std::round(celsius); };
+  auto toF = [](float celsius) -> uint16_t { return std::round(celsius * 1.8 + 32); };
+  auto toK = [](float celsius) -> uint16_t { return std::round(celsius + 273.15); };
+  uint16_t temperature_c = toC(*temperature);
   auto critical = isCritical(temperature_c);
   auto warning = isWarning(temperature_c);
   auto format = format_;
@@ -155,20 +246,39 @@ auto waybar::modules::Temperature::update() -> void {
   event_box_.show();
 
   auto max_temp = config_["critical-threshold"].isInt() ? config_["critical-threshold"].asInt() : 0;
-  updateLabelAndTooltip(format, "{temperatureC}°C", fmt::arg("temperatureC", temperature_c),
-                        fmt::arg("temperatureF", temperature_f),
-                        fmt::arg("temperatureK", temperature_k),
-                        fmt::arg("icon", getIcon(temperature_c, "", max_temp)));
+  fmt::dynamic_format_arg_store<fmt::format_context> store;
+  store.push_back(fmt::arg("temperatureC", temperature_c));
+  store.push_back(fmt::arg("temperatureF", toF(*temperature)));
+  store.push_back(fmt::arg("temperatureK", toK(*temperature)));
+  for (std::size_t i = 0; i < sensors_.size() && i < readings->size(); i++) {
+    const auto& sensor = sensors_[i];
+    const auto& reading = (*readings)[i];
+    if (sensor.name.empty()) {
+      continue;
+    }
+    // The placeholders of a sensor without a reading are empty
+    if (reading) {
+      store.push_back(fmt::arg(sensor.arg_c.c_str(), toC(*reading)));
+      store.push_back(fmt::arg(sensor.arg_f.c_str(), toF(*reading)));
+      store.push_back(fmt::arg(sensor.arg_k.c_str(), toK(*reading)));
+    } else {
+      store.push_back(fmt::arg(sensor.arg_c.c_str(), ""));
+      store.push_back(fmt::arg(sensor.arg_f.c_str(), ""));
+      store.push_back(fmt::arg(sensor.arg_k.c_str(), ""));
+    }
+  }
+  store.push_back(fmt::arg("icon", getIcon(temperature_c, "", max_temp)));
+  updateLabelAndTooltip(format, "{temperatureC}°C", store);
   // Call parent update
   ALabel::update();
 }
 
-float waybar::modules::Temperature::getTemperature() {
+float waybar::modules::Temperature::Reader::getTemperature(Input& input) {
 #if defined(__FreeBSD__)
   int temp;
   size_t size = sizeof temp;
 
-  auto zone = config_["thermal-zone"].isInt() ? config_["thermal-zone"].asInt() : 0;
+  auto zone = input.config["thermal-zone"].isInt() ? input.config["thermal-zone"].asInt() : 0;
 
   // First, try with dev.cpu
   if ((sysctlbyname(fmt::format("dev.cpu.{}.temperature", zone).c_str(), &temp, &size, NULL, 0) ==
@@ -183,20 +293,14 @@ float waybar::modules::Temperature::getTemperature() {
       "sysctl hw.acpi.thermal.tz{}.temperature and dev.cpu.{}.temperature failed", zone, zone));
 
 #else  // Linux
-  std::ifstream temp(file_path_);
-  if (!temp.is_open()) {
-    throw std::runtime_error("Can't open " + file_path_);
+  // In millidegrees Celsius, one pread on the kept-open input
+  const auto text = input.file->read();
+  long millidegrees = 0;
+  const auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), millidegrees);
+  if (ec != std::errc()) {
+    throw std::runtime_error("Can't parse " + input.file->path());
   }
-  std::string line;
-  if (temp.good()) {
-    getline(temp, line);
-  } else {
-    temp.close();
-    throw std::runtime_error("Can't read from " + file_path_);
-  }
-  temp.close();
-  auto temperature_c = std::strtol(line.c_str(), nullptr, 10) / 1000.0;
-  return temperature_c;
+  return millidegrees / 1000.0;
 #endif
 }
 
@@ -210,6 +314,11 @@ bool waybar::modules::Temperature::isCritical(uint16_t temperature_c) {
          temperature_c >= config_["critical-threshold"].asInt();
 }
 
-void waybar::modules::Temperature::suspend() { thread_.pause(); }
+// The sensors stop being read once every module showing them is suspended
+void waybar::modules::Temperature::suspend() { readings_.reset(); }
 
-void waybar::modules::Temperature::resume() { thread_.resume(); }
+void waybar::modules::Temperature::resume() {
+  if (!key_.empty() && !readings_) {
+    subscribe();
+  }
+}
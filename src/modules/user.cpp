@@ -80,12 +80,7 @@ std::string User::get_user_login() const { return Glib::get_user_name(); }
 std::string User::get_user_home_dir() const { return Glib::get_home_dir(); }
 
 void User::init_update_worker() {
-  this->thread_ = [this] {
-    ALabel::dp.emit();
-    auto now = std::chrono::system_clock::now();
-    auto diff = now.time_since_epoch() % ALabel::interval_;
-    this->thread_.sleep_for(ALabel::interval_ - diff);
-  };
+  this->timer_.start([this] { ALabel::dp.emit(); }, ALabel::interval_, true);
 }
 
 void User::init_avatar(const Json::Value& config) {
@@ -24,10 +24,7 @@ constexpr const char* DEFAULT_FORMAT = "{state}";
 
 waybar::modules::Wwan::Wwan(const std::string& id, const Json::Value& config)
     : ALabel(config, "wwan", id, "{}", 5) {
-  thread_ = [this] {
-    dp.emit();
-    thread_.sleep_for(interval_);
-  };
+  timer_.start([this] { dp.emit(); }, interval_);
 
   GError* error = nullptr;
   connection = g_bus_get_sync(G_BUS_TYPE_SYSTEM, nullptr, &error);
@@ -244,15 +241,9 @@ auto waybar::modules::Wwan::update() -> void {
     if (!state_.empty() && label_.get_style_context()->has_class(state_)) {
       label_.get_style_context()->remove_class(state_);
     }
-    if (config_["format-" + state].isString()) {
-      default_format_ = config_["format-" + state].asString();
-    } else if (config_["format"].isString()) {
-      default_format_ = config_["format"].asString();
-    } else {
-      default_format_ = DEFAULT_FORMAT;
-    }
-    if (config_["tooltip-format-" + state].isString()) {
-      tooltip_format = config_["tooltip-format-" + state].asString();
+    default_format_ = resolveFormat(DEFAULT_FORMAT, state);
+    if (const auto* state_tooltip = module_config_.string("tooltip-format", state)) {
+      tooltip_format = *state_tooltip;
     }
     if (!label_.get_style_context()->has_class(state)) {
       label_.get_style_context()->add_class(state);
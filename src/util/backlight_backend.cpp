@@ -205,6 +205,10 @@ BacklightBackend::BacklightBackend(std::chrono::milliseconds interval,
     ctl_event.events = EPOLLIN;
     ctl_event.data.fd = udev_fd;
 
+    check0(epoll_ctl(epoll_fd.get(), EPOLL_CTL_ADD, ctl_event.data.fd, &ctl_event),
+           "epoll_ctl failed: {}");
+    // Interrupts epoll_wait() when the thread is stopped
+    ctl_event.data.fd = udev_thread_.stopFd();
     check0(epoll_ctl(epoll_fd.get(), EPOLL_CTL_ADD, ctl_event.data.fd, &ctl_event),
            "epoll_ctl failed: {}");
     epoll_event events[EPOLL_MAX_EVENTS];
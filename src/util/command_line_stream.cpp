@@ -92,25 +92,32 @@ waybar::util::command::LineStream::LineStream(std::string output_name, OutputCal
       on_output_(std::move(on_output)),
       on_exit_(std::move(on_exit)),
       pid_(0),
-      stdout_fd_(-1) {}
+      stdout_fd_(-1),
+      stdin_fd_(-1) {}
 
 waybar::util::command::LineStream::~LineStream() { stop(); }
 
-void waybar::util::command::LineStream::start(const std::string& cmd) {
+void waybar::util::command::LineStream::start(const std::string& cmd, bool with_stdin) {
   stop();
 
   std::vector<std::string> argv{"/bin/sh", "-c", cmd};
   auto envp = buildChildEnvironment(output_name_);
   Glib::spawn_async_with_pipes("", argv, envp,
                                Glib::SPAWN_DO_NOT_REAP_CHILD | Glib::SPAWN_CLOEXEC_PIPES,
-                               sigc::ptr_fun(&prepareChild), &pid_, nullptr, &stdout_fd_, nullptr);
+                               sigc::ptr_fun(&prepareChild), &pid_,
+                               with_stdin ? &stdin_fd_ : nullptr, &stdout_fd_, nullptr);
 
-  const auto flags = fcntl(stdout_fd_, F_GETFL, 0);
-  if (flags == -1 || fcntl(stdout_fd_, F_SETFL, flags | O_NONBLOCK) == -1) {
-    const auto saved_errno = errno;
-    stop();
-    throw std::runtime_error("Unable to configure child stdout: " +
-                             std::string(std::strerror(saved_errno)));
+  for (const auto& [fd, name] : {std::pair{stdout_fd_, "stdout"}, std::pair{stdin_fd_, "stdin"}}) {
+    if (fd == -1) {
+      continue;
+    }
+    const auto flags = fcntl(fd, F_GETFL, 0);
+    if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+      const auto saved_errno = errno;
+      stop();
+      throw std::runtime_error("Unable to configure child " + std::string(name) + ": " +
+                               std::string(std::strerror(saved_errno)));
+    }
   }
 
   stdout_connection_ =
@@ -120,23 +127,63 @@ void waybar::util::command::LineStream::start(const std::string& cmd) {
       Glib::signal_child_watch().connect(sigc::mem_fun(*this, &LineStream::handleExit), pid_);
 }
 
-void waybar::util::command::LineStream::stop() {
+void waybar::util::command::LineStream::stop(int sig) {
   stdout_connection_.disconnect();
   child_connection_.disconnect();
 
   if (pid_ != 0) {
-    killpg(pid_, SIGTERM);
+    killpg(pid_, sig);
     waitpid(pid_, nullptr, 0);
     Glib::spawn_close_pid(pid_);
     pid_ = 0;
   }
 
+  closeStdin();
   closeStdout();
   buffer_.clear();
 }
 
 bool waybar::util::command::LineStream::running() const { return pid_ != 0; }
 
+bool waybar::util::command::LineStream::write(std::string_view line) {
+  if (stdin_fd_ == -1) {
+    return false;
+  }
+  std::string data(line);
+  data += '\n';
+
+  // Writing to a command that closed its stdin raises SIGPIPE, which would kill Waybar. It is
+  // blocked around the write, and the one raised by it taken back.
+  sigset_t pipe_set;
+  sigset_t previous;
+  sigset_t pending;
+  sigemptyset(&pipe_set);
+  sigaddset(&pipe_set, SIGPIPE);
+  sigpending(&pending);
+  const bool was_pending = sigismember(&pending, SIGPIPE) == 1;
+  pthread_sigmask(SIG_BLOCK, &pipe_set, &previous);
+  ssize_t written;
+  do {
+    written = ::write(stdin_fd_, data.data(), data.size());
+  } while (written == -1 && errno == EINTR);
+  const auto saved_errno = errno;
+  if (written == -1 && saved_errno == EPIPE && !was_pending) {
+    const timespec no_wait{};
+    sigtimedwait(&pipe_set, nullptr, &no_wait);
+  }
+  pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+
+  if (written == -1) {
+    if (saved_errno == EPIPE) {
+      closeStdin();
+    } else if (saved_errno != EAGAIN && saved_errno != EWOULDBLOCK) {
+      spdlog::error("Writing command stdin failed: {}", std::strerror(saved_errno));
+    }
+    return false;
+  }
+  return static_cast<std::size_t>(written) == data.size();
+}
+
 bool waybar::util::command::LineStream::handleStdout(Glib::IOCondition condition) {
   const auto should_flush =
       static_cast<bool>(condition & (Glib::IO_HUP | Glib::IO_ERR | Glib::IO_NVAL));
@@ -159,6 +206,8 @@ void waybar::util::command::LineStream::handleExit(Glib::Pid pid, int status) {
     closeStdout();
   }
 
+  closeStdin();
+
   if (pid_ == pid) {
     Glib::spawn_close_pid(pid_);
     pid_ = 0;
@@ -169,6 +218,13 @@ void waybar::util::command::LineStream::handleExit(Glib::Pid pid, int status) {
   on_exit_(statusToExitCode(status));
 }
 
+void waybar::util::command::LineStream::closeStdin() {
+  if (stdin_fd_ != -1) {
+    ::close(stdin_fd_);
+    stdin_fd_ = -1;
+  }
+}
+
 void waybar::util::command::LineStream::closeStdout() {
   if (stdout_fd_ != -1) {
     ::close(stdout_fd_);
@@ -0,0 +1,212 @@
+#include "util/compiled_format.hpp"
+
+#include <cctype>
+#include <cstring>
+#include <type_traits>
+
+namespace waybar::util {
+
+namespace {
+
+bool isIndex(std::string_view id) {
+  return !id.empty() && std::ranges::all_of(id, [](char c) { return std::isdigit(c) != 0; });
+}
+
+bool isName(std::string_view id) {
+  return !id.empty() && (std::isalpha(id[0]) != 0 || id[0] == '_') &&
+         std::ranges::all_of(id, [](char c) { return std::isalnum(c) != 0 || c == '_'; });
+}
+
+// Writes the argument of a field without spec the way fmt would, for the common types
+struct PlainWriter {
+  fmt::memory_buffer& out;
+
+  bool operator()(fmt::string_view value) {
+    out.append(value.data(), value.data() + value.size());
+    return true;
+  }
+  bool operator()(const char* value) {
+    if (value == nullptr) {
+      return false;
+    }
+    out.append(value, value + std::strlen(value));
+    return true;
+  }
+  template <typename T>
+  bool operator()(T value) {
+    if constexpr (std::is_same_v<T, int> || std::is_same_v<T, unsigned> ||
+                  std::is_same_v<T, long long> || std::is_same_v<T, unsigned long long>) {
+      const fmt::format_int formatted(value);
+      out.append(formatted.data(), formatted.data() + formatted.size());
+      return true;
+    } else {
+      return false;
+    }
+  }
+};
+
+bool writePlain(fmt::memory_buffer& out, const fmt::format_args::format_arg& arg) {
+  if (!arg) {
+    return false;
+  }
+#if FMT_VERSION >= 110000
+  return arg.visit(PlainWriter{out});
+#else
+  return fmt::visit_format_arg(PlainWriter{out}, arg);
+#endif
+}
+
+}  // namespace
+
+CompiledFormat::CompiledFormat(std::string format) : format_(std::move(format)) {
+  const std::string_view str = format_;
+  std::string literal;
+  std::size_t literal_begin = 0;
+  unsigned next_index = 0;
+  bool automatic = false;
+  bool manual = false;
+  bool nested = false;
+  bool invalid_id = false;
+
+  const auto flush = [&](std::size_t end) {
+    if (!literal.empty()) {
+      segments_.push_back({std::move(literal), false, {}, literal_begin, end});
+      literal.clear();
+    }
+  };
+
+  std::size_t i = 0;
+  while (i < str.size()) {
+    const char c = str[i];
+    if (c == '}') {
+      if (i + 1 < str.size() && str[i + 1] == '}') {
+        literal += '}';
+        i += 2;
+        continue;
+      }
+      return;
+    }
+    if (c != '{') {
+      literal += c;
+      ++i;
+      continue;
+    }
+    if (i + 1 < str.size() && str[i + 1] == '{') {
+      literal += '{';
+      i += 2;
+      continue;
+    }
+
+    // A field, up to the matching brace as the spec may hold nested fields
+    std::size_t end = i + 1;
+    for (int depth = 1; depth > 0; ++end) {
+      if (end == str.size()) {
+        return;
+      }
+      if (str[end] == '{') {
+        ++depth;
+      } else if (str[end] == '}') {
+        --depth;
+      }
+    }
+    flush(i);
+    literal_begin = end;
+
+    const auto field = str.substr(i + 1, end - i - 2);
+    const auto colon = field.find(':');
+    const auto id = field.substr(0, colon);
+    const auto spec = colon == std::string_view::npos ? std::string_view() : field.substr(colon);
+    for (auto open = spec.find('{'); open != std::string_view::npos;
+         open = spec.find('{', open + 1)) {
+      nested = true;
+      const auto nested_id = spec.substr(open + 1, spec.find_first_of(":}", open + 1) - open - 1);
+      if (isName(nested_id)) {
+        names_.emplace_back(nested_id);
+      } else {
+        positional_ = true;
+      }
+    }
+
+    Segment segment{{}, true, {}, i, end};
+    if (id.empty()) {
+      // Numbered, as each field is formatted on its own
+      automatic = true;
+      positional_ = true;
+      if (spec.empty()) {
+        segment.plain_index = static_cast<int>(next_index);
+      }
+      segment.text = fmt::format("{{{}{}}}", next_index++, spec);
+    } else {
+      manual = manual || isIndex(id);
+      positional_ = positional_ || isIndex(id);
+      if (isIndex(id) && spec.empty() && id.size() < 6) {
+        segment.plain_index = std::stoi(std::string(id));
+      }
+      if (isName(id)) {
+        names_.emplace_back(id);
+        if (spec.empty()) {
+          segment.plain_name = id;
+        }
+      } else if (!isIndex(id)) {
+        invalid_id = true;
+      }
+      segment.text = fmt::format("{{{}}}", field);
+    }
+    segments_.push_back(std::move(segment));
+    i = end;
+  }
+  flush(str.size());
+
+  parsed_ = true;
+  whole_ = (automatic && manual) || nested || invalid_id;
+}
+
+bool CompiledFormat::uses(std::string_view name) const {
+  return usesAny([name](const std::string& used) { return used == name; });
+}
+
+void CompiledFormat::renderTo(fmt::memory_buffer& out, fmt::format_args args) const {
+  if (whole_) {
+    fmt::vformat_to(fmt::appender(out), format_, args);
+    return;
+  }
+  for (const auto& segment : segments_) {
+    if (segment.field) {
+      const bool written =
+          (!segment.plain_name.empty() &&
+           writePlain(out, args.get(fmt::string_view(segment.plain_name)))) ||
+          (segment.plain_index >= 0 && writePlain(out, args.get(segment.plain_index)));
+      if (!written) {
+        fmt::vformat_to(fmt::appender(out), segment.text, args);
+      }
+    } else {
+      out.append(segment.text.data(), segment.text.data() + segment.text.size());
+    }
+  }
+}
+
+std::string CompiledFormat::render(fmt::format_args args) const {
+  fmt::memory_buffer out;
+  renderTo(out, args);
+  return fmt::to_string(out);
+}
+
+std::string CompiledFormat::substitute(
+    const std::function<const std::string*(std::string_view)>& value) const {
+  if (!parsed_) {
+    return format_;
+  }
+  std::string result;
+  result.reserve(format_.size());
+  for (const auto& segment : segments_) {
+    const auto* replacement = segment.plain_name.empty() ? nullptr : value(segment.plain_name);
+    if (replacement != nullptr) {
+      result += *replacement;
+    } else {
+      result.append(format_, segment.begin, segment.end - segment.begin);
+    }
+  }
+  return result;
+}
+
+}  // namespace waybar::util
@@ -0,0 +1,328 @@
+#include "util/exec_pool.hpp"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spdlog/spdlog.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <future>
+#include <limits>
+#include <optional>
+#include <utility>
+
+#include "util/module_stats.hpp"
+#include "util/scoped_fd.hpp"
+
+namespace waybar::util {
+
+namespace {
+
+// poll(2) on a single fd until `deadline`, 0 once it passed
+int pollUntil(pollfd& pfd, ExecPool::clock::time_point deadline) {
+  int ready;
+  do {
+    const auto left = std::chrono::ceil<std::chrono::milliseconds>(deadline -
+                                                                   ExecPool::clock::now())
+                          .count();
+    ready = poll(&pfd, 1,
+                 static_cast<int>(std::clamp<decltype(left)>(left, 0,
+                                                             std::numeric_limits<int>::max())));
+  } while (ready == -1 && errno == EINTR);
+  return ready;
+}
+
+}  // namespace
+
+ExecPool* ExecPool::inst() {
+  static auto* pool = new ExecPool();
+  return pool;
+}
+
+ExecPool::ExecPool(std::size_t max_children)
+    : max_children_(std::max<std::size_t>(max_children, 1)) {}
+
+ExecPool::~ExecPool() {
+  {
+    std::lock_guard lock(mutex_);
+    stop_ = true;
+    while (!queue_.empty()) {
+      std::lock_guard job_lock(queue_.top()->mutex);
+      queue_.top()->finished = true;
+      queue_.pop();
+    }
+  }
+  cv_.notify_all();
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+}
+
+ExecPool::Task& ExecPool::Task::operator=(Task&& other) noexcept {
+  if (this != &other) {
+    cancel();
+    job_ = std::move(other.job_);
+  }
+  return *this;
+}
+
+bool ExecPool::Task::pending() const {
+  if (!job_) return false;
+  std::lock_guard lock(job_->mutex);
+  return !job_->finished && !job_->cancelled;
+}
+
+void ExecPool::Task::cancel() {
+  if (!job_) return;
+  {
+    // Taken while the callback runs, so it is done once the lock is held
+    std::lock_guard lock(job_->mutex);
+    job_->cancelled = true;
+    if (job_->pgid > 0) {
+      killpg(job_->pgid, SIGKILL);
+    }
+  }
+  job_.reset();
+}
+
+void ExecPool::setMaxChildren(std::size_t max_children) {
+  {
+    std::lock_guard lock(mutex_);
+    max_children_ = std::max<std::size_t>(max_children, 1);
+    spdlog::debug("Exec pool limited to {} concurrent commands", max_children_);
+    spawnThreads();
+  }
+  cv_.notify_all();
+}
+
+std::size_t ExecPool::maxChildren() {
+  std::lock_guard lock(mutex_);
+  return max_children_;
+}
+
+std::size_t ExecPool::running() {
+  std::lock_guard lock(mutex_);
+  return running_ + long_running_;
+}
+
+std::size_t ExecPool::waiting() {
+  std::lock_guard lock(mutex_);
+  return queue_.size();
+}
+
+uint64_t ExecPool::timedOut() {
+  std::lock_guard lock(mutex_);
+  return timed_out_;
+}
+
+ExecPool::clock::time_point ExecPool::deadlineIn(std::chrono::milliseconds interval) {
+  const auto now = clock::now();
+  if (interval > std::chrono::duration_cast<std::chrono::milliseconds>(clock::time_point::max() -
+                                                                       now)) {
+    return clock::time_point::max();
+  }
+  return now + interval;
+}
+
+ExecPool::Task ExecPool::submit(std::vector<Request> steps, Callback done,
+                                std::shared_ptr<ModuleStats> stats) {
+  auto job = std::make_shared<Job>();
+  job->steps = std::move(steps);
+  job->done = std::move(done);
+  job->stats = std::move(stats);
+  if (job->steps.empty()) {
+    job->steps.emplace_back();
+  }
+  {
+    std::lock_guard lock(mutex_);
+    job->seq = seq_++;
+    queue_.push(job);
+    spawnThreads();
+  }
+  cv_.notify_one();
+  return Task(std::move(job));
+}
+
+ExecPool::Task ExecPool::submit(Request request, Callback done,
+                                std::shared_ptr<ModuleStats> stats) {
+  std::vector<Request> steps;
+  steps.push_back(std::move(request));
+  return submit(std::move(steps), std::move(done), std::move(stats));
+}
+
+command::res ExecPool::run(const Request& request) {
+  if (request.cmd.empty()) return {-1, ""};
+  std::promise<command::res> result;
+  auto future = result.get_future();
+  // Destroyed before `result`, once the callback returned
+  auto task = submit(request, [&result](command::res res) { result.set_value(std::move(res)); });
+  return future.get();
+}
+
+void ExecPool::spawnThreads() {
+  // The long running jobs keep their thread without a slot
+  const auto busy = running_ + long_running_;
+  while (threads_.size() < max_children_ + long_running_ &&
+         threads_.size() < busy + queue_.size()) {
+    threads_.emplace_back(&ExecPool::work, this);
+  }
+}
+
+void ExecPool::work() {
+  std::unique_lock lock(mutex_);
+  while (true) {
+    cv_.wait(lock, [this] { return stop_ || (!queue_.empty() && running_ < max_children_); });
+    if (stop_) return;
+    auto job = queue_.top();
+    queue_.pop();
+    running_++;
+    job->started = clock::now();
+    lock.unlock();
+    auto result = runJob(*job);
+    lock.lock();
+    if (job->long_running) {
+      long_running_--;
+    } else {
+      running_--;
+    }
+    lock.unlock();
+    finish(*job, std::move(result));
+    lock.lock();
+  }
+}
+
+void ExecPool::releaseSlot(Job& job) {
+  if (job.long_running) return;
+  job.long_running = true;
+  {
+    std::lock_guard lock(mutex_);
+    running_--;
+    long_running_++;
+    spawnThreads();
+  }
+  cv_.notify_one();
+}
+
+command::res ExecPool::runJob(Job& job) {
+  ModuleStats::Scope stats_scope(job.stats.get(), &ModuleStats::sample_time);
+  command::res result{-1, ""};
+  try {
+    for (const auto& step : job.steps) {
+      {
+        std::lock_guard lock(job.mutex);
+        if (job.cancelled) break;
+      }
+      result = step.cmd.empty() ? command::res{-1, ""} : execute(step, job);
+      if (result.exit_code != 0) break;
+    }
+  } catch (const std::exception& e) {
+    spdlog::error("Exec pool: {}", e.what());
+    result = {-1, ""};
+  }
+  return result;
+}
+
+void ExecPool::finish(Job& job, command::res result) {
+  std::lock_guard lock(job.mutex);
+  job.finished = true;
+  if (job.cancelled || !job.done) return;
+  try {
+    job.done(std::move(result));
+  } catch (const std::exception& e) {
+    spdlog::error("Exec pool callback: {}", e.what());
+  }
+}
+
+command::res ExecPool::execute(const Request& request, Job& job) {
+  // The output is always read from a pipe, its end tells when the command is done even without
+  // a pidfd. With no_read, it is read and discarded.
+  int fd[2];
+  if (pipe2(fd, O_CLOEXEC) != 0) {
+    spdlog::error("Unable to pipe fd");
+    return {-1, ""};
+  }
+  ScopedFd out(fd[0]);
+  auto child = command::spawn(request.cmd, request.output_name, fd[1], true, request.direct);
+  ::close(fd[1]);
+  if (child.pid < 0) {
+    return {-1, ""};
+  }
+  {
+    std::lock_guard lock(job.mutex);
+    if (job.cancelled) {
+      killpg(child.pid, SIGKILL);
+    }
+    job.pgid = child.pid;
+  }
+
+  const bool limited = request.timeout.count() > 0;
+  const auto kill_at = clock::now() + request.timeout;
+  bool killed = false;
+  auto kill = [&] {
+    killpg(child.pid, SIGKILL);
+    killed = true;
+    spdlog::warn("{} timed out after {}ms, killed", request.cmd, request.timeout.count());
+  };
+
+  const std::size_t max_output = request.no_read ? 0 : request.max_output;
+  const auto release_at = job.started + LONG_RUNNING;
+  auto output = command::readAll(
+      out, max_output,
+      job.long_running ? (limited ? std::optional(kill_at) : std::nullopt)
+                       : std::optional(limited ? std::min(kill_at, release_at) : release_at));
+  if (output.timed_out && !job.long_running && (!limited || clock::now() < kill_at)) {
+    // Still running after its slot time, the rest is read without it
+    releaseSlot(job);
+    auto rest = command::readAll(out, max_output - std::min(max_output, output.text.size()),
+                                 limited ? std::optional(kill_at) : std::nullopt);
+    output.text += rest.text;
+    output.truncated = output.truncated || rest.truncated;
+    output.timed_out = rest.timed_out;
+  }
+  if (output.timed_out) {
+    // A process outside the group may still hold the output, don't wait for it
+    kill();
+  }
+  out.reset();
+
+  // The command may outlive its output. Without a pidfd it is waited for without limit, and
+  // keeps its slot.
+  if (!killed && child.pidfd != -1 && (limited || !job.long_running)) {
+    pollfd pfd{.fd = child.pidfd, .events = POLLIN, .revents = 0};
+    while (true) {
+      const auto until = job.long_running ? kill_at
+                                          : (limited ? std::min(kill_at, release_at) : release_at);
+      if (pollUntil(pfd, until) != 0) break;
+      if (job.long_running || (limited && clock::now() >= kill_at)) {
+        kill();
+        break;
+      }
+      releaseSlot(job);
+      if (!limited) break;
+    }
+  }
+  {
+    // Still a zombie until waited for, so the group can't be reused before this
+    std::lock_guard lock(job.mutex);
+    job.pgid = -1;
+  }
+  const auto stat = command::wait(child);
+
+  if (killed) {
+    std::lock_guard lock(mutex_);
+    timed_out_++;
+    return {TIMEOUT_EXIT_CODE, ""};
+  }
+  if (output.truncated && !request.no_read) {
+    spdlog::warn("Output of {} truncated to {} bytes", request.cmd, output.text.size());
+  }
+  // Remove last newline
+  if (!output.text.empty() && output.text.back() == '\n') {
+    output.text.pop_back();
+  }
+  return {WEXITSTATUS(stat), std::move(output.text)};
+}
+
+}  // namespace waybar::util
@@ -0,0 +1,138 @@
+#include "util/hwmon_index.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <charconv>
+#include <exception>
+#include <utility>
+
+#include "util/proc_file.hpp"
+
+namespace waybar::util {
+
+namespace {
+
+// hwmon10 sorts after hwmon9
+unsigned int hwmonNumber(const std::filesystem::path& dir) {
+  const auto name = dir.filename().string();
+  unsigned int number = 0;
+  if (name.starts_with("hwmon")) {
+    std::from_chars(name.data() + 5, name.data() + name.size(), number);
+  }
+  return number;
+}
+
+}  // namespace
+
+std::vector<HwmonDevice> scanHwmon(const std::filesystem::path& root) {
+  std::vector<HwmonDevice> devices;
+  std::error_code ec;
+  for (const auto& entry : std::filesystem::directory_iterator(root, ec)) {
+    try {
+      ProcFile name((entry.path() / "name").string());
+      auto text = name.read();
+      devices.push_back({.dir = entry.path(), .name = std::string(nextLine(text))});
+    } catch (const std::exception&) {
+      // Not every device has a name
+      devices.push_back({.dir = entry.path(), .name = {}});
+    }
+  }
+  if (ec) {
+    spdlog::debug("Can't list {}: {}", root.string(), ec.message());
+  }
+  std::ranges::sort(devices, {}, [](const auto& device) { return hwmonNumber(device.dir); });
+  return devices;
+}
+
+HwmonIndex::HwmonIndex(std::filesystem::path root) : root_(std::move(root)) {}
+
+std::shared_ptr<HwmonIndex> HwmonIndex::shared() {
+  static std::mutex mutex;
+  static std::weak_ptr<HwmonIndex> instance;
+
+  std::lock_guard lock(mutex);
+  auto index = instance.lock();
+  if (!index) {
+    index = std::make_shared<HwmonIndex>("/sys/class/hwmon");
+    index->watchUdev();
+    instance = index;
+  }
+  return index;
+}
+
+void HwmonIndex::watchUdev() {
+#ifdef HAVE_LIBUDEV
+  udev_ = std::unique_ptr<udev, UdevDeleter>(udev_new());
+  if (udev_ != nullptr) {
+    mon_ = std::unique_ptr<udev_monitor, UdevMonitorDeleter>(
+        udev_monitor_new_from_netlink(udev_.get(), "kernel"));
+  }
+  if (mon_ == nullptr ||
+      udev_monitor_filter_add_match_subsystem_devtype(mon_.get(), "hwmon", nullptr) < 0 ||
+      udev_monitor_enable_receiving(mon_.get()) < 0) {
+    spdlog::warn("hwmon: no udev monitor, hwmon devices won't be tracked");
+    mon_.reset();
+  }
+#endif
+}
+
+std::optional<std::filesystem::path> HwmonIndex::find(std::string_view name) {
+  std::lock_guard lock(mutex_);
+  refresh();
+  const auto it = std::ranges::find(devices_, name, &HwmonDevice::name);
+  if (it == devices_.end()) {
+    return std::nullopt;
+  }
+  return it->dir;
+}
+
+std::optional<std::filesystem::path> HwmonIndex::findContaining(std::string_view needle,
+                                                                std::string_view input) {
+  std::lock_guard lock(mutex_);
+  refresh();
+  const auto it = std::ranges::find_if(devices_, [needle, input](const auto& device) {
+    std::error_code ec;
+    return device.name.find(needle) != std::string::npos &&
+           (input.empty() || std::filesystem::exists(device.dir / input, ec));
+  });
+  if (it == devices_.end()) {
+    return std::nullopt;
+  }
+  return it->dir;
+}
+
+uint64_t HwmonIndex::generation() {
+  std::lock_guard lock(mutex_);
+  refresh();
+  return generation_;
+}
+
+void HwmonIndex::invalidate() {
+  std::lock_guard lock(mutex_);
+  stale_ = true;
+}
+
+void HwmonIndex::refresh() {
+#ifdef HAVE_LIBUDEV
+  // The monitor socket doesn't block, only the devices coming and going matter: a "change" of
+  // an hwmon device doesn't move its sensors
+  while (mon_ != nullptr) {
+    std::unique_ptr<udev_device, UdevDeviceDeleter> dev(udev_monitor_receive_device(mon_.get()));
+    if (dev == nullptr) {
+      break;
+    }
+    const char* action = udev_device_get_action(dev.get());
+    if (action != nullptr && std::string_view(action) != "change") {
+      stale_ = true;
+    }
+  }
+#endif
+  if (stale_) {
+    devices_ = scanHwmon(root_);
+    stale_ = false;
+    generation_++;
+  }
+}
+
+}  // namespace waybar::util
@@ -0,0 +1,133 @@
+#include "util/link_stats.hpp"
+
+#include <linux/if_link.h>
+#include <linux/rtnetlink.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#include "util/module_stats.hpp"
+
+namespace waybar::util {
+
+namespace {
+
+// A kernel that doesn't answer within this is treated as not supporting the request
+constexpr timeval REPLY_TIMEOUT{.tv_sec = 1, .tv_usec = 0};
+
+}  // namespace
+
+std::optional<LinkCounters> parseLinkStats(const nlmsghdr* message) {
+  if (message->nlmsg_type != RTM_NEWLINK || message->nlmsg_len < NLMSG_LENGTH(sizeof(ifinfomsg))) {
+    return std::nullopt;
+  }
+  const auto* ifi = static_cast<const ifinfomsg*>(NLMSG_DATA(message));
+  int len = static_cast<int>(message->nlmsg_len - NLMSG_LENGTH(sizeof(*ifi)));
+  for (const auto* rta = IFLA_RTA(ifi); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+    if (rta->rta_type != IFLA_STATS64 || RTA_PAYLOAD(rta) < sizeof(rtnl_link_stats64)) {
+      continue;
+    }
+    // The payload is only 4-byte aligned
+    rtnl_link_stats64 stats;
+    std::memcpy(&stats, RTA_DATA(rta), sizeof(stats));
+    return LinkCounters{.rx_bytes = stats.rx_bytes, .tx_bytes = stats.tx_bytes};
+  }
+  return std::nullopt;
+}
+
+std::optional<LinkCounters> parseNetDev(std::string_view netdev, std::string_view ifname) {
+  // skip the headers (first two lines)
+  nextLine(netdev);
+  nextLine(netdev);
+  while (!netdev.empty()) {
+    // "  eth0: <receive columns> <transmit columns>", each group has the following columns:
+    // bytes, packets, errs, drop, fifo, frame, compressed, multicast
+    auto line = nextLine(netdev);
+    const auto colon = line.find(':');
+    if (colon == std::string_view::npos) {
+      continue;
+    }
+    auto name = line.substr(0, colon);
+    name.remove_prefix(std::min(name.find_first_not_of(' '), name.size()));
+    if (name != ifname) {
+      continue;
+    }
+    line.remove_prefix(colon + 1);
+    LinkCounters counters;
+    uint64_t skipped = 0;
+    bool valid = scanUnsigned(line, counters.rx_bytes);
+    for (int column = 0; valid && column < 7; column++) {
+      valid = scanUnsigned(line, skipped);
+    }
+    if (valid && scanUnsigned(line, counters.tx_bytes)) {
+      return counters;
+    }
+    return std::nullopt;
+  }
+  return std::nullopt;
+}
+
+LinkStatsReader::LinkStatsReader(std::string netdev_path) : netdev_(std::move(netdev_path)) {
+  sock_.reset(socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE));
+  if (sock_ != -1) {
+    setsockopt(sock_, SOL_SOCKET, SO_RCVTIMEO, &REPLY_TIMEOUT, sizeof(REPLY_TIMEOUT));
+  }
+}
+
+std::optional<LinkCounters> LinkStatsReader::read(int ifindex, std::string_view ifname) {
+  if (ifindex > 0 && sock_ != -1) {
+    if (auto counters = query(ifindex)) {
+      return counters;
+    }
+  }
+  try {
+    return parseNetDev(netdev_.read(), ifname);
+  } catch (const std::runtime_error&) {
+    return std::nullopt;
+  }
+}
+
+std::optional<LinkCounters> LinkStatsReader::query(int ifindex) {
+  struct {
+    nlmsghdr header;
+    ifinfomsg ifi;
+  } request{};
+  request.header.nlmsg_len = sizeof(request);
+  request.header.nlmsg_type = RTM_GETLINK;
+  request.header.nlmsg_flags = NLM_F_REQUEST;
+  request.header.nlmsg_seq = ++seq_;
+  request.ifi.ifi_family = AF_UNSPEC;
+  request.ifi.ifi_index = ifindex;
+  if (send(sock_, &request, sizeof(request), 0) < 0) {
+    return std::nullopt;
+  }
+
+  while (true) {
+    auto len = recv(sock_, buffer_, sizeof(buffer_), 0);
+    if (len < 0 && errno == EINTR) {
+      continue;
+    }
+    if (len <= 0) {
+      return std::nullopt;
+    }
+    ModuleStats::addBytesRead(len);
+    for (auto* message = reinterpret_cast<const nlmsghdr*>(buffer_); NLMSG_OK(message, len);
+         message = NLMSG_NEXT(message, len)) {
+      // Replies to an earlier request that timed out are dropped
+      if (message->nlmsg_seq != seq_) {
+        continue;
+      }
+      if (message->nlmsg_type == NLMSG_ERROR) {
+        return std::nullopt;
+      }
+      return parseLinkStats(message);
+    }
+  }
+}
+
+}  // namespace waybar::util
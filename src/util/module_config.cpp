@@ -0,0 +1,199 @@
+#include "util/module_config.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace waybar::util {
+
+namespace {
+
+const std::string EMPTY;
+
+std::optional<ModuleConfig::Icons> compileIcons(const Json::Value& value) {
+  ModuleConfig::Icons icons;
+  if (value.isString()) {
+    icons.icons.push_back(value.asString());
+    return icons;
+  }
+  if (!value.isArray()) {
+    return std::nullopt;
+  }
+  icons.thresholds = value.size() != 0U && value[0].isObject();
+  for (const auto& icon : value) {
+    if (!icons.thresholds) {
+      // A misconfigured entry shows nothing rather than shifting the others
+      icons.icons.push_back(icon.isString() ? icon.asString() : "");
+      continue;
+    }
+    if (!icon.isObject() || !icon["icon"].isString() || !icon["max"].isUInt()) {
+      spdlog::warn(
+          "format-icons: skipping invalid threshold object, expected {\"icon\": \"...\", "
+          "\"max\": N}");
+      continue;
+    }
+    icons.icons.push_back(icon["icon"].asString());
+    icons.max.push_back(icon["max"].asUInt());
+  }
+  return icons;
+}
+
+}  // namespace
+
+const std::string& ModuleConfig::Icons::get(uint16_t percentage, uint16_t range) const {
+  if (icons.empty()) {
+    return EMPTY;
+  }
+  if (thresholds) {
+    for (std::size_t i = 0; i < icons.size(); ++i) {
+      if (percentage <= max[i]) {
+        return icons[i];
+      }
+    }
+    return icons.back();
+  }
+  const auto size = static_cast<unsigned>(icons.size());
+  const auto divisor = std::max(1U, (range == 0 ? 100U : static_cast<unsigned>(range)) / size);
+  return icons[std::clamp(percentage / divisor, 0U, size - 1)];
+}
+
+ModuleConfig::ModuleConfig(const Json::Value& config) {
+  if (!config.isObject()) {
+    return;
+  }
+  for (auto it = config.begin(); it != config.end(); ++it) {
+    if (!it->isString()) {
+      continue;
+    }
+    const auto name = it.name();
+    max_key_size_ = std::max(max_key_size_, name.size());
+    const auto& value = strings_.emplace(name, it->asString()).first->second;
+    if (name == "format" || name.starts_with("format-") || name.starts_with("tooltip-format")) {
+      formats_.try_emplace(value, value);
+    }
+  }
+
+  const auto& states = config["states"];
+  if (states.isObject()) {
+    for (auto it = states.begin(); it != states.end(); ++it) {
+      if (it->isUInt()) {
+        states_descending_.push_back({it.name(), static_cast<uint8_t>(it->asUInt())});
+      }
+    }
+    states_ascending_ = states_descending_;
+    std::ranges::stable_sort(states_descending_,
+                             [](const auto& a, const auto& b) { return a.threshold > b.threshold; });
+    std::ranges::stable_sort(states_ascending_,
+                             [](const auto& a, const auto& b) { return a.threshold < b.threshold; });
+  }
+
+  const auto& icons = config["format-icons"];
+  if (icons.isObject()) {
+    for (auto it = icons.begin(); it != icons.end(); ++it) {
+      if (auto compiled = compileIcons(*it)) {
+        icons_.emplace(it.name(), std::move(*compiled));
+      }
+    }
+  } else {
+    root_icons_ = compileIcons(icons);
+  }
+}
+
+const std::string* ModuleConfig::find(std::initializer_list<std::string_view> parts) const {
+  std::array<char, 256> buffer;
+  std::size_t size = 0;
+  for (const auto part : parts) {
+    if (part.empty()) {
+      return nullptr;
+    }
+    const auto needed = size + (size != 0 ? 1 : 0) + part.size();
+    // Longer than any configured key, so not configured
+    if (needed > max_key_size_ || needed > buffer.size()) {
+      return nullptr;
+    }
+    if (size != 0) {
+      buffer[size++] = '-';
+    }
+    std::memcpy(buffer.data() + size, part.data(), part.size());
+    size += part.size();
+  }
+  const auto it = strings_.find(std::string_view(buffer.data(), size));
+  return it != strings_.end() ? &it->second : nullptr;
+}
+
+const std::string* ModuleConfig::string(std::string_view key) const { return find({key}); }
+
+const std::string* ModuleConfig::string(std::string_view key, std::string_view a) const {
+  return find({key, a});
+}
+
+const std::string* ModuleConfig::string(std::string_view key, std::string_view a,
+                                        std::string_view b) const {
+  return find({key, a, b});
+}
+
+const std::string* ModuleConfig::first(std::initializer_list<const std::string*> options) {
+  for (const auto* option : options) {
+    if (option != nullptr) {
+      return option;
+    }
+  }
+  return nullptr;
+}
+
+const std::string& ModuleConfig::resolve(std::string_view key, std::string_view state,
+                                         const std::string& fallback) const {
+  const auto* value = first({string(key, state), string(key)});
+  return value != nullptr ? *value : fallback;
+}
+
+const CompiledFormat* ModuleConfig::compiled(std::string_view format) const {
+  const auto it = formats_.find(format);
+  return it != formats_.end() ? &it->second : nullptr;
+}
+
+const ModuleConfig::State* ModuleConfig::state(uint8_t value, bool lesser) const {
+  for (const auto& state : states(lesser)) {
+    if (lesser ? value <= state.threshold : value >= state.threshold) {
+      return &state;
+    }
+  }
+  return nullptr;
+}
+
+const ModuleConfig::Icons* ModuleConfig::iconsOf(std::string_view alt) const {
+  const auto it = icons_.find(alt);
+  return it != icons_.end() ? &it->second : nullptr;
+}
+
+const ModuleConfig::Icons* ModuleConfig::icons(std::initializer_list<std::string_view> alts) const {
+  if (root_icons_) {
+    return &*root_icons_;
+  }
+  for (const auto alt : alts) {
+    if (!alt.empty()) {
+      if (const auto* icons = iconsOf(alt)) {
+        return icons;
+      }
+    }
+  }
+  return iconsOf("default");
+}
+
+const ModuleConfig::Icons* ModuleConfig::icons(const std::vector<std::string>& alts) const {
+  if (root_icons_) {
+    return &*root_icons_;
+  }
+  for (const auto& alt : alts) {
+    if (!alt.empty()) {
+      if (const auto* icons = iconsOf(alt)) {
+        return icons;
+      }
+    }
+  }
+  return iconsOf("default");
+}
+
+}  // namespace waybar::util
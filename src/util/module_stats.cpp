@@ -0,0 +1,181 @@
+#include "util/module_stats.hpp"
+
+#include <fmt/format.h>
+#include <json/writer.h>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <bit>
+#include <fstream>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace waybar::util {
+
+namespace {
+
+thread_local ModuleStats* current_stats = nullptr;
+
+std::mutex& registryMutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+std::vector<std::weak_ptr<ModuleStats>>& registry() {
+  static std::vector<std::weak_ptr<ModuleStats>> registry;
+  return registry;
+}
+
+}  // namespace
+
+std::atomic<bool> ModuleStats::enabled_{false};
+
+void LatencyHistogram::record(std::chrono::nanoseconds elapsed) {
+  const auto ns = static_cast<uint64_t>(std::max(elapsed.count(), int64_t{0}));
+  const auto bucket = std::min<std::size_t>(std::bit_width(ns / 1000), BUCKETS - 1);
+  buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  total_ns_.fetch_add(ns, std::memory_order_relaxed);
+  auto max = max_ns_.load(std::memory_order_relaxed);
+  while (ns > max && !max_ns_.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {
+  }
+}
+
+Json::Value LatencyHistogram::toJson() const {
+  Json::Value json(Json::objectValue);
+  const auto count = count_.load(std::memory_order_relaxed);
+  json["count"] = Json::UInt64(count);
+  json["total_us"] = Json::UInt64(total_ns_.load(std::memory_order_relaxed) / 1000);
+  json["mean_us"] =
+      count > 0 ? static_cast<double>(total_ns_.load(std::memory_order_relaxed)) / count / 1000
+                : 0.0;
+  json["max_us"] = Json::UInt64(max_ns_.load(std::memory_order_relaxed) / 1000);
+  Json::Value buckets(Json::objectValue);
+  for (std::size_t i = 0; i < BUCKETS; ++i) {
+    const auto value = buckets_[i].load(std::memory_order_relaxed);
+    if (value == 0) {
+      continue;
+    }
+    const auto label = i + 1 < BUCKETS ? "<" + std::to_string(1ULL << i) + "us"
+                                       : ">=" + std::to_string(1ULL << (i - 1)) + "us";
+    buckets[label] = Json::UInt64(value);
+  }
+  json["buckets"] = buckets;
+  return json;
+}
+
+ModuleStats::Scope::Scope(ModuleStats* stats, LatencyHistogram ModuleStats::* histogram) {
+  if (stats == nullptr || !enabled()) {
+    return;
+  }
+  stats_ = stats;
+  previous_ = current_stats;
+  current_stats = stats;
+  if (histogram != nullptr) {
+    histogram_ = &(stats->*histogram);
+    start_ = std::chrono::steady_clock::now();
+  }
+}
+
+ModuleStats::Scope::~Scope() {
+  if (stats_ == nullptr) {
+    return;
+  }
+  if (histogram_ != nullptr) {
+    histogram_->record(std::chrono::steady_clock::now() - start_);
+  }
+  current_stats = previous_;
+}
+
+ModuleStats::ModuleStats(std::string name)
+    : name_(std::move(name)), created_(std::chrono::steady_clock::now()) {}
+
+std::shared_ptr<ModuleStats> ModuleStats::create(const std::string& name) {
+  auto stats = std::make_shared<ModuleStats>(name);
+  std::lock_guard lock(registryMutex());
+  std::erase_if(registry(), [](const auto& weak) { return weak.expired(); });
+  registry().push_back(stats);
+  return stats;
+}
+
+void ModuleStats::setEnabled(bool enabled) { enabled_.store(enabled, std::memory_order_relaxed); }
+
+ModuleStats* ModuleStats::current() { return current_stats; }
+
+void ModuleStats::addBytesRead(std::size_t bytes) {
+  if (!enabled()) {
+    return;
+  }
+  if (auto* stats = current()) {
+    stats->bytes_read.fetch_add(bytes, std::memory_order_relaxed);
+  }
+}
+
+void ModuleStats::addChildSpawned() {
+  if (!enabled()) {
+    return;
+  }
+  if (auto* stats = current()) {
+    stats->children_spawned.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+Json::Value ModuleStats::toJson() const {
+  Json::Value json(Json::objectValue);
+  const auto seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - created_).count();
+  const auto emitted = emits.load(std::memory_order_relaxed);
+  const auto updated = updates.load(std::memory_order_relaxed);
+  json["uptime_s"] = seconds;
+  json["emits"] = Json::UInt64(emitted);
+  json["emits_per_s"] = seconds > 0 ? emitted / seconds : 0.0;
+  json["updates"] = Json::UInt64(updated);
+  // Emits folded into an update that was already pending
+  json["coalesced"] = Json::UInt64(emitted > updated ? emitted - updated : 0);
+  json["label_changes"] = Json::UInt64(label_changes.load(std::memory_order_relaxed));
+  json["label_unchanged"] = Json::UInt64(label_unchanged.load(std::memory_order_relaxed));
+  json["bytes_read"] = Json::UInt64(bytes_read.load(std::memory_order_relaxed));
+  json["children_spawned"] = Json::UInt64(children_spawned.load(std::memory_order_relaxed));
+  json["sample_time"] = sample_time.toJson();
+  json["update_time"] = update_time.toJson();
+  return json;
+}
+
+Json::Value ModuleStats::dump() {
+  Json::Value json(Json::objectValue);
+  std::lock_guard lock(registryMutex());
+  for (const auto& weak : registry()) {
+    if (auto stats = weak.lock()) {
+      // The same module on several bars
+      auto key = stats->name_;
+      for (int n = 2; json.isMember(key); ++n) {
+        key = fmt::format("{} ({})", stats->name_, n);
+      }
+      json[key] = stats->toJson();
+    }
+  }
+  return json;
+}
+
+void ModuleStats::dumpTo(const std::string& path) {
+  if (!enabled()) {
+    spdlog::warn("Module statistics are disabled, run waybar with --stats to collect them");
+    return;
+  }
+  Json::StreamWriterBuilder builder;
+  builder["indentation"] = "  ";
+  const auto content = Json::writeString(builder, dump());
+  if (path.empty()) {
+    spdlog::info("Module statistics: {}", content);
+    return;
+  }
+  std::ofstream file(path, std::ios::trunc);
+  if (!(file << content << '\n')) {
+    spdlog::error("Failed to write module statistics to {}", path);
+    return;
+  }
+  spdlog::info("Module statistics written to {}", path);
+}
+
+}  // namespace waybar::util
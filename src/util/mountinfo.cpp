@@ -0,0 +1,94 @@
+#include "util/mountinfo.hpp"
+
+#include <filesystem>
+
+#include "util/proc_file.hpp"
+
+namespace waybar::util {
+
+namespace {
+
+std::string_view nextField(std::string_view& line) {
+  const auto begin = line.find_first_not_of(' ');
+  if (begin == std::string_view::npos) {
+    line = {};
+    return {};
+  }
+  line.remove_prefix(begin);
+  const auto end = line.find(' ');
+  const auto field = line.substr(0, end);
+  line.remove_prefix(end == std::string_view::npos ? line.size() : end);
+  return field;
+}
+
+// Spaces, tabs, newlines and backslashes are escaped as \ooo
+std::string unescape(std::string_view field) {
+  std::string text;
+  text.reserve(field.size());
+  for (std::size_t i = 0; i < field.size(); i++) {
+    if (field[i] == '\\' && i + 3 < field.size() && field[i + 1] >= '0' && field[i + 1] <= '3' &&
+        field[i + 2] >= '0' && field[i + 2] <= '7' && field[i + 3] >= '0' && field[i + 3] <= '7') {
+      text += static_cast<char>((field[i + 1] - '0') * 64 + (field[i + 2] - '0') * 8 +
+                                (field[i + 3] - '0'));
+      i += 3;
+    } else {
+      text += field[i];
+    }
+  }
+  return text;
+}
+
+}  // namespace
+
+std::vector<MountEntry> parseMountinfo(std::string_view text) {
+  std::vector<MountEntry> mounts;
+  while (!text.empty()) {
+    auto line = nextLine(text);
+    // 36 35 98:0 /mnt1 /mnt/parent rw,noatime master:1 - ext3 /dev/root rw,errors=continue
+    MountEntry mount;
+    nextField(line);
+    nextField(line);
+    auto device = nextField(line);
+    if (!scanUnsigned(device, mount.major) || !device.starts_with(':')) {
+      continue;
+    }
+    device.remove_prefix(1);
+    if (!scanUnsigned(device, mount.minor)) {
+      continue;
+    }
+    nextField(line);
+    mount.mount_point = unescape(nextField(line));
+    // The optional fields end with a lone dash
+    std::string_view field;
+    do {
+      field = nextField(line);
+    } while (!field.empty() && field != "-");
+    mount.fstype = unescape(nextField(line));
+    mount.source = unescape(nextField(line));
+    if (mount.mount_point.empty() || mount.fstype.empty()) {
+      continue;
+    }
+    mounts.push_back(std::move(mount));
+  }
+  return mounts;
+}
+
+const MountEntry* findMount(const std::vector<MountEntry>& mounts, std::string_view path) {
+  const auto normal = std::filesystem::path(path).lexically_normal().string();
+  if (!normal.starts_with('/')) {
+    return nullptr;
+  }
+  const MountEntry* found = nullptr;
+  for (const auto& mount : mounts) {
+    const auto& point = mount.mount_point;
+    const bool contains = normal.starts_with(point) &&
+                          (normal.size() == point.size() || point.ends_with('/') ||
+                           normal[point.size()] == '/');
+    if (contains && (found == nullptr || point.size() >= found->mount_point.size())) {
+      found = &mount;
+    }
+  }
+  return found;
+}
+
+}  // namespace waybar::util
@@ -0,0 +1,387 @@
+#include "util/netlink_monitor.hpp"
+
+#include <linux/rtnetlink.h>
+#include <netlink/genl/ctrl.h>
+#include <netlink/genl/genl.h>
+#include <poll.h>
+#include <spdlog/spdlog.h>
+#include <sys/socket.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+namespace waybar::util {
+
+struct NetlinkMonitor::Subscriber {
+  Subscriber(Callback callback, bool routes) : callback(std::move(callback)), routes(routes) {}
+
+  bool wants(const NetlinkChange& change) const {
+    const int index = ifindex.load(std::memory_order_relaxed);
+    switch (change.kind) {
+      case NetlinkChange::Kind::LINK:
+        return index == -1 || index == change.index;
+      case NetlinkChange::Kind::ADDRESS:
+        return index == change.index;
+      case NetlinkChange::Kind::ROUTE:
+        return routes || index == change.index;
+      case NetlinkChange::Kind::WIRELESS:
+        return change.index == -1 || index == change.index;
+      default:
+        return false;
+    }
+  }
+
+  const Callback callback;
+  const bool routes;
+  std::atomic<int> ifindex{-1};
+};
+
+NetlinkMonitor::Subscription::Subscription(std::shared_ptr<NetlinkMonitor> monitor,
+                                           std::shared_ptr<Subscriber> subscriber)
+    : monitor_(std::move(monitor)), subscriber_(std::move(subscriber)) {}
+
+auto NetlinkMonitor::Subscription::operator=(Subscription&& other) noexcept -> Subscription& {
+  reset();
+  monitor_ = std::move(other.monitor_);
+  subscriber_ = std::move(other.subscriber_);
+  return *this;
+}
+
+void NetlinkMonitor::Subscription::reset() {
+  if (monitor_) {
+    monitor_->unsubscribe(subscriber_);
+    subscriber_.reset();
+    monitor_.reset();
+  }
+}
+
+void NetlinkMonitor::Subscription::setInterface(int ifindex) {
+  if (subscriber_) {
+    subscriber_->ifindex.store(ifindex, std::memory_order_relaxed);
+  }
+}
+
+auto NetlinkMonitor::subscribe(bool routes, Callback callback) -> Subscription {
+  static std::mutex mutex;
+  static std::weak_ptr<NetlinkMonitor> instance;
+
+  std::shared_ptr<NetlinkMonitor> monitor;
+  {
+    std::lock_guard lock(mutex);
+    monitor = instance.lock();
+    if (!monitor) {
+      monitor = std::shared_ptr<NetlinkMonitor>(new NetlinkMonitor());
+      instance = monitor;
+    }
+  }
+  auto subscriber = std::make_shared<Subscriber>(std::move(callback), routes);
+  {
+    std::lock_guard lock(monitor->subscribers_mutex_);
+    monitor->subscribers_.push_back(subscriber);
+  }
+  return Subscription(std::move(monitor), std::move(subscriber));
+}
+
+NetlinkMonitor::NetlinkMonitor() : stats_(ModuleStats::create("netlink")) {
+  sock_.reset(socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE));
+  if (sock_ == -1) {
+    throw std::runtime_error("Can't create network socket");
+  }
+  sockaddr_nl addr{};
+  addr.nl_family = AF_NETLINK;
+  if (bind(sock_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+    throw std::runtime_error("Can't connect network socket");
+  }
+  // Enlarge the socket receive buffer so that a burst of link/address/route change
+  // notifications (e.g. a router reboot or a PPPoE redial) is less likely to overflow it and
+  // make the kernel drop messages (ENOBUFS). Overruns are still handled by resynchronising the
+  // state, but a larger buffer avoids most of them. The kernel caps it at net.core.rmem_max.
+  int buffer_size = 1024 * 1024;
+  setsockopt(sock_, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+  for (int group : {RTNLGRP_LINK, RTNLGRP_IPV4_IFADDR, RTNLGRP_IPV6_IFADDR, RTNLGRP_IPV4_ROUTE,
+                    RTNLGRP_IPV6_ROUTE}) {
+    if (setsockopt(sock_, SOL_NETLINK, NETLINK_ADD_MEMBERSHIP, &group, sizeof(group)) != 0) {
+      throw std::runtime_error("Can't join network notification groups");
+    }
+  }
+
+  nl80211_sock_ = nl_socket_alloc();
+  if (nl80211_sock_ == nullptr || genl_connect(nl80211_sock_) != 0) {
+    nl_socket_free(nl80211_sock_);
+    throw std::runtime_error("Can't connect to netlink socket");
+  }
+  nl80211_id_ = genl_ctrl_resolve(nl80211_sock_, "nl80211");
+  if (nl80211_id_ < 0) {
+    spdlog::warn("Can't resolve nl80211 interface");
+  } else {
+    joinNl80211Groups();
+  }
+
+  {
+    std::lock_guard lock(state_mutex_);
+    requestDump(RTM_GETLINK);
+    requestDump(RTM_GETADDR);
+    requestDump(RTM_GETROUTE);
+    sendNextDump();
+  }
+  thread_ = [this] {
+    const int nl80211_fd = nl80211_events_ != nullptr ? nl_socket_get_fd(nl80211_events_) : -1;
+    std::array<pollfd, 3> fds{{{sock_, POLLIN, 0},
+                               {nl80211_fd, POLLIN, 0},
+                               {thread_.stopFd(), POLLIN, 0}}};
+    if (poll(fds.data(), fds.size(), -1) <= 0 || fds[2].revents != 0) {
+      return;
+    }
+    receive(fds[0].revents != 0, fds[1].revents != 0);
+  };
+}
+
+NetlinkMonitor::~NetlinkMonitor() {
+  thread_.join();
+  if (nl80211_events_ != nullptr) {
+    nl_close(nl80211_events_);
+    nl_socket_free(nl80211_events_);
+  }
+  if (nl80211_sock_ != nullptr) {
+    nl_close(nl80211_sock_);
+    nl_socket_free(nl80211_sock_);
+  }
+}
+
+void NetlinkMonitor::joinNl80211Groups() {
+  auto* sock = nl_socket_alloc();
+  if (sock == nullptr) {
+    return;
+  }
+  nl_socket_disable_seq_check(sock);
+  nl_socket_modify_cb(sock, NL_CB_VALID, NL_CB_CUSTOM, handleNl80211Event, this);
+  bool joined = false;
+  if (genl_connect(sock) == 0) {
+    for (const char* group : {"mlme", "scan", "config"}) {
+      int id = genl_ctrl_resolve_grp(nl80211_sock_, "nl80211", group);
+      if (id >= 0 && nl_socket_add_membership(sock, id) == 0) {
+        joined = true;
+      } else {
+        spdlog::debug("network: can't join the nl80211 {} group", group);
+      }
+    }
+  }
+  // Scan results of a crowded area come in bursts
+  nl_socket_set_buffer_size(sock, 256 * 1024, 0);
+  if (!joined || nl_socket_set_nonblocking(sock) != 0) {
+    spdlog::warn("network: no nl80211 events, the wireless state is polled");
+    nl_socket_free(sock);
+    return;
+  }
+  nl80211_events_ = sock;
+}
+
+int NetlinkMonitor::handleNl80211Event(nl_msg* message, void* data) {
+  auto* monitor = static_cast<NetlinkMonitor*>(data);
+  const auto change = parseNl80211Event(nlmsg_hdr(message));
+  if (change.kind != NetlinkChange::Kind::NONE) {
+    monitor->changes_.push_back(change);
+  }
+  return NL_OK;
+}
+
+void NetlinkMonitor::unsubscribe(const std::shared_ptr<Subscriber>& subscriber) {
+  std::lock_guard lock(subscribers_mutex_);
+  std::erase(subscribers_, subscriber);
+}
+
+std::optional<LinkCounters> NetlinkMonitor::linkStats(int ifindex, std::string_view ifname) {
+  std::lock_guard lock(link_stats_mutex_);
+  return link_stats_.read(ifindex, ifname);
+}
+
+int NetlinkMonitor::nl80211Request(nl_msg* message, nl_recvmsg_msg_cb_t callback, void* arg) {
+  std::lock_guard lock(nl80211_mutex_);
+  int err = nl_socket_modify_cb(nl80211_sock_, NL_CB_VALID, NL_CB_CUSTOM, callback, arg);
+  if (err < 0) {
+    nlmsg_free(message);
+    return err;
+  }
+  return nl_send_sync(nl80211_sock_, message);
+}
+
+void NetlinkMonitor::receive(bool rtnetlink, bool nl80211) {
+  {
+    ModuleStats::Scope scope(stats_.get(), &ModuleStats::sample_time);
+    if (rtnetlink) {
+      receiveRtnetlink();
+    }
+    if (nl80211) {
+      receiveNl80211();
+    }
+  }
+  notify();
+}
+
+void NetlinkMonitor::receiveRtnetlink() {
+  std::lock_guard lock(state_mutex_);
+  // Read as many messages as possible, until the socket blocks
+  while (true) {
+    auto len = recv(sock_, buffer_, sizeof(buffer_), MSG_DONTWAIT);
+    if (len < 0 && errno == EINTR) {
+      continue;
+    }
+    if (len < 0 && errno == ENOBUFS) {
+      // The kernel dropped notifications because the receive buffer overflowed, we have lost
+      // track of the current state (#5122). Dump it again; a dump in progress may have lost
+      // its replies too, so it is restarted.
+      spdlog::warn("network: netlink receive buffer overrun, resyncing state");
+      if (dump_seq_ != 0) {
+        requestDump(dump_type_);
+        dump_seq_ = 0;
+      }
+      dump_busy_ = false;
+      requestDump(RTM_GETLINK);
+      requestDump(RTM_GETADDR);
+      requestDump(RTM_GETROUTE);
+      continue;
+    }
+    if (len < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        spdlog::error("network: netlink receive error: {}", strerror(errno));
+        thread_.stop();
+      }
+      break;
+    }
+    ModuleStats::addBytesRead(len);
+    for (const auto* message = reinterpret_cast<const nlmsghdr*>(buffer_); NLMSG_OK(message, len);
+         message = NLMSG_NEXT(message, len)) {
+      handleMessage(message);
+    }
+  }
+  sendNextDump();
+}
+
+void NetlinkMonitor::receiveNl80211() {
+  while (true) {
+    int rc = nl_recvmsgs_default(nl80211_events_);
+    if (rc == -NLE_AGAIN) {
+      break;
+    }
+    if (rc == -NLE_NOMEM) {
+      // ENOBUFS, events were dropped: every wireless interface is queried again
+      spdlog::warn("network: nl80211 receive buffer overrun, resyncing state");
+      changes_.push_back({.kind = NetlinkChange::Kind::WIRELESS, .index = -1});
+      continue;
+    }
+    if (rc < 0) {
+      spdlog::error("network: nl80211 receive error: {}", nl_geterror(-rc));
+      thread_.stop();
+      break;
+    }
+  }
+}
+
+void NetlinkMonitor::handleMessage(const nlmsghdr* message) {
+  const bool in_dump = dump_seq_ != 0 && message->nlmsg_seq == dump_seq_;
+  switch (message->nlmsg_type) {
+    case NLMSG_DONE:
+      if (in_dump) {
+        state_.endDump();
+        dump_seq_ = 0;
+        notify_all_ = true;
+        if (dump_interrupted_) {
+          // The links changed while being dumped, the reply may be inconsistent
+          requestDump(dump_type_);
+        }
+      } else {
+        // End of a dump abandoned after an overrun, the next one can be sent
+        dump_busy_ = false;
+      }
+      break;
+    case NLMSG_ERROR: {
+      if (!in_dump) {
+        break;
+      }
+      int error = 0;
+      if (message->nlmsg_len >= NLMSG_LENGTH(sizeof(nlmsgerr))) {
+        error = static_cast<const nlmsgerr*>(NLMSG_DATA(message))->error;
+      }
+      if (error == -EBUSY) {
+        // The dump abandoned after an overrun is still running, retry after its end
+        requestDump(dump_type_);
+        dump_busy_ = true;
+      } else {
+        spdlog::error("network: netlink dump failed: {}", strerror(-error));
+      }
+      dump_seq_ = 0;
+      break;
+    }
+    default: {
+      if (in_dump && (message->nlmsg_flags & NLM_F_DUMP_INTR) != 0) {
+        dump_interrupted_ = true;
+      }
+      const auto change = state_.apply(message);
+      // Dump replies are notified all at once when the dump is done
+      if (change.kind != NetlinkChange::Kind::NONE && !in_dump) {
+        changes_.push_back(change);
+      }
+      break;
+    }
+  }
+}
+
+void NetlinkMonitor::requestDump(uint16_t type) {
+  if (std::ranges::find(wanted_dumps_, type) == wanted_dumps_.end()) {
+    wanted_dumps_.push_back(type);
+  }
+}
+
+void NetlinkMonitor::sendNextDump() {
+  // Dumps on a socket can't overlap, the next one is sent once the current one is done
+  if (dump_seq_ != 0 || dump_busy_ || wanted_dumps_.empty()) {
+    return;
+  }
+  struct {
+    nlmsghdr header;
+    rtgenmsg body;
+  } request{};
+  request.header.nlmsg_len = sizeof(request);
+  request.header.nlmsg_type = wanted_dumps_.front();
+  request.header.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+  request.header.nlmsg_seq = ++seq_ == 0 ? ++seq_ : seq_;
+  request.body.rtgen_family = AF_UNSPEC;
+  if (send(sock_, &request, sizeof(request), 0) < 0) {
+    spdlog::error("network: failed to ask for a netlink dump: {}", strerror(errno));
+    return;
+  }
+  dump_type_ = wanted_dumps_.front();
+  dump_seq_ = request.header.nlmsg_seq;
+  dump_interrupted_ = false;
+  wanted_dumps_.erase(wanted_dumps_.begin());
+  state_.beginDump(dump_type_);
+}
+
+void NetlinkMonitor::notify() {
+  if (changes_.empty() && !notify_all_) {
+    return;
+  }
+  // Callbacks are invoked with the lock held so a module cannot be destroyed while it is
+  // being notified.
+  std::lock_guard lock(subscribers_mutex_);
+  for (const auto& subscriber : subscribers_) {
+    NetlinkNotification notification{.state = notify_all_};
+    for (const auto& change : changes_) {
+      if (subscriber->wants(change)) {
+        notification.add(change);
+      }
+    }
+    if (!notification.empty()) {
+      subscriber->callback(notification);
+    }
+  }
+  changes_.clear();
+  notify_all_ = false;
+}
+
+}  // namespace waybar::util
@@ -0,0 +1,308 @@
+#include "util/netlink_state.hpp"
+
+#include <arpa/inet.h>
+#include <linux/if_addr.h>
+#include <linux/genetlink.h>
+#include <linux/if_link.h>
+#include <linux/nl80211.h>
+#include <linux/rtnetlink.h>
+#include <net/if.h>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <utility>
+
+namespace waybar::util {
+
+namespace {
+
+std::string attributeString(const rtattr* rta) {
+  const auto* data = static_cast<const char*>(RTA_DATA(rta));
+  return {data, strnlen(data, RTA_PAYLOAD(rta))};
+}
+
+std::string attributeAddress(int family, const rtattr* rta) {
+  const std::size_t size = family == AF_INET ? 4 : family == AF_INET6 ? 16 : 0;
+  char address[INET6_ADDRSTRLEN];
+  if (size == 0 || RTA_PAYLOAD(rta) < size ||
+      inet_ntop(family, RTA_DATA(rta), address, sizeof(address)) == nullptr) {
+    return {};
+  }
+  return address;
+}
+
+template <typename T>
+T attributeValue(const rtattr* rta) {
+  T value{};
+  if (RTA_PAYLOAD(rta) >= sizeof(value)) {
+    std::memcpy(&value, RTA_DATA(rta), sizeof(value));
+  }
+  return value;
+}
+
+// Generic netlink attributes by type, the ones above N - 1 are ignored
+template <std::size_t N>
+std::array<const nlattr*, N> parseAttributes(const void* data, std::size_t len) {
+  std::array<const nlattr*, N> attributes{};
+  const auto* next = static_cast<const char*>(data);
+  while (len >= NLA_HDRLEN) {
+    const auto* nla = reinterpret_cast<const nlattr*>(next);
+    if (nla->nla_len < NLA_HDRLEN || nla->nla_len > len) {
+      break;
+    }
+    const auto type = nla->nla_type & NLA_TYPE_MASK;
+    if (type < N) {
+      attributes[type] = nla;
+    }
+    const std::size_t aligned = std::min<std::size_t>(NLA_ALIGN(nla->nla_len), len);
+    next += aligned;
+    len -= aligned;
+  }
+  return attributes;
+}
+
+const void* attributeData(const nlattr* nla) {
+  return reinterpret_cast<const char*>(nla) + NLA_HDRLEN;
+}
+
+std::size_t attributePayload(const nlattr* nla) { return nla->nla_len - NLA_HDRLEN; }
+
+template <typename T>
+T attributeValue(const nlattr* nla) {
+  T value{};
+  if (attributePayload(nla) >= sizeof(value)) {
+    std::memcpy(&value, attributeData(nla), sizeof(value));
+  }
+  return value;
+}
+
+}  // namespace
+
+void NetlinkNotification::add(const NetlinkChange& change) {
+  if (change.kind != NetlinkChange::Kind::WIRELESS) {
+    state = true;
+  } else if (change.signal_dbm.has_value()) {
+    signal_dbm = change.signal_dbm;
+  } else {
+    wireless = true;
+  }
+}
+
+NetlinkChange parseNl80211Event(const nlmsghdr* message) {
+  if (message->nlmsg_len < NLMSG_LENGTH(GENL_HDRLEN)) {
+    return {};
+  }
+  const auto* genl = static_cast<const genlmsghdr*>(NLMSG_DATA(message));
+  const auto tb = parseAttributes<NL80211_ATTR_MAX + 1>(
+      reinterpret_cast<const char*>(genl) + GENL_HDRLEN,
+      message->nlmsg_len - NLMSG_LENGTH(GENL_HDRLEN));
+  if (tb[NL80211_ATTR_IFINDEX] == nullptr) {
+    return {};
+  }
+  NetlinkChange change{
+      .kind = NetlinkChange::Kind::WIRELESS,
+      .index = static_cast<int>(attributeValue<uint32_t>(tb[NL80211_ATTR_IFINDEX]))};
+  switch (genl->cmd) {
+    case NL80211_CMD_NOTIFY_CQM:
+      // The signal crossed a threshold set by the supplicant. Without the level (older
+      // kernels, beacon or packet loss events), the state is queried instead.
+      if (tb[NL80211_ATTR_CQM] != nullptr) {
+        const auto cqm = parseAttributes<NL80211_ATTR_CQM_MAX + 1>(
+            attributeData(tb[NL80211_ATTR_CQM]), attributePayload(tb[NL80211_ATTR_CQM]));
+        if (cqm[NL80211_ATTR_CQM_RSSI_LEVEL] != nullptr) {
+          change.signal_dbm = attributeValue<int32_t>(cqm[NL80211_ATTR_CQM_RSSI_LEVEL]);
+        }
+      }
+      return change;
+    case NL80211_CMD_CONNECT:
+    case NL80211_CMD_ROAM:
+    case NL80211_CMD_DISCONNECT:
+    case NL80211_CMD_ASSOCIATE:
+    case NL80211_CMD_DISASSOCIATE:
+    case NL80211_CMD_DEAUTHENTICATE:
+    case NL80211_CMD_NEW_SCAN_RESULTS:
+    case NL80211_CMD_CH_SWITCH_NOTIFY:
+    case NL80211_CMD_NEW_INTERFACE:
+    case NL80211_CMD_SET_INTERFACE:
+    case NL80211_CMD_DEL_INTERFACE:
+      return change;
+    default:
+      // Scan requests, frames and regulatory changes don't change what is displayed
+      return {};
+  }
+}
+
+NetlinkChange NetlinkState::apply(const nlmsghdr* message) {
+  switch (message->nlmsg_type) {
+    case RTM_NEWLINK:
+    case RTM_DELLINK:
+      return applyLink(message);
+    case RTM_NEWADDR:
+    case RTM_DELADDR:
+      return applyAddress(message);
+    case RTM_NEWROUTE:
+    case RTM_DELROUTE:
+      return applyRoute(message);
+    default:
+      return {};
+  }
+}
+
+void NetlinkState::beginDump(uint16_t type) {
+  generation_++;
+  dump_type_ = type;
+}
+
+void NetlinkState::endDump() {
+  auto stale = [this](const auto& entry) { return entry.generation != generation_; };
+  switch (dump_type_) {
+    case RTM_GETLINK:
+      std::erase_if(links_, [&stale](const auto& entry) { return stale(entry.second); });
+      break;
+    case RTM_GETADDR:
+      std::erase_if(addresses_, stale);
+      break;
+    case RTM_GETROUTE:
+      std::erase_if(routes_, stale);
+      break;
+  }
+  dump_type_ = 0;
+}
+
+NetlinkChange NetlinkState::applyLink(const nlmsghdr* message) {
+  if (message->nlmsg_len < NLMSG_LENGTH(sizeof(ifinfomsg))) {
+    return {};
+  }
+  const auto* ifi = static_cast<const ifinfomsg*>(NLMSG_DATA(message));
+  const int index = ifi->ifi_index;
+  const NetlinkChange change{.kind = NetlinkChange::Kind::LINK, .index = index};
+  if (message->nlmsg_type == RTM_DELLINK) {
+    links_.erase(index);
+    std::erase_if(addresses_, [index](const auto& address) { return address.index == index; });
+    std::erase_if(routes_, [index](const auto& route) { return route.oif == index; });
+    return change;
+  }
+
+  auto& link = links_[index];
+  link.index = index;
+  link.flags = ifi->ifi_flags;
+  link.generation = generation_;
+  link.altnames.clear();
+  int len = static_cast<int>(message->nlmsg_len - NLMSG_LENGTH(sizeof(*ifi)));
+  for (const auto* rta = IFLA_RTA(ifi); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+    switch (rta->rta_type & NLA_TYPE_MASK) {
+      case IFLA_IFNAME:
+        link.ifname = attributeString(rta);
+        break;
+      case IFLA_CARRIER:
+        link.carrier = attributeValue<uint8_t>(rta) == 1;
+        break;
+      case IFLA_PROP_LIST: {
+        int nested_len = static_cast<int>(RTA_PAYLOAD(rta));
+        for (const auto* prop = static_cast<const rtattr*>(RTA_DATA(rta));
+             RTA_OK(prop, nested_len); prop = RTA_NEXT(prop, nested_len)) {
+          if ((prop->rta_type & NLA_TYPE_MASK) == IFLA_ALT_IFNAME) {
+            link.altnames.push_back(attributeString(prop));
+          }
+        }
+        break;
+      }
+    }
+  }
+  if ((ifi->ifi_flags & IFF_UP) == 0) {
+    // The routes of a link going down are flushed without a notification for each
+    std::erase_if(routes_, [index](const auto& route) { return route.oif == index; });
+  }
+  return change;
+}
+
+NetlinkChange NetlinkState::applyAddress(const nlmsghdr* message) {
+  if (message->nlmsg_len < NLMSG_LENGTH(sizeof(ifaddrmsg))) {
+    return {};
+  }
+  const auto* ifa = static_cast<const ifaddrmsg*>(NLMSG_DATA(message));
+  NetlinkAddress address{.index = static_cast<int>(ifa->ifa_index),
+                         .family = ifa->ifa_family,
+                         .prefixlen = ifa->ifa_prefixlen,
+                         .scope = ifa->ifa_scope,
+                         .generation = generation_};
+  int len = static_cast<int>(IFA_PAYLOAD(message));
+  for (const auto* rta = IFA_RTA(ifa); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+    if (rta->rta_type == IFA_ADDRESS) {
+      address.address = attributeAddress(address.family, rta);
+    } else if (rta->rta_type == IFA_LOCAL) {
+      address.local = attributeAddress(address.family, rta);
+    }
+  }
+
+  const auto it = std::ranges::find_if(addresses_, [&address](const auto& other) {
+    return other.index == address.index && other.family == address.family &&
+           other.prefixlen == address.prefixlen && other.address == address.address &&
+           other.local == address.local;
+  });
+  if (message->nlmsg_type == RTM_DELADDR) {
+    if (it != addresses_.end()) {
+      addresses_.erase(it);
+    }
+  } else if (it != addresses_.end()) {
+    *it = std::move(address);
+  } else {
+    addresses_.push_back(std::move(address));
+  }
+  return {.kind = NetlinkChange::Kind::ADDRESS, .index = static_cast<int>(ifa->ifa_index)};
+}
+
+NetlinkChange NetlinkState::applyRoute(const nlmsghdr* message) {
+  if (message->nlmsg_len < NLMSG_LENGTH(sizeof(rtmsg))) {
+    return {};
+  }
+  const auto* rtm = static_cast<const rtmsg*>(NLMSG_DATA(message));
+  // A destination like 0.0.0.0/24 is not a default route
+  if (rtm->rtm_table != RT_TABLE_MAIN || rtm->rtm_dst_len != 0) {
+    return {};
+  }
+  NetlinkRoute route{.family = rtm->rtm_family, .generation = generation_};
+  bool has_destination = false;
+  int len = static_cast<int>(RTM_PAYLOAD(message));
+  for (const auto* rta = RTM_RTA(rtm); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+    switch (rta->rta_type) {
+      case RTA_GATEWAY:
+        route.gateway = attributeAddress(route.family, rta);
+        break;
+      case RTA_DST: {
+        // Either missing or all 0s for a default route
+        const auto* dest = static_cast<const unsigned char*>(RTA_DATA(rta));
+        has_destination = std::any_of(dest, dest + RTA_PAYLOAD(rta), [](auto b) { return b != 0; });
+        break;
+      }
+      case RTA_OIF:
+        route.oif = attributeValue<int>(rta);
+        break;
+      case RTA_PRIORITY:
+        route.priority = attributeValue<uint32_t>(rta);
+        break;
+    }
+  }
+  if (route.gateway.empty() || has_destination || route.oif == -1) {
+    return {};
+  }
+
+  const auto it = std::ranges::find_if(routes_, [&route](const auto& other) {
+    return other.family == route.family && other.oif == route.oif &&
+           other.priority == route.priority;
+  });
+  const int oif = route.oif;
+  if (message->nlmsg_type == RTM_DELROUTE) {
+    if (it != routes_.end()) {
+      routes_.erase(it);
+    }
+  } else if (it != routes_.end()) {
+    *it = std::move(route);
+  } else {
+    routes_.push_back(std::move(route));
+  }
+  return {.kind = NetlinkChange::Kind::ROUTE, .index = oif};
+}
+
+}  // namespace waybar::util
@@ -0,0 +1,123 @@
+#include "util/power_supply.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <charconv>
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+
+namespace waybar::util {
+
+namespace {
+
+using Property = std::optional<int64_t> PowerSupplyReadings::*;
+
+// Attribute file names, the uevent has them uppercased
+constexpr std::array<std::pair<std::string_view, Property>, 16> PROPERTIES = {{
+    {"online", &PowerSupplyReadings::online},
+    {"capacity", &PowerSupplyReadings::capacity},
+    {"current_now", &PowerSupplyReadings::current_now},
+    {"current_avg", &PowerSupplyReadings::current_avg},
+    {"voltage_now", &PowerSupplyReadings::voltage_now},
+    {"voltage_avg", &PowerSupplyReadings::voltage_avg},
+    {"power_now", &PowerSupplyReadings::power_now},
+    {"charge_now", &PowerSupplyReadings::charge_now},
+    {"charge_full", &PowerSupplyReadings::charge_full},
+    {"charge_full_design", &PowerSupplyReadings::charge_full_design},
+    {"energy_now", &PowerSupplyReadings::energy_now},
+    {"energy_full", &PowerSupplyReadings::energy_full},
+    {"energy_full_design", &PowerSupplyReadings::energy_full_design},
+    {"time_to_empty_now", &PowerSupplyReadings::time_to_empty_now},
+    {"time_to_full_now", &PowerSupplyReadings::time_to_full_now},
+    {"cycle_count", &PowerSupplyReadings::cycle_count},
+}};
+
+constexpr std::string_view UEVENT_PREFIX = "POWER_SUPPLY_";
+
+bool equalsUppercased(std::string_view upper, std::string_view name) {
+  return std::ranges::equal(upper, name, [](char a, char b) {
+    return a == std::toupper(static_cast<unsigned char>(b));
+  });
+}
+
+std::optional<int64_t> parseNumber(std::string_view text) {
+  int64_t value = 0;
+  const auto* end = text.data() + text.size();
+  const auto [ptr, ec] = std::from_chars(text.data(), end, value);
+  if (ec != std::errc() || ptr == text.data()) {
+    return std::nullopt;
+  }
+  return value;
+}
+
+}  // namespace
+
+bool PowerSupplyReadings::empty() const {
+  return status.empty() && std::ranges::none_of(PROPERTIES, [this](const auto& property) {
+           return (this->*property.second).has_value();
+         });
+}
+
+void PowerSupplyReadings::clear() {
+  status.clear();
+  for (const auto& [name, property] : PROPERTIES) {
+    (this->*property).reset();
+  }
+}
+
+void parsePowerSupplyUevent(std::string_view uevent, PowerSupplyReadings& readings) {
+  while (!uevent.empty()) {
+    auto line = nextLine(uevent);
+    if (!line.starts_with(UEVENT_PREFIX)) {
+      continue;
+    }
+    line.remove_prefix(UEVENT_PREFIX.size());
+    const auto equal = line.find('=');
+    if (equal == std::string_view::npos) {
+      continue;
+    }
+    const auto key = line.substr(0, equal);
+    const auto value = line.substr(equal + 1);
+    if (key == "STATUS") {
+      readings.status = value;
+      continue;
+    }
+    const auto property = std::ranges::find_if(
+        PROPERTIES, [key](const auto& p) { return equalsUppercased(key, p.first); });
+    if (property != PROPERTIES.end()) {
+      readings.*(property->second) = parseNumber(value);
+    }
+  }
+}
+
+void readPowerSupplyAttributes(const std::filesystem::path& dir, PowerSupplyReadings& readings) {
+  // for hotplug-in device, access it is always unstable because you may remove the
+  // device anytime so just allow failure happen and do nothing
+  std::getline(std::ifstream(dir / "status"), readings.status);
+  for (const auto& [name, property] : PROPERTIES) {
+    int64_t value = 0;
+    if (std::ifstream(dir / name) >> value) {
+      readings.*property = value;
+    }
+  }
+}
+
+PowerSupply::PowerSupply(std::filesystem::path dir)
+    : dir_(std::move(dir)), uevent_((dir_ / "uevent").string()) {}
+
+const PowerSupplyReadings& PowerSupply::read() {
+  readings_.clear();
+  try {
+    parsePowerSupplyUevent(uevent_.read(), readings_);
+  } catch (const std::runtime_error&) {
+    // The device may be going away, or there is no uevent
+  }
+  if (readings_.empty()) {
+    readPowerSupplyAttributes(dir_, readings_);
+  }
+  return readings_;
+}
+
+}  // namespace waybar::util
@@ -0,0 +1,63 @@
+#include "util/proc_file.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#include "util/module_stats.hpp"
+
+namespace waybar::util {
+
+namespace {
+
+// Fits /proc/stat of a few dozen cpus and most sysfs attributes without growing
+constexpr std::size_t INITIAL_BUFFER_SIZE = 4096;
+
+}  // namespace
+
+ProcFile::ProcFile(std::string path) : path_(std::move(path)) {
+  fd_.reset(open(path_.c_str(), O_RDONLY | O_CLOEXEC));
+}
+
+std::string_view ProcFile::read() {
+  if (fd_ == -1) {
+    fd_.reset(open(path_.c_str(), O_RDONLY | O_CLOEXEC));
+    if (fd_ == -1) {
+      throw std::runtime_error("Can't open " + path_);
+    }
+  }
+  if (buffer_.empty()) {
+    buffer_.resize(INITIAL_BUFFER_SIZE);
+  }
+
+  std::size_t size = 0;
+  while (true) {
+    if (size == buffer_.size()) {
+      buffer_.resize(buffer_.size() * 2);
+    }
+    const auto n = pread(fd_, buffer_.data() + size, buffer_.size() - size, size);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      const auto error = errno;
+      fd_.reset();
+      throw std::runtime_error("Can't read " + path_ + ": " + std::strerror(error));
+    }
+    // Files of several records hand out about a page per read whatever the room left, only an
+    // empty read is the end
+    if (n == 0) {
+      break;
+    }
+    size += n;
+  }
+
+  ModuleStats::addBytesRead(size);
+  return {buffer_.data(), size};
+}
+
+}  // namespace waybar::util
@@ -0,0 +1,358 @@
+#include "util/scheduler.hpp"
+
+#include <spdlog/spdlog.h>
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+#include <algorithm>
+#include <exception>
+
+#include "util/prepare_for_sleep.h"
+
+namespace waybar::util {
+
+struct Scheduler::Job {
+  std::function<void()> func;
+  std::chrono::milliseconds interval;
+  bool align;
+  // Bumped whenever the job is rescheduled, so stale heap entries can be skipped lazily
+  uint64_t generation{0};
+  bool paused{false};
+  // The job came due while paused and must be rearmed on resume
+  bool parked{false};
+  bool queued{false};
+  bool running{false};
+  // wake_up() was called while the job was running
+  bool rerun{false};
+  bool cancelled{false};
+  // Run a single time, see BackgroundTask
+  bool once{false};
+  // An overrun was already logged
+  bool overran{false};
+  std::thread::id runner;
+};
+
+Scheduler* Scheduler::inst() {
+  static auto* scheduler = new Scheduler();
+  return scheduler;
+}
+
+Scheduler::Scheduler() : timer_thread_([this] { timerLoop(); }) {
+  // Same behaviour as SleeperThread: refresh everything right after resuming from sleep
+  prepare_for_sleep().connect([this](bool sleep) {
+    if (not sleep) wakeUpAll();
+  });
+}
+
+std::size_t Scheduler::threadCount() {
+  std::lock_guard lock(mutex_);
+  return workers_.size() + 1;
+}
+
+void Scheduler::setTimerSlack(std::chrono::milliseconds slack) {
+  std::lock_guard lock(mutex_);
+  slack_ = std::max(slack, std::chrono::milliseconds::zero());
+  slack_ms_ = slack_.count();
+  spdlog::debug("Scheduler timer slack set to {}ms", slack_.count());
+}
+
+std::chrono::milliseconds Scheduler::timerSlack() {
+  std::lock_guard lock(mutex_);
+  return slack_;
+}
+
+uint64_t Scheduler::wakeups() {
+  std::lock_guard lock(mutex_);
+  return wakeups_;
+}
+
+uint64_t Scheduler::overruns() {
+  std::lock_guard lock(mutex_);
+  return overruns_;
+}
+
+Scheduler::clock::duration Scheduler::nextDelay(std::chrono::milliseconds interval, bool align,
+                                                std::chrono::milliseconds slack,
+                                                std::chrono::system_clock::duration since_epoch) {
+  auto delay = std::chrono::duration_cast<clock::duration>(interval);
+  if (align) {
+    delay -= since_epoch % interval;
+  }
+  if (slack > std::chrono::milliseconds::zero()) {
+    // Round the due time up to the shared grid, so jobs due close to each other fire together
+    auto remainder = (since_epoch + delay) % slack;
+    if (remainder > clock::duration::zero()) {
+      delay += slack - remainder;
+    }
+  }
+  return delay;
+}
+
+// Must be called with mutex_ held
+Scheduler::clock::duration Scheduler::nextDelay(const Job& job) const {
+  return nextDelay(job.interval, job.align, slack_,
+                   std::chrono::system_clock::now().time_since_epoch());
+}
+
+// Must be called with mutex_ held
+void Scheduler::countWakeup() {
+  ++wakeups_;
+  const auto now = clock::now();
+  const auto elapsed = now - report_start_;
+  if (elapsed >= std::chrono::minutes(1)) {
+    spdlog::debug("Scheduler: {:.2f} wakeups/s",
+                  static_cast<double>(wakeups_ - report_wakeups_) /
+                      std::chrono::duration<double>(elapsed).count());
+    report_wakeups_ = wakeups_;
+    report_start_ = now;
+  }
+}
+
+void Scheduler::applyTimerSlack(std::chrono::milliseconds::rep& applied) const {
+#ifdef __linux__
+  const auto slack = slack_ms_.load(std::memory_order_relaxed);
+  if (slack != applied) {
+    // 0 restores the default slack of the thread
+    prctl(PR_SET_TIMERSLACK, static_cast<unsigned long>(slack) * 1000000UL);
+    applied = slack;
+  }
+#endif
+}
+
+void Scheduler::add(const std::shared_ptr<Job>& job) {
+  std::lock_guard lock(mutex_);
+  std::erase_if(jobs_, [](const auto& weak) { return weak.expired(); });
+  jobs_.push_back(job);
+  dispatch(job);
+}
+
+void Scheduler::wakeUp(const std::shared_ptr<Job>& job) {
+  std::lock_guard lock(mutex_);
+  if (!job->cancelled) {
+    job->parked = false;
+    dispatch(job);
+  }
+}
+
+void Scheduler::wakeUpAll() {
+  std::lock_guard lock(mutex_);
+  for (const auto& weak : jobs_) {
+    if (auto job = weak.lock(); job && !job->cancelled) {
+      job->parked = false;
+      dispatch(job);
+    }
+  }
+}
+
+void Scheduler::pause(const std::shared_ptr<Job>& job) {
+  std::lock_guard lock(mutex_);
+  job->paused = true;
+}
+
+void Scheduler::resume(const std::shared_ptr<Job>& job) {
+  std::lock_guard lock(mutex_);
+  job->paused = false;
+  if (job->parked && !job->cancelled) {
+    job->parked = false;
+    arm(job, clock::now() + nextDelay(*job));
+  }
+}
+
+void Scheduler::remove(const std::shared_ptr<Job>& job) {
+  std::unique_lock lock(mutex_);
+  job->cancelled = true;
+  job->generation++;
+  if (job->queued) {
+    std::erase(ready_, job);
+    job->queued = false;
+  }
+  if (job->running && job->runner != std::this_thread::get_id()) {
+    done_cv_.wait(lock, [&job] { return !job->running; });
+  }
+  std::erase_if(jobs_, [&job](const auto& weak) { return weak.expired() || weak.lock() == job; });
+}
+
+// Must be called with mutex_ held
+void Scheduler::arm(const std::shared_ptr<Job>& job, clock::time_point due) {
+  job->generation++;
+  const bool earliest = heap_.empty() || due < heap_.top().due;
+  heap_.push({due, job->generation, job});
+  if (earliest) {
+    timer_cv_.notify_one();
+  }
+}
+
+// Must be called with mutex_ held
+void Scheduler::dispatch(const std::shared_ptr<Job>& job) {
+  if (job->running) {
+    job->rerun = true;
+    return;
+  }
+  if (job->queued) {
+    return;
+  }
+  // Drop the pending timer entry, the job is rearmed after this run
+  job->generation++;
+  job->queued = true;
+  ready_.push_back(job);
+  if (ready_.size() > idle_workers_ && workers_.size() < MAX_WORKERS) {
+    workers_.emplace_back([this] { workerLoop(); });
+  }
+  work_cv_.notify_one();
+}
+
+void Scheduler::timerLoop() {
+  std::chrono::milliseconds::rep applied_slack = 0;
+  // Set when the thread slept since it last dispatched a job
+  bool slept = true;
+  std::unique_lock lock(mutex_);
+  while (true) {
+    applyTimerSlack(applied_slack);
+    while (!heap_.empty() && heap_.top().generation != heap_.top().job->generation) {
+      heap_.pop();
+    }
+    if (heap_.empty()) {
+      timer_cv_.wait(lock);
+      slept = true;
+      continue;
+    }
+    // Jobs rounded up to the same grid point are a few microseconds apart, run the ones right
+    // behind a job that just fired in the same wakeup
+    const auto now = clock::now();
+    const bool straggler = !slept && heap_.top().due <= now + slack_ / 2;
+    if (now < heap_.top().due && !straggler) {
+      timer_cv_.wait_until(lock, heap_.top().due);
+      slept = true;
+      continue;
+    }
+    auto job = heap_.top().job;
+    heap_.pop();
+    if (job->cancelled) {
+      continue;
+    }
+    if (job->paused) {
+      job->parked = true;
+      continue;
+    }
+    if (slept) {
+      countWakeup();
+      slept = false;
+    }
+    dispatch(job);
+  }
+}
+
+void Scheduler::workerLoop() {
+  std::chrono::milliseconds::rep applied_slack = 0;
+  std::unique_lock lock(mutex_);
+  while (true) {
+    applyTimerSlack(applied_slack);
+    ++idle_workers_;
+    work_cv_.wait(lock, [this] { return !ready_.empty(); });
+    --idle_workers_;
+
+    auto job = ready_.front();
+    ready_.pop_front();
+    job->queued = false;
+    if (job->cancelled) {
+      continue;
+    }
+    job->running = true;
+    job->runner = std::this_thread::get_id();
+    lock.unlock();
+
+    const auto start = clock::now();
+    try {
+      job->func();
+    } catch (const std::exception& e) {
+      spdlog::error("Scheduled job failed: {}", e.what());
+    }
+    const auto elapsed = clock::now() - start;
+
+    lock.lock();
+    // Background tasks are allowed to block, they run once
+    const auto limit = job->interval > std::chrono::milliseconds::zero()
+                           ? std::min(job->interval, SLOW_JOB)
+                           : SLOW_JOB;
+    if (!job->once && elapsed > limit) {
+      overruns_++;
+      if (!job->overran) {
+        job->overran = true;
+        spdlog::warn(
+            "Scheduler: a job ran for {}ms with an interval of {}ms, it blocks the other modules",
+            std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count(),
+            job->interval.count());
+      }
+    }
+    job->running = false;
+    job->runner = {};
+    if (job->once) {
+      job->cancelled = true;
+    } else if (!job->cancelled) {
+      if (job->rerun) {
+        job->rerun = false;
+        dispatch(job);
+      } else if (job->interval > std::chrono::milliseconds::zero() &&
+                 job->interval != std::chrono::milliseconds::max()) {
+        arm(job, clock::now() + nextDelay(*job));
+      }
+    }
+    done_cv_.notify_all();
+  }
+}
+
+void PeriodicTask::start(std::function<void()> func, std::chrono::milliseconds interval,
+                         bool align) {
+  stop();
+  job_ = std::make_shared<Scheduler::Job>();
+  job_->func = std::move(func);
+  job_->interval = interval;
+  job_->align = align && interval > std::chrono::milliseconds::zero() &&
+                interval != std::chrono::milliseconds::max();
+  Scheduler::inst()->add(job_);
+}
+
+void PeriodicTask::wake_up() {
+  if (job_) {
+    Scheduler::inst()->wakeUp(job_);
+  }
+}
+
+void PeriodicTask::pause() {
+  if (job_) {
+    Scheduler::inst()->pause(job_);
+  }
+}
+
+void PeriodicTask::resume() {
+  if (job_) {
+    Scheduler::inst()->resume(job_);
+  }
+}
+
+void PeriodicTask::stop() {
+  if (job_) {
+    Scheduler::inst()->remove(job_);
+    job_.reset();
+  }
+}
+
+void BackgroundTask::start(std::function<void()> func) {
+  stop();
+  job_ = std::make_shared<Scheduler::Job>();
+  job_->func = std::move(func);
+  job_->interval = std::chrono::milliseconds::max();
+  job_->align = false;
+  job_->once = true;
+  Scheduler::inst()->add(job_);
+}
+
+void BackgroundTask::stop() {
+  if (job_) {
+    Scheduler::inst()->remove(job_);
+    job_.reset();
+  }
+}
+
+}  // namespace waybar::util
@@ -0,0 +1,224 @@
+#include "util/startup_profile.hpp"
+
+#include <fmt/format.h>
+#ifdef __linux__
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace waybar::util {
+
+namespace {
+
+using clock = std::chrono::steady_clock;
+
+struct Phase {
+  std::string name;
+  clock::time_point start;
+  clock::time_point end;
+  std::thread::id thread;
+  bool mark;
+};
+
+struct Profile {
+  std::mutex mutex;
+  clock::time_point origin;
+  std::thread::id main_thread;
+  std::vector<Phase> phases;
+  int expected_frames{0};
+  bool batch_done{false};
+  // Set after the first enable(), later ones are reloads
+  bool enabled_once{false};
+};
+
+std::atomic<bool> profile_enabled{false};
+
+Profile& profile() {
+  static auto* profile = new Profile();
+  return *profile;
+}
+
+void record(Phase phase) {
+  auto& p = profile();
+  std::lock_guard lock(p.mutex);
+  p.phases.push_back(std::move(phase));
+}
+
+// Time elapsed since the process started
+std::optional<clock::duration> sinceProcessStart() {
+#ifdef __linux__
+  std::ifstream stat("/proc/self/stat");
+  std::string content;
+  if (!std::getline(stat, content)) {
+    return std::nullopt;
+  }
+  // The command name may contain spaces, count the fields from its closing parenthesis
+  const auto comm_end = content.rfind(')');
+  if (comm_end == std::string::npos || comm_end + 2 > content.size()) {
+    return std::nullopt;
+  }
+  std::istringstream fields(content.substr(comm_end + 2));
+  std::string skipped;
+  // starttime is field 22, in clock ticks since boot; field 3 follows the command name
+  for (int field = 3; field < 22 && fields >> skipped; ++field) {
+  }
+  unsigned long long start_ticks = 0;
+  timespec now{};
+  const long ticks_per_second = sysconf(_SC_CLK_TCK);
+  if (!(fields >> start_ticks) || ticks_per_second <= 0 ||
+      clock_gettime(CLOCK_BOOTTIME, &now) != 0) {
+    return std::nullopt;
+  }
+  const auto uptime = std::chrono::seconds(now.tv_sec) + std::chrono::nanoseconds(now.tv_nsec);
+  const auto started = std::chrono::nanoseconds(start_ticks * 1000000000ULL / ticks_per_second);
+  if (started > uptime) {
+    return std::nullopt;
+  }
+  return std::chrono::duration_cast<clock::duration>(uptime - started);
+#else
+  return std::nullopt;
+#endif
+}
+
+double offsetMs(clock::time_point origin, clock::time_point point) {
+  return std::chrono::duration<double, std::milli>(point - origin).count();
+}
+
+}  // namespace
+
+StartupProfile::Span::Span(std::string name) {
+  if (!enabled()) {
+    return;
+  }
+  name_ = std::move(name);
+  start_ = clock::now();
+  active_ = true;
+}
+
+StartupProfile::Span::~Span() {
+  if (active_ && enabled()) {
+    record({std::move(name_), start_, clock::now(), std::this_thread::get_id(), false});
+  }
+}
+
+void StartupProfile::enable() {
+  auto& p = profile();
+  const auto now = clock::now();
+  {
+    std::lock_guard lock(p.mutex);
+    p.main_thread = std::this_thread::get_id();
+    p.phases.clear();
+    p.expected_frames = 0;
+    p.batch_done = false;
+    // A reload is timed from here, not from the start of the process
+    p.origin = now;
+    if (!p.enabled_once) {
+      p.origin -= sinceProcessStart().value_or(clock::duration::zero());
+    }
+    p.enabled_once = true;
+    if (p.origin != now) {
+      p.phases.push_back({"process start to main", p.origin, now, p.main_thread, false});
+    }
+  }
+  profile_enabled.store(true, std::memory_order_relaxed);
+}
+
+bool StartupProfile::enabled() { return profile_enabled.load(std::memory_order_relaxed); }
+
+void StartupProfile::mark(const std::string& name) {
+  if (!enabled()) {
+    return;
+  }
+  const auto now = clock::now();
+  record({name, now, now, std::this_thread::get_id(), true});
+}
+
+void StartupProfile::expectFrame() {
+  if (!enabled()) {
+    return;
+  }
+  auto& p = profile();
+  std::lock_guard lock(p.mutex);
+  if (!p.batch_done) {
+    ++p.expected_frames;
+  }
+}
+
+void StartupProfile::frameDone(const std::string& output) {
+  if (!enabled()) {
+    return;
+  }
+  mark("first frame on " + output);
+  auto& p = profile();
+  bool done = false;
+  {
+    std::lock_guard lock(p.mutex);
+    --p.expected_frames;
+    done = p.batch_done && p.expected_frames <= 0;
+  }
+  if (done) {
+    report();
+  }
+}
+
+void StartupProfile::batchDone() {
+  if (!enabled()) {
+    return;
+  }
+  auto& p = profile();
+  bool done = false;
+  {
+    std::lock_guard lock(p.mutex);
+    p.batch_done = true;
+    done = p.expected_frames <= 0;
+  }
+  if (done) {
+    report();
+  }
+}
+
+void StartupProfile::report() {
+  // Only the first caller prints
+  if (!profile_enabled.exchange(false)) {
+    return;
+  }
+  auto& p = profile();
+  std::lock_guard lock(p.mutex);
+  std::stable_sort(p.phases.begin(), p.phases.end(),
+                   [](const auto& a, const auto& b) { return a.start < b.start; });
+
+  // Name the other threads in order of appearance
+  std::map<std::thread::id, std::string> threads{{p.main_thread, "main"}};
+  auto end = p.origin;
+  for (const auto& phase : p.phases) {
+    if (!threads.contains(phase.thread)) {
+      threads.emplace(phase.thread, fmt::format("worker-{}", threads.size()));
+    }
+    end = std::max(end, phase.end);
+  }
+
+  fmt::print(stderr, "Startup profile, {:.1f}ms to the first frame of every bar:\n",
+             offsetMs(p.origin, end));
+  fmt::print(stderr, "{:>10} {:>10}  {:<10} {}\n", "start ms", "took ms", "thread", "phase");
+  for (const auto& phase : p.phases) {
+    const auto took =
+        phase.mark ? std::string("-") : fmt::format("{:.1f}", offsetMs(phase.start, phase.end));
+    fmt::print(stderr, "{:>10.1f} {:>10}  {:<10} {}\n", offsetMs(p.origin, phase.start), took,
+               threads[phase.thread], phase.name);
+  }
+  p.phases.clear();
+}
+
+}  // namespace waybar::util
@@ -0,0 +1,142 @@
+#include "util/update_dispatcher.hpp"
+
+#include <glibmm/dispatcher.h>
+#include <gtk/gtk.h>
+
+#include <mutex>
+#include <unordered_set>
+
+namespace waybar::util {
+
+// Modules that were emitted since the last drain, shared by all bars
+class DirtySet {
+ public:
+  static DirtySet& inst() {
+    static auto* set = new DirtySet();
+    return *set;
+  }
+
+  void mark(UpdateDispatcher* dispatcher) {
+    bool wake = false;
+    {
+      std::lock_guard lock(mutex_);
+      // Only the first mark after a drain needs to wake the main loop
+      wake = dirty_.empty() && !draining_;
+      dirty_.insert(dispatcher);
+    }
+    if (wake) {
+      dp_.emit();
+    }
+  }
+
+  void forget(UpdateDispatcher* dispatcher) {
+    std::lock_guard lock(mutex_);
+    dirty_.erase(dispatcher);
+    pending_.erase(dispatcher);
+  }
+
+ private:
+  DirtySet() { dp_.connect(sigc::mem_fun(*this, &DirtySet::drain)); }
+
+  void drain() {
+    std::unique_lock lock(mutex_);
+    draining_ = true;
+    // Modules emitted while this batch is handled are left for the next wakeup, so a module
+    // emitting from its own update() cannot keep the loop spinning.
+    pending_.swap(dirty_);
+    while (!pending_.empty()) {
+      auto* dispatcher = pending_.extract(pending_.begin()).value();
+      lock.unlock();
+      dispatcher->schedule();
+      lock.lock();
+    }
+    draining_ = false;
+    const bool rearm = !dirty_.empty();
+    lock.unlock();
+    if (rearm) {
+      dp_.emit();
+    }
+  }
+
+  Glib::Dispatcher dp_;
+  std::mutex mutex_;
+  std::unordered_set<UpdateDispatcher*> dirty_;
+  std::unordered_set<UpdateDispatcher*> pending_;
+  bool draining_{false};
+};
+
+// Instantiate the shared dispatcher on the main thread, before any worker can emit
+UpdateDispatcher::UpdateDispatcher() { DirtySet::inst(); }
+
+UpdateDispatcher::~UpdateDispatcher() {
+  setWidget(nullptr);
+  DirtySet::inst().forget(this);
+}
+
+void UpdateDispatcher::emit() {
+  if (stats_ != nullptr && ModuleStats::enabled()) {
+    stats_->emits.fetch_add(1, std::memory_order_relaxed);
+  }
+  DirtySet::inst().mark(this);
+}
+
+void UpdateDispatcher::setWidget(Gtk::Widget* widget) {
+  if (tick_id_ != 0) {
+    cancelTick();
+    // Don't lose the pending update
+    if (widget != nullptr) {
+      emit();
+    }
+  }
+  widget_ = widget;
+}
+
+void UpdateDispatcher::cancelTick() {
+  if (tick_id_ != 0) {
+    gtk_widget_remove_tick_callback(widget_->gobj(), tick_id_);
+    tick_id_ = 0;
+  }
+  if (timeout_id_ != 0) {
+    g_source_remove(timeout_id_);
+    timeout_id_ = 0;
+  }
+}
+
+void UpdateDispatcher::schedule() {
+  if (widget_ == nullptr || !widget_->get_mapped()) {
+    run();
+    return;
+  }
+  if (tick_id_ == 0) {
+    tick_id_ = gtk_widget_add_tick_callback(widget_->gobj(), &UpdateDispatcher::onTick, this,
+                                            nullptr);
+    timeout_id_ = g_timeout_add(FRAME_TIMEOUT_MS, &UpdateDispatcher::onFrameTimeout, this);
+  }
+}
+
+gboolean UpdateDispatcher::onTick(GtkWidget* /*widget*/, GdkFrameClock* /*clock*/, gpointer data) {
+  auto* self = static_cast<UpdateDispatcher*>(data);
+  self->tick_id_ = 0;
+  self->cancelTick();
+  self->run();
+  return G_SOURCE_REMOVE;
+}
+
+gboolean UpdateDispatcher::onFrameTimeout(gpointer data) {
+  // The frame clock is frozen, don't hold the update until the bar is visible again
+  auto* self = static_cast<UpdateDispatcher*>(data);
+  self->timeout_id_ = 0;
+  self->cancelTick();
+  self->run();
+  return G_SOURCE_REMOVE;
+}
+
+void UpdateDispatcher::run() {
+  ModuleStats::Scope scope(stats_, &ModuleStats::update_time);
+  if (stats_ != nullptr && ModuleStats::enabled()) {
+    stats_->updates.fetch_add(1, std::memory_order_relaxed);
+  }
+  signal_.emit();
+}
+
+}  // namespace waybar::util
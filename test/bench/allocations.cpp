@@ -0,0 +1,29 @@
+// Replaces the global allocation functions to count allocations. Kept apart from any caller so
+// the compiler cannot pair an inlined operator delete with a malloc it did not see.
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#include "bench.hpp"
+
+namespace {
+std::atomic<uint64_t> allocation_count{0};
+}  // namespace
+
+void* operator new(std::size_t size) {
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  if (void* ptr = std::malloc(size == 0 ? 1 : size)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t /*size*/) noexcept { std::free(ptr); }
+
+namespace waybar::bench {
+
+uint64_t allocations() { return allocation_count.load(std::memory_order_relaxed); }
+
+}  // namespace waybar::bench
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+namespace waybar::bench {
+
+// Number of C++ heap allocations since start, counted by the replaced global operator new
+uint64_t allocations();
+
+/**
+ * Drives the timed loop of one benchmark run:
+ *
+ *   WAYBAR_BENCH("name") {
+ *     ... setup, not measured ...
+ *     while (state.keepRunning()) {
+ *       ... measured ...
+ *     }
+ *   }
+ *
+ * The clock and the allocation counter start on the first call to `keepRunning()` and stop
+ * when it returns false.
+ */
+class State {
+ public:
+  explicit State(std::size_t iterations) : remaining_(iterations) {}
+
+  bool keepRunning() {
+    if (!started_) {
+      started_ = true;
+      allocations_ = allocations();
+      start_ = std::chrono::steady_clock::now();
+    }
+    if (remaining_ > 0) {
+      --remaining_;
+      return true;
+    }
+    elapsed_ = std::chrono::steady_clock::now() - start_;
+    allocations_ = allocations() - allocations_;
+    return false;
+  }
+
+  // Marks the benchmark as not runnable in this environment, must be called before the loop
+  void skip(std::string reason) { skipped_ = std::move(reason); }
+
+  std::chrono::nanoseconds elapsed() const { return elapsed_; }
+  uint64_t allocationCount() const { return allocations_; }
+  const std::string& skipped() const { return skipped_; }
+
+ private:
+  std::size_t remaining_;
+  bool started_{false};
+  std::chrono::steady_clock::time_point start_;
+  std::chrono::nanoseconds elapsed_{0};
+  uint64_t allocations_{0};
+  std::string skipped_;
+};
+
+using Function = void (*)(State&);
+
+struct Registrar {
+  Registrar(const char* name, Function function);
+};
+
+// Keeps the optimizer from dropping a result that is otherwise unused
+template <typename T>
+inline void doNotOptimize(const T& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// Directory holding the /proc fixtures
+inline std::string fixture(const std::string& name) {
+  return std::string(BENCH_FIXTURES_DIR) + "/" + name;
+}
+
+}  // namespace waybar::bench
+
+#define WAYBAR_BENCH_CONCAT_(a, b) a##b
+#define WAYBAR_BENCH_CONCAT(a, b) WAYBAR_BENCH_CONCAT_(a, b)
+#define WAYBAR_BENCH_IMPL_(name, function)                                                   \
+  static void function(waybar::bench::State& state);                                        \
+  static const waybar::bench::Registrar WAYBAR_BENCH_CONCAT(function, _registrar){name,     \
+                                                                                 &function}; \
+  static void function([[maybe_unused]] waybar::bench::State& state)
+#define WAYBAR_BENCH(name) WAYBAR_BENCH_IMPL_(name, WAYBAR_BENCH_CONCAT(waybar_bench_, __LINE__))
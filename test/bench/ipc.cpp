@@ -0,0 +1,64 @@
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "bench.hpp"
+#include "modules/hyprland/backend.hpp"
+
+namespace waybar::modules::hyprland {
+struct IPCTestAccess {
+  static void parseIPC(IPC& ipc, const std::string& ev) { ipc.parseIPC(ev); }
+};
+}  // namespace waybar::modules::hyprland
+
+namespace hyprland = waybar::modules::hyprland;
+
+namespace {
+
+// Constructs the IPC without connecting to a compositor
+class IPCBenchHelper : public hyprland::IPC {};
+
+// Splits the payload the way the workspaces module does
+class PayloadHandler : public hyprland::EventHandler {
+ public:
+  void onEvent(const std::string& ev) override {
+    const auto payload = ev.substr(ev.find_first_of('>') + 2);
+    const auto separator = payload.find(',');
+    first = payload.substr(0, separator);
+    second = separator == std::string::npos ? "" : payload.substr(separator + 1);
+  }
+
+  std::string first;
+  std::string second;
+};
+
+}  // namespace
+
+WAYBAR_BENCH("hyprland/parseIPC dispatch") {
+  // The listener thread gives up right away without an instance signature
+  unsetenv("HYPRLAND_INSTANCE_SIGNATURE");
+  IPCBenchHelper ipc;
+  // A typical bar: workspaces, window, submap and language modules
+  std::vector<std::unique_ptr<PayloadHandler>> handlers;
+  for (const auto* event :
+       {"workspacev2", "focusedmonv2", "createworkspacev2", "destroyworkspacev2", "openwindow",
+        "closewindow", "movewindowv2", "activewindowv2", "submap", "activelayout"}) {
+    handlers.push_back(std::make_unique<PayloadHandler>());
+    ipc.registerForIPC(event, handlers.back().get());
+  }
+  const std::vector<std::string> events{
+      "activewindowv2>>5632a1b8e2d0",
+      "workspacev2>>3,3",
+      "focusedmonv2>>DP-1,3",
+      "openwindow>>5632a1b8e2d0,3,kitty,~/src/waybar",
+      "activelayout>>at-translated-set-2-keyboard,English (US)",
+  };
+  std::size_t i = 0;
+  while (state.keepRunning()) {
+    hyprland::IPCTestAccess::parseIPC(ipc, events[i++ % events.size()]);
+  }
+  for (const auto& handler : handlers) {
+    ipc.unregisterForIPC(handler.get());
+  }
+}
@@ -0,0 +1,97 @@
+#include <fmt/args.h>
+#include <gtk/gtk.h>
+#include <gtkmm/main.h>
+
+#include <list>
+#include <mutex>
+#include <string>
+
+#include "ALabel.hpp"
+#include "bench.hpp"
+
+// Required by util/command.hpp, pulled in by AModule
+std::mutex reap_mtx;
+std::list<pid_t> reap;
+
+namespace {
+
+bool gtkAvailable() {
+  static const bool available = [] {
+    if (gtk_init_check(nullptr, nullptr) == FALSE) {
+      return false;
+    }
+    Gtk::Main::init_gtkmm_internals();
+    return true;
+  }();
+  return available;
+}
+
+// A memory-like module: label and tooltip rendered from the same named arguments
+class BenchLabel : public waybar::ALabel {
+ public:
+  explicit BenchLabel(const Json::Value& config) : ALabel(config, "bench", "", "{}", 0) {}
+
+  void render(int percentage, double used, double total) {
+    updateLabelAndTooltip(format_, "{used:0.1f}GiB used", fmt::arg("percentage", percentage),
+                          fmt::arg("used", used), fmt::arg("total", total),
+                          fmt::arg("icon", getIcon(percentage)));
+  }
+
+  void renderStore(int percentage, double used, double total) {
+    fmt::dynamic_format_arg_store<fmt::format_context> store;
+    store.push_back(fmt::arg("percentage", percentage));
+    store.push_back(fmt::arg("used", used));
+    store.push_back(fmt::arg("total", total));
+    updateLabelAndTooltip(format_, "{used:0.1f}GiB used", store);
+  }
+};
+
+Json::Value labelConfig() {
+  Json::Value config(Json::objectValue);
+  config["format"] = "{icon} {percentage}% {used:0.1f}/{total:0.1f}G";
+  config["tooltip-format"] = "Memory: {used:0.1f}GiB of {total:0.1f}GiB ({percentage}%)";
+  config["format-icons"] = Json::Value(Json::arrayValue);
+  for (const auto* icon : {"▁", "▂", "▃", "▄", "▅", "▆", "▇", "█"}) {
+    config["format-icons"].append(icon);
+  }
+  return config;
+}
+
+}  // namespace
+
+WAYBAR_BENCH("label/updateLabelAndTooltip changed") {
+  if (!gtkAvailable()) {
+    state.skip("no display");
+    return;
+  }
+  BenchLabel label(labelConfig());
+  int i = 0;
+  while (state.keepRunning()) {
+    label.render(i % 100, 0.3 * (i % 100), 32.0);
+    ++i;
+  }
+}
+
+WAYBAR_BENCH("label/updateLabelAndTooltip unchanged") {
+  if (!gtkAvailable()) {
+    state.skip("no display");
+    return;
+  }
+  BenchLabel label(labelConfig());
+  while (state.keepRunning()) {
+    label.render(42, 12.6, 32.0);
+  }
+}
+
+WAYBAR_BENCH("label/updateLabelAndTooltip arg store") {
+  if (!gtkAvailable()) {
+    state.skip("no display");
+    return;
+  }
+  BenchLabel label(labelConfig());
+  int i = 0;
+  while (state.keepRunning()) {
+    label.renderStore(i % 100, 0.3 * (i % 100), 32.0);
+    ++i;
+  }
+}
@@ -0,0 +1,119 @@
+// Microbenchmarks of the per-update hot paths.
+//
+// Usage: waybar_bench [--samples N] [--min-time MS] [FILTER...]
+//
+// Every benchmark is calibrated until a run takes at least --min-time, then run --samples times.
+// The median ns/op is reported with the spread of the samples; allocs/op counts C++ heap
+// allocations (GLib and C library allocations are not seen).
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "bench.hpp"
+
+namespace {
+
+struct Benchmark {
+  std::string name;
+  waybar::bench::Function function;
+};
+
+std::vector<Benchmark>& benchmarks() {
+  static std::vector<Benchmark> benchmarks;
+  return benchmarks;
+}
+
+struct Result {
+  double ns_per_op;
+  double allocs_per_op;
+};
+
+Result runOnce(const Benchmark& benchmark, std::size_t iterations, std::string& skipped) {
+  waybar::bench::State state(iterations);
+  benchmark.function(state);
+  skipped = state.skipped();
+  return {static_cast<double>(state.elapsed().count()) / static_cast<double>(iterations),
+          static_cast<double>(state.allocationCount()) / static_cast<double>(iterations)};
+}
+
+bool matches(const std::string& name, const std::vector<std::string>& filters) {
+  return filters.empty() || std::any_of(filters.begin(), filters.end(), [&](const auto& filter) {
+           return name.find(filter) != std::string::npos;
+         });
+}
+
+}  // namespace
+
+namespace waybar::bench {
+
+Registrar::Registrar(const char* name, Function function) {
+  benchmarks().push_back({name, function});
+}
+
+}  // namespace waybar::bench
+
+int main(int argc, char* argv[]) {
+  std::size_t samples = 7;
+  double min_time_ms = 20;
+  std::vector<std::string> filters;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--samples" && i + 1 < argc) {
+      samples = std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "--min-time" && i + 1 < argc) {
+      min_time_ms = std::max(1.0, std::atof(argv[++i]));
+    } else if (arg == "-h" || arg == "--help") {
+      fmt::print("Usage: {} [--samples N] [--min-time MS] [FILTER...]\n", argv[0]);
+      return 0;
+    } else {
+      filters.push_back(arg);
+    }
+  }
+  // The code under test logs on errors only, keep the table readable
+  spdlog::set_level(spdlog::level::off);
+
+  auto sorted = benchmarks();
+  std::sort(sorted.begin(), sorted.end(),
+            [](const auto& a, const auto& b) { return a.name < b.name; });
+
+  fmt::print("{:<44} {:>12} {:>8} {:>11} {:>12}\n", "benchmark", "ns/op", "spread", "allocs/op",
+             "iterations");
+  for (const auto& benchmark : sorted) {
+    if (!matches(benchmark.name, filters)) {
+      continue;
+    }
+    std::string skipped;
+    // Calibration, also warms caches and lazily built state up
+    std::size_t iterations = 1;
+    auto result = runOnce(benchmark, iterations, skipped);
+    while (skipped.empty() && result.ns_per_op * iterations < min_time_ms * 1e6 &&
+           iterations < (1U << 30)) {
+      const auto target = min_time_ms * 1e6 / std::max(result.ns_per_op, 1.0);
+      iterations = std::clamp<std::size_t>(target * 1.2, iterations * 2, iterations * 100);
+      result = runOnce(benchmark, iterations, skipped);
+    }
+    if (!skipped.empty()) {
+      fmt::print("{:<44} skipped: {}\n", benchmark.name, skipped);
+      continue;
+    }
+
+    std::vector<Result> results;
+    for (std::size_t i = 0; i < samples; ++i) {
+      results.push_back(runOnce(benchmark, iterations, skipped));
+    }
+    std::sort(results.begin(), results.end(),
+              [](const auto& a, const auto& b) { return a.ns_per_op < b.ns_per_op; });
+    const auto& median = results[results.size() / 2];
+    const auto spread = median.ns_per_op > 0
+                            ? (results.back().ns_per_op - results.front().ns_per_op) /
+                                  median.ns_per_op * 100
+                            : 0.0;
+    fmt::print("{:<44} {:>12.1f} {:>7.1f}% {:>11.2f} {:>12}\n", benchmark.name, median.ns_per_op,
+               spread, median.allocs_per_op, iterations);
+  }
+  return 0;
+}
@@ -0,0 +1,29 @@
+#include <net/if.h>
+
+#include "bench.hpp"
+#include "util/link_stats.hpp"
+
+// The /proc/net/dev fallback, on a host with many veth interfaces
+WAYBAR_BENCH("net/dev 512 interfaces") {
+  waybar::util::ProcFile netdev(waybar::bench::fixture("proc_net_dev_512"));
+  netdev.read();
+  while (state.keepRunning()) {
+    auto counters = waybar::util::parseNetDev(netdev.read(), "tailscale0");
+    waybar::bench::doNotOptimize(counters);
+  }
+}
+
+// A RTM_GETLINK round trip for the loopback interface
+WAYBAR_BENCH("net/link stats64") {
+  // No fallback, so that a missing netlink shows up as a skip
+  waybar::util::LinkStatsReader reader("");
+  const int ifindex = static_cast<int>(if_nametoindex("lo"));
+  if (ifindex == 0 || !reader.read(ifindex, "lo")) {
+    state.skip("no rtnetlink");
+    return;
+  }
+  while (state.keepRunning()) {
+    auto counters = reader.read(ifindex, "lo");
+    waybar::bench::doNotOptimize(counters);
+  }
+}
@@ -0,0 +1,46 @@
+#include "bench.hpp"
+#include "modules/cpu_usage.hpp"
+#include "modules/memory.hpp"
+
+// A sample of the kept-open reader, as done on every interval
+static void benchStat(waybar::bench::State& state, const std::string& fixture) {
+  waybar::modules::CpuUsage::StatReader reader(waybar::bench::fixture(fixture));
+  // Sizes the buffers, which the timed samples reuse
+  reader.read();
+  while (state.keepRunning()) {
+    const auto& times = reader.read();
+    waybar::bench::doNotOptimize(times);
+  }
+}
+
+WAYBAR_BENCH("proc/stat 8 cpus") { benchStat(state, "proc_stat_8cpu"); }
+
+WAYBAR_BENCH("proc/stat 64 cpus") { benchStat(state, "proc_stat_64cpu"); }
+
+WAYBAR_BENCH("proc/stat 256 cpus") { benchStat(state, "proc_stat_256cpu"); }
+
+// Opening and sizing the buffers for every sample, for comparison
+WAYBAR_BENCH("proc/stat 256 cpus reopened") {
+  const auto path = waybar::bench::fixture("proc_stat_256cpu");
+  while (state.keepRunning()) {
+    auto times = waybar::modules::CpuUsage::parseCpuinfo(path);
+    waybar::bench::doNotOptimize(times);
+  }
+}
+
+WAYBAR_BENCH("proc/meminfo") {
+  waybar::modules::Memory::MeminfoReader reader(waybar::bench::fixture("proc_meminfo"), false);
+  reader.read();
+  while (state.keepRunning()) {
+    const auto& meminfo = reader.read();
+    waybar::bench::doNotOptimize(meminfo);
+  }
+}
+
+WAYBAR_BENCH("proc/meminfo reopened") {
+  const auto path = waybar::bench::fixture("proc_meminfo");
+  while (state.keepRunning()) {
+    auto meminfo = waybar::modules::Memory::parseMeminfo(path);
+    waybar::bench::doNotOptimize(meminfo);
+  }
+}
@@ -0,0 +1,230 @@
+#include <fmt/format.h>
+#include <json/value.h>
+
+#include <array>
+#include <iterator>
+#include <string>
+
+#include "bench.hpp"
+#include "util/compiled_format.hpp"
+#include "util/format.hpp"
+#include "util/json.hpp"
+#include "util/module_config.hpp"
+#include "util/regex_collection.hpp"
+#include "util/rewrite_string.hpp"
+#include "util/sanitize_str.hpp"
+#include "util/utf8_string.hpp"
+
+namespace {
+
+// Window title rewrite rules as found in the wild
+Json::Value rewriteRules() {
+  Json::Value rules(Json::objectValue);
+  rules["(.*) — Mozilla Firefox"] = "🌎 $1";
+  rules["(.*) - Visual Studio Code"] = "󰨞 $1";
+  rules["(.*) - vim"] = " $1";
+  rules["(.*) - zsh"] = "> [$1]";
+  rules["class<kitty>"] = "";
+  rules["title<.*youtube.*>"] = "";
+  return rules;
+}
+
+// Battery module config with the usual per-status and per-state formats
+Json::Value batteryConfig() {
+  Json::Value config(Json::objectValue);
+  config["format"] = "{capacity}% {icon}";
+  config["format-charging"] = "{capacity}% 󰂄";
+  config["format-discharging-warning"] = "{capacity}% {icon} {time}";
+  config["tooltip-format"] = "{timeTo}";
+  config["states"]["warning"] = 30;
+  config["states"]["critical"] = 15;
+  for (const auto* icon : {"󰁺", "󰁻", "󰁼", "󰁽", "󰁾", "󰁿", "󰂀", "󰂁", "󰂂", "󰁹"}) {
+    config["format-icons"].append(icon);
+  }
+  return config;
+}
+
+}  // namespace
+
+WAYBAR_BENCH("format/pow_format auto") {
+  std::string out;
+  long long value = 1536;
+  while (state.keepRunning()) {
+    out.clear();
+    fmt::format_to(std::back_inserter(out), "{:>}", pow_format(value, "B/s"));
+    value = value * 7 % 100000000007;
+  }
+  waybar::bench::doNotOptimize(out);
+}
+
+WAYBAR_BENCH("format/pow_format forced scale") {
+  std::string out;
+  long long value = 1536;
+  while (state.keepRunning()) {
+    out.clear();
+    fmt::format_to(std::back_inserter(out), "{:>3M}", pow_format(value, "B", true));
+    value = value * 7 % 100000000007;
+  }
+  waybar::bench::doNotOptimize(out);
+}
+
+WAYBAR_BENCH("format/vformat named args") {
+  const std::string format = "<span color='#ffffff'>{icon}</span> {capacity}% ({time}) {power:.1f}W";
+  const int capacity = 42;
+  const std::string icon = "󰁾";
+  const std::string time = "2h 13min";
+  const double power = 7.25;
+  const auto capacity_arg = fmt::arg("capacity", capacity);
+  const auto icon_arg = fmt::arg("icon", icon);
+  const auto time_arg = fmt::arg("time", time);
+  const auto power_arg = fmt::arg("power", power);
+  fmt::memory_buffer out;
+  while (state.keepRunning()) {
+    out.clear();
+    fmt::vformat_to(fmt::appender(out), format,
+                    fmt::make_format_args(capacity_arg, icon_arg, time_arg, power_arg));
+    waybar::bench::doNotOptimize(out);
+  }
+}
+
+WAYBAR_BENCH("format/compiled named args") {
+  const waybar::util::CompiledFormat format(
+      "<span color='#ffffff'>{icon}</span> {capacity}% ({time}) {power:.1f}W");
+  const int capacity = 42;
+  const std::string icon = "󰁾";
+  const std::string time = "2h 13min";
+  const double power = 7.25;
+  const auto capacity_arg = fmt::arg("capacity", capacity);
+  const auto icon_arg = fmt::arg("icon", icon);
+  const auto time_arg = fmt::arg("time", time);
+  const auto power_arg = fmt::arg("power", power);
+  fmt::memory_buffer out;
+  while (state.keepRunning()) {
+    out.clear();
+    format.renderTo(out, fmt::make_format_args(capacity_arg, icon_arg, time_arg, power_arg));
+    waybar::bench::doNotOptimize(out);
+  }
+}
+
+WAYBAR_BENCH("json/parse sway workspace event") {
+  // Payload of a sway "workspace" IPC event, parsed by every sway workspaces module
+  const std::string payload = R"({"change":"focus","current":{"id":9,"type":"workspace",)"
+                              R"("orientation":"horizontal","percent":null,"urgent":false,)"
+                              R"("marks":[],"focused":true,"layout":"splith","border":"none",)"
+                              R"("current_border_width":0,"rect":{"x":0,"y":30,"width":2560,)"
+                              R"("height":1410},"name":"2","num":2,"output":"DP-1",)"
+                              R"("representation":"H[kitty firefox]","nodes":[],)"
+                              R"("floating_nodes":[],"focus":[12,11],"sticky":false},)"
+                              R"("old":{"id":4,"type":"workspace","name":"1","num":1,)"
+                              R"("output":"DP-1","focused":false,"urgent":false,)"
+                              R"("representation":"H[kitty]","focus":[5]}})";
+  waybar::util::JsonParser parser;
+  while (state.keepRunning()) {
+    auto json = parser.parse(payload);
+    waybar::bench::doNotOptimize(json);
+  }
+}
+
+WAYBAR_BENCH("json/parse custom module output") {
+  const std::string payload =
+      R"({"text":"42°C","alt":"warm","tooltip":"CPU package\nCore 0: 40°C","class":["warm"],)"
+      R"("percentage":42})";
+  waybar::util::JsonParser parser;
+  while (state.keepRunning()) {
+    auto json = parser.parse(payload);
+    waybar::bench::doNotOptimize(json);
+  }
+}
+
+WAYBAR_BENCH("module_config/format lookup json") {
+  const auto config = batteryConfig();
+  const std::string status = "discharging";
+  const std::string level = "warning";
+  while (state.keepRunning()) {
+    std::string format;
+    if (config["format-" + status + "-" + level].isString()) {
+      format = config["format-" + status + "-" + level].asString();
+    } else if (config["format-" + status].isString()) {
+      format = config["format-" + status].asString();
+    }
+    waybar::bench::doNotOptimize(format);
+  }
+}
+
+WAYBAR_BENCH("module_config/format lookup compiled") {
+  const waybar::util::ModuleConfig config(batteryConfig());
+  const std::string status = "discharging";
+  const std::string level = "warning";
+  while (state.keepRunning()) {
+    const auto* format = waybar::util::ModuleConfig::first(
+        {config.string("format", status, level), config.string("format", status)});
+    waybar::bench::doNotOptimize(format);
+  }
+}
+
+WAYBAR_BENCH("module_config/state and icon") {
+  const waybar::util::ModuleConfig config(batteryConfig());
+  uint8_t capacity = 0;
+  while (state.keepRunning()) {
+    const auto* reached = config.state(capacity, true);
+    const auto& icon = config.icons({"discharging"})->get(capacity, 0);
+    waybar::bench::doNotOptimize(reached);
+    waybar::bench::doNotOptimize(icon);
+    capacity = (capacity + 7) % 101;
+  }
+}
+
+WAYBAR_BENCH("regex_collection/get cached") {
+  waybar::util::RegexCollection collection(rewriteRules(), "{}");
+  std::array<std::string, 4> titles{"Waybar — Mozilla Firefox", "main.cpp - Visual Studio Code",
+                                    "notes.txt - vim", "Untitled"};
+  std::size_t i = 0;
+  while (state.keepRunning()) {
+    auto& repr = collection.get(titles[i++ % titles.size()]);
+    waybar::bench::doNotOptimize(repr);
+  }
+}
+
+WAYBAR_BENCH("rewrite_string/match") {
+  const auto rules = rewriteRules();
+  const std::string title = "Pull requests · Alexays/Waybar — Mozilla Firefox";
+  while (state.keepRunning()) {
+    auto rewritten = waybar::util::rewriteString(title, rules);
+    waybar::bench::doNotOptimize(rewritten);
+  }
+}
+
+WAYBAR_BENCH("rewrite_string/no match") {
+  const auto rules = rewriteRules();
+  const std::string title = "Untitled document";
+  while (state.keepRunning()) {
+    auto rewritten = waybar::util::rewriteString(title, rules);
+    waybar::bench::doNotOptimize(rewritten);
+  }
+}
+
+WAYBAR_BENCH("sanitize_string/title") {
+  const std::string title = R"(<b>"Tom & Jerry"</b> — 'Episode 1' <i>(1940)</i>)";
+  while (state.keepRunning()) {
+    auto sanitized = waybar::util::sanitize_string(title);
+    waybar::bench::doNotOptimize(sanitized);
+  }
+}
+
+WAYBAR_BENCH("utf8_string/width mixed") {
+  const std::string text = "󰕾 Volume 42% — 日本語のタイトル 🎵 Now playing";
+  while (state.keepRunning()) {
+    auto width = waybar::util::utf8_width(text);
+    waybar::bench::doNotOptimize(width);
+  }
+}
+
+WAYBAR_BENCH("utf8_string/truncate") {
+  const std::string text = "󰕾 Volume 42% — 日本語のタイトル 🎵 Now playing";
+  std::string truncated;
+  while (state.keepRunning()) {
+    truncated = text;
+    waybar::util::utf8_truncate(truncated, "…", 20);
+    waybar::bench::doNotOptimize(truncated);
+  }
+}
@@ -0,0 +1,125 @@
+#include "config_cache.hpp"
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+
+#include "config.hpp"
+
+#if __has_include(<catch2/catch_test_macros.hpp>)
+#include <catch2/catch_test_macros.hpp>
+#else
+#include <catch2/catch.hpp>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+class TempDir {
+ public:
+  TempDir() {
+    std::string tmpl = (fs::temp_directory_path() / "waybar-config-cache-XXXXXX").string();
+    path_ = mkdtemp(tmpl.data());
+  }
+  ~TempDir() {
+    std::error_code ec;
+    fs::remove_all(path_, ec);
+  }
+  const fs::path& path() const { return path_; }
+
+ private:
+  fs::path path_;
+};
+
+void write(const fs::path& path, const std::string& content) {
+  std::ofstream file(path, std::ios::trunc);
+  file << content;
+}
+
+// Snapshots aren't stored while a dependency was modified in the last seconds
+void backdate(const fs::path& dir) {
+  const auto past = fs::file_time_type::clock::now() - std::chrono::hours(1);
+  for (const auto& entry : fs::recursive_directory_iterator(dir)) {
+    fs::last_write_time(entry.path(), past);
+  }
+  fs::last_write_time(dir, past);
+}
+
+// Loads `config` with the cache enabled, returns whether the snapshot was reused
+bool loadCached(waybar::Config& conf, const fs::path& cache_dir, const std::string& config) {
+  waybar::ConfigCache cache(cache_dir.string(), config);
+  const bool hit = cache.load().has_value();
+  conf.enableCache(cache_dir.string());
+  conf.load(config);
+  return hit;
+}
+
+}  // namespace
+
+TEST_CASE("Reuse the cached config until a dependency changes", "[config]") {
+  TempDir tmp;
+  // Kept apart, storing the snapshot must not touch a searched directory
+  TempDir cache_tmp;
+  const auto cache_dir = cache_tmp.path() / "cache";
+  const auto config = (tmp.path() / "config.jsonc").string();
+  fs::create_directory(tmp.path() / "parts");
+  write(config, R"({"height": 30, "include": [")" + (tmp.path() / "parts").string() +
+                    R"(/*.json", "$WAYBAR_TEST_INCLUDE"]})");
+  write(tmp.path() / "parts" / "a.json", R"({"layer": "top"})");
+  write(tmp.path() / "env.json", R"({"position": "left"})");
+  setenv("WAYBAR_TEST_INCLUDE", (tmp.path() / "env.json").c_str(), 1);
+  backdate(tmp.path());
+
+  waybar::Config conf;
+  REQUIRE_FALSE(loadCached(conf, cache_dir, config));
+  REQUIRE(conf.getConfig()["layer"].asString() == "top");
+
+  waybar::Config cached;
+  REQUIRE(loadCached(cached, cache_dir, config));
+  REQUIRE(cached.getConfig() == conf.getConfig());
+
+  SECTION("an included file is modified") {
+    write(tmp.path() / "parts" / "a.json", R"({"layer": "bottom", "spacing": 4})");
+    REQUIRE_FALSE(loadCached(conf, cache_dir, config));
+    REQUIRE(conf.getConfig()["layer"].asString() == "bottom");
+  }
+  SECTION("a file matching a wildcard include is added") {
+    write(tmp.path() / "parts" / "b.json", R"({"spacing": 4})");
+    REQUIRE_FALSE(loadCached(conf, cache_dir, config));
+    REQUIRE(conf.getConfig()["spacing"].asInt() == 4);
+  }
+  SECTION("an environment variable used by an include changes") {
+    write(tmp.path() / "other.json", R"({"position": "right"})");
+    setenv("WAYBAR_TEST_INCLUDE", (tmp.path() / "other.json").c_str(), 1);
+    REQUIRE_FALSE(loadCached(conf, cache_dir, config));
+    REQUIRE(conf.getConfig()["position"].asString() == "right");
+  }
+  unsetenv("WAYBAR_TEST_INCLUDE");
+}
+
+TEST_CASE("Round-trip a config through the binary encoding", "[config]") {
+  Json::Value config;
+  config["int"] = -42;
+  config["uint"] = Json::Value(Json::UInt64(1) << 63);
+  config["real"] = 0.1;
+  config["string"] = std::string("with\0nul", 8);
+  config["bool"] = true;
+  config["null"] = Json::Value();
+  config["modules-left"].append("clock");
+  config["modules-left"].append(Json::Value(Json::objectValue));
+
+  Json::Value decoded;
+  REQUIRE(waybar::ConfigCache::decode(waybar::ConfigCache::encode(config), decoded));
+  REQUIRE(decoded == config);
+  REQUIRE(decoded["int"].isInt());
+  REQUIRE(decoded["uint"].type() == Json::uintValue);
+  REQUIRE(decoded["real"].type() == Json::realValue);
+
+  auto truncated = waybar::ConfigCache::encode(config);
+  truncated.pop_back();
+  REQUIRE_FALSE(waybar::ConfigCache::decode(truncated, decoded));
+}
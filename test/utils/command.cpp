@@ -7,44 +7,25 @@
 #include <sys/wait.h>
 #include <unistd.h>
 
-#include <cerrno>
+#include <chrono>
 #include <list>
 #include <mutex>
 
 std::mutex reap_mtx;
 std::list<pid_t> reap;
 
-extern "C" int waybar_test_execl(const char* path, const char* arg, ...);
-extern "C" int waybar_test_execlp(const char* file, const char* arg, ...);
-
-#define execl waybar_test_execl
-#define execlp waybar_test_execlp
 #include "util/command.hpp"
-#undef execl
-#undef execlp
-
-extern "C" int waybar_test_execl(const char* path, const char* arg, ...) {
-  (void)path;
-  (void)arg;
-  errno = ENOENT;
-  return -1;
-}
-
-extern "C" int waybar_test_execlp(const char* file, const char* arg, ...) {
-  (void)file;
-  (void)arg;
-  errno = ENOENT;
-  return -1;
-}
 
-TEST_CASE("command::execNoRead returns 127 when shell exec fails", "[util][command]") {
-  const auto result = waybar::util::command::execNoRead("echo should-not-run");
+// Other tests link command.hpp too, so exec failures come from a missing executable rather than
+// from a hook on execve
+TEST_CASE("command::execNoRead returns 127 when exec fails", "[util][command]") {
+  const auto result = waybar::util::command::execNoRead("/nonexistent/waybar-test", true);
   REQUIRE(result.exit_code == waybar::util::command::kExecFailureExitCode);
   REQUIRE(result.out.empty());
 }
 
-TEST_CASE("command::forkExec child exits 127 when shell exec fails", "[util][command]") {
-  const auto pid = waybar::util::command::forkExec("echo should-not-run", "test-output");
+TEST_CASE("command::forkExec child exits 127 when exec fails", "[util][command]") {
+  const auto pid = waybar::util::command::forkExec("/nonexistent/waybar-test", "test-output");
   REQUIRE(pid > 0);
 
   int status = -1;
@@ -55,3 +36,54 @@ TEST_CASE("command::forkExec child exits 127 when shell exec fails", "[util][com
   std::scoped_lock<std::mutex> lock(reap_mtx);
   reap.remove(pid);
 }
+
+TEST_CASE("command::exec passes the output name", "[util][command]") {
+  const auto result = waybar::util::command::exec("echo \"$WAYBAR_OUTPUT_NAME\"; exit 3", "DP-1");
+  REQUIRE(result.exit_code == 3);
+  REQUIRE(result.out == "DP-1");
+}
+
+TEST_CASE("command::exec runs plain commands without a shell", "[util][command]") {
+  using waybar::util::command::needsShell;
+  REQUIRE_FALSE(needsShell("notify-send -u low Waybar"));
+  REQUIRE(needsShell("echo $HOME"));
+  REQUIRE(needsShell("cat file | wc -l"));
+  REQUIRE(needsShell("echo 'quoted text'"));
+  REQUIRE(needsShell("FOO=1 env"));
+
+  // $0 is not expanded, it is passed as is
+  const auto direct = waybar::util::command::exec("printf %s:%s  a  b", "", true);
+  const auto shell = waybar::util::command::exec("printf %s:%s a $0", "", true);
+  REQUIRE(direct.exit_code == 0);
+  REQUIRE(direct.out == "a:b");
+  REQUIRE(shell.out == "a:sh");
+}
+
+TEST_CASE("command::readAll reads the whole output", "[util][command]") {
+  const auto result = waybar::util::command::exec("head -c 1000000 /dev/zero | tr '\\0' x", "");
+  REQUIRE(result.exit_code == 0);
+  REQUIRE(result.out.size() == 1000000);
+  REQUIRE(result.out.find_first_not_of('x') == std::string::npos);
+}
+
+TEST_CASE("command::readAll truncates and stops at the deadline", "[util][command]") {
+  int fd[2];
+  REQUIRE(pipe(fd) == 0);
+  REQUIRE(write(fd[1], "0123456789", 10) == 10);
+
+  // The writer is still open, only the deadline ends the read
+  const auto start = std::chrono::steady_clock::now();
+  const auto output =
+      waybar::util::command::readAll(fd[0], 4, start + std::chrono::milliseconds(50));
+  REQUIRE(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(50));
+  REQUIRE(output.timed_out);
+  REQUIRE(output.truncated);
+  REQUIRE(output.text == "0123");
+
+  close(fd[1]);
+  const auto rest = waybar::util::command::readAll(fd[0]);
+  REQUIRE_FALSE(rest.timed_out);
+  REQUIRE_FALSE(rest.truncated);
+  REQUIRE(rest.text.empty());
+  close(fd[0]);
+}
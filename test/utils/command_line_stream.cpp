@@ -66,3 +66,44 @@ TEST_CASE("command::LineStream does not emit an extra line after newline-termina
   REQUIRE(*result.exit_code == 0);
   REQUIRE(result.lines == std::vector<std::string>{"first", "second"});
 }
+
+TEST_CASE("command::LineStream writes requests to stdin", "[util][command_line_stream]") {
+  auto loop = Glib::MainLoop::create();
+  bool timed_out = false;
+  auto timeout = Glib::signal_timeout().connect(
+      [&]() {
+        timed_out = true;
+        loop->quit();
+        return false;
+      },
+      3000);
+
+  std::vector<std::string> lines;
+  std::optional<int> exit_code;
+  waybar::util::command::LineStream stream(
+      "",
+      [&](const std::string& line) {
+        lines.push_back(line);
+        if (lines.size() == 2) {
+          loop->quit();
+        }
+      },
+      [&](int code) {
+        exit_code = code;
+        loop->quit();
+      });
+
+  REQUIRE_FALSE(stream.write("no stdin yet"));
+  stream.start("while read -r request; do echo \"reply to $request\"; done", true);
+  REQUIRE(stream.write("tick"));
+  REQUIRE(stream.write("click 1"));
+  loop->run();
+  timeout.disconnect();
+
+  REQUIRE_FALSE(timed_out);
+  REQUIRE_FALSE(exit_code.has_value());
+  REQUIRE(lines == std::vector<std::string>{"reply to tick", "reply to click 1"});
+
+  stream.stop();
+  REQUIRE_FALSE(stream.write("tick"));
+}
@@ -0,0 +1,57 @@
+#include "util/compiled_format.hpp"
+
+#if __has_include(<catch2/catch_test_macros.hpp>)
+#include <catch2/catch_test_macros.hpp>
+#else
+#include <catch2/catch.hpp>
+#endif
+
+using waybar::util::CompiledFormat;
+
+TEST_CASE("CompiledFormat renders like fmt", "[util][compiled_format]") {
+  const auto capacity = 42;
+  const std::string icon = "󰁾";
+  const auto capacity_arg = fmt::arg("capacity", capacity);
+  const auto icon_arg = fmt::arg("icon", icon);
+  const auto args = fmt::make_format_args(capacity_arg, icon_arg);
+
+  for (const auto* format : {"{capacity}% {icon}", "{capacity:>4}%", "{{literal}} {icon}}}",
+                             "no fields", "", "<b>{icon}</b>{capacity:03}"}) {
+    CAPTURE(format);
+    REQUIRE(CompiledFormat(format).render(args) == fmt::vformat(format, args));
+  }
+}
+
+TEST_CASE("CompiledFormat numbers automatic fields", "[util][compiled_format]") {
+  std::string text = "text";
+  int percentage = 7;
+  const auto args = fmt::make_format_args(text, percentage);
+  REQUIRE(CompiledFormat("{} {:>3}%").render(args) == "text   7%");
+  REQUIRE(CompiledFormat("{1} {0}").render(args) == "7 text");
+  // Mixed indexing is left to fmt, which rejects it
+  REQUIRE_THROWS_AS(CompiledFormat("{} {0}").render(args), fmt::format_error);
+  REQUIRE_THROWS_AS(CompiledFormat("{unbalanced").render(args), fmt::format_error);
+}
+
+TEST_CASE("CompiledFormat records the named arguments", "[util][compiled_format]") {
+  CompiledFormat format("{usage}% {icon0}{icon1} {:{width}}");
+  REQUIRE(format.uses("usage"));
+  REQUIRE(format.uses("width"));
+  REQUIRE_FALSE(format.uses("icons"));
+  REQUIRE(format.usesAny([](const std::string& name) { return name.starts_with("icon"); }));
+  REQUIRE(CompiledFormat("{broken").uses("anything"));
+
+  REQUIRE(format.usesPositional());
+  REQUIRE(CompiledFormat("{1}").usesPositional());
+  REQUIRE_FALSE(CompiledFormat("{usage:{width}}").usesPositional());
+  REQUIRE(CompiledFormat("{broken").usesPositional());
+}
+
+TEST_CASE("CompiledFormat substitutes plain named fields", "[util][compiled_format]") {
+  CompiledFormat format("<tt>{calendar}</tt> {:%H:%M} {calendar:>3} {{}}");
+  const std::string calendar = "cal";
+  const auto substituted = format.substitute([&](std::string_view name) {
+    return name == "calendar" ? &calendar : nullptr;
+  });
+  REQUIRE(substituted == "<tt>cal</tt> {:%H:%M} {calendar:>3} {{}}");
+}
@@ -0,0 +1,175 @@
+#if __has_include(<catch2/catch_test_macros.hpp>)
+#include <catch2/catch_test_macros.hpp>
+#else
+#include <catch2/catch.hpp>
+#endif
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "fixtures/WaitFor.hpp"
+#include "util/exec_pool.hpp"
+
+using namespace std::chrono_literals;
+using waybar::util::ExecPool;
+
+TEST_CASE("ExecPool runs commands", "[util][exec_pool]") {
+  ExecPool pool(2);
+  const auto result =
+      pool.run({.cmd = "echo \"$WAYBAR_OUTPUT_NAME\"; exit 3", .output_name = "DP-1"});
+  REQUIRE(result.exit_code == 3);
+  REQUIRE(result.out == "DP-1");
+
+  const auto no_read = pool.run({.cmd = "echo discarded", .no_read = true});
+  REQUIRE(no_read.exit_code == 0);
+  REQUIRE(no_read.out.empty());
+
+  const auto truncated = pool.run({.cmd = "echo 0123456789", .max_output = 4});
+  REQUIRE(truncated.exit_code == 0);
+  REQUIRE(truncated.out == "0123");
+}
+
+TEST_CASE("ExecPool limits the concurrent commands", "[util][exec_pool]") {
+  ExecPool pool(2);
+  std::atomic<bool> done = false;
+  std::size_t peak = 0;
+  std::thread watcher([&] {
+    while (!done) {
+      peak = std::max(peak, pool.running());
+      std::this_thread::sleep_for(1ms);
+    }
+  });
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 6; i++) {
+    threads.emplace_back([&pool] { pool.run({.cmd = "sleep 0.05"}); });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  done = true;
+  watcher.join();
+  REQUIRE(peak == 2);
+  REQUIRE(pool.running() == 0);
+  REQUIRE(pool.waiting() == 0);
+}
+
+TEST_CASE("ExecPool starts the earliest deadline first", "[util][exec_pool]") {
+  ExecPool pool(1);
+  // With a single slot, the commands append to the log in the order they started
+  const auto log = std::filesystem::temp_directory_path() /
+                   ("waybar-exec-pool-" + std::to_string(getpid()));
+  std::filesystem::remove(log);
+  auto run = [&pool, &log](const std::string& name, ExecPool::clock::time_point deadline) {
+    pool.run({.cmd = "echo " + name + " >> " + log.string(), .deadline = deadline});
+  };
+
+  std::thread blocker([&pool] { pool.run({.cmd = "sleep 0.2"}); });
+  REQUIRE(waitFor([&pool] { return pool.running() == 1; }));
+  std::thread late(run, "late", ExecPool::deadlineIn(10s));
+  REQUIRE(waitFor([&pool] { return pool.waiting() == 1; }));
+  std::thread urgent(run, "urgent", ExecPool::clock::now());
+  REQUIRE(waitFor([&pool] { return pool.waiting() == 2; }));
+  blocker.join();
+  late.join();
+  urgent.join();
+
+  std::ifstream file(log);
+  std::string first;
+  std::string second;
+  std::getline(file, first);
+  std::getline(file, second);
+  std::filesystem::remove(log);
+  REQUIRE(first == "urgent");
+  REQUIRE(second == "late");
+}
+
+TEST_CASE("ExecPool kills the process group on timeout", "[util][exec_pool]") {
+  ExecPool pool(1);
+  const auto start = std::chrono::steady_clock::now();
+  // The background sleep keeps the output open, it must be killed with the shell
+  const auto result = pool.run({.cmd = "sleep 10 & sleep 10", .timeout = 100ms});
+  REQUIRE(std::chrono::steady_clock::now() - start < 2s);
+  REQUIRE(result.exit_code == ExecPool::TIMEOUT_EXIT_CODE);
+  REQUIRE(pool.timedOut() == 1);
+
+  // A command closing its output is still bound by the timeout
+  const auto closed = pool.run({.cmd = "exec >&-; sleep 10", .timeout = 100ms});
+  REQUIRE(closed.exit_code == ExecPool::TIMEOUT_EXIT_CODE);
+  REQUIRE(std::chrono::steady_clock::now() - start < 4s);
+}
+
+TEST_CASE("ExecPool runs submitted steps on its own threads", "[util][exec_pool]") {
+  ExecPool pool(1);
+  std::atomic<int> calls = 0;
+  waybar::util::command::res result;
+  const auto caller = std::this_thread::get_id();
+  std::thread::id runner;
+  // Returns before the commands ran
+  auto task = pool.submit(std::vector<ExecPool::Request>{{.cmd = "true"}, {.cmd = "echo second"}},
+                          [&](waybar::util::command::res res) {
+                            result = std::move(res);
+                            runner = std::this_thread::get_id();
+                            calls++;
+                          });
+  REQUIRE(waitFor([&calls] { return calls == 1; }));
+  REQUIRE_FALSE(task.pending());
+  REQUIRE(runner != caller);
+  REQUIRE(result.exit_code == 0);
+  REQUIRE(result.out == "second");
+
+  // A failing step ends the job with its result
+  auto failed = pool.submit(
+      std::vector<ExecPool::Request>{{.cmd = "exit 2", .no_read = true}, {.cmd = "echo never"}},
+      [&](waybar::util::command::res res) {
+                              result = std::move(res);
+                              calls++;
+                            });
+  REQUIRE(waitFor([&calls] { return calls == 2; }));
+  REQUIRE(result.exit_code == 2);
+  REQUIRE(result.out.empty());
+}
+
+TEST_CASE("ExecPool tasks cancel their commands", "[util][exec_pool]") {
+  ExecPool pool(1);
+  std::atomic<bool> called = false;
+  const auto start = std::chrono::steady_clock::now();
+  auto task = pool.submit({.cmd = "sleep 10"}, [&called](auto) { called = true; });
+  REQUIRE(waitFor([&pool] { return pool.running() == 1; }));
+  auto queued = pool.submit({.cmd = "echo queued"}, [&called](auto) { called = true; });
+  REQUIRE(task.pending());
+  REQUIRE(queued.pending());
+
+  // The running command is killed, the queued one never starts
+  queued.cancel();
+  task.cancel();
+  REQUIRE(waitFor([&pool] { return pool.running() == 0 && pool.waiting() == 0; }));
+  REQUIRE(std::chrono::steady_clock::now() - start < 2s);
+  REQUIRE_FALSE(called);
+}
+
+TEST_CASE("ExecPool long running commands give their slot back", "[util][exec_pool]") {
+  ExecPool pool(1);
+  auto slow = pool.submit({.cmd = "sleep 10"}, [](auto) {});
+  REQUIRE(waitFor([&pool] { return pool.running() == 1; }));
+  // Starts once the slow one ran for LONG_RUNNING, without waiting for its end
+  const auto result = pool.run({.cmd = "echo fast"});
+  REQUIRE(result.out == "fast");
+  REQUIRE(slow.pending());
+  REQUIRE(pool.running() == 1);
+  slow.cancel();
+  REQUIRE(waitFor([&pool] { return pool.running() == 0; }));
+}
+
+TEST_CASE("ExecPool deadlines don't overflow", "[util][exec_pool]") {
+  REQUIRE(ExecPool::deadlineIn(std::chrono::milliseconds::max()) ==
+          ExecPool::clock::time_point::max());
+  REQUIRE(ExecPool::deadlineIn(1s) > ExecPool::clock::now());
+}
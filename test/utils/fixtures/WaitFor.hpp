@@ -0,0 +1,20 @@
+#pragma once
+
+#include <chrono>
+#include <thread>
+
+/**
+ * Polls `pred` until it holds, for the tests of code running on other threads. False if it still
+ * doesn't after `timeout`.
+ */
+template <typename Pred>
+bool waitFor(Pred pred, std::chrono::milliseconds timeout = std::chrono::seconds(2)) {
+  const auto deadline = std::chrono::steady_clock::now() + timeout;
+  while (!pred()) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return true;
+}
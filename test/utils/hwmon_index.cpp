@@ -0,0 +1,59 @@
+#include "util/hwmon_index.hpp"
+
+#if __has_include(<catch2/catch_test_macros.hpp>)
+#include <catch2/catch_test_macros.hpp>
+#else
+#include <catch2/catch.hpp>
+#endif
+
+#include <unistd.h>
+
+#include <fstream>
+
+namespace fs = std::filesystem;
+using waybar::util::HwmonIndex;
+
+TEST_CASE("HwmonIndex looks devices up by name", "[util][hwmon]") {
+  std::string tmpl = (fs::temp_directory_path() / "waybar-hwmon-XXXXXX").string();
+  REQUIRE(mkdtemp(tmpl.data()) != nullptr);
+  const fs::path root = tmpl;
+
+  auto add = [&root](const char* dir, const char* name) {
+    fs::create_directory(root / dir);
+    std::ofstream(root / dir / "name") << name << '\n';
+  };
+  add("hwmon10", "nvme");
+  add("hwmon2", "k10temp");
+  add("hwmon9", "nvme");
+  fs::create_directory(root / "hwmon3");
+
+  const auto devices = waybar::util::scanHwmon(root);
+  REQUIRE(devices.size() == 4);
+  REQUIRE(devices[0].name == "k10temp");
+  REQUIRE(devices[1].name.empty());
+  REQUIRE(devices[2].dir == root / "hwmon9");
+
+  HwmonIndex index(root);
+  REQUIRE(index.find("nvme") == root / "hwmon9");
+  REQUIRE(index.findContaining("10t") == root / "hwmon2");
+  REQUIRE_FALSE(index.find("amdgpu").has_value());
+  const auto generation = index.generation();
+
+  // Built once, until invalidated
+  add("hwmon4", "amdgpu");
+  REQUIRE_FALSE(index.find("amdgpu").has_value());
+  REQUIRE(index.generation() == generation);
+  index.invalidate();
+  REQUIRE(index.find("amdgpu") == root / "hwmon4");
+  REQUIRE(index.generation() != generation);
+
+  // Only the second device of the same name has the input
+  add("hwmon5", "amdgpu");
+  std::ofstream(root / "hwmon5" / "temp2_input") << "45000\n";
+  index.invalidate();
+  REQUIRE(index.findContaining("amdgpu") == root / "hwmon4");
+  REQUIRE(index.findContaining("amdgpu", "temp2_input") == root / "hwmon5");
+  REQUIRE_FALSE(index.findContaining("amdgpu", "temp3_input").has_value());
+
+  fs::remove_all(root);
+}
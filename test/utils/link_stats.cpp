@@ -0,0 +1,80 @@
+#include "util/link_stats.hpp"
+
+#if __has_include(<catch2/catch_test_macros.hpp>)
+#include <catch2/catch_test_macros.hpp>
+#else
+#include <catch2/catch.hpp>
+#endif
+
+#include <linux/if_link.h>
+#include <linux/rtnetlink.h>
+
+#include <cstring>
+#include <vector>
+
+namespace {
+
+// RTM_NEWLINK message with an IFLA_IFNAME attribute, followed by IFLA_STATS64 if `stats` is set
+std::vector<char> newLinkMessage(const rtnl_link_stats64* stats) {
+  std::vector<char> buffer(NLMSG_SPACE(sizeof(ifinfomsg)) + RTA_SPACE(sizeof("eth0")) +
+                           RTA_SPACE(sizeof(rtnl_link_stats64)));
+  auto* message = reinterpret_cast<nlmsghdr*>(buffer.data());
+  message->nlmsg_type = RTM_NEWLINK;
+  message->nlmsg_len = NLMSG_LENGTH(sizeof(ifinfomsg));
+
+  auto append = [message](unsigned short type, const void* data, std::size_t size) {
+    auto* rta = reinterpret_cast<rtattr*>(reinterpret_cast<char*>(message) +
+                                          NLMSG_ALIGN(message->nlmsg_len));
+    rta->rta_type = type;
+    rta->rta_len = RTA_LENGTH(size);
+    std::memcpy(RTA_DATA(rta), data, size);
+    message->nlmsg_len = NLMSG_ALIGN(message->nlmsg_len) + RTA_ALIGN(rta->rta_len);
+  };
+  append(IFLA_IFNAME, "eth0", sizeof("eth0"));
+  if (stats != nullptr) {
+    append(IFLA_STATS64, stats, sizeof(*stats));
+  }
+  return buffer;
+}
+
+}  // namespace
+
+TEST_CASE("parseNetDev finds the counters of an interface", "[util][link_stats]") {
+  constexpr std::string_view NETDEV =
+      "Inter-|   Receive                                                |  Transmit\n"
+      " face |bytes    packets errs drop fifo frame compressed multicast|bytes    packets errs "
+      "drop fifo colls carrier compressed\n"
+      "    lo:    1234      10    0    0    0     0          0         0     1234      10    0 "
+      "   0    0     0       0          0\n"
+      "enp3s0: 98765432109   72345    0    3    0     0          0       120 5678901   41234    0 "
+      "   0    0     0       0          0\n";
+
+  auto counters = waybar::util::parseNetDev(NETDEV, "enp3s0");
+  REQUIRE(counters.has_value());
+  REQUIRE(counters->rx_bytes == 98765432109);
+  REQUIRE(counters->tx_bytes == 5678901);
+
+  counters = waybar::util::parseNetDev(NETDEV, "lo");
+  REQUIRE(counters.has_value());
+  REQUIRE(counters->rx_bytes == 1234);
+
+  REQUIRE_FALSE(waybar::util::parseNetDev(NETDEV, "eth0").has_value());
+  REQUIRE_FALSE(waybar::util::parseNetDev(NETDEV, "enp3").has_value());
+}
+
+TEST_CASE("parseLinkStats reads IFLA_STATS64", "[util][link_stats]") {
+  rtnl_link_stats64 stats{};
+  stats.rx_bytes = 1ULL << 40;
+  stats.tx_bytes = 123456789;
+  stats.rx_packets = 42;
+
+  auto message = newLinkMessage(&stats);
+  auto counters = waybar::util::parseLinkStats(reinterpret_cast<const nlmsghdr*>(message.data()));
+  REQUIRE(counters.has_value());
+  REQUIRE(counters->rx_bytes == 1ULL << 40);
+  REQUIRE(counters->tx_bytes == 123456789);
+
+  message = newLinkMessage(nullptr);
+  REQUIRE_FALSE(
+      waybar::util::parseLinkStats(reinterpret_cast<const nlmsghdr*>(message.data())).has_value());
+}
@@ -0,0 +1,117 @@
+#include "util/module_config.hpp"
+
+#if __has_include(<catch2/catch_test_macros.hpp>)
+#include <catch2/catch_test_macros.hpp>
+#else
+#include <catch2/catch.hpp>
+#endif
+
+using waybar::util::ModuleConfig;
+
+TEST_CASE("ModuleConfig resolves formats by state", "[util][module_config]") {
+  Json::Value json;
+  json["format"] = "{capacity}%";
+  json["format-charging"] = "{capacity}% charging";
+  json["format-charging-warning"] = "";
+  json["interval"] = 30;
+  ModuleConfig config(json);
+
+  REQUIRE(*config.string("format") == "{capacity}%");
+  REQUIRE(*config.string("format", "charging") == "{capacity}% charging");
+  REQUIRE(config.string("format", "charging", "warning")->empty());
+  REQUIRE(config.string("format", "discharging") == nullptr);
+  REQUIRE(config.string("format", "") == nullptr);
+  REQUIRE(config.string("interval") == nullptr);
+  REQUIRE(config.string("format", std::string(300, 'x')) == nullptr);
+
+  const std::string fallback = "{}";
+  REQUIRE(config.resolve("format", "charging", fallback) == "{capacity}% charging");
+  REQUIRE(config.resolve("format", "full", fallback) == "{capacity}%");
+  REQUIRE(&config.resolve("tooltip-format", "", fallback) == &fallback);
+  REQUIRE(*ModuleConfig::first({config.string("format", "full"), config.string("format")}) ==
+          "{capacity}%");
+}
+
+TEST_CASE("ModuleConfig compiles the configured formats", "[util][module_config]") {
+  Json::Value json;
+  json["format"] = "{usage}%";
+  json["tooltip-format-critical"] = "{usage0} {usage1}";
+  json["on-click"] = "{not a format}";
+  ModuleConfig config(json);
+
+  REQUIRE(config.compiled("{usage}%") != nullptr);
+  REQUIRE(config.compiled("{usage0} {usage1}")->uses("usage1"));
+  REQUIRE(config.compiled("{not a format}") == nullptr);
+  REQUIRE(config.compiled("{usage}") == nullptr);
+
+  REQUIRE(config.anyFormatUses([](const std::string& name) { return name == "usage1"; }));
+  REQUIRE_FALSE(config.anyFormatUses([](const std::string& name) { return name == "not"; }));
+  json["format-alt"] = "{}";
+  REQUIRE(ModuleConfig(json).anyFormatUses([](const std::string&) { return false; }));
+}
+
+TEST_CASE("ModuleConfig sorts states both ways", "[util][module_config]") {
+  Json::Value json;
+  json["states"]["good"] = 95;
+  json["states"]["warning"] = 30;
+  json["states"]["critical"] = 15;
+  json["states"]["invalid"] = "high";
+  ModuleConfig config(json);
+
+  REQUIRE(config.states(false).size() == 3);
+  REQUIRE(config.state(99, false)->name == "good");
+  REQUIRE(config.state(50, false)->name == "warning");
+  REQUIRE(config.state(10, false) == nullptr);
+
+  REQUIRE(config.state(10, true)->name == "critical");
+  REQUIRE(config.state(20, true)->name == "warning");
+  REQUIRE(config.state(90, true)->name == "good");
+  REQUIRE(config.state(99, true) == nullptr);
+}
+
+TEST_CASE("ModuleConfig flattens format-icons", "[util][module_config]") {
+  SECTION("list spread over the range") {
+    Json::Value json;
+    for (const auto* icon : {"a", "b", "c", "d"}) {
+      json["format-icons"].append(icon);
+    }
+    ModuleConfig config(json);
+    const auto* icons = config.icons({"ignored"});
+    REQUIRE(icons != nullptr);
+    REQUIRE(icons->get(0, 0) == "a");
+    REQUIRE(icons->get(49, 0) == "b");
+    REQUIRE(icons->get(100, 0) == "d");
+    REQUIRE(icons->get(3, 8) == "b");
+  }
+  SECTION("per alt with default") {
+    Json::Value json;
+    json["format-icons"]["default"] = "d";
+    json["format-icons"]["muted"] = "m";
+    json["format-icons"]["nested"]["x"] = "ignored";
+    ModuleConfig config(json);
+    REQUIRE(config.icons({"muted"})->get(0, 0) == "m");
+    REQUIRE(config.icons({"nested"})->get(0, 0) == "d");
+    REQUIRE(config.icons(std::vector<std::string>{"", "other", "muted"})->get(0, 0) == "m");
+  }
+  SECTION("thresholds") {
+    Json::Value json;
+    Json::Value low;
+    low["icon"] = "low";
+    low["max"] = 20;
+    Json::Value high;
+    high["icon"] = "high";
+    high["max"] = 80;
+    json["format-icons"].append(low);
+    json["format-icons"].append("invalid");
+    json["format-icons"].append(high);
+    ModuleConfig config(json);
+    const auto* icons = config.icons({});
+    REQUIRE(icons->get(10, 0) == "low");
+    REQUIRE(icons->get(50, 0) == "high");
+    REQUIRE(icons->get(90, 0) == "high");
+  }
+  SECTION("none") {
+    ModuleConfig config(Json::Value{});
+    REQUIRE(config.icons({"any"}) == nullptr);
+  }
+}
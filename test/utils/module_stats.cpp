@@ -0,0 +1,60 @@
+#include "util/module_stats.hpp"
+
+#if __has_include(<catch2/catch_test_macros.hpp>)
+#include <catch2/catch_test_macros.hpp>
+#else
+#include <catch2/catch.hpp>
+#endif
+
+#include <chrono>
+
+using waybar::util::ModuleStats;
+
+TEST_CASE("ModuleStats attributes work to the current scope", "[util][stats]") {
+  ModuleStats::setEnabled(true);
+  auto stats = ModuleStats::create("test#attribution");
+
+  ModuleStats::addBytesRead(10);
+  REQUIRE(stats->bytes_read == 0);
+  {
+    ModuleStats::Scope scope(stats.get(), &ModuleStats::sample_time);
+    REQUIRE(ModuleStats::current() == stats.get());
+    ModuleStats::addBytesRead(10);
+    ModuleStats::addChildSpawned();
+  }
+  REQUIRE(ModuleStats::current() == nullptr);
+  REQUIRE(stats->bytes_read == 10);
+  REQUIRE(stats->children_spawned == 1);
+
+  const auto json = ModuleStats::dump()["test#attribution"];
+  REQUIRE(json["bytes_read"].asUInt64() == 10);
+  REQUIRE(json["sample_time"]["count"].asUInt64() == 1);
+  REQUIRE(json["update_time"]["count"].asUInt64() == 0);
+  ModuleStats::setEnabled(false);
+}
+
+TEST_CASE("ModuleStats records nothing while disabled", "[util][stats]") {
+  ModuleStats::setEnabled(false);
+  auto stats = ModuleStats::create("test#disabled");
+  {
+    ModuleStats::Scope scope(stats.get(), &ModuleStats::update_time);
+    REQUIRE(ModuleStats::current() == nullptr);
+    ModuleStats::addChildSpawned();
+  }
+  REQUIRE(stats->children_spawned == 0);
+  REQUIRE(ModuleStats::dump()["test#disabled"]["update_time"]["count"].asUInt64() == 0);
+}
+
+TEST_CASE("LatencyHistogram buckets by powers of two microseconds", "[util][stats]") {
+  waybar::util::LatencyHistogram histogram;
+  histogram.record(std::chrono::nanoseconds(500));
+  histogram.record(std::chrono::microseconds(3));
+  histogram.record(std::chrono::seconds(10));
+
+  const auto json = histogram.toJson();
+  REQUIRE(json["count"].asUInt64() == 3);
+  REQUIRE(json["max_us"].asUInt64() == 10000000);
+  REQUIRE(json["buckets"]["<1us"].asUInt64() == 1);
+  REQUIRE(json["buckets"]["<4us"].asUInt64() == 1);
+  REQUIRE(json["buckets"][">=262144us"].asUInt64() == 1);
+}
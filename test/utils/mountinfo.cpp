@@ -0,0 +1,33 @@
+#include "util/mountinfo.hpp"
+
+#if __has_include(<catch2/catch_test_macros.hpp>)
+#include <catch2/catch_test_macros.hpp>
+#else
+#include <catch2/catch.hpp>
+#endif
+
+using waybar::util::findMount;
+using waybar::util::parseMountinfo;
+
+TEST_CASE("Mountinfo maps paths to their mount", "[util][mountinfo]") {
+  const auto mounts = parseMountinfo(
+      "22 1 259:2 / / rw,relatime shared:1 - ext4 /dev/nvme0n1p2 rw\n"
+      "40 22 0:35 / /home rw,relatime shared:20 - btrfs /dev/nvme0n1p3 rw\n"
+      "41 22 0:36 / /mnt/My\\040Files rw - nfs4 server:/export rw,vers=4.2\n"
+      "malformed line\n"
+      "42 22 0:37 / /home rw - tmpfs tmpfs rw\n");
+  REQUIRE(mounts.size() == 4);
+  REQUIRE(mounts[0].major == 259);
+  REQUIRE(mounts[0].minor == 2);
+  REQUIRE(mounts[0].source == "/dev/nvme0n1p2");
+  REQUIRE(mounts[2].mount_point == "/mnt/My Files");
+  REQUIRE(mounts[2].fstype == "nfs4");
+  REQUIRE(mounts[2].source == "server:/export");
+
+  REQUIRE(findMount(mounts, "/")->fstype == "ext4");
+  REQUIRE(findMount(mounts, "/homer")->fstype == "ext4");
+  // Stacked on /home, the last one is visible
+  REQUIRE(findMount(mounts, "/home/user/../user")->fstype == "tmpfs");
+  REQUIRE(findMount(mounts, "/mnt/My Files/a")->fstype == "nfs4");
+  REQUIRE(findMount(mounts, "relative") == nullptr);
+}
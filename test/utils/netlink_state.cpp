@@ -0,0 +1,233 @@
+#include "util/netlink_state.hpp"
+
+#if __has_include(<catch2/catch_test_macros.hpp>)
+#include <catch2/catch_test_macros.hpp>
+#else
+#include <catch2/catch.hpp>
+#endif
+
+#include <arpa/inet.h>
+#include <linux/genetlink.h>
+#include <linux/if_addr.h>
+#include <linux/if_link.h>
+#include <linux/nl80211.h>
+#include <linux/rtnetlink.h>
+#include <net/if.h>
+
+#include <cstring>
+#include <optional>
+#include <vector>
+
+using waybar::util::NetlinkChange;
+using waybar::util::NetlinkNotification;
+using waybar::util::NetlinkState;
+
+namespace {
+
+// Builds a rtnetlink message: a header, a family specific struct, then attributes
+class Message {
+ public:
+  template <typename T>
+  Message(uint16_t type, const T& body) : buffer_(8192) {
+    header()->nlmsg_type = type;
+    header()->nlmsg_len = NLMSG_LENGTH(sizeof(body));
+    std::memcpy(NLMSG_DATA(header()), &body, sizeof(body));
+  }
+
+  Message& attribute(unsigned short type, const void* data, std::size_t size) {
+    auto* rta = reinterpret_cast<rtattr*>(buffer_.data() + NLMSG_ALIGN(header()->nlmsg_len));
+    rta->rta_type = type;
+    rta->rta_len = RTA_LENGTH(size);
+    std::memcpy(RTA_DATA(rta), data, size);
+    header()->nlmsg_len = NLMSG_ALIGN(header()->nlmsg_len) + RTA_ALIGN(rta->rta_len);
+    return *this;
+  }
+
+  Message& address(unsigned short type, int family, const char* text) {
+    unsigned char data[16];
+    inet_pton(family, text, data);
+    return attribute(type, data, family == AF_INET ? 4 : 16);
+  }
+
+  const nlmsghdr* get() const { return reinterpret_cast<const nlmsghdr*>(buffer_.data()); }
+
+ private:
+  nlmsghdr* header() { return reinterpret_cast<nlmsghdr*>(buffer_.data()); }
+
+  std::vector<char> buffer_;
+};
+
+Message link(uint16_t type, int index, const char* ifname, unsigned int flags) {
+  ifinfomsg ifi{};
+  ifi.ifi_index = index;
+  ifi.ifi_flags = flags;
+  Message message(type, ifi);
+  message.attribute(IFLA_IFNAME, ifname, std::strlen(ifname) + 1);
+  return message;
+}
+
+Message address(uint16_t type, int index, const char* text, uint8_t prefixlen) {
+  ifaddrmsg ifa{};
+  ifa.ifa_family = AF_INET;
+  ifa.ifa_index = index;
+  ifa.ifa_prefixlen = prefixlen;
+  ifa.ifa_scope = RT_SCOPE_UNIVERSE;
+  Message message(type, ifa);
+  message.address(IFA_ADDRESS, AF_INET, text).address(IFA_LOCAL, AF_INET, text);
+  return message;
+}
+
+Message route(uint16_t type, int oif, const char* gateway, uint32_t priority) {
+  rtmsg rtm{};
+  rtm.rtm_family = AF_INET;
+  rtm.rtm_table = RT_TABLE_MAIN;
+  Message message(type, rtm);
+  message.address(RTA_GATEWAY, AF_INET, gateway)
+      .attribute(RTA_OIF, &oif, sizeof(oif))
+      .attribute(RTA_PRIORITY, &priority, sizeof(priority));
+  return message;
+}
+
+// An nl80211 event, its attributes have the layout of the rtnetlink ones
+Message nl80211(uint8_t cmd, std::optional<uint32_t> ifindex) {
+  genlmsghdr genl{};
+  genl.cmd = cmd;
+  Message message(GENL_MIN_ID, genl);
+  if (ifindex.has_value()) {
+    message.attribute(NL80211_ATTR_IFINDEX, &*ifindex, sizeof(*ifindex));
+  }
+  return message;
+}
+
+Message cqm(uint32_t ifindex, int32_t rssi_level) {
+  std::vector<char> nested(NLA_HDRLEN + sizeof(rssi_level));
+  auto* nla = reinterpret_cast<nlattr*>(nested.data());
+  nla->nla_type = NL80211_ATTR_CQM_RSSI_LEVEL;
+  nla->nla_len = nested.size();
+  std::memcpy(nested.data() + NLA_HDRLEN, &rssi_level, sizeof(rssi_level));
+  auto message = nl80211(NL80211_CMD_NOTIFY_CQM, ifindex);
+  message.attribute(NL80211_ATTR_CQM | NLA_F_NESTED, nested.data(), nested.size());
+  return message;
+}
+
+}  // namespace
+
+TEST_CASE("NetlinkState tracks links, addresses and default routes", "[util][netlink]") {
+  NetlinkState state;
+
+  SECTION("Links") {
+    auto message = link(RTM_NEWLINK, 2, "enp3s0", IFF_UP);
+    uint8_t carrier = 1;
+    message.attribute(IFLA_CARRIER, &carrier, sizeof(carrier));
+    auto change = state.apply(message.get());
+    REQUIRE(change.kind == NetlinkChange::Kind::LINK);
+    REQUIRE(change.index == 2);
+    REQUIRE(state.links().at(2).ifname == "enp3s0");
+    REQUIRE(state.links().at(2).carrier == true);
+
+    state.apply(link(RTM_DELLINK, 2, "enp3s0", 0).get());
+    REQUIRE(state.links().empty());
+  }
+
+  SECTION("Addresses") {
+    state.apply(address(RTM_NEWADDR, 2, "192.0.2.10", 24).get());
+    auto change = state.apply(address(RTM_NEWADDR, 2, "198.51.100.4", 24).get());
+    REQUIRE(change.kind == NetlinkChange::Kind::ADDRESS);
+    REQUIRE(state.addresses().size() == 2);
+    REQUIRE(state.addresses()[0].local == "192.0.2.10");
+
+    // Renewed, not duplicated
+    state.apply(address(RTM_NEWADDR, 2, "192.0.2.10", 24).get());
+    REQUIRE(state.addresses().size() == 2);
+
+    state.apply(address(RTM_DELADDR, 2, "192.0.2.10", 24).get());
+    REQUIRE(state.addresses().size() == 1);
+    REQUIRE(state.addresses()[0].address == "198.51.100.4");
+    REQUIRE(state.addresses()[0].prefixlen == 24);
+  }
+
+  SECTION("Default routes") {
+    state.apply(link(RTM_NEWLINK, 2, "enp3s0", IFF_UP).get());
+    auto change = state.apply(route(RTM_NEWROUTE, 2, "192.0.2.1", 100).get());
+    REQUIRE(change.kind == NetlinkChange::Kind::ROUTE);
+    REQUIRE(change.index == 2);
+    REQUIRE(state.routes().size() == 1);
+    REQUIRE(state.routes()[0].gateway == "192.0.2.1");
+    REQUIRE(state.routes()[0].priority == 100);
+
+    // Routes to a destination aren't tracked
+    auto subnet = route(RTM_NEWROUTE, 2, "192.0.2.1", 100);
+    subnet.address(RTA_DST, AF_INET, "203.0.113.0");
+    REQUIRE(state.apply(subnet.get()).kind == NetlinkChange::Kind::NONE);
+    REQUIRE(state.routes().size() == 1);
+
+    // They are flushed when the link goes down
+    state.apply(link(RTM_NEWLINK, 2, "enp3s0", 0).get());
+    REQUIRE(state.routes().empty());
+  }
+
+  SECTION("A dump drops what it doesn't list") {
+    state.apply(link(RTM_NEWLINK, 2, "enp3s0", IFF_UP).get());
+    state.apply(link(RTM_NEWLINK, 3, "wlp2s0", IFF_UP).get());
+    state.apply(address(RTM_NEWADDR, 3, "192.0.2.10", 24).get());
+
+    state.beginDump(RTM_GETLINK);
+    state.apply(link(RTM_NEWLINK, 3, "wlp2s0", IFF_UP).get());
+    state.endDump();
+    REQUIRE(state.links().size() == 1);
+    REQUIRE(state.links().contains(3));
+    // Other kinds are left to their own dump
+    REQUIRE(state.addresses().size() == 1);
+  }
+}
+
+TEST_CASE("nl80211 events are parsed into wireless changes", "[util][netlink]") {
+  SECTION("Association changes") {
+    for (const auto cmd : {NL80211_CMD_CONNECT, NL80211_CMD_DISCONNECT}) {
+      auto change = waybar::util::parseNl80211Event(nl80211(cmd, 3).get());
+      REQUIRE(change.kind == NetlinkChange::Kind::WIRELESS);
+      REQUIRE(change.index == 3);
+      REQUIRE_FALSE(change.signal_dbm.has_value());
+
+      // Subscribers query the association again
+      NetlinkNotification notification;
+      notification.add(change);
+      REQUIRE(notification.wireless);
+      REQUIRE_FALSE(notification.state);
+      REQUIRE_FALSE(notification.signal_dbm.has_value());
+    }
+  }
+
+  SECTION("Signal threshold crossed") {
+    auto change = waybar::util::parseNl80211Event(cqm(3, -70).get());
+    REQUIRE(change.kind == NetlinkChange::Kind::WIRELESS);
+    REQUIRE(change.index == 3);
+    REQUIRE(change.signal_dbm == -70);
+
+    // The level pushed is used as is, the latest one of a batch wins
+    NetlinkNotification notification;
+    notification.add(change);
+    notification.add(waybar::util::parseNl80211Event(cqm(3, -55).get()));
+    REQUIRE_FALSE(notification.wireless);
+    REQUIRE(notification.signal_dbm == -55);
+
+    // Without the level, the state is queried
+    auto no_level = waybar::util::parseNl80211Event(nl80211(NL80211_CMD_NOTIFY_CQM, 3).get());
+    REQUIRE(no_level.kind == NetlinkChange::Kind::WIRELESS);
+    REQUIRE_FALSE(no_level.signal_dbm.has_value());
+  }
+
+  SECTION("Ignored events") {
+    auto scan = waybar::util::parseNl80211Event(nl80211(NL80211_CMD_TRIGGER_SCAN, 3).get());
+    REQUIRE(scan.kind == NetlinkChange::Kind::NONE);
+    auto no_index =
+        waybar::util::parseNl80211Event(nl80211(NL80211_CMD_CONNECT, std::nullopt).get());
+    REQUIRE(no_index.kind == NetlinkChange::Kind::NONE);
+
+    NetlinkNotification notification;
+    REQUIRE(notification.empty());
+    notification.add(NetlinkChange{.kind = NetlinkChange::Kind::LINK, .index = 3});
+    REQUIRE(notification.state);
+    REQUIRE_FALSE(notification.empty());
+  }
+}
@@ -0,0 +1,61 @@
+#include "util/power_supply.hpp"
+
+#if __has_include(<catch2/catch_test_macros.hpp>)
+#include <catch2/catch_test_macros.hpp>
+#else
+#include <catch2/catch.hpp>
+#endif
+
+#include <unistd.h>
+
+#include <fstream>
+
+namespace fs = std::filesystem;
+using waybar::util::PowerSupply;
+using waybar::util::PowerSupplyReadings;
+
+TEST_CASE("PowerSupply parses the uevent properties", "[util][power_supply]") {
+  PowerSupplyReadings readings;
+  waybar::util::parsePowerSupplyUevent(
+      "DEVTYPE=power_supply\n"
+      "POWER_SUPPLY_NAME=BAT0\n"
+      "POWER_SUPPLY_STATUS=Not charging\n"
+      "POWER_SUPPLY_CURRENT_NOW=-1250000\n"
+      "POWER_SUPPLY_ENERGY_FULL_DESIGN=57000000\n"
+      "POWER_SUPPLY_CAPACITY=80\n"
+      "POWER_SUPPLY_CYCLE_COUNT=\n",
+      readings);
+  REQUIRE(readings.status == "Not charging");
+  REQUIRE(readings.current_now == -1250000);
+  REQUIRE(readings.energy_full_design == 57000000);
+  REQUIRE(readings.capacity == 80);
+  REQUIRE_FALSE(readings.cycle_count.has_value());
+  REQUIRE_FALSE(readings.energy_full.has_value());
+
+  readings.clear();
+  REQUIRE(readings.empty());
+}
+
+TEST_CASE("PowerSupply falls back to the attribute files", "[util][power_supply]") {
+  std::string tmpl = (fs::temp_directory_path() / "waybar-power-supply-XXXXXX").string();
+  REQUIRE(mkdtemp(tmpl.data()) != nullptr);
+  const fs::path dir = tmpl;
+
+  // A uevent without properties, as mocked devices have
+  std::ofstream(dir / "uevent") << "POWER_SUPPLY_NAME=BAT0\n";
+  std::ofstream(dir / "status") << "Discharging\n";
+  std::ofstream(dir / "capacity") << "55\n";
+  PowerSupply supply(dir);
+  const auto& attributes = supply.read();
+  REQUIRE(attributes.status == "Discharging");
+  REQUIRE(attributes.capacity == 55);
+  REQUIRE_FALSE(attributes.power_now.has_value());
+
+  std::ofstream(dir / "uevent") << "POWER_SUPPLY_STATUS=Charging\nPOWER_SUPPLY_POWER_NOW=7\n";
+  const auto& uevent = supply.read();
+  REQUIRE(uevent.status == "Charging");
+  REQUIRE(uevent.power_now == 7);
+  REQUIRE_FALSE(uevent.capacity.has_value());
+
+  fs::remove_all(dir);
+}
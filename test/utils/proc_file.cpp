@@ -0,0 +1,83 @@
+#include "util/proc_file.hpp"
+
+#if __has_include(<catch2/catch_test_macros.hpp>)
+#include <catch2/catch_test_macros.hpp>
+#else
+#include <catch2/catch.hpp>
+#endif
+
+#include <fmt/format.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+namespace fs = std::filesystem;
+using waybar::util::ProcFile;
+
+TEST_CASE("ProcFile reads the current content on every call", "[util][proc_file]") {
+  std::string path = (fs::temp_directory_path() / "waybar-proc-file-XXXXXX").string();
+  const int fd = mkstemp(path.data());
+  REQUIRE(fd != -1);
+  close(fd);
+
+  std::ofstream(path) << "cpu  1 2 3\n";
+  ProcFile file(path);
+  REQUIRE(file.isOpen());
+  REQUIRE(file.read() == "cpu  1 2 3\n");
+
+  // Larger than the initial buffer
+  const std::string large(10000, 'x');
+  std::ofstream(path, std::ios::trunc) << large;
+  REQUIRE(file.read() == large);
+
+  std::ofstream(path, std::ios::trunc) << "short";
+  REQUIRE(file.read() == "short");
+
+  fs::remove(path);
+  REQUIRE_THROWS_AS(ProcFile(path).read(), std::runtime_error);
+}
+
+TEST_CASE("ProcFile reads seq files of several pages to the end", "[util][proc_file]") {
+  // Alternating protections keep the mappings apart, a line each in /proc/self/maps
+  const auto page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+  constexpr int MAPPINGS = 256;
+  auto* area = static_cast<char*>(
+      mmap(nullptr, page * MAPPINGS, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+  REQUIRE(area != MAP_FAILED);
+  for (int i = 0; i < MAPPINGS; i += 2) {
+    mprotect(area + page * i, page, PROT_READ);
+  }
+
+  ProcFile file("/proc/self/maps");
+  const std::string maps(file.read());
+  REQUIRE(maps.size() > 4 * page);
+  REQUIRE(maps.back() == '\n');
+  for (int i = 0; i < MAPPINGS; i++) {
+    const auto start = reinterpret_cast<uintptr_t>(area + page * i);
+    REQUIRE(maps.find(fmt::format("\n{:x}-", start)) != std::string::npos);
+  }
+  munmap(area, page * MAPPINGS);
+}
+
+TEST_CASE("ProcFile scans lines of unsigned numbers", "[util][proc_file]") {
+  std::string_view text = "cpu0 437718  1517\tx\nlast";
+  auto line = waybar::util::nextLine(text);
+  REQUIRE(line == "cpu0 437718  1517\tx");
+  REQUIRE(text == "last");
+
+  line.remove_prefix(4);
+  size_t value = 0;
+  REQUIRE(waybar::util::scanUnsigned(line, value));
+  REQUIRE(value == 437718);
+  REQUIRE(waybar::util::scanUnsigned(line, value));
+  REQUIRE(value == 1517);
+  REQUIRE_FALSE(waybar::util::scanUnsigned(line, value));
+  REQUIRE(line == "\tx");
+
+  REQUIRE(waybar::util::nextLine(text) == "last");
+  REQUIRE(text.empty());
+}
@@ -0,0 +1,101 @@
+#if __has_include(<catch2/catch_test_macros.hpp>)
+#include <catch2/catch_test_macros.hpp>
+#else
+#include <catch2/catch.hpp>
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#include "fixtures/WaitFor.hpp"
+#include "util/shared_sampler.hpp"
+
+using namespace std::chrono_literals;
+using waybar::util::SharedSampler;
+
+TEST_CASE("SharedSampler runs one sampler for all subscribers of a key",
+          "[util][shared_sampler]") {
+  std::atomic<int> samples = 0;
+  std::atomic<int> first_notified = 0;
+  std::atomic<int> second_notified = 0;
+  auto sampler = [&samples] { return ++samples; };
+
+  auto first = SharedSampler<int>::subscribe("test@max", std::chrono::milliseconds::max(),
+                                             sampler, [&first_notified] { first_notified++; });
+  REQUIRE(waitFor([&first_notified] { return first_notified == 1; }));
+
+  auto second = SharedSampler<int>::subscribe("test@max", std::chrono::milliseconds::max(),
+                                              sampler, [&second_notified] { second_notified++; });
+  // The late subscriber is handed the existing sample instead of triggering a new one
+  REQUIRE(second_notified == 1);
+  REQUIRE(samples == 1);
+  REQUIRE(*first.snapshot() == 1);
+  REQUIRE(*second.snapshot() == 1);
+
+  second.refresh();
+  REQUIRE(waitFor([&] { return first_notified == 2 && second_notified == 2; }));
+  REQUIRE(samples == 2);
+  REQUIRE(*first.snapshot() == 2);
+}
+
+TEST_CASE("SharedSampler keeps distinct keys apart and restarts released sources",
+          "[util][shared_sampler]") {
+  std::atomic<int> a_samples = 0;
+  std::atomic<int> b_samples = 0;
+  {
+    auto a = SharedSampler<int>::subscribe(
+        "a@max", std::chrono::milliseconds::max(), [&a_samples] { return ++a_samples; }, [] {});
+    auto b = SharedSampler<int>::subscribe(
+        "b@max", std::chrono::milliseconds::max(), [&b_samples] { return ++b_samples; }, [] {});
+    REQUIRE(waitFor([&] { return a_samples == 1 && b_samples == 1; }));
+  }
+
+  auto a = SharedSampler<int>::subscribe(
+      "a@max", std::chrono::milliseconds::max(), [&a_samples] { return ++a_samples; }, [] {});
+  REQUIRE(waitFor([&a_samples] { return a_samples == 2; }));
+  REQUIRE(*a.snapshot() == 2);
+}
+
+TEST_CASE("SharedSampler publishes asynchronous samples", "[util][shared_sampler]") {
+  std::atomic<int> started = 0;
+  std::atomic<int> notified = 0;
+  SharedSampler<int>::Publish pending;
+  std::mutex mutex;
+  auto sub = SharedSampler<int>::subscribeAsync(
+      "async@max", std::chrono::milliseconds::max(),
+      [&](SharedSampler<int>::Publish publish) {
+        std::lock_guard lock(mutex);
+        pending = std::move(publish);
+        started++;
+      },
+      [&notified] { notified++; });
+  REQUIRE(waitFor([&started] { return started == 1; }));
+
+  // No other sample starts while one is in flight, the refresh waits for its end
+  sub.refresh();
+  std::this_thread::sleep_for(20ms);
+  REQUIRE(started == 1);
+  REQUIRE(notified == 0);
+
+  {
+    std::lock_guard lock(mutex);
+    pending(42);
+  }
+  REQUIRE(notified == 1);
+  REQUIRE(*sub.snapshot() == 42);
+  REQUIRE(waitFor([&started] { return started == 2; }));
+
+  {
+    std::lock_guard lock(mutex);
+    pending(43);
+  }
+  REQUIRE(notified == 2);
+  // Nothing was asked meanwhile
+  std::this_thread::sleep_for(20ms);
+  REQUIRE(started == 2);
+
+  sub.refresh();
+  REQUIRE(waitFor([&started] { return started == 3; }));
+}
@@ -68,6 +68,23 @@ int run_control_flag_stress() {
   }
   return 0;
 }
+
+int run_stop_interrupts_blocking_wait() {
+  int fds[2];
+  if (pipe(fds) != 0) {
+    return 1;
+  }
+  const auto start = std::chrono::steady_clock::now();
+  {
+    waybar::util::SleeperThread thread;
+    // Nothing is ever written to the pipe, only stop() can end the wait
+    thread = [&thread, &fds] { thread.waitReadable(fds[0]); };
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  close(fds[0]);
+  close(fds[1]);
+  return std::chrono::steady_clock::now() - start < std::chrono::seconds(1) ? 0 : 1;
+}
 }  // namespace
 
 TEST_CASE("SleeperThread reassignment does not terminate process", "[util][sleeper_thread]") {
@@ -78,3 +95,8 @@ TEST_CASE("SleeperThread control flags are stable under concurrent wake and stop
           "[util][sleeper_thread]") {
   REQUIRE(run_in_subprocess(run_control_flag_stress) == 0);
 }
+
+TEST_CASE("SleeperThread stop interrupts a worker blocked on a file descriptor",
+          "[util][sleeper_thread]") {
+  REQUIRE(run_in_subprocess(run_stop_interrupts_blocking_wait) == 0);
+}
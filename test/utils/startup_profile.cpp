@@ -0,0 +1,34 @@
+#include "util/startup_profile.hpp"
+
+#if __has_include(<catch2/catch_test_macros.hpp>)
+#include <catch2/catch_test_macros.hpp>
+#else
+#include <catch2/catch.hpp>
+#endif
+
+using waybar::util::StartupProfile;
+
+TEST_CASE("StartupProfile reports once every expected frame is done", "[util][startup]") {
+  StartupProfile::enable();
+  REQUIRE(StartupProfile::enabled());
+  { StartupProfile::Span span("config"); }
+
+  StartupProfile::expectFrame();
+  StartupProfile::expectFrame();
+  StartupProfile::frameDone("DP-1");
+  StartupProfile::batchDone();
+  REQUIRE(StartupProfile::enabled());
+
+  StartupProfile::frameDone("DP-2");
+  REQUIRE_FALSE(StartupProfile::enabled());
+}
+
+TEST_CASE("StartupProfile reports right away without bars", "[util][startup]") {
+  StartupProfile::enable();
+  StartupProfile::batchDone();
+  REQUIRE_FALSE(StartupProfile::enabled());
+  // Recording stops after the report
+  StartupProfile::expectFrame();
+  StartupProfile::mark("late");
+  REQUIRE_FALSE(StartupProfile::enabled());
+}
@@ -0,0 +1,71 @@
+#include "util/update_dispatcher.hpp"
+
+#include <glibmm.h>
+
+#if __has_include(<catch2/catch_test_macros.hpp>)
+#include <catch2/catch_test_macros.hpp>
+#else
+#include <catch2/catch.hpp>
+#endif
+#include <memory>
+#include <thread>
+
+#include "fixtures/GlibTestsFixture.hpp"
+
+using waybar::util::UpdateDispatcher;
+
+/**
+ * A burst of emits between two main loop iterations results in a single handler call
+ */
+TEST_CASE_METHOD(GlibTestsFixture, "UpdateDispatcher coalesces emits", "[util][dispatcher]") {
+  int count = 0;
+  UpdateDispatcher dispatcher;
+  dispatcher.connect([&count] { count++; });
+
+  setTimeout(500);
+
+  run([&] {
+    for (int i = 0; i < 100; ++i) {
+      dispatcher.emit();
+    }
+    REQUIRE(count == 0);
+    Glib::signal_idle().connect_once([this] { quit(); }, Glib::PRIORITY_LOW);
+  });
+
+  REQUIRE(count == 1);
+}
+
+TEST_CASE_METHOD(GlibTestsFixture, "UpdateDispatcher delivers emits on the main thread",
+                 "[util][dispatcher][thread]") {
+  const auto main_tid = std::this_thread::get_id();
+  UpdateDispatcher dispatcher;
+  std::thread producer;
+
+  setTimeout(500);
+
+  dispatcher.connect([&] {
+    REQUIRE(std::this_thread::get_id() == main_tid);
+    quit();
+  });
+
+  run([&] { producer = std::thread([&dispatcher] { dispatcher.emit(); }); });
+
+  producer.join();
+}
+
+TEST_CASE_METHOD(GlibTestsFixture, "UpdateDispatcher drops pending emits on destruction",
+                 "[util][dispatcher]") {
+  bool called = false;
+  auto dispatcher = std::make_unique<UpdateDispatcher>();
+  dispatcher->connect([&called] { called = true; });
+
+  setTimeout(500);
+
+  run([&] {
+    dispatcher->emit();
+    dispatcher.reset();
+    Glib::signal_idle().connect_once([this] { quit(); }, Glib::PRIORITY_LOW);
+  });
+
+  REQUIRE_FALSE(called);
+}